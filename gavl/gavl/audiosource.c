@@ -244,7 +244,11 @@ static int process_input(gavl_audio_source_t * s, gavl_audio_frame_t * f)
     int skipped = gavl_audio_frame_skip(&s->src_format,
                                         f, s->skip_samples);;
     s->skip_samples -= skipped;
-    s->next_pts += skipped;
+
+    /* If all samples of the first frame were skipped, we don't know
+       the time yet */
+    if(s->next_pts != GAVL_TIME_UNDEFINED)
+      s->next_pts += skipped;
 
     if(!f->valid_samples)
       return 0;
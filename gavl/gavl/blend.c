@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <config.h>
 #include <gavl/gavl.h>
 #include <video.h>
 #include <blend.h>
@@ -86,15 +87,177 @@ gavl_overlay_blend_context_init(gavl_overlay_blend_context_t * ctx,
     gavl_find_blend_func_c(ctx,
                            dst_format->pixelformat,
                            &ctx->ovl_format.pixelformat);
+
+#ifdef HAVE_SSE2
+  if(ctx->opt.accel_flags & GAVL_ACCEL_SSE2)
+    {
+    gavl_blend_func_t func;
+    func = gavl_find_blend_func_sse2(ctx,
+                                     dst_format->pixelformat,
+                                     ctx->ovl_format.pixelformat);
+    if(func)
+      ctx->func = func;
+    }
+#endif
   
   gavl_video_format_copy(ovl_format, &ctx->ovl_format);
   return 1;
   }
 
+/* Check if a pixel of the overlay is not fully transparent */
+
+static int pixel_visible(gavl_pixelformat_t pfmt, const uint8_t * ptr, int x)
+  {
+  switch(pfmt)
+    {
+    case GAVL_GRAYA_16:
+      return ptr[2*x+1];
+    case GAVL_GRAYA_32:
+      return ((const uint16_t*)ptr)[2*x+1];
+    case GAVL_GRAYA_FLOAT:
+      return ((const float*)ptr)[2*x+1] > 0.0;
+    case GAVL_RGBA_32:
+    case GAVL_YUVA_32:
+      return ptr[4*x+3];
+    case GAVL_RGBA_64:
+    case GAVL_YUVA_64:
+      return ((const uint16_t*)ptr)[4*x+3];
+    case GAVL_RGBA_FLOAT:
+    case GAVL_YUVA_FLOAT:
+      return ((const float*)ptr)[4*x+3] > 0.0;
+    default:
+      return 1;
+    }
+  }
+
+static int row_visible(gavl_pixelformat_t pfmt, const uint8_t * ptr, int w)
+  {
+  int i;
+  for(i = 0; i < w; i++)
+    {
+    if(pixel_visible(pfmt, ptr, i))
+      return 1;
+    }
+  return 0;
+  }
+
+/*
+ *  Shrink the overlay rectangle to the bounding box of the non
+ *  transparent pixels. Subtitles usually consist of a few lines of
+ *  text in a large, mostly transparent rectangle. Since the overlay is
+ *  blended onto many frames, scanning it once pays off.
+ *
+ *  The rectangle is shrunk in multiples of the chroma subsampling
+ *  factors, so the result is the same as without cropping.
+ *
+ *  Returns 0 if the overlay is fully transparent.
+ */
+
+static int crop_transparent(gavl_overlay_blend_context_t * ctx,
+                            const gavl_overlay_t * ovl)
+  {
+  int i, j;
+  int x1, y1, x2, y2;
+  const uint8_t * ptr;
+  const uint8_t * start;
+  gavl_rectangle_i_t * r = &ctx->src_rect;
+  gavl_pixelformat_t pfmt = ctx->ovl_format.pixelformat;
+  
+  /* Blending onto frames with alpha also modifies the colors
+     below transparent overlay pixels */
+  if(!gavl_pixelformat_has_alpha(pfmt) ||
+     gavl_pixelformat_has_alpha(ctx->dst_format.pixelformat))
+    return 1;
+
+  start = ovl->planes[0] +
+    r->y * ovl->strides[0] +
+    r->x * gavl_pixelformat_bytes_per_pixel(pfmt);
+
+  /* Top */
+  y1 = 0;
+  ptr = start;
+  while(y1 < r->h)
+    {
+    if(row_visible(pfmt, ptr, r->w))
+      break;
+    ptr += ovl->strides[0];
+    y1++;
+    }
+
+  if(y1 == r->h)
+    return 0;
+  
+  /* Bottom */
+  y2 = r->h;
+  ptr = start + (y2 - 1) * ovl->strides[0];
+  while(y2 > y1)
+    {
+    if(row_visible(pfmt, ptr, r->w))
+      break;
+    ptr -= ovl->strides[0];
+    y2--;
+    }
+
+  /* Left and right */
+  x1 = r->w;
+  x2 = 0;
+  ptr = start + y1 * ovl->strides[0];
+  
+  for(i = y1; i < y2; i++)
+    {
+    for(j = 0; j < x1; j++)
+      {
+      if(pixel_visible(pfmt, ptr, j))
+        {
+        x1 = j;
+        break;
+        }
+      }
+    for(j = r->w - 1; j >= x2; j--)
+      {
+      if(pixel_visible(pfmt, ptr, j))
+        {
+        x2 = j + 1;
+        break;
+        }
+      }
+    ptr += ovl->strides[0];
+    }
+
+  /* Align to chroma subsampling */
+  x1 -= x1 % ctx->dst_sub_h;
+  y1 -= y1 % ctx->dst_sub_v;
+
+  x2 += (ctx->dst_sub_h - x2 % ctx->dst_sub_h) % ctx->dst_sub_h;
+  y2 += (ctx->dst_sub_v - y2 % ctx->dst_sub_v) % ctx->dst_sub_v;
+
+  if(x2 > r->w)
+    x2 = r->w;
+  if(y2 > r->h)
+    y2 = r->h;
+
+  r->x += x1;
+  r->y += y1;
+  ctx->dst_rect.x += x1;
+  ctx->dst_rect.y += y1;
+  r->w = x2 - x1;
+  r->h = y2 - y1;
+  return 1;
+  }
+
+/*
+ *  The overlay itself is never changed: Callers (like the cursor
+ *  overlay of the X11 grabber) reuse it for many frames and only
+ *  update some of the coordinates.
+ */
+
 void gavl_overlay_blend_context_set_overlay(gavl_overlay_blend_context_t * ctx,
                                             gavl_overlay_t * ovl)
   {
   int diff;
+  gavl_rectangle_i_t * src = &ctx->src_rect;
+  gavl_rectangle_i_t * dst = &ctx->dst_rect;
+  
   /* Save overlay */
 
   if(!ovl || !ovl->src_rect.w || !ovl->src_rect.h)
@@ -103,74 +266,82 @@ void gavl_overlay_blend_context_set_overlay(gavl_overlay_blend_context_t * ctx,
     return;
     }
   ctx->ovl = ovl;
+
+  gavl_rectangle_i_copy(src, &ovl->src_rect);
+  dst->x = ovl->dst_x;
+  dst->y = ovl->dst_y;
   
   /* Crop rectangle to destination format */
 
-  if(ctx->ovl->dst_x < 0)
+  if(dst->x < 0)
     {
-    ctx->ovl->src_rect.w += ctx->ovl->dst_x;
-    ctx->ovl->src_rect.x -= ctx->ovl->dst_x;
-    ctx->ovl->dst_x = 0;
+    src->w += dst->x;
+    src->x -= dst->x;
+    dst->x = 0;
     }
 
-  if(ctx->ovl->dst_y < 0)
+  if(dst->y < 0)
     {
-    ctx->ovl->src_rect.h += ctx->ovl->dst_y;
-    ctx->ovl->src_rect.y -= ctx->ovl->dst_y;
-    ctx->ovl->dst_y = 0;
+    src->h += dst->y;
+    src->y -= dst->y;
+    dst->y = 0;
     }
   
-  diff = ctx->ovl->dst_x + ctx->ovl->src_rect.w - ctx->dst_format.image_width;
+  diff = dst->x + src->w - ctx->dst_format.image_width;
   if(diff > 0)
-    ctx->ovl->src_rect.w -= diff;
+    src->w -= diff;
 
-  diff = ctx->ovl->dst_y + ctx->ovl->src_rect.h - ctx->dst_format.image_height;
+  diff = dst->y + src->h - ctx->dst_format.image_height;
   if(diff > 0)
-    ctx->ovl->src_rect.h -= diff;
+    src->h -= diff;
 
   /* Crop rectangle to source format */
 
-  if(ctx->ovl->src_rect.x < 0)
+  if(src->x < 0)
     {
-    ctx->ovl->src_rect.w += ctx->ovl->src_rect.x;
-    ctx->ovl->dst_x -= ctx->ovl->src_rect.x;
-    ctx->ovl->src_rect.x = 0;
+    src->w += src->x;
+    dst->x -= src->x;
+    src->x = 0;
     }
 
-  if(ctx->ovl->src_rect.y < 0)
+  if(src->y < 0)
     {
-    ctx->ovl->src_rect.h += ctx->ovl->src_rect.y;
-    ctx->ovl->dst_y -= ctx->ovl->src_rect.y;
-    ctx->ovl->src_rect.y = 0;
+    src->h += src->y;
+    dst->y -= src->y;
+    src->y = 0;
     }
 
-  diff = ctx->ovl->src_rect.x + ctx->ovl->src_rect.w - ctx->ovl_format.image_width;
+  diff = src->x + src->w - ctx->ovl_format.image_width;
   if(diff > 0)
-    ctx->ovl->src_rect.w -= diff;
+    src->w -= diff;
 
-  diff = ctx->ovl->src_rect.y + ctx->ovl->src_rect.h - ctx->ovl_format.image_height;
+  diff = src->y + src->h - ctx->ovl_format.image_height;
   if(diff > 0)
-    ctx->ovl->src_rect.h -= diff;
+    src->h -= diff;
 
+  if((src->w <= 0) || (src->h <= 0) ||
+     !crop_transparent(ctx, ovl))
+    {
+    ctx->ovl = NULL;
+    return;
+    }
+  
   /* Align rectangle */
 
-  ctx->ovl->src_rect.w -= ctx->ovl->src_rect.w % ctx->dst_sub_h;
-  ctx->ovl->src_rect.h -= ctx->ovl->src_rect.h % ctx->dst_sub_v;
-  ctx->ovl->dst_x      -= ctx->ovl->dst_x % ctx->dst_sub_h;
-  ctx->ovl->dst_y      -= ctx->ovl->dst_y % ctx->dst_sub_v;
-
-  /* Set destination rectangle for getting the subframe later on */
+  src->w -= src->w % ctx->dst_sub_h;
+  src->h -= src->h % ctx->dst_sub_v;
+  dst->x -= dst->x % ctx->dst_sub_h;
+  dst->y -= dst->y % ctx->dst_sub_v;
 
-  ctx->dst_rect.x = ctx->ovl->dst_x;
-  ctx->dst_rect.y = ctx->ovl->dst_y;
+  /* Destination rectangle for getting the subframe later on */
 
-  ctx->dst_rect.w = ctx->ovl->src_rect.w;
-  ctx->dst_rect.h = ctx->ovl->src_rect.h;
+  dst->w = src->w;
+  dst->h = src->h;
     
   gavl_video_frame_get_subframe(ctx->ovl_format.pixelformat,
                                 ovl,
                                 ctx->ovl_win,
-                                &ctx->ovl->src_rect);
+                                src);
   }
 
 void gavl_overlay_blend(gavl_overlay_blend_context_t * ctx,
@@ -72,12 +72,12 @@ static void blend_gray_8(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       tmp = *dst_ptr;
       BLEND_8(ovl_ptr[0], tmp, ovl_ptr[1]);
@@ -110,12 +110,12 @@ static void blend_gray_16(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = (uint16_t*)ovl_ptr_start;
     dst_ptr = (uint16_t*)dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       tmp = *dst_ptr;
       BLEND_16(ovl_ptr[0], tmp, ovl_ptr[1]);
@@ -146,12 +146,12 @@ static void blend_gray_float(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = (float*)ovl_ptr_start;
     dst_ptr = (float*)dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       BLEND_FLOAT(ovl_ptr[0], *dst_ptr, ovl_ptr[1]);
       dst_ptr++;
@@ -182,12 +182,12 @@ static void blend_graya_16(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       /* Transparent frame -> Copy overlay */
       if(!dst_ptr[1])
@@ -241,12 +241,12 @@ static void blend_graya_32(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = (uint16_t*)ovl_ptr_start;
     dst_ptr = (uint16_t*)dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       /* Transparent frame -> Copy overlay */
       if(!dst_ptr[1])
@@ -302,12 +302,12 @@ static void blend_graya_float(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = (float*)ovl_ptr_start;
     dst_ptr = (float*)dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       /* Transparent frame -> Copy overlay */
       if(dst_ptr[3] == 0.0)
@@ -362,12 +362,12 @@ static void blend_rgb_15(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = (uint16_t*)dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       r_tmp = RGB15_TO_R_8(*dst_ptr);
       g_tmp = RGB15_TO_G_8(*dst_ptr);
@@ -408,12 +408,12 @@ static void blend_bgr_15(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = (uint16_t*)dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       r_tmp = BGR15_TO_R_8(*dst_ptr);
       g_tmp = BGR15_TO_G_8(*dst_ptr);
@@ -453,12 +453,12 @@ static void blend_rgb_16(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = (uint16_t*)dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       r_tmp = RGB16_TO_R_8(*dst_ptr);
       g_tmp = RGB16_TO_G_8(*dst_ptr);
@@ -498,12 +498,12 @@ static void blend_bgr_16(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = (uint16_t*)dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       r_tmp = BGR16_TO_R_8(*dst_ptr);
       g_tmp = BGR16_TO_G_8(*dst_ptr);
@@ -543,12 +543,12 @@ static void blend_rgb_24(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       r_tmp = dst_ptr[0];
       g_tmp = dst_ptr[1];
@@ -590,12 +590,12 @@ static void blend_bgr_24(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       r_tmp = dst_ptr[2];
       g_tmp = dst_ptr[1];
@@ -637,12 +637,12 @@ static void blend_rgb_32(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       r_tmp = dst_ptr[0];
       g_tmp = dst_ptr[1];
@@ -684,12 +684,12 @@ static void blend_bgr_32(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       r_tmp = dst_ptr[2];
       g_tmp = dst_ptr[1];
@@ -731,12 +731,12 @@ static void blend_rgba_32(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       /* Transparent frame -> Copy overlay */
       if(!dst_ptr[3])
@@ -805,12 +805,12 @@ static void blend_rgb_48(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = (uint16_t*)ovl_ptr_start;
     dst_ptr = (uint16_t*)dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       r_tmp = dst_ptr[0];
       g_tmp = dst_ptr[1];
@@ -852,12 +852,12 @@ static void blend_rgba_64(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = (uint16_t*)ovl_ptr_start;
     dst_ptr = (uint16_t*)dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       /* Transparent frame -> Copy overlay */
       if(!dst_ptr[3])
@@ -925,12 +925,12 @@ static void blend_rgb_float(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = (float*)ovl_ptr_start;
     dst_ptr = (float*)dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       BLEND_FLOAT(ovl_ptr[0], dst_ptr[0], ovl_ptr[3]);
       BLEND_FLOAT(ovl_ptr[1], dst_ptr[1], ovl_ptr[3]);
@@ -962,12 +962,12 @@ static void blend_rgba_float(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = (float*)ovl_ptr_start;
     dst_ptr = (float*)dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       a_dst = dst_ptr[3] + ovl_ptr[3] - dst_ptr[3]*ovl_ptr[3];
 
@@ -1011,9 +1011,9 @@ static void blend_yuy2(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
 
-  jmax = ctx->ovl->src_rect.w / 2;
+  jmax = ctx->dst_rect.w / 2;
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = dst_ptr_start;
@@ -1070,9 +1070,9 @@ static void blend_uyvy(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
 
-  jmax = ctx->ovl->src_rect.w / 2;
+  jmax = ctx->dst_rect.w / 2;
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = dst_ptr_start;
@@ -1127,12 +1127,12 @@ static void blend_yuva_32(gavl_overlay_blend_context_t * ctx,
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_start = frame->planes[0];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr = dst_ptr_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       /* Transparent frame -> Copy overlay */
       if(!dst_ptr[3])
@@ -1207,8 +1207,8 @@ static void blend_yuv_420_p(gavl_overlay_blend_context_t * ctx,
   dst_ptr_u_start = frame->planes[1];
   dst_ptr_v_start = frame->planes[2];
 
-  imax = ctx->ovl->src_rect.h / 2;
-  jmax = ctx->ovl->src_rect.w / 2;
+  imax = ctx->dst_rect.h / 2;
+  jmax = ctx->dst_rect.w / 2;
   
   for(i = 0; i < imax; i++)
     {
@@ -1296,9 +1296,9 @@ static void blend_yuv_422_p(gavl_overlay_blend_context_t * ctx,
   dst_ptr_u_start = frame->planes[1];
   dst_ptr_v_start = frame->planes[2];
 
-  jmax = ctx->ovl->src_rect.w / 2;
+  jmax = ctx->dst_rect.w / 2;
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr_y = dst_ptr_y_start;
@@ -1362,14 +1362,14 @@ static void blend_yuv_444_p(gavl_overlay_blend_context_t * ctx,
   dst_ptr_u_start = frame->planes[1];
   dst_ptr_v_start = frame->planes[2];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr_y = dst_ptr_y_start;
     dst_ptr_u = dst_ptr_u_start;
     dst_ptr_v = dst_ptr_v_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       /* Y0 */
       tmp = *dst_ptr_y;
@@ -1421,9 +1421,9 @@ static void blend_yuv_411_p(gavl_overlay_blend_context_t * ctx,
   dst_ptr_u_start = frame->planes[1];
   dst_ptr_v_start = frame->planes[2];
 
-  jmax = ctx->ovl->src_rect.w / 4;
+  jmax = ctx->dst_rect.w / 4;
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr_y = dst_ptr_y_start;
@@ -1497,8 +1497,8 @@ static void blend_yuv_410_p(gavl_overlay_blend_context_t * ctx,
   dst_ptr_u_start = frame->planes[1];
   dst_ptr_v_start = frame->planes[2];
 
-  imax = ctx->ovl->src_rect.h / 4;
-  jmax = ctx->ovl->src_rect.w / 4;
+  imax = ctx->dst_rect.h / 4;
+  jmax = ctx->dst_rect.w / 4;
   
   for(i = 0; i < imax; i++)
     {
@@ -1668,8 +1668,8 @@ static void blend_yuvj_420_p(gavl_overlay_blend_context_t * ctx,
   
   int tmp;
 
-  imax = ctx->ovl->src_rect.h/2;
-  jmax = ctx->ovl->src_rect.w/2;
+  imax = ctx->dst_rect.h/2;
+  jmax = ctx->dst_rect.w/2;
   
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_y_start = frame->planes[0];
@@ -1759,14 +1759,14 @@ static void blend_yuvj_422_p(gavl_overlay_blend_context_t * ctx,
   
   int tmp;
 
-  jmax = ctx->ovl->src_rect.w/2;
+  jmax = ctx->dst_rect.w/2;
   
   ovl_ptr_start = overlay->planes[0];
   dst_ptr_y_start = frame->planes[0];
   dst_ptr_u_start = frame->planes[1];
   dst_ptr_v_start = frame->planes[2];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr_y = dst_ptr_y_start;
@@ -1831,14 +1831,14 @@ static void blend_yuvj_444_p(gavl_overlay_blend_context_t * ctx,
   dst_ptr_u_start = frame->planes[1];
   dst_ptr_v_start = frame->planes[2];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = ovl_ptr_start;
     dst_ptr_y = dst_ptr_y_start;
     dst_ptr_u = dst_ptr_u_start;
     dst_ptr_v = dst_ptr_v_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       /* Y0 */
       tmp = *dst_ptr_y;
@@ -1890,9 +1890,9 @@ static void blend_yuv_422_p_16(gavl_overlay_blend_context_t * ctx,
   dst_ptr_u_start = frame->planes[1];
   dst_ptr_v_start = frame->planes[2];
 
-  jmax = ctx->ovl->src_rect.w / 2;
+  jmax = ctx->dst_rect.w / 2;
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = (uint16_t*)ovl_ptr_start;
     dst_ptr_y = (uint16_t*)dst_ptr_y_start;
@@ -1959,14 +1959,14 @@ static void blend_yuv_444_p_16(gavl_overlay_blend_context_t * ctx,
   dst_ptr_u_start = frame->planes[1];
   dst_ptr_v_start = frame->planes[2];
   
-  for(i = 0; i < ctx->ovl->src_rect.h; i++)
+  for(i = 0; i < ctx->dst_rect.h; i++)
     {
     ovl_ptr = (uint16_t*)ovl_ptr_start;
     dst_ptr_y = (uint16_t*)dst_ptr_y_start;
     dst_ptr_u = (uint16_t*)dst_ptr_u_start;
     dst_ptr_v = (uint16_t*)dst_ptr_v_start;
     
-    for(j = 0; j < ctx->ovl->src_rect.w; j++)
+    for(j = 0; j < ctx->dst_rect.w; j++)
       {
       alpha = ovl_ptr[3];
       /* Y0 */
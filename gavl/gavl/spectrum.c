@@ -0,0 +1,604 @@
+/*****************************************************************
+ * gavl - a general purpose audio/video processing library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include <gavl/spectrum.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Beat detection (taken from lemuria) */
+
+#define BEAT_MAX 200
+#define BEAT_SENSITIVITY 4
+
+typedef struct
+  {
+  float * history; /* Last fft_size samples */
+  float * spectrum;
+  float * bands;
+  } channel_t;
+
+struct gavl_spectrum_analyzer_s
+  {
+  gavl_audio_format_t format;
+  channel_t channels[GAVL_MAX_CHANNELS];
+
+  int fft_size;
+  int num_bands;
+  int pos; /* Write position in the history (= oldest sample) */
+
+  /* FFT plan: A real FFT of fft_size is done as a complex
+     FFT of fft_size/2 */
+  int * bitrev;
+  float * tw_re;    /* Twiddles for the complex FFT */
+  float * tw_im;
+  float * post_re;  /* Twiddles for splitting the real spectrum */
+  float * post_im;
+  float * window;
+  float norm;
+
+  int * band_edges;
+
+  /* Scratch buffers */
+  float * re;
+  float * im;
+
+  /* Loudness of the last frame */
+  double sum_squares;
+  int num_squares;
+  float loudness;
+
+  /* Beat detection */
+  int beathistory[BEAT_MAX];
+  int beatbase;
+  int aged;     /* smoothed out loudness */
+  int lowest;   /* quietest point in current beat */
+  int elapsed;  /* frames since last beat */
+  int prevbeat; /* period of previous beat */
+  int beat;
+
+  void (*add_channel)(gavl_spectrum_analyzer_t*, void * samples, int num,
+                      int offset, int advance, int channel);
+  void (*add)(gavl_spectrum_analyzer_t*, gavl_audio_frame_t*);
+
+  gavl_audio_sink_t * sink;
+
+  gavl_update_spectrum_callback callback;
+  void * callback_priv;
+  };
+
+/* Copy samples into the history */
+
+#define ADD_CHANNEL(name, type, conv)                                   \
+static void name(gavl_spectrum_analyzer_t * sa, void * _samples,        \
+                 int num, int offset, int advance, int channel)         \
+  {                                                                     \
+  int i, pos;                                                           \
+  float val;                                                            \
+  float * history = sa->channels[channel].history;                      \
+  type * samples = (type*)_samples;                                     \
+  samples += offset;                                                    \
+  if(num > sa->fft_size)                                                \
+    {                                                                   \
+    samples += (num - sa->fft_size) * advance;                          \
+    num = sa->fft_size;                                                 \
+    }                                                                   \
+  pos = sa->pos;                                                        \
+  for(i = 0; i < num; i++)                                              \
+    {                                                                   \
+    val = conv;                                                         \
+    history[pos] = val;                                                 \
+    sa->sum_squares += val * val;                                       \
+    pos++;                                                              \
+    if(pos == sa->fft_size)                                             \
+      pos = 0;                                                          \
+    samples += advance;                                                 \
+    }                                                                   \
+  sa->num_squares += num;                                               \
+  }
+
+ADD_CHANNEL(add_channel_u8, uint8_t, ((int)(*samples) - 0x80) / 128.0)
+ADD_CHANNEL(add_channel_s8, int8_t, (*samples) / 128.0)
+ADD_CHANNEL(add_channel_u16, uint16_t, ((int)(*samples) - 0x8000) / 32768.0)
+ADD_CHANNEL(add_channel_s16, int16_t, (*samples) / 32768.0)
+ADD_CHANNEL(add_channel_s32, int32_t, (*samples) / 2147483648.0)
+ADD_CHANNEL(add_channel_float, float, *samples)
+ADD_CHANNEL(add_channel_double, double, *samples)
+
+static void add_none(gavl_spectrum_analyzer_t * sa, gavl_audio_frame_t * f)
+  {
+  int i;
+  for(i = 0; i < sa->format.num_channels; i++)
+    sa->add_channel(sa, f->channels.s_8[i], f->valid_samples, 0, 1, i);
+  }
+
+static void add_all(gavl_spectrum_analyzer_t * sa, gavl_audio_frame_t * f)
+  {
+  int i;
+  for(i = 0; i < sa->format.num_channels; i++)
+    sa->add_channel(sa, f->samples.s_8, f->valid_samples,
+                    i, sa->format.num_channels, i);
+  }
+
+static void add_2(gavl_spectrum_analyzer_t * sa, gavl_audio_frame_t * f)
+  {
+  int i;
+  for(i = 0; i < sa->format.num_channels/2; i++)
+    {
+    sa->add_channel(sa, f->channels.s_8[2*i], f->valid_samples, 0, 2, 2*i);
+    sa->add_channel(sa, f->channels.s_8[2*i], f->valid_samples, 1, 2, 2*i+1);
+    }
+  if(sa->format.num_channels % 2)
+    sa->add_channel(sa, f->channels.s_8[sa->format.num_channels-1],
+                    f->valid_samples, 0, 1, sa->format.num_channels-1);
+  }
+
+/* FFT */
+
+static void fft(gavl_spectrum_analyzer_t * sa)
+  {
+  int len, half_len, step, i, j, a, b;
+  float wr, wi, tr, ti;
+  int n = sa->fft_size / 2;
+  float * re = sa->re;
+  float * im = sa->im;
+
+  for(len = 2; len <= n; len <<= 1)
+    {
+    half_len = len >> 1;
+    step = n / len;
+
+    for(i = 0; i < n; i += len)
+      {
+      for(j = 0; j < half_len; j++)
+        {
+        wr = sa->tw_re[j * step];
+        wi = sa->tw_im[j * step];
+        a = i + j;
+        b = a + half_len;
+        tr = wr * re[b] - wi * im[b];
+        ti = wr * im[b] + wi * re[b];
+        re[b] = re[a] - tr;
+        im[b] = im[a] - ti;
+        re[a] += tr;
+        im[a] += ti;
+        }
+      }
+    }
+  }
+
+static void analyze_channel(gavl_spectrum_analyzer_t * sa, int channel)
+  {
+  int i, k, m, idx;
+  int n = sa->fft_size / 2;
+  float er, ei, odd_r, odd_i, xr, xi;
+  float sum;
+  channel_t * c = &sa->channels[channel];
+
+  /* Pack even and odd samples into real and imaginary parts. The
+     oldest sample can be at an odd position, so the wrap around
+     can happen between the two samples of a pair */
+  idx = sa->pos;
+  for(i = 0; i < n; i++)
+    {
+    sa->re[sa->bitrev[i]] = c->history[idx] * sa->window[2*i];
+    if(++idx == sa->fft_size)
+      idx = 0;
+    sa->im[sa->bitrev[i]] = c->history[idx] * sa->window[2*i+1];
+    if(++idx == sa->fft_size)
+      idx = 0;
+    }
+
+  fft(sa);
+
+  /* Split into the spectrum of the real signal */
+  for(k = 0; k < n; k++)
+    {
+    m = k ? n - k : 0;
+    er = 0.5 * (sa->re[k] + sa->re[m]);
+    ei = 0.5 * (sa->im[k] - sa->im[m]);
+    odd_r = 0.5 * (sa->im[k] + sa->im[m]);
+    odd_i = -0.5 * (sa->re[k] - sa->re[m]);
+
+    xr = er + sa->post_re[k] * odd_r - sa->post_im[k] * odd_i;
+    xi = ei + sa->post_re[k] * odd_i + sa->post_im[k] * odd_r;
+    c->spectrum[k] = sqrt(xr * xr + xi * xi) * sa->norm;
+    }
+  c->spectrum[n] = fabs(sa->re[0] - sa->im[0]) * sa->norm * 0.5;
+  c->spectrum[0] *= 0.5;
+
+  /* Logarithmic bands */
+  for(i = 0; i < sa->num_bands; i++)
+    {
+    sum = 0.0;
+    for(k = sa->band_edges[i]; k < sa->band_edges[i+1]; k++)
+      sum += c->spectrum[k] * c->spectrum[k];
+    c->bands[i] = sqrt(sum);
+    }
+  }
+
+/* Beats are detected by looking for a sudden loudness after a lull.
+   They are also limited to occur no more than once every 15 frames */
+
+static int detect_beat(gavl_spectrum_analyzer_t * sa, int loudness)
+  {
+  int beat, i, j;
+  int total;
+  int sensitivity;
+
+  /* Incorporate the current loudness into history */
+  sa->aged = (sa->aged * 7 + loudness) >> 3;
+  sa->elapsed++;
+
+  /* If silent, then clobber the beat */
+  if((sa->aged < 2000) || (sa->elapsed > BEAT_MAX))
+    {
+    sa->elapsed = 0;
+    sa->lowest = sa->aged;
+    memset(sa->beathistory, 0, sizeof(sa->beathistory));
+    }
+  else if(sa->aged < sa->lowest)
+    sa->lowest = sa->aged;
+
+  j = (sa->beatbase + sa->elapsed) % BEAT_MAX;
+  sa->beathistory[j] = loudness - sa->aged;
+  beat = 0;
+
+  if((sa->elapsed > 15) && (sa->aged > 2000) && (loudness * 4 > sa->aged * 5))
+    {
+    /* Compute the average loudness change, assuming this is beat */
+    for(i = BEAT_MAX / sa->elapsed, total = 0;
+        --i > 0;
+        j = (j + BEAT_MAX - sa->elapsed) % BEAT_MAX)
+      total += sa->beathistory[j];
+
+    total = total * sa->elapsed / BEAT_MAX;
+
+    /* Tweak the sensitivity to emphasize a consistent rhythm */
+    sensitivity = BEAT_SENSITIVITY;
+    i = 3 - abs(sa->elapsed - sa->prevbeat)/2;
+    if(i > 0)
+      sensitivity += i;
+
+    /* If average change is significantly positive, this is a beat. */
+    if(total * sensitivity > sa->aged)
+      {
+      sa->prevbeat = sa->elapsed;
+      sa->beatbase = (sa->beatbase + sa->elapsed) % BEAT_MAX;
+      sa->lowest = sa->aged;
+      sa->elapsed = 0;
+      beat = 1;
+      }
+    }
+  return beat;
+  }
+
+static gavl_sink_status_t put_frame_func(void * priv,
+                                         gavl_audio_frame_t * frame)
+  {
+  int i;
+  gavl_spectrum_analyzer_t * sa = priv;
+
+  if(!sa->fft_size)
+    return GAVL_SINK_OK;
+
+  sa->sum_squares = 0.0;
+  sa->num_squares = 0;
+
+  sa->add(sa, frame);
+
+  /* All channels were written at the same position. Of larger
+     frames, only the last fft_size samples were written */
+  if(frame->valid_samples < sa->fft_size)
+    sa->pos = (sa->pos + frame->valid_samples) % sa->fft_size;
+
+  for(i = 0; i < sa->format.num_channels; i++)
+    analyze_channel(sa, i);
+
+  if(sa->num_squares)
+    sa->loudness = sqrt(sa->sum_squares / sa->num_squares);
+  else
+    sa->loudness = 0.0;
+
+  sa->beat = detect_beat(sa, (int)(sa->loudness * 32768.0));
+
+  if(sa->callback)
+    sa->callback(sa->callback_priv, sa);
+
+  return GAVL_SINK_OK;
+  }
+
+gavl_spectrum_analyzer_t * gavl_spectrum_analyzer_create()
+  {
+  gavl_spectrum_analyzer_t * ret;
+  ret = calloc(1, sizeof(*ret));
+  return ret;
+  }
+
+static void free_plan(gavl_spectrum_analyzer_t * sa)
+  {
+  int i;
+
+  for(i = 0; i < GAVL_MAX_CHANNELS; i++)
+    {
+    if(sa->channels[i].history)
+      free(sa->channels[i].history);
+    if(sa->channels[i].spectrum)
+      free(sa->channels[i].spectrum);
+    if(sa->channels[i].bands)
+      free(sa->channels[i].bands);
+    }
+  memset(sa->channels, 0, sizeof(sa->channels));
+
+  if(sa->bitrev)
+    free(sa->bitrev);
+  if(sa->tw_re)
+    free(sa->tw_re);
+  if(sa->tw_im)
+    free(sa->tw_im);
+  if(sa->post_re)
+    free(sa->post_re);
+  if(sa->post_im)
+    free(sa->post_im);
+  if(sa->window)
+    free(sa->window);
+  if(sa->band_edges)
+    free(sa->band_edges);
+  if(sa->re)
+    free(sa->re);
+  if(sa->im)
+    free(sa->im);
+
+  sa->bitrev = NULL;
+  sa->tw_re = NULL;
+  sa->tw_im = NULL;
+  sa->post_re = NULL;
+  sa->post_im = NULL;
+  sa->window = NULL;
+  sa->band_edges = NULL;
+  sa->re = NULL;
+  sa->im = NULL;
+  sa->fft_size = 0;
+  }
+
+void gavl_spectrum_analyzer_destroy(gavl_spectrum_analyzer_t * sa)
+  {
+  free_plan(sa);
+  if(sa->sink)
+    gavl_audio_sink_destroy(sa->sink);
+  free(sa);
+  }
+
+void gavl_spectrum_analyzer_set_callback(gavl_spectrum_analyzer_t * sa,
+                                         gavl_update_spectrum_callback callback,
+                                         void * priv)
+  {
+  sa->callback = callback;
+  sa->callback_priv = priv;
+  }
+
+static void init_plan(gavl_spectrum_analyzer_t * sa)
+  {
+  int i, j, bits, n, rev;
+  double sum, edge;
+
+  n = sa->fft_size / 2;
+
+  for(bits = 0; (1 << bits) < n; bits++)
+    ;
+
+  sa->bitrev = malloc(n * sizeof(*sa->bitrev));
+  for(i = 0; i < n; i++)
+    {
+    rev = 0;
+    for(j = 0; j < bits; j++)
+      {
+      if(i & (1 << j))
+        rev |= 1 << (bits - 1 - j);
+      }
+    sa->bitrev[i] = rev;
+    }
+
+  sa->tw_re = malloc(n/2 * sizeof(*sa->tw_re));
+  sa->tw_im = malloc(n/2 * sizeof(*sa->tw_im));
+  for(i = 0; i < n/2; i++)
+    {
+    sa->tw_re[i] = cos(2.0 * M_PI * i / n);
+    sa->tw_im[i] = -sin(2.0 * M_PI * i / n);
+    }
+
+  sa->post_re = malloc(n * sizeof(*sa->post_re));
+  sa->post_im = malloc(n * sizeof(*sa->post_im));
+  for(i = 0; i < n; i++)
+    {
+    sa->post_re[i] = cos(2.0 * M_PI * i / sa->fft_size);
+    sa->post_im[i] = -sin(2.0 * M_PI * i / sa->fft_size);
+    }
+
+  /* Hann window */
+  sa->window = malloc(sa->fft_size * sizeof(*sa->window));
+  sum = 0.0;
+  for(i = 0; i < sa->fft_size; i++)
+    {
+    sa->window[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / sa->fft_size);
+    sum += sa->window[i];
+    }
+  /* Full scale sine has amplitude 1.0 */
+  sa->norm = 2.0 / sum;
+
+  /* Logarithmic bands from the first bin to the nyquist frequency */
+  if(sa->num_bands > n)
+    sa->num_bands = n;
+
+  sa->band_edges = malloc((sa->num_bands+1) * sizeof(*sa->band_edges));
+  sa->band_edges[0] = 1;
+  for(i = 1; i <= sa->num_bands; i++)
+    {
+    edge = pow((double)(n+1), (double)i / (double)sa->num_bands);
+    sa->band_edges[i] = (int)(edge + 0.5);
+
+    if(sa->band_edges[i] <= sa->band_edges[i-1])
+      sa->band_edges[i] = sa->band_edges[i-1] + 1;
+    if(sa->band_edges[i] > n + 1 - (sa->num_bands - i))
+      sa->band_edges[i] = n + 1 - (sa->num_bands - i);
+    }
+
+  sa->re = malloc(n * sizeof(*sa->re));
+  sa->im = malloc(n * sizeof(*sa->im));
+
+  for(i = 0; i < sa->format.num_channels; i++)
+    {
+    sa->channels[i].history  = calloc(sa->fft_size, sizeof(float));
+    sa->channels[i].spectrum = calloc(n + 1, sizeof(float));
+    sa->channels[i].bands    = calloc(sa->num_bands, sizeof(float));
+    }
+  }
+
+void gavl_spectrum_analyzer_set_format(gavl_spectrum_analyzer_t * sa,
+                                       const gavl_audio_format_t * format,
+                                       int fft_size, int num_bands)
+  {
+  free_plan(sa);
+
+  gavl_audio_format_copy(&sa->format, format);
+
+  switch(sa->format.interleave_mode)
+    {
+    case GAVL_INTERLEAVE_NONE:
+      sa->add = add_none;
+      break;
+    case GAVL_INTERLEAVE_ALL:
+      sa->add = add_all;
+      break;
+    case GAVL_INTERLEAVE_2:
+      sa->add = add_2;
+      break;
+    }
+
+  switch(sa->format.sample_format)
+    {
+    case GAVL_SAMPLE_U8:
+      sa->add_channel = add_channel_u8;
+      break;
+    case GAVL_SAMPLE_S8:
+      sa->add_channel = add_channel_s8;
+      break;
+    case GAVL_SAMPLE_U16:
+      sa->add_channel = add_channel_u16;
+      break;
+    case GAVL_SAMPLE_S16:
+      sa->add_channel = add_channel_s16;
+      break;
+    case GAVL_SAMPLE_S32:
+      sa->add_channel = add_channel_s32;
+      break;
+    case GAVL_SAMPLE_FLOAT:
+      sa->add_channel = add_channel_float;
+      break;
+    case GAVL_SAMPLE_DOUBLE:
+      sa->add_channel = add_channel_double;
+      break;
+    case GAVL_SAMPLE_NONE:
+      break;
+    }
+
+  /* Round down to a power of 2 */
+  sa->fft_size = 16;
+  while(sa->fft_size * 2 <= fft_size)
+    sa->fft_size *= 2;
+
+  sa->num_bands = (num_bands > 0) ? num_bands : 1;
+
+  init_plan(sa);
+  gavl_spectrum_analyzer_reset(sa);
+
+  if(sa->sink)
+    gavl_audio_sink_destroy(sa->sink);
+
+  sa->sink = gavl_audio_sink_create(NULL, put_frame_func, sa, format);
+  }
+
+const gavl_audio_format_t *
+gavl_spectrum_analyzer_get_format(gavl_spectrum_analyzer_t * sa)
+  {
+  return &sa->format;
+  }
+
+void gavl_spectrum_analyzer_update(gavl_spectrum_analyzer_t * sa,
+                                   gavl_audio_frame_t * frame)
+  {
+  gavl_audio_sink_put_frame(sa->sink, frame);
+  }
+
+gavl_audio_sink_t *
+gavl_spectrum_analyzer_get_sink(gavl_spectrum_analyzer_t * sa)
+  {
+  return sa->sink;
+  }
+
+const float * gavl_spectrum_analyzer_get_spectrum(gavl_spectrum_analyzer_t * sa,
+                                                  int channel)
+  {
+  return sa->channels[channel].spectrum;
+  }
+
+const float * gavl_spectrum_analyzer_get_bands(gavl_spectrum_analyzer_t * sa,
+                                               int channel)
+  {
+  return sa->channels[channel].bands;
+  }
+
+int gavl_spectrum_analyzer_get_beat(gavl_spectrum_analyzer_t * sa,
+                                    float * loudness)
+  {
+  if(loudness)
+    *loudness = sa->loudness;
+  return sa->beat;
+  }
+
+void gavl_spectrum_analyzer_reset(gavl_spectrum_analyzer_t * sa)
+  {
+  int i;
+
+  for(i = 0; i < sa->format.num_channels; i++)
+    {
+    if(!sa->channels[i].history)
+      continue;
+    memset(sa->channels[i].history, 0, sa->fft_size * sizeof(float));
+    memset(sa->channels[i].spectrum, 0, (sa->fft_size/2+1) * sizeof(float));
+    memset(sa->channels[i].bands, 0, sa->num_bands * sizeof(float));
+    }
+  sa->pos = 0;
+  sa->loudness = 0.0;
+
+  memset(sa->beathistory, 0, sizeof(sa->beathistory));
+  sa->beatbase = 0;
+  sa->aged = 0;
+  sa->lowest = 0;
+  sa->elapsed = 0;
+  sa->prevbeat = 0;
+  sa->beat = 0;
+  }
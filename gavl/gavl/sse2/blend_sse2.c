@@ -0,0 +1,468 @@
+/*****************************************************************
+ * gavl - a general purpose audio/video processing library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+#include <config.h>
+#include <attributes.h>
+
+#include <stdio.h>
+#include <gavl/gavl.h>
+#include <video.h>
+#include <blend.h>
+
+#include "../mmx/mmx.h"
+#include "../sse/sse.h"
+
+/*
+ *  The C version does
+ *
+ *  d = (((s - d) * a)>>8) + d
+ *
+ *  which is (bit exact) the same as
+ *
+ *  d = (d * (256 - a) + s * a) >> 8
+ *
+ *  The latter has no negative intermediate results and
+ *  fits into unsigned 16 bit words.
+ */
+
+static const sse_t w_256 = { .uw = { 0x0100, 0x0100, 0x0100, 0x0100,
+                                     0x0100, 0x0100, 0x0100, 0x0100 } };
+
+static const sse_t d_low_word = { .ud = { 0x0000FFFF, 0x0000FFFF,
+                                          0x0000FFFF, 0x0000FFFF } };
+
+static const sse_t b_0 = { .ud = { 0x000000FF, 0x000000FF,
+                                   0x000000FF, 0x000000FF } };
+
+static const sse_t b_rgb = { .ud = { 0x00FFFFFF, 0x00FFFFFF,
+                                     0x00FFFFFF, 0x00FFFFFF } };
+
+static const sse_t b_a = { .ud = { 0xFF000000, 0xFF000000,
+                                   0xFF000000, 0xFF000000 } };
+
+#define BLEND_8(s, d, a) \
+  d = (((s - d) * a)>>8) + d;
+
+/*
+ *  xmm0: Source words
+ *  xmm1: Alpha words
+ *  xmm2: Destination
+ *  xmm3, xmm4: Scratch
+ *  xmm5, xmm6: Overlay pixels
+ *  xmm7: 0
+ */
+
+/* Blend xmm2 (unpacked to words) */
+
+#define BLEND_WORDS \
+  movdqa_m2r(w_256, xmm3);\
+  psubw_r2r(xmm1, xmm3);\
+  pmullw_r2r(xmm3, xmm2);\
+  movdqa_r2r(xmm0, xmm4);\
+  pmullw_r2r(xmm1, xmm4);\
+  paddw_r2r(xmm4, xmm2);\
+  psrlw_i2r(8, xmm2);\
+  packuswb_r2r(xmm2, xmm2);
+
+/* Blend 8 destination bytes */
+
+#define BLEND_8_BYTES(dst) \
+  movq_m2r(*((mmx_t*)(dst)), xmm2);\
+  punpcklbw_r2r(xmm7, xmm2);\
+  BLEND_WORDS \
+  movq_r2m(xmm2, *((mmx_t*)(dst)));
+
+/* Blend 4 destination bytes (chroma planes of 4:2:0) */
+
+#define BLEND_4_BYTES(dst) \
+  movd_m2r(*((uint32_t*)(dst)), xmm2);\
+  punpcklbw_r2r(xmm7, xmm2);\
+  BLEND_WORDS \
+  movd_r2m(xmm2, *((uint32_t*)(dst)));
+
+/* Load 8 pixels of a 4 byte per pixel overlay into xmm5 and xmm6 */
+
+#define LOAD_OVL_32(ptr) \
+  movdqu_m2r(*((sse_t*)(ptr)), xmm5);\
+  movdqu_m2r(*((sse_t*)((ptr)+16)), xmm6);
+
+/* Extract byte number num from the 8 overlay pixels as words */
+
+#define EXTRACT_32(num, reg) \
+  movdqa_r2r(xmm5, reg);\
+  movdqa_r2r(xmm6, xmm4);\
+  psrld_i2r(8*num, reg);\
+  psrld_i2r(8*num, xmm4);\
+  pand_m2r(b_0, reg);\
+  pand_m2r(b_0, xmm4);\
+  packssdw_r2r(xmm4, reg);
+
+/* Keep only the even words of reg and pack them into the lower half */
+
+#define EVEN_WORDS(reg) \
+  pand_m2r(d_low_word, reg);\
+  packssdw_r2r(reg, reg);
+
+/* ovl: GAVL_GRAYA_16 */
+
+static void blend_gray_8_sse2(gavl_overlay_blend_context_t * ctx,
+                              gavl_video_frame_t * frame,
+                              gavl_video_frame_t * overlay)
+  {
+  int i, j, jmax;
+  uint8_t * ovl_ptr;
+  uint8_t * dst_ptr;
+  
+  uint8_t * ovl_ptr_start;
+  uint8_t * dst_ptr_start;
+  
+  int tmp;
+  
+  ovl_ptr_start = overlay->planes[0];
+  dst_ptr_start = frame->planes[0];
+
+  jmax = ctx->dst_rect.w / 8;
+
+  pxor_r2r(xmm7, xmm7);
+  
+  for(i = 0; i < ctx->dst_rect.h; i++)
+    {
+    ovl_ptr = ovl_ptr_start;
+    dst_ptr = dst_ptr_start;
+    
+    for(j = 0; j < jmax; j++)
+      {
+      movdqu_m2r(*((sse_t*)ovl_ptr), xmm0);
+      movdqa_r2r(xmm0, xmm1);
+      psllw_i2r(8, xmm0);
+      psrlw_i2r(8, xmm0);
+      psrlw_i2r(8, xmm1);
+      BLEND_8_BYTES(dst_ptr);
+      ovl_ptr += 16;
+      dst_ptr += 8;
+      }
+
+    for(j = jmax * 8; j < ctx->dst_rect.w; j++)
+      {
+      tmp = *dst_ptr;
+      BLEND_8(ovl_ptr[0], tmp, ovl_ptr[1]);
+      *(dst_ptr++) = tmp;
+      ovl_ptr+=2;
+      }
+    
+    ovl_ptr_start += overlay->strides[0];
+    dst_ptr_start += frame->strides[0];
+    }
+  }
+
+/* ovl: GAVL_RGBA_32 */
+
+static void blend_rgb_32_sse2(gavl_overlay_blend_context_t * ctx,
+                              gavl_video_frame_t * frame,
+                              gavl_video_frame_t * overlay)
+  {
+  int i, j, jmax;
+  uint8_t * ovl_ptr;
+  uint8_t * dst_ptr;
+  
+  uint8_t * ovl_ptr_start;
+  uint8_t * dst_ptr_start;
+
+  int r_tmp, g_tmp, b_tmp;
+  
+  ovl_ptr_start = overlay->planes[0];
+  dst_ptr_start = frame->planes[0];
+
+  jmax = ctx->dst_rect.w / 2;
+
+  pxor_r2r(xmm7, xmm7);
+  
+  for(i = 0; i < ctx->dst_rect.h; i++)
+    {
+    ovl_ptr = ovl_ptr_start;
+    dst_ptr = dst_ptr_start;
+
+    /* 2 pixels at once */
+    for(j = 0; j < jmax; j++)
+      {
+      movq_m2r(*((mmx_t*)ovl_ptr), xmm0);
+      punpcklbw_r2r(xmm7, xmm0);
+      pshuflw_r2ri(xmm0, xmm1, 0xff);
+      pshufhw_r2ri(xmm1, xmm1, 0xff);
+
+      movq_m2r(*((mmx_t*)dst_ptr), xmm5);
+      movdqa_r2r(xmm5, xmm2);
+      punpcklbw_r2r(xmm7, xmm2);
+      BLEND_WORDS
+      
+      /* Keep the 4th byte of the destination */
+      pand_m2r(b_rgb, xmm2);
+      pand_m2r(b_a, xmm5);
+      por_r2r(xmm5, xmm2);
+      movq_r2m(xmm2, *((mmx_t*)dst_ptr));
+      
+      ovl_ptr += 8;
+      dst_ptr += 8;
+      }
+
+    if(ctx->dst_rect.w & 1)
+      {
+      r_tmp = dst_ptr[0];
+      g_tmp = dst_ptr[1];
+      b_tmp = dst_ptr[2];
+
+      BLEND_8(ovl_ptr[0], r_tmp, ovl_ptr[3]);
+      BLEND_8(ovl_ptr[1], g_tmp, ovl_ptr[3]);
+      BLEND_8(ovl_ptr[2], b_tmp, ovl_ptr[3]);
+      
+      dst_ptr[0] = r_tmp;
+      dst_ptr[1] = g_tmp;
+      dst_ptr[2] = b_tmp;
+      }
+    
+    ovl_ptr_start += overlay->strides[0];
+    dst_ptr_start += frame->strides[0];
+    }
+  }
+
+/* ovl: GAVL_YUVA_32 */
+
+static void blend_yuv_444_p_sse2(gavl_overlay_blend_context_t * ctx,
+                                 gavl_video_frame_t * frame,
+                                 gavl_video_frame_t * overlay)
+  {
+  int i, j, jmax;
+  uint8_t * ovl_ptr;
+  uint8_t * dst_ptr_y;
+  uint8_t * dst_ptr_u;
+  uint8_t * dst_ptr_v;
+  
+  uint8_t * ovl_ptr_start;
+  uint8_t * dst_ptr_y_start;
+  uint8_t * dst_ptr_u_start;
+  uint8_t * dst_ptr_v_start;
+  
+  int tmp;
+  
+  ovl_ptr_start = overlay->planes[0];
+  dst_ptr_y_start = frame->planes[0];
+  dst_ptr_u_start = frame->planes[1];
+  dst_ptr_v_start = frame->planes[2];
+
+  jmax = ctx->dst_rect.w / 8;
+
+  pxor_r2r(xmm7, xmm7);
+  
+  for(i = 0; i < ctx->dst_rect.h; i++)
+    {
+    ovl_ptr = ovl_ptr_start;
+    dst_ptr_y = dst_ptr_y_start;
+    dst_ptr_u = dst_ptr_u_start;
+    dst_ptr_v = dst_ptr_v_start;
+
+    for(j = 0; j < jmax; j++)
+      {
+      LOAD_OVL_32(ovl_ptr);
+      EXTRACT_32(3, xmm1);
+
+      EXTRACT_32(0, xmm0);
+      BLEND_8_BYTES(dst_ptr_y);
+      EXTRACT_32(1, xmm0);
+      BLEND_8_BYTES(dst_ptr_u);
+      EXTRACT_32(2, xmm0);
+      BLEND_8_BYTES(dst_ptr_v);
+      
+      ovl_ptr   += 32;
+      dst_ptr_y += 8;
+      dst_ptr_u += 8;
+      dst_ptr_v += 8;
+      }
+    
+    for(j = jmax * 8; j < ctx->dst_rect.w; j++)
+      {
+      tmp = *dst_ptr_y;
+      BLEND_8(ovl_ptr[0], tmp, ovl_ptr[3]);
+      *(dst_ptr_y++) = tmp;
+
+      tmp = *dst_ptr_u;
+      BLEND_8(ovl_ptr[1], tmp, ovl_ptr[3]);
+      *(dst_ptr_u++) = tmp;
+
+      tmp = *dst_ptr_v;
+      BLEND_8(ovl_ptr[2], tmp, ovl_ptr[3]);
+      *(dst_ptr_v++) = tmp;
+      
+      ovl_ptr+=4;
+      }
+    
+    ovl_ptr_start += overlay->strides[0];
+    dst_ptr_y_start += frame->strides[0];
+    dst_ptr_u_start += frame->strides[1];
+    dst_ptr_v_start += frame->strides[2];
+    }
+  }
+
+/* ovl: GAVL_YUVA_32 */
+
+static void blend_yuv_420_p_sse2(gavl_overlay_blend_context_t * ctx,
+                                 gavl_video_frame_t * frame,
+                                 gavl_video_frame_t * overlay)
+  {
+  int i, j, imax, jmax;
+  uint8_t * ovl_ptr;
+  uint8_t * dst_ptr_y;
+  uint8_t * dst_ptr_u;
+  uint8_t * dst_ptr_v;
+  
+  uint8_t * ovl_ptr_start;
+  uint8_t * dst_ptr_y_start;
+  uint8_t * dst_ptr_u_start;
+  uint8_t * dst_ptr_v_start;
+  
+  int tmp;
+  
+  ovl_ptr_start = overlay->planes[0];
+  dst_ptr_y_start = frame->planes[0];
+  dst_ptr_u_start = frame->planes[1];
+  dst_ptr_v_start = frame->planes[2];
+
+  imax = ctx->dst_rect.h / 2;
+  jmax = ctx->dst_rect.w / 8;
+
+  pxor_r2r(xmm7, xmm7);
+  
+  for(i = 0; i < imax; i++)
+    {
+    /* Luma and chroma */
+    ovl_ptr = ovl_ptr_start;
+    dst_ptr_y = dst_ptr_y_start;
+    dst_ptr_u = dst_ptr_u_start;
+    dst_ptr_v = dst_ptr_v_start;
+    
+    for(j = 0; j < jmax; j++)
+      {
+      LOAD_OVL_32(ovl_ptr);
+      EXTRACT_32(3, xmm1);
+
+      EXTRACT_32(0, xmm0);
+      BLEND_8_BYTES(dst_ptr_y);
+      
+      EVEN_WORDS(xmm1);
+      
+      EXTRACT_32(1, xmm0);
+      EVEN_WORDS(xmm0);
+      BLEND_4_BYTES(dst_ptr_u);
+      
+      EXTRACT_32(2, xmm0);
+      EVEN_WORDS(xmm0);
+      BLEND_4_BYTES(dst_ptr_v);
+      
+      ovl_ptr   += 32;
+      dst_ptr_y += 8;
+      dst_ptr_u += 4;
+      dst_ptr_v += 4;
+      }
+
+    for(j = jmax * 4; j < ctx->dst_rect.w / 2; j++)
+      {
+      /* Y0 */
+      tmp = *dst_ptr_y;
+      BLEND_8(ovl_ptr[0], tmp, ovl_ptr[3]);
+      *(dst_ptr_y++) = tmp;
+
+      /* U0 */
+      tmp = *dst_ptr_u;
+      BLEND_8(ovl_ptr[1], tmp, ovl_ptr[3]);
+      *(dst_ptr_u++) = tmp;
+
+      /* V0 */
+      tmp = *dst_ptr_v;
+      BLEND_8(ovl_ptr[2], tmp, ovl_ptr[3]);
+      *(dst_ptr_v++) = tmp;
+
+      /* Y1 */
+      tmp = *dst_ptr_y;
+      BLEND_8(ovl_ptr[4], tmp, ovl_ptr[7]);
+      *(dst_ptr_y++) = tmp;
+      
+      ovl_ptr+=8;
+      }
+    
+    ovl_ptr_start += overlay->strides[0];
+    dst_ptr_y_start += frame->strides[0];
+    dst_ptr_u_start += frame->strides[1];
+    dst_ptr_v_start += frame->strides[2];
+
+    /* Luma only */
+    ovl_ptr = ovl_ptr_start;
+    dst_ptr_y = dst_ptr_y_start;
+
+    for(j = 0; j < jmax; j++)
+      {
+      LOAD_OVL_32(ovl_ptr);
+      EXTRACT_32(3, xmm1);
+      EXTRACT_32(0, xmm0);
+      BLEND_8_BYTES(dst_ptr_y);
+      ovl_ptr   += 32;
+      dst_ptr_y += 8;
+      }
+    
+    for(j = jmax * 8; j < (ctx->dst_rect.w & ~1); j++)
+      {
+      tmp = *dst_ptr_y;
+      BLEND_8(ovl_ptr[0], tmp, ovl_ptr[3]);
+      *(dst_ptr_y++) = tmp;
+      ovl_ptr+=4;
+      }
+    
+    ovl_ptr_start += overlay->strides[0];
+    dst_ptr_y_start += frame->strides[0];
+    }
+  }
+
+gavl_blend_func_t
+gavl_find_blend_func_sse2(gavl_overlay_blend_context_t * ctx,
+                          gavl_pixelformat_t frame_format,
+                          gavl_pixelformat_t overlay_format)
+  {
+  switch(frame_format)
+    {
+    case GAVL_GRAY_8:
+      if(overlay_format == GAVL_GRAYA_16)
+        return blend_gray_8_sse2;
+      break;
+    case GAVL_RGB_32:
+      if(overlay_format == GAVL_RGBA_32)
+        return blend_rgb_32_sse2;
+      break;
+    case GAVL_YUV_420_P:
+      if(overlay_format == GAVL_YUVA_32)
+        return blend_yuv_420_p_sse2;
+      break;
+    case GAVL_YUV_444_P:
+      if(overlay_format == GAVL_YUVA_32)
+        return blend_yuv_444_p_sse2;
+      break;
+    default:
+      break;
+    }
+  return NULL;
+  }
@@ -34,6 +34,8 @@ struct gavl_overlay_blend_context_s
   gavl_video_frame_t * ovl_win;
   gavl_video_frame_t * dst_win;
 
+  /* Cropped rectangles, the overlay itself is left untouched */
+  gavl_rectangle_i_t src_rect;
   gavl_rectangle_i_t dst_rect;
     
   gavl_video_options_t opt;
@@ -48,4 +50,9 @@ gavl_find_blend_func_c(gavl_overlay_blend_context_t * ctx,
                        gavl_pixelformat_t frame_format,
                        gavl_pixelformat_t * overlay_format);
 
-                       
+#ifdef HAVE_SSE2
+gavl_blend_func_t
+gavl_find_blend_func_sse2(gavl_overlay_blend_context_t * ctx,
+                          gavl_pixelformat_t frame_format,
+                          gavl_pixelformat_t overlay_format);
+#endif
@@ -0,0 +1,205 @@
+/*****************************************************************
+ * gavl - a general purpose audio/video processing library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/**
+ * @file spectrum.h
+ * external api header.
+ */
+
+#ifndef GAVL_SPECTRUM_H_INCLUDED
+#define GAVL_SPECTRUM_H_INCLUDED
+
+#include <gavl/connectors.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \defgroup spectrum_analysis Spectrum analyzer
+ *  \ingroup audio
+ *  \brief Spectrum analysis and beat detection for visualizations
+ *
+ *  The spectrum analyzer keeps the last samples of each channel and
+ *  analyzes them (windowed real FFT, logarithmic bands and beat
+ *  detection) once per audio frame. Several consumers like
+ *  visualizations and level meters can share the result.
+ *
+ * @{
+ */
+
+/*! \brief Opaque structure for spectrum analyzer
+ *
+ * You don't want to know what's inside.
+ */
+
+typedef struct gavl_spectrum_analyzer_s gavl_spectrum_analyzer_t;
+
+/*! \brief Callback called after each analysis
+ *  \param priv Client data
+ *  \param sa The spectrum analyzer
+ *
+ *  Use the get functions to obtain the results from within the callback.
+ *
+ *  Since 1.5.0
+ */
+
+typedef void (*gavl_update_spectrum_callback)(void * priv,
+                                              gavl_spectrum_analyzer_t * sa);
+
+/*! \brief Create spectrum analyzer
+ *  \returns A newly allocated spectrum analyzer
+ *
+ *  Since 1.5.0
+ */
+
+GAVL_PUBLIC
+gavl_spectrum_analyzer_t * gavl_spectrum_analyzer_create();
+
+/*! \brief Destroys a spectrum analyzer and frees all associated memory
+ *  \param sa A spectrum analyzer
+ *
+ *  Since 1.5.0
+ */
+
+GAVL_PUBLIC
+void gavl_spectrum_analyzer_destroy(gavl_spectrum_analyzer_t * sa);
+
+/*! \brief Set callback
+ *  \param sa A spectrum analyzer
+ *  \param callback Callback called after each analysis or NULL
+ *  \param priv Client data passed to the callback
+ *
+ *  Since 1.5.0
+ */
+
+GAVL_PUBLIC
+void gavl_spectrum_analyzer_set_callback(gavl_spectrum_analyzer_t * sa,
+                                         gavl_update_spectrum_callback callback,
+                                         void * priv);
+
+/*! \brief Set format for a spectrum analyzer
+ *  \param sa A spectrum analyzer
+ *  \param format The format subsequent frames will be passed with
+ *  \param fft_size Number of samples per analysis (a power of 2, at least 16)
+ *  \param num_bands Number of logarithmic frequency bands
+ *
+ * This function can be called multiple times with one instance. It also
+ * calls \ref gavl_spectrum_analyzer_reset.
+ *
+ *  Since 1.5.0
+ */
+
+GAVL_PUBLIC
+void gavl_spectrum_analyzer_set_format(gavl_spectrum_analyzer_t * sa,
+                                       const gavl_audio_format_t * format,
+                                       int fft_size, int num_bands);
+
+/*! \brief Get format
+ *  \param sa A spectrum analyzer
+ *  \returns The internal format
+ *
+ *  Since 1.5.0
+ */
+
+GAVL_PUBLIC const gavl_audio_format_t *
+gavl_spectrum_analyzer_get_format(gavl_spectrum_analyzer_t * sa);
+
+/*! \brief Feed the spectrum analyzer with a new frame
+ *  \param sa A spectrum analyzer
+ *  \param frame An audio frame
+ *
+ *  Since 1.5.0
+ */
+
+GAVL_PUBLIC
+void gavl_spectrum_analyzer_update(gavl_spectrum_analyzer_t * sa,
+                                   gavl_audio_frame_t * frame);
+
+/*! \brief Get the audio sink
+ *  \param sa A spectrum analyzer
+ *  \returns An audio sink
+ *
+ *  Use the returned sink for passing audio frames as an alternative to
+ *  \ref gavl_spectrum_analyzer_update
+ *
+ *  Since 1.5.0
+ */
+
+GAVL_PUBLIC
+gavl_audio_sink_t * gavl_spectrum_analyzer_get_sink(gavl_spectrum_analyzer_t * sa);
+
+/*! \brief Get the spectrum of one channel
+ *  \param sa A spectrum analyzer
+ *  \param channel Channel index
+ *  \returns fft_size/2+1 amplitudes from 0 to samplerate/2
+ *
+ *  The amplitudes are normalized such that a full scale sine wave
+ *  has an amplitude of 1.0.
+ *
+ *  Since 1.5.0
+ */
+
+GAVL_PUBLIC
+const float * gavl_spectrum_analyzer_get_spectrum(gavl_spectrum_analyzer_t * sa,
+                                                  int channel);
+
+/*! \brief Get the logarithmic frequency bands of one channel
+ *  \param sa A spectrum analyzer
+ *  \param channel Channel index
+ *  \returns num_bands amplitudes from low to high frequencies
+ *
+ *  Since 1.5.0
+ */
+
+GAVL_PUBLIC
+const float * gavl_spectrum_analyzer_get_bands(gavl_spectrum_analyzer_t * sa,
+                                               int channel);
+
+/*! \brief Get the result of the beat detection
+ *  \param sa A spectrum analyzer
+ *  \param loudness If non-NULL returns the loudness (0.0 - 1.0) of the last frame
+ *  \returns 1 if the last frame started a beat, 0 else
+ *
+ *  Since 1.5.0
+ */
+
+GAVL_PUBLIC
+int gavl_spectrum_analyzer_get_beat(gavl_spectrum_analyzer_t * sa,
+                                    float * loudness);
+
+/*! \brief Reset a spectrum analyzer
+ *  \param sa A spectrum analyzer
+ *
+ *  Since 1.5.0
+ */
+
+GAVL_PUBLIC
+void gavl_spectrum_analyzer_reset(gavl_spectrum_analyzer_t * sa);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GAVL_SPECTRUM_H_INCLUDED
@@ -19,6 +19,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  * *****************************************************************/
 #include <stdlib.h>
+#include <string.h>
 #include <gavl.h>
 #include <gavl_version.h>
 //#include "colorspace.h" // Common routines
@@ -26,6 +27,7 @@
 #include <png.h>
 
 #include <accel.h>
+#include "timeutils.h"
 
 #define IN_X 0
 #define IN_Y 0
@@ -272,6 +274,87 @@ static gavl_video_frame_t * read_png(const char * filename,
     return frame;
   }
 
+/* Timing mode */
+
+#define NUM_BLENDS 100
+
+static const struct
+  {
+  int flags;
+  const char * name;
+  }
+accel_flags[] =
+  {
+    { GAVL_ACCEL_C,    "C"    },
+    { GAVL_ACCEL_SSE2, "SSE2" },
+  };
+
+static void time_blend(const char * frame_file, const char * overlay_file)
+  {
+  int i, j, k, imax;
+  uint64_t t;
+  gavl_overlay_blend_context_t *blend;
+  gavl_video_format_t frame_format, overlay_format;
+  gavl_video_frame_t * frame, * overlay;
+  gavl_video_options_t * opt;
+  gavl_pixelformat_t frame_csp;
+  
+  memset(&frame_format,   0, sizeof(frame_format));
+  memset(&overlay_format, 0, sizeof(overlay_format));
+
+  imax = gavl_num_pixelformats();
+  blend = gavl_overlay_blend_context_create();
+  opt = gavl_overlay_blend_context_get_options(blend);
+
+  for(i = 0; i < imax; i++)
+    {
+    frame_csp = gavl_get_pixelformat(i);
+    
+    for(j = 0; j < sizeof(accel_flags)/sizeof(accel_flags[0]); j++)
+      {
+      if((accel_flags[j].flags != GAVL_ACCEL_C) &&
+         !(gavl_accel_supported() & accel_flags[j].flags))
+        continue;
+      
+      gavl_video_options_set_accel_flags(opt, accel_flags[j].flags);
+      
+      frame = read_png(frame_file, &frame_format, frame_csp);
+
+      /* Get the overlay format the blender wants */
+      overlay_format.pixelformat = GAVL_RGBA_32;
+      gavl_overlay_blend_context_init(blend, &frame_format, &overlay_format);
+
+      overlay = read_png(overlay_file, &overlay_format,
+                         overlay_format.pixelformat);
+      gavl_overlay_blend_context_init(blend, &frame_format, &overlay_format);
+      
+      overlay->src_rect.x = 0;
+      overlay->src_rect.y = 0;
+      overlay->src_rect.w = overlay_format.image_width;
+      overlay->src_rect.h = overlay_format.image_height;
+      
+      overlay->dst_x = OUT_X;
+      overlay->dst_y = OUT_Y;
+      gavl_overlay_blend_context_set_overlay(blend, overlay);
+
+      /* Overlays are usually blended onto many frames */
+      timer_init();
+      for(k = 0; k < NUM_BLENDS; k++)
+        gavl_overlay_blend(blend, frame);
+      t = timer_stop();
+      
+      printf("Frame: %s, Overlay: %s, %s: %.2f usec/blend\n",
+             gavl_pixelformat_to_string(frame_csp),
+             gavl_pixelformat_to_string(overlay_format.pixelformat),
+             accel_flags[j].name, (double)t / NUM_BLENDS);
+      
+      gavl_video_frame_destroy(frame);
+      gavl_video_frame_destroy(overlay);
+      }
+    }
+  gavl_overlay_blend_context_destroy(blend);
+  }
+
 int main(int argc, char ** argv)
   {
   char filename_buffer[1024];
@@ -288,9 +371,16 @@ int main(int argc, char ** argv)
   gavl_pixelformat_t overlay_csp;
 
 
+  if((argc == 4) && !strcmp(argv[1], "-t"))
+    {
+    time_blend(argv[2], argv[3]);
+    return 0;
+    }
+  
   if(argc != 3)
     {
-    fprintf(stderr, "Usage: blend_test <frame_file> <overlay_file>\n");
+    fprintf(stderr, "Usage: blend_test [-t] <frame_file> <overlay_file>\n");
+    fprintf(stderr, "       -t: Measure the speed of the blend functions\n");
     return -1;
     }
 
@@ -0,0 +1,159 @@
+/*****************************************************************
+ * gavl - a general purpose audio/video processing library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+#include <gavl.h>
+#include <gavl/spectrum.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#define FFT_SIZE    1024
+#define NUM_BANDS   32
+#define SAMPLES     512
+#define MAX_SAMPLES 3000
+#define SINE_BIN    64
+#define NUM_FRAMES  10000
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Left channel: Sine with amplitude 0.5, right channel: Clicks
+   every 40 frames */
+
+static void make_frame(gavl_audio_frame_t * f, int frame,
+                       int64_t start, int num)
+  {
+  int i;
+  int64_t t;
+  int click = ((frame % 40) == 0);
+
+  for(i = 0; i < num; i++)
+    {
+    t = start + i;
+    f->samples.s_16[2*i] =
+      (int)(16384.0 * sin(2.0 * M_PI * SINE_BIN * (double)t / FFT_SIZE));
+
+    if(click)
+      f->samples.s_16[2*i+1] = (rand() % 65536) - 32768;
+    else
+      f->samples.s_16[2*i+1] = 0;
+    }
+  f->valid_samples = num;
+  }
+
+/* Feed the sine in frames of the given size and check the peak
+   position and amplitude. Odd sizes make the history start at odd
+   positions, sizes larger than the FFT overflow the history */
+
+static int check_sine(gavl_spectrum_analyzer_t * sa,
+                      gavl_audio_frame_t * f, int num)
+  {
+  int i, max_bin;
+  int64_t t = 0;
+  const float * spec;
+  int ret;
+  
+  gavl_spectrum_analyzer_reset(sa);
+  
+  for(i = 0; i < 2 * FFT_SIZE / num + 3; i++)
+    {
+    make_frame(f, 1, t, num);
+    t += num;
+    gavl_spectrum_analyzer_update(sa, f);
+    }
+
+  spec = gavl_spectrum_analyzer_get_spectrum(sa, 0);
+  max_bin = 0;
+  for(i = 1; i <= FFT_SIZE/2; i++)
+    {
+    if(spec[i] > spec[max_bin])
+      max_bin = i;
+    }
+  ret = (max_bin == SINE_BIN) && (fabs(spec[max_bin] - 0.5) < 0.005);
+  
+  fprintf(stderr, "Sine (%4d samples per frame): peak at bin %d (expected %d), amplitude %f (expected 0.5) [%s]\n",
+          num, max_bin, SINE_BIN, spec[max_bin], ret ? "ok" : "fail");
+  return ret;
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i, num_beats = 0;
+  int result = 1;
+  float loudness;
+  gavl_audio_format_t format;
+  gavl_audio_frame_t * f;
+  gavl_spectrum_analyzer_t * sa;
+  gavl_timer_t * timer;
+  gavl_time_t time;
+
+  memset(&format, 0, sizeof(format));
+  format.num_channels = 2;
+  format.interleave_mode = GAVL_INTERLEAVE_ALL;
+  format.sample_format = GAVL_SAMPLE_S16;
+  format.samples_per_frame = MAX_SAMPLES;
+  format.samplerate = 44100;
+  gavl_set_channel_setup(&format);
+
+  f = gavl_audio_frame_create(&format);
+  sa = gavl_spectrum_analyzer_create();
+  gavl_spectrum_analyzer_set_format(sa, &format, FFT_SIZE, NUM_BANDS);
+
+  /* Sine: Check peak position and amplitude */
+  if(!check_sine(sa, f, SAMPLES))
+    result = 0;
+  if(!check_sine(sa, f, 333))
+    result = 0;
+  if(!check_sine(sa, f, 1))
+    result = 0;
+  if(!check_sine(sa, f, MAX_SAMPLES))
+    result = 0;
+
+  /* Clicks: Count beats and time the analysis */
+  gavl_spectrum_analyzer_reset(sa);
+
+  timer = gavl_timer_create();
+  gavl_timer_start(timer);
+
+  for(i = 0; i < NUM_FRAMES; i++)
+    {
+    make_frame(f, i, (int64_t)i * SAMPLES, SAMPLES);
+    gavl_spectrum_analyzer_update(sa, f);
+    if(gavl_spectrum_analyzer_get_beat(sa, &loudness))
+      num_beats++;
+    }
+
+  time = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+
+  fprintf(stderr, "Clicks: %d beats detected (%d clicks)\n",
+          num_beats, NUM_FRAMES / 40);
+  fprintf(stderr, "%d frames analyzed in %f seconds (%.1f us per frame)\n",
+          NUM_FRAMES, gavl_time_to_seconds(time),
+          1.0e6 * gavl_time_to_seconds(time) / NUM_FRAMES);
+
+  gavl_timer_destroy(timer);
+  gavl_spectrum_analyzer_destroy(sa);
+  gavl_audio_frame_destroy(f);
+  return result ? 0 : 1;
+  }
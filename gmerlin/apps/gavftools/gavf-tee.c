@@ -29,6 +29,32 @@ static bg_plug_t ** out_plugs = NULL;
 static char ** outfiles = NULL;
 static int num_outfiles = 0;
 
+/* Each output is written by its own thread through a queue, so a slow
+   output doesn't stall the others. The queue size can be changed with
+   -oopt queue=<n> (0 writes synchronously). With the drop or
+   disconnect overflow policy, a failed output is detached while the
+   others continue. */
+
+#define QUEUE_SIZE 64
+
+static int check_outputs(int * out_errors)
+  {
+  int i;
+  int num_ok = 0;
+  
+  for(i = 0; i < num_outfiles; i++)
+    {
+    if(!out_errors[i] && bg_plug_got_error(out_plugs[i]))
+      {
+      bg_log(BG_LOG_WARNING, LOG_DOMAIN, "Output %s disconnected", outfiles[i]);
+      out_errors[i] = 1;
+      }
+    if(!out_errors[i])
+      num_ok++;
+    }
+  return num_ok;
+  }
+
 static void
 opt_o(void * data, int * argc, char *** _argv, int arg)
   {
@@ -55,7 +81,7 @@ static bg_cmdline_arg_t global_options[] =
     {
       .arg =         "-o",
       .help_arg =    "<output>",
-      .help_string = TRS("Output file or location. Use this option multiple times to add more outputs."),
+      .help_string = TRS("Output file or location. Use this option multiple times to add more outputs. Each output is written by a separate thread with a queue of 64 packets unless -oopt queue=<n> is given."),
       .callback    = &opt_o,
     },
     GAVFTOOLS_OOPT_OPTIONS,
@@ -88,6 +114,7 @@ int main(int argc, char ** argv)
   {
   int ret = EXIT_FAILURE;
   int i;
+  int * out_errors = NULL;
   bg_mediaconnector_t conn;
   
   gavftools_init();
@@ -97,6 +124,10 @@ int main(int argc, char ** argv)
 
   gavftools_set_cmdline_parameters(global_options);
 
+  /* Asynchronous writing by default, -oopt can override this */
+  bg_cfg_section_set_parameter_int(gavftools_oopt_section(), "queue",
+                                   QUEUE_SIZE);
+
   bg_cmdline_init(&app_data);
   bg_cmdline_parse(global_options, &argc, &argv, NULL);
 
@@ -125,6 +156,7 @@ int main(int argc, char ** argv)
   bg_mediaconnector_create_conn(&conn);
   
   out_plugs = calloc(num_outfiles, sizeof(*out_plugs));
+  out_errors = calloc(num_outfiles, sizeof(*out_errors));
 
   for(i = 0; i < num_outfiles; i++)
     {
@@ -151,6 +183,12 @@ int main(int argc, char ** argv)
     if(bg_plug_got_error(in_plug))
       break;
 
+    if(!check_outputs(out_errors))
+      {
+      bg_log(BG_LOG_ERROR, LOG_DOMAIN, "All outputs disconnected");
+      break;
+      }
+
     if(gavftools_stop() ||
        !bg_mediaconnector_iteration(&conn))
       break;
@@ -167,12 +205,17 @@ int main(int argc, char ** argv)
     bg_plug_destroy(in_plug);
   
   for(i = 0; i < num_outfiles; i++)
-    bg_plug_destroy(out_plugs[i]);
+    {
+    if(out_plugs && out_plugs[i])
+      bg_plug_destroy(out_plugs[i]);
+    }
 
   if(outfiles)
     free(outfiles);
   if(out_plugs)
     free(out_plugs);
+  if(out_errors)
+    free(out_errors);
   
   gavftools_cleanup();
   
@@ -27,3 +27,6 @@ void bg_shm_pool_destroy(bg_shm_pool_t *);
 bg_shm_t * bg_shm_pool_get_read(bg_shm_pool_t *, int id);
 bg_shm_t * bg_shm_pool_get_write(bg_shm_pool_t *);
 
+/* Number of segments, which are still referenced by a reader */
+int bg_shm_pool_num_used(bg_shm_pool_t *);
+
@@ -137,7 +137,7 @@ typedef int (*bg_read_video_func_t)(void * priv, gavl_video_frame_t* frame,
 /** @}
  */
 
-#define BG_PLUGIN_API_VERSION 26
+#define BG_PLUGIN_API_VERSION 27
 
 /* Include this into all plugin modules exactly once
    to let the plugin loader obtain the API version */
@@ -1091,6 +1091,17 @@ struct bg_recorder_plugin_s
    */
   
   gavl_video_source_t * (*get_video_source)(void * priv);
+
+  /** \brief Check whether the last video frame changed
+   *  \param priv The handle returned by the create() method
+   *  \param rect If non-NULL, returns the bounding box of the changed area
+   *  \returns 0 if the last frame is identical to the one before, 1 else
+   *
+   *  This function is optional. If it's NULL, all frames are
+   *  assumed to be changed.
+   */
+
+  int (*video_frame_changed)(void * priv, gavl_rectangle_i_t * rect);
   
   /** \brief Close plugin
    *  \param priv The handle returned by the create() method
@@ -889,6 +889,64 @@ int bg_get_thumbnail(const char * gml,
                      gavl_video_frame_t ** frame_ret,
                      gavl_video_format_t * format_ret);
 
+/** \brief Thumbnailer
+ *
+ *  Generates thumbnails for many files in the background.
+ *  Thumbnails are stored in the same places as
+ *  with \ref bg_get_thumbnail.
+ */
+
+typedef struct bg_thumbnailer_s bg_thumbnailer_t;
+
+/** \brief Callback for finished thumbnails
+ *  \param data The cb_data passed to \ref bg_thumbnailer_create
+ *  \param gml Location
+ *  \param thumbnail_file Thumbnail file or NULL if no thumbnail could be generated
+ *
+ *  This is called from a separate thread.
+ */
+
+typedef void (*bg_thumbnailer_callback_t)(void * data, const char * gml,
+                                          const char * thumbnail_file);
+
+/** \brief Create a thumbnailer
+ *  \param plugin_reg Plugin registry
+ *  \param num_threads Number of decoding threads
+ *  \param time_budget Maximum time to spend on one file or 0
+ *  \param cb Callback (can be NULL)
+ *  \param cb_data Client data for the callback
+ *  \returns A newly allocated thumbnailer or NULL
+ *
+ *  The plugin registry must not be used for loading plugins by other
+ *  threads as long as the thumbnailer exists.
+ */
+
+bg_thumbnailer_t *
+bg_thumbnailer_create(bg_plugin_registry_t * plugin_reg,
+                      int num_threads, gavl_time_t time_budget,
+                      bg_thumbnailer_callback_t cb, void * cb_data);
+
+/** \brief Queue a file for thumbnail generation
+ *  \param t A thumbnailer
+ *  \param gml Location (should be a regular file)
+ */
+
+void bg_thumbnailer_add(bg_thumbnailer_t * t, const char * gml);
+
+/** \brief Wait until all queued files are finished
+ *  \param t A thumbnailer
+ */
+
+void bg_thumbnailer_wait(bg_thumbnailer_t * t);
+
+/** \brief Destroy a thumbnailer
+ *  \param t A thumbnailer
+ *
+ *  Queued files are finished before.
+ */
+
+void bg_thumbnailer_destroy(bg_thumbnailer_t * t);
+
 
 /*
  *  These are the actual loading/unloading functions
@@ -32,8 +32,16 @@ void bg_subtitle_handler_init(bg_subtitle_handler_t * h,
 void bg_subtitle_handler_update(bg_subtitle_handler_t *,
                                 const gavl_video_frame_t * frame);
 
+/* Stops the prefetch thread and flushes all pending subtitles */
 void bg_subtitle_handler_reset(bg_subtitle_handler_t *);
 
+/* Start a thread, which renders the upcoming subtitles ahead of time.
+   bg_subtitle_handler_update() then only picks up the finished overlays.
+   The thread must be stopped before the source is seeked or destroyed. */
+
+void bg_subtitle_handler_start(bg_subtitle_handler_t *);
+void bg_subtitle_handler_stop(bg_subtitle_handler_t *);
+
 
 
 
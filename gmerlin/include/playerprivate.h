@@ -424,6 +424,10 @@ void bg_player_ov_create(bg_player_t * player);
 
 void bg_player_ov_reset(bg_player_t * player);
 
+/* Stop rendering subtitles ahead. To be called while the video thread
+   is paused, the video thread restarts it when playback continues */
+void bg_player_ov_stop_prefetch(bg_player_t * player);
+
 void bg_player_ov_destroy(bg_player_t * player);
 int bg_player_ov_init(bg_player_video_stream_t * vs);
 
@@ -32,6 +32,27 @@ bg_plugin_info_t * bg_plugin_registry_load(const char * filename);
 
 void bg_plugin_registry_save(bg_plugin_info_t * info);
 
+/** \ingroup plugin_registry
+ *  \brief Load plugin infos from the binary cache
+ *  \param filename The name of the cache file
+ *  \param path Colon separated list of all scanned plugin directories
+ *  \param xml_file The name of the xml file
+ *  \returns The plugin infos or NULL if the cache is missing or outdated
+ */
+
+bg_plugin_info_t * bg_plugin_registry_load_cache(const char * filename,
+                                                 const char * path,
+                                                 const char * xml_file);
+
+/** \ingroup plugin_registry
+ *  \brief Save plugin infos to the binary cache
+ */
+
+void bg_plugin_registry_save_cache(const bg_plugin_info_t * info,
+                                   const char * filename,
+                                   const char * path,
+                                   const char * xml_file);
+
 
 void bg_plugin_info_destroy(bg_plugin_info_t * info);
 
@@ -104,6 +104,20 @@ typedef struct
 void bg_recorder_audio_set_eof(bg_recorder_audio_stream_t*, int eof);
 int  bg_recorder_audio_get_eof(bg_recorder_audio_stream_t*);
 
+/* Snapshots are written by a separate thread. Frames are copied into
+   a small ring of slots, if all are busy the snapshot is skipped */
+
+#define SNAPSHOT_QUEUE_SIZE 4
+
+typedef struct
+  {
+  gavl_video_frame_t * frame;
+  gavl_video_format_t format;
+  gavl_metadata_t m;
+  char * filename;
+  int init; // First snapshot after (re)initialization
+  } bg_recorder_snapshot_t;
+
 typedef struct 
   {
   int flags;
@@ -164,6 +178,13 @@ typedef struct
   
   gavl_video_frame_t * snapshot_frame;
   gavl_video_frame_t * enc_frame;
+
+  /* Unchanged input frames (e.g. from a screen grabber) aren't
+     converted again if there are no filters */
+  int frame_changed;       /* Input changed since the last pipe frame */
+  int have_filters;
+  int enc_frame_valid;     /* enc_frame contains the last pipe frame */
+  int monitor_frame_valid; /* monitor_frame_priv contains the last pipe frame */
   
   gavl_timer_t * timer;
   
@@ -189,6 +210,21 @@ typedef struct
   
   int snapshot_counter;
 
+  /* Snapshot writer */
+  bg_recorder_snapshot_t snapshot_queue[SNAPSHOT_QUEUE_SIZE];
+  int snapshot_queue_start;
+  int snapshot_queue_len;
+  int snapshot_writer_stop;
+  int snapshots_skipped;
+  int snapshot_writer_init; // Converter is initialized
+
+  pthread_t snapshot_thread;
+  pthread_mutex_t snapshot_queue_mutex;
+  pthread_cond_t snapshot_queue_cond;
+
+  /* Locked while the writer uses the plugin */
+  pthread_mutex_t snapshot_write_mutex;
+
   int eof;
   pthread_mutex_t eof_mutex;
   
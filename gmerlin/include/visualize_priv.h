@@ -35,6 +35,12 @@
  * will be termimated with BG_VIS_SLAVE_MSG_END */
 #define BG_VIS_MSG_TELL          9
 
+/* Audio frame in a shared memory segment:
+ * arg_0 = segment id, arg_1 = valid samples, arg_2 = timestamp
+ * The size of the segments is passed as arg_1 of BG_VIS_MSG_AUDIO_FORMAT,
+ * the slave unrefs the segment when it's done with it */
+#define BG_VIS_MSG_AUDIO_SHM     10
+
 /* Messages from the visualizer to the application */
 
 #define BG_VIS_SLAVE_MSG_FPS     (BG_LOG_LEVEL_MAX+1)
@@ -194,4 +194,11 @@ int bg_x11_grab_window_init(bg_x11_grab_window_t *, gavl_video_format_t * format
 gavl_source_status_t
 bg_x11_grab_window_grab(void *, gavl_video_frame_t ** frame);
 
+/* Returns 0 if the last grabbed frame is the same as the one before.
+   Otherwise, rect (if non-NULL) is set to the bounding box of the
+   changed area */
+
+int bg_x11_grab_window_get_changed(bg_x11_grab_window_t * win,
+                                   gavl_rectangle_i_t * rect);
+
 void bg_x11_grab_window_close(bg_x11_grab_window_t * win);
@@ -23,7 +23,10 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include <unistd.h>
+#include <time.h>
+#include <pthread.h>
 
 #ifdef HAVE_MQ
 #include <fcntl.h>           /* For O_* constants */
@@ -31,7 +34,6 @@
 #define _XOPEN_SOURCE 600
 #include <mqueue.h>
 #include <errno.h>
-#include <time.h>
 
 #define MQ_NAME_MAX 32
 
@@ -78,6 +80,11 @@ typedef struct
   /* Writing */
   gavl_packet_sink_t * sink_ext;
   gavl_packet_sink_t * sink_int;
+  gavl_packet_sink_t * sink_gavf; // Behind the writer queue
+
+  gavl_packet_t p_drop; // Handed out if the queue is full
+  int drop;             // Dropping until the next keyframe
+  int64_t dropped;
   
   bg_plug_t * plug;
 
@@ -112,6 +119,19 @@ typedef struct
   bg_stream_action_t action;
   } stream_t;
 
+/* Entry of the writer queue */
+
+typedef struct queue_packet_s
+  {
+  gavl_packet_t p; // Must be first
+  stream_t * s;
+  struct queue_packet_s * next;
+  } queue_packet_t;
+
+#define OVERFLOW_BLOCK      0
+#define OVERFLOW_DROP       1
+#define OVERFLOW_DISCONNECT 2
+
 struct bg_plug_s
   {
   int wr;
@@ -146,6 +166,28 @@ struct bg_plug_s
   int got_error;
   int shm_threshold;
   int timeout;
+
+  /* Asynchronous writing: Packets are queued and written by a
+     separate thread */
+  int queue_size;
+  int overflow;
+
+  queue_packet_t * queue_packets;
+  queue_packet_t * queue_free;
+  queue_packet_t * queue_first;
+  queue_packet_t * queue_last;
+
+  int queue_len;
+  int queue_max; // Maximum lag
+  int disconnected;
+  int writer_running;
+  int writer_stop;
+  int64_t packets_written;
+  int64_t packets_dropped;
+
+  pthread_t writer_thread;
+  pthread_mutex_t queue_mutex;
+  pthread_cond_t queue_cond;
   
 #ifdef HAVE_MQ
   mqd_t mq;
@@ -281,7 +323,7 @@ static int io_cb_write(void * priv, int type, const void * data)
   clock_gettime(CLOCK_REALTIME, &timeout);
 
   timeout.tv_nsec += (p->timeout % 1000) * 1000000;
-  if(timeout.tv_nsec > 1000000000)
+  if(timeout.tv_nsec >= 1000000000)
     {
     timeout.tv_sec++;
     timeout.tv_nsec -= 1000000000;
@@ -356,6 +398,7 @@ static bg_plug_t * create_common()
 
   ret->timeout = 5000;
   ret->shm_threshold = 1024;
+  ret->queue_size = 0;
   
 #ifdef HAVE_MQ
   ret->mq = -1;
@@ -366,6 +409,8 @@ static bg_plug_t * create_common()
   //                         GAVF_OPT_FLAG_DUMP_METADATA);
   
   pthread_mutex_init(&ret->mutex, NULL);
+  pthread_mutex_init(&ret->queue_mutex, NULL);
+  pthread_cond_init(&ret->queue_cond, NULL);
 
   return ret;
   }
@@ -441,6 +486,9 @@ static void free_streams(stream_t * streams, int num)
       gavl_packet_source_destroy(s->src_ext);
     if(s->sink_ext && (s->sink_ext != s->sink_int))
       gavl_packet_sink_destroy(s->sink_ext);
+    if(s->sink_gavf)
+      gavl_packet_sink_destroy(s->sink_int);
+    gavl_packet_free(&s->p_drop);
     
     if(s->aframe)
       {
@@ -459,12 +507,18 @@ static void free_streams(stream_t * streams, int num)
     free(streams);
   }
 
+static void stop_writer(bg_plug_t * p);
+
 void bg_plug_destroy(bg_plug_t * p)
   {
   flush_streams(p->audio_streams, p->num_audio_streams);
   flush_streams(p->video_streams, p->num_video_streams);
   flush_streams(p->text_streams, p->num_text_streams);
   flush_streams(p->overlay_streams, p->num_overlay_streams);
+
+  /* Write the remaining queued packets */
+  if(p->writer_running)
+    stop_writer(p);
   
   gavf_close(p->g);
   if(p->io)
@@ -488,8 +542,18 @@ void bg_plug_destroy(bg_plug_t * p)
 #endif
   
   gavl_packet_free(&p->skip_packet);
+
+  if(p->queue_packets)
+    {
+    int i;
+    for(i = 0; i < p->queue_size; i++)
+      gavl_packet_free(&p->queue_packets[i].p);
+    free(p->queue_packets);
+    }
   
   pthread_mutex_destroy(&p->mutex);
+  pthread_mutex_destroy(&p->queue_mutex);
+  pthread_cond_destroy(&p->queue_cond);
 
   free(p);
   }
@@ -545,6 +609,27 @@ static const bg_parameter_info_t output_parameters[] =
       .val_max =     { .val_i = 100000 },
       .long_name = TRS("Timeout (milliseconds)"),
     },
+    {
+      .name = "queue",
+      .long_name = TRS("Queue size (packets)"),
+      .type = BG_PARAMETER_INT,
+      .val_min =     { .val_i =  0 },
+      .val_max =     { .val_i = 10000 },
+      .help_string = TRS("Packets are written by a separate thread through a queue of this size. Zero (the default) writes synchronously"),
+    },
+    {
+      .name =      "overflow",
+      .long_name = TRS("Queue overflow"),
+      .type      = BG_PARAMETER_STRINGLIST,
+      .val_default = { .val_str = "block" },
+      .multi_names =  (char const *[]){ "block",
+                                        "drop",
+                                        "disconnect", NULL },
+      .multi_labels = (char const *[]){ TRS("Block"),
+                                        TRS("Drop until next keyframe"),
+                                        TRS("Disconnect"), NULL  },
+      .help_string = TRS("What to do if the queue is full (i.e. the output is too slow). Block waits for the output, drop discards packets of a stream until its next keyframe, disconnect stops writing to this output if it didn't recover within the timeout while the input continues."),
+    },
     {
       .name = "dp",
       .long_name = TRS("Dump gavf packets"),
@@ -597,6 +682,17 @@ void bg_plug_set_parameter(void * data, const char * name,
     p->shm_threshold = val->val_i;
   else if(!strcmp(name, "timeout"))
     p->timeout = val->val_i;
+  else if(!strcmp(name, "queue"))
+    p->queue_size = val->val_i;
+  else if(!strcmp(name, "overflow"))
+    {
+    if(!strcmp(val->val_str, "drop"))
+      p->overflow = OVERFLOW_DROP;
+    else if(!strcmp(val->val_str, "disconnect"))
+      p->overflow = OVERFLOW_DISCONNECT;
+    else
+      p->overflow = OVERFLOW_BLOCK;
+    }
   }
 
 #undef SET_GAVF_FLAG
@@ -1118,6 +1214,269 @@ static gavl_sink_status_t put_packet_shm(void * priv, gavl_packet_t * pp)
   return gavl_packet_sink_put_packet(s->sink_int, p);
   }
 
+/* Writer queue */
+
+static void set_error(bg_plug_t * p)
+  {
+  pthread_mutex_lock(&p->mutex);
+  p->got_error = 1;
+  pthread_mutex_unlock(&p->mutex);
+  }
+
+/* Called with the queue mutex locked */
+
+static void release_queue_packet(bg_plug_t * p, queue_packet_t * qp)
+  {
+  qp->next = p->queue_free;
+  p->queue_free = qp;
+  pthread_cond_broadcast(&p->queue_cond);
+  }
+
+static void count_drop(bg_plug_t * p, stream_t * s)
+  {
+  s->dropped++;
+  p->packets_dropped++;
+  }
+
+static gavl_packet_t * get_packet_queue(void * priv)
+  {
+  gavl_packet_t * ret;
+  queue_packet_t * qp;
+  stream_t * s = priv;
+  bg_plug_t * p = s->plug;
+  
+  pthread_mutex_lock(&p->queue_mutex);
+
+  if(p->overflow == OVERFLOW_BLOCK)
+    {
+    while(!p->queue_free && !p->disconnected)
+      pthread_cond_wait(&p->queue_cond, &p->queue_mutex);
+    }
+  else if((p->overflow == OVERFLOW_DISCONNECT) && !p->queue_free)
+    {
+    /* Give a stalled output the timeout to recover */
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_nsec += (p->timeout % 1000) * 1000000;
+    if(timeout.tv_nsec >= 1000000000)
+      {
+      timeout.tv_sec++;
+      timeout.tv_nsec -= 1000000000;
+      }
+    timeout.tv_sec += p->timeout / 1000;
+
+    while(!p->queue_free && !p->disconnected)
+      {
+      if(pthread_cond_timedwait(&p->queue_cond, &p->queue_mutex, &timeout))
+        break;
+      }
+    }
+  
+  if(!p->queue_free || p->disconnected)
+    ret = &s->p_drop;
+  else
+    {
+    qp = p->queue_free;
+    p->queue_free = qp->next;
+    qp->next = NULL;
+    qp->s = s;
+    ret = &qp->p;
+    }
+  
+  pthread_mutex_unlock(&p->queue_mutex);
+  
+  gavl_packet_reset(ret);
+  return ret;
+  }
+
+static gavl_sink_status_t put_packet_queue(void * priv, gavl_packet_t * pp)
+  {
+  queue_packet_t * qp;
+  stream_t * s = priv;
+  bg_plug_t * p = s->plug;
+  gavl_sink_status_t ret = GAVL_SINK_OK;
+  int disconnect = 0;
+  
+  pthread_mutex_lock(&p->queue_mutex);
+
+  if(pp == &s->p_drop)
+    {
+    /* Queue was full or we are disconnected */
+    if(p->disconnected)
+      {
+      /* Blocking outputs stop the whole pipeline on errors as
+         if they were synchronous */
+      if(p->overflow == OVERFLOW_BLOCK)
+        ret = GAVL_SINK_ERROR;
+      }
+    else if(p->overflow == OVERFLOW_DISCONNECT)
+      {
+      p->disconnected = 1;
+      disconnect = 1;
+      pthread_cond_broadcast(&p->queue_cond);
+      }
+    else if(!s->drop)
+      {
+      /* Warn once, the totals are logged at the end */
+      if(!s->dropped)
+        bg_log(BG_LOG_WARNING, LOG_DOMAIN,
+               "Queue overflow, dropping packets of stream %d until next keyframe",
+               s->h->id);
+      s->drop = 1;
+      }
+    count_drop(p, s);
+    }
+  else
+    {
+    qp = (queue_packet_t*)pp;
+
+    if(p->disconnected ||
+       (s->drop && !(pp->flags & GAVL_PACKET_KEYFRAME)))
+      {
+      release_queue_packet(p, qp);
+      count_drop(p, s);
+      }
+    else
+      {
+      s->drop = 0;
+      
+      if(p->queue_last)
+        p->queue_last->next = qp;
+      else
+        p->queue_first = qp;
+      p->queue_last = qp;
+
+      p->queue_len++;
+      if(p->queue_len > p->queue_max)
+        p->queue_max = p->queue_len;
+      pthread_cond_broadcast(&p->queue_cond);
+      }
+    }
+  
+  pthread_mutex_unlock(&p->queue_mutex);
+
+  if(disconnect)
+    {
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN,
+           "Queue overflow, disconnecting output");
+    set_error(p);
+    }
+  return ret;
+  }
+
+static void * writer_thread(void * data)
+  {
+  queue_packet_t * qp;
+  int disconnected;
+  int report;
+  gavl_sink_status_t st;
+  bg_plug_t * p = data;
+  
+  while(1)
+    {
+    pthread_mutex_lock(&p->queue_mutex);
+
+    while(!p->queue_first && !p->writer_stop)
+      pthread_cond_wait(&p->queue_cond, &p->queue_mutex);
+    
+    if(!p->queue_first)
+      {
+      pthread_mutex_unlock(&p->queue_mutex);
+      break;
+      }
+
+    qp = p->queue_first;
+    p->queue_first = qp->next;
+    if(!p->queue_first)
+      p->queue_last = NULL;
+    p->queue_len--;
+    
+    disconnected = p->disconnected;
+    pthread_mutex_unlock(&p->queue_mutex);
+
+    /* Write without holding the queue mutex */
+    if(!disconnected)
+      st = gavl_packet_sink_put_packet(qp->s->sink_gavf, &qp->p);
+    else
+      st = GAVL_SINK_ERROR;
+    
+    report = 0;
+    pthread_mutex_lock(&p->queue_mutex);
+
+    if(st == GAVL_SINK_OK)
+      p->packets_written++;
+    else
+      {
+      count_drop(p, qp->s);
+      if(!p->disconnected)
+        {
+        p->disconnected = 1;
+        report = 1;
+        }
+      }
+    release_queue_packet(p, qp);
+    pthread_mutex_unlock(&p->queue_mutex);
+
+    if(report)
+      {
+      bg_log(BG_LOG_ERROR, LOG_DOMAIN,
+             "Writing packet failed, disconnecting output");
+      set_error(p);
+      }
+    }
+  return NULL;
+  }
+
+static void start_writer(bg_plug_t * p)
+  {
+  int i;
+
+  p->queue_packets = calloc(p->queue_size, sizeof(*p->queue_packets));
+
+  for(i = 0; i < p->queue_size; i++)
+    {
+    if(i < p->queue_size - 1)
+      p->queue_packets[i].next = p->queue_packets + i + 1;
+    }
+  p->queue_free = p->queue_packets;
+  
+  pthread_create(&p->writer_thread, NULL, writer_thread, p);
+  p->writer_running = 1;
+  }
+
+static void stop_writer(bg_plug_t * p)
+  {
+  int i;
+  stream_t * s;
+  
+  pthread_mutex_lock(&p->queue_mutex);
+  p->writer_stop = 1;
+  pthread_cond_broadcast(&p->queue_cond);
+  pthread_mutex_unlock(&p->queue_mutex);
+  
+  pthread_join(p->writer_thread, NULL);
+  p->writer_running = 0;
+
+  bg_log(BG_LOG_INFO, LOG_DOMAIN,
+         "Queue statistics: %"PRId64" packets written, %"PRId64" dropped, maximum lag: %d/%d packets",
+         p->packets_written, p->packets_dropped, p->queue_max, p->queue_size);
+
+#define LOG_DROPPED(streams, num)                                       \
+  for(i = 0; i < num; i++)                                              \
+    {                                                                   \
+    s = streams + i;                                                    \
+    if(s->dropped)                                                      \
+      bg_log(BG_LOG_INFO, LOG_DOMAIN,                                   \
+             "Stream %d: %"PRId64" packets dropped", s->h->id, s->dropped); \
+    }
+
+  LOG_DROPPED(p->audio_streams, p->num_audio_streams);
+  LOG_DROPPED(p->video_streams, p->num_video_streams);
+  LOG_DROPPED(p->text_streams, p->num_text_streams);
+  LOG_DROPPED(p->overlay_streams, p->num_overlay_streams);
+#undef LOG_DROPPED
+  }
+
 static void check_shm_write(bg_plug_t * p, stream_t * s,
                             gavl_metadata_t * m,
                             const gavl_compression_info_t * ci)
@@ -1150,6 +1509,15 @@ static int init_write_common(bg_plug_t * p, stream_t * s)
   {
   s->sink_int = gavf_get_packet_sink(p->g, s->h->id);
   gavl_packet_sink_set_lock_funcs(s->sink_int, lock_func, unlock_func, p);
+
+  if(p->queue_size > 0)
+    {
+    s->plug = p;
+    s->sink_gavf = s->sink_int;
+    s->sink_int = gavl_packet_sink_create(get_packet_queue,
+                                          put_packet_queue,
+                                          s);
+    }
   
   if(s->shm_size)
     {
@@ -1326,19 +1694,26 @@ static int init_write(bg_plug_t * p)
     return 0;
 
   create_sinks(p);
+
+  if(p->queue_size > 0)
+    start_writer(p);
   
   return 1;
   }
 
 static void update_metadata(void * priv, const gavl_metadata_t * m)
   {
-  gavf_update_metadata(priv, m);
+  bg_plug_t * p = priv;
+  /* The writer thread might be writing packets */
+  pthread_mutex_lock(&p->mutex);
+  gavf_update_metadata(p->g, m);
+  pthread_mutex_unlock(&p->mutex);
   }
 
 void bg_plug_transfer_metadata(bg_plug_t * in_plug, bg_plug_t * out_plug)
   {
   gavf_options_set_metadata_callback(gavf_get_options(bg_plug_get_gavf(in_plug)),
-                                     update_metadata, bg_plug_get_gavf(out_plug));
+                                     update_metadata, out_plug);
   
   }
 
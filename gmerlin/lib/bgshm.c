@@ -292,9 +292,9 @@ bg_shm_t * bg_shm_pool_get_write(bg_shm_pool_t * p)
       p->segments = realloc(p->segments,
                             p->segments_alloc * sizeof(*p->segments));
       }
-    p->segments[p->num_segments] =
-      bg_shm_alloc_write(p->segment_size);
-    ret = p->segments[p->num_segments];
+    if(!(ret = bg_shm_alloc_write(p->segment_size)))
+      return NULL;
+    p->segments[p->num_segments] = ret;
     p->num_segments++;
     }
 
@@ -303,6 +303,17 @@ bg_shm_t * bg_shm_pool_get_write(bg_shm_pool_t * p)
   return ret;
   }
 
+int bg_shm_pool_num_used(bg_shm_pool_t * p)
+  {
+  int i, ret = 0;
+  for(i = 0; i < p->num_segments; i++)
+    {
+    if(bg_shm_refcount(p->segments[i]))
+      ret++;
+    }
+  return ret;
+  }
+
 void bg_shm_pool_destroy(bg_shm_pool_t * p)
   {
   int i;
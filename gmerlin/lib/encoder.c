@@ -522,7 +522,8 @@ static void set_stream_param(void * priv, const char * name,
 
 static bg_plugin_handle_t * get_stream_handle(bg_encoder_t * enc,
                                               bg_stream_type_t type,
-                                              int stream, int in_index)
+                                              int stream, int in_index,
+                                              const char * suffix)
   {
   bg_plugin_handle_t * ret;
   const bg_plugin_info_t * info = NULL;
@@ -558,10 +559,13 @@ static bg_plugin_handle_t * get_stream_handle(bg_encoder_t * enc,
 
     if(enc->total_streams > 1)
       {
-      if(strcmp(enc->filename_base, "-"))
-        filename_base = bg_sprintf("%s_%s_%02d", enc->filename_base, type_string, in_index+1);
-      else
+      if(!strcmp(enc->filename_base, "-"))
         filename_base = gavl_strdup(enc->filename_base);
+      else if(suffix)
+        filename_base = bg_sprintf("%s_%s_%02d_%s", enc->filename_base,
+                                   type_string, in_index+1, suffix);
+      else
+        filename_base = bg_sprintf("%s_%s_%02d", enc->filename_base, type_string, in_index+1);
 
       ret = load_encoder(enc, info, section, filename_base);
       free(filename_base);
@@ -591,7 +595,7 @@ static int start_audio(bg_encoder_t * enc, int stream)
 
   /* Get handle */
 
-  h = get_stream_handle(enc, BG_STREAM_AUDIO, stream, s->com.in_index);
+  h = get_stream_handle(enc, BG_STREAM_AUDIO, stream, s->com.in_index, NULL);
 
   if(!h)
     return 0;
@@ -637,14 +641,30 @@ static int start_audio(bg_encoder_t * enc, int stream)
 
 static int start_video(bg_encoder_t * enc, int stream)
   {
+  int i;
   video_stream_t * s;
   bg_plugin_handle_t * h;
   set_stream_param_struct_t st;
+  char * suffix = NULL;
   
   s = &enc->video_streams[stream];
 
+  /* Additional sizes of the same source stream go to separate files
+     named after the image size */
+  for(i = 0; i < stream; i++)
+    {
+    if(enc->video_streams[i].com.in_index == s->com.in_index)
+      {
+      suffix = bg_sprintf("%dx%d", s->format.image_width,
+                          s->format.image_height);
+      break;
+      }
+    }
+  
   /* Get handle */
-  h = get_stream_handle(enc, BG_STREAM_VIDEO, stream, s->com.in_index);
+  h = get_stream_handle(enc, BG_STREAM_VIDEO, stream, s->com.in_index, suffix);
+  if(suffix)
+    free(suffix);
 
   if(!h)
     return 0;
@@ -710,7 +730,7 @@ static int start_text(bg_encoder_t * enc, int stream)
   s = &enc->text_streams[stream];
 
   /* Get handle */
-  h = get_stream_handle(enc, BG_STREAM_TEXT, stream, s->com.in_index);
+  h = get_stream_handle(enc, BG_STREAM_TEXT, stream, s->com.in_index, NULL);
 
   if(!h)
     return 0;
@@ -749,7 +769,7 @@ static int start_overlay(bg_encoder_t * enc, int stream)
   s = &enc->overlay_streams[stream];
 
   /* Get handle */
-  h = get_stream_handle(enc, BG_STREAM_OVERLAY, stream, s->com.in_index);
+  h = get_stream_handle(enc, BG_STREAM_OVERLAY, stream, s->com.in_index, NULL);
 
   if(!h)
     return 0;
@@ -55,6 +55,11 @@
 #define TYPE_COLOR_RGBA     6
 #define TYPE_POSITION       7
 
+/* Pointer arguments up to this size (in total) are stored inside the
+   message itself. This saves allocations for the usual small
+   strings and formats */
+#define INLINE_SIZE 128
+
 struct bg_msg_s
   {
   uint32_t id;
@@ -75,17 +80,28 @@ struct bg_msg_s
     } args[BG_MSG_MAX_ARGS];
 
   int num_args;
-
-  sem_t produced;
   
-  bg_msg_t * prev;
   bg_msg_t * next;
+
+  int inline_used;
+  union
+    {
+    uint8_t buf[INLINE_SIZE];
+    double align;
+    } inline_data;
   };
 
+static int is_inline(bg_msg_t * msg, void * ptr)
+  {
+  return ((uint8_t*)ptr >= msg->inline_data.buf) &&
+    ((uint8_t*)ptr < msg->inline_data.buf + INLINE_SIZE);
+  }
+
 void bg_msg_set_id(bg_msg_t * msg, int id)
   {
   msg->id = id;
   msg->num_args = 0;
+  msg->inline_used = 0;
 
   /* Zero everything */
 
@@ -128,8 +144,17 @@ void * bg_msg_set_arg_ptr(bg_msg_t * msg, int arg, int len)
   {
   if(!check_arg(arg))
     return NULL;
+
+  if(msg->inline_used + len <= INLINE_SIZE)
+    {
+    msg->args[arg].value.val_ptr = msg->inline_data.buf + msg->inline_used;
+    memset(msg->args[arg].value.val_ptr, 0, len);
+    /* Keep the next argument aligned */
+    msg->inline_used += (len + 7) & ~7;
+    }
+  else
+    msg->args[arg].value.val_ptr = calloc(1, len);
   
-  msg->args[arg].value.val_ptr = calloc(1, len);
   msg->args[arg].size = len;
   msg->args[arg].type = TYPE_POINTER;
   if(arg+1 > msg->num_args)
@@ -264,6 +289,21 @@ void bg_msg_get_arg_position(bg_msg_t * msg, int arg, double * val)
   val[1] = msg->args[arg].value.val_pos[1];
   }
 
+/* Inline arguments are copied because the caller gets the ownership */
+
+static void * steal_ptr(bg_msg_t * msg, int arg)
+  {
+  void * ret = msg->args[arg].value.val_ptr;
+  
+  if(ret && is_inline(msg, ret))
+    {
+    ret = malloc(msg->args[arg].size);
+    memcpy(ret, msg->args[arg].value.val_ptr, msg->args[arg].size);
+    }
+  msg->args[arg].value.val_ptr = NULL;
+  return ret;
+  }
+
 void * bg_msg_get_arg_ptr(bg_msg_t * msg, int arg, int * length)
   {
   void * ret;
@@ -271,8 +311,7 @@ void * bg_msg_get_arg_ptr(bg_msg_t * msg, int arg, int * length)
   if(!check_arg(arg))
     return NULL;
 
-  ret = msg->args[arg].value.val_ptr;
-  msg->args[arg].value.val_ptr = NULL;
+  ret = steal_ptr(msg, arg);
   if(length)
     *length = msg->args[arg].size;
   return ret;
@@ -287,12 +326,9 @@ void * bg_msg_get_arg_ptr_nocopy(bg_msg_t * msg, int arg)
 
 char * bg_msg_get_arg_string(bg_msg_t * msg, int arg)
   {
-  char * ret;
   if(!check_arg(arg))
     return NULL;
-  ret = msg->args[arg].value.val_ptr;
-  msg->args[arg].value.val_ptr = NULL;
-  return ret;
+  return steal_ptr(msg, arg);
   }
 
 
@@ -530,9 +566,6 @@ bg_msg_t * bg_msg_create()
   {
   bg_msg_t * ret;
   ret = calloc(1, sizeof(*ret));
-  
-  sem_init(&ret->produced, 0, 0);
-    
   return ret;
   }
 
@@ -544,16 +577,17 @@ void bg_msg_free(bg_msg_t * m)
     if((m->args[i].type == TYPE_POINTER) &&
        (m->args[i].value.val_ptr))
       {
-      free(m->args[i].value.val_ptr);
+      if(!is_inline(m, m->args[i].value.val_ptr))
+        free(m->args[i].value.val_ptr);
       m->args[i].value.val_ptr = NULL;
       }
     }
+  m->inline_used = 0;
   }
 
 void bg_msg_destroy(bg_msg_t * m)
   {
   bg_msg_free(m);
-  sem_destroy(&m->produced);
   free(m);
   }
 
@@ -721,16 +755,31 @@ void bg_msg_get_parameter(bg_msg_t * msg,
     }
   }
 
+/*
+ *  Message queue: A single producer, single consumer queue of recycled
+ *  messages. The reader always keeps the last read message (tail)
+ *  as a placeholder, all messages before it can be reused by
+ *  the writer. Reader and writer synchronize only via the tail
+ *  pointer and the message counter, multiple writers are serialized
+ *  by the write mutex. The semaphore is only touched if the reader
+ *  actually goes to sleep.
+ */
+
 struct bg_msg_queue_s
   {
-  bg_msg_t * msg_input;
-  bg_msg_t * msg_output;
-  bg_msg_t * msg_last;
-
-  pthread_mutex_t chain_mutex;
+  /* Writer side */
+  bg_msg_t * head;      /* Last written message */
+  bg_msg_t * first;     /* Oldest message for reuse */
+  bg_msg_t * tail_copy; /* Last known tail */
+  bg_msg_t * msg_input; /* Message between lock_write and unlock_write */
   pthread_mutex_t write_mutex;
+
+  /* Reader side */
+  bg_msg_t * tail;      /* Last read message */
   
-  int num_messages; /* Number of total messages */
+  int num_unread;       /* Number of unread messages */
+  int waiting;          /* Reader is about to sleep */
+  sem_t wakeup;
   };
 
 bg_msg_queue_t * bg_msg_queue_create()
@@ -738,19 +787,12 @@ bg_msg_queue_t * bg_msg_queue_create()
   bg_msg_queue_t * ret;
   ret = calloc(1, sizeof(*ret));
   
-  /* Allocate at least 2 messages */
-  
-  ret->msg_output       = bg_msg_create();
-  ret->msg_output->next = bg_msg_create();
+  ret->tail = bg_msg_create();
+  ret->head = ret->tail;
+  ret->first = ret->tail;
+  ret->tail_copy = ret->tail;
   
-  /* Set in- and output messages */
-
-  ret->msg_input = ret->msg_output;
-  ret->msg_last  = ret->msg_output->next;
-  
-  /* Initialize chain mutex */
-
-  pthread_mutex_init(&ret->chain_mutex, NULL);
+  sem_init(&ret->wakeup, 0, 0);
   pthread_mutex_init(&ret->write_mutex, NULL);
   
   return ret;
@@ -759,45 +801,74 @@ bg_msg_queue_t * bg_msg_queue_create()
 void bg_msg_queue_destroy(bg_msg_queue_t * m)
   {
   bg_msg_t * tmp_message;
-  while(m->msg_output)
+  while(m->first)
     {
-    tmp_message = m->msg_output->next;
-    bg_msg_destroy(m->msg_output);
-    m->msg_output = tmp_message;
+    tmp_message = m->first->next;
+    bg_msg_destroy(m->first);
+    m->first = tmp_message;
     }
+  sem_destroy(&m->wakeup);
+  pthread_mutex_destroy(&m->write_mutex);
   free(m);
   }
 
 /* Lock message queue for reading, block until something arrives */
 
+static bg_msg_t * get_read_msg(bg_msg_queue_t * m)
+  {
+  return __atomic_load_n(&m->tail->next, __ATOMIC_ACQUIRE);
+  }
+
+static int try_read(bg_msg_queue_t * m)
+  {
+  if(__atomic_load_n(&m->num_unread, __ATOMIC_ACQUIRE) > 0)
+    {
+    __atomic_sub_fetch(&m->num_unread, 1, __ATOMIC_ACQ_REL);
+    return 1;
+    }
+  return 0;
+  }
+
 bg_msg_t * bg_msg_queue_lock_read(bg_msg_queue_t * m)
   {
-  while(sem_wait(&m->msg_output->produced) == -1)
+  while(!try_read(m))
     {
-    if(errno != EINTR)
-      return NULL;
+    __atomic_store_n(&m->waiting, 1, __ATOMIC_SEQ_CST);
+
+    /* Check again, a message might have arrived before we set
+       the flag */
+    if(__atomic_load_n(&m->num_unread, __ATOMIC_SEQ_CST) > 0)
+      {
+      /* If the writer already reset the flag, it also posted the
+         semaphore */
+      if(!__atomic_exchange_n(&m->waiting, 0, __ATOMIC_SEQ_CST))
+        sem_wait(&m->wakeup);
+      continue;
+      }
+    
+    while(sem_wait(&m->wakeup) == -1)
+      {
+      if(errno != EINTR)
+        return NULL;
+      }
     }
-  return m->msg_output;
-  
-  // sem_ret->msg_output
+  return get_read_msg(m);
   }
 
 bg_msg_t * bg_msg_queue_try_lock_read(bg_msg_queue_t * m)
   {
-  if(!sem_trywait(&m->msg_output->produced))
-    return m->msg_output;
+  if(try_read(m))
+    return get_read_msg(m);
   else
     return NULL;
   }
 
 int bg_msg_queue_peek(bg_msg_queue_t * m, uint32_t * id)
   {
-  int sem_val;
-  sem_getvalue(&m->msg_output->produced, &sem_val);
-  if(sem_val)
+  if(__atomic_load_n(&m->num_unread, __ATOMIC_ACQUIRE) > 0)
     {
     if(id)
-      *id = m->msg_output->id;
+      *id = get_read_msg(m)->id;
     return 1;
     }
   else
@@ -806,48 +877,55 @@ int bg_msg_queue_peek(bg_msg_queue_t * m, uint32_t * id)
 
 void bg_msg_queue_unlock_read(bg_msg_queue_t * m)
   {
+  bg_msg_t * msg = get_read_msg(m);
 
-  bg_msg_t * old_out_message;
-
-  pthread_mutex_lock(&m->chain_mutex);
-  old_out_message = m->msg_output;
-  
-  bg_msg_free(old_out_message);
-  
-  m->msg_output = m->msg_output->next;
-  m->msg_last->next = old_out_message;
-  m->msg_last = m->msg_last->next;
-  m->msg_last->next = NULL;
+  bg_msg_free(msg);
 
-  pthread_mutex_unlock(&m->chain_mutex);
+  /* Release the previous tail to the writer */
+  __atomic_store_n(&m->tail, msg, __ATOMIC_RELEASE);
   }
 
 /*
  *  Lock queue for writing
  */
 
+static bg_msg_t * get_write_msg(bg_msg_queue_t * m)
+  {
+  bg_msg_t * ret;
+
+  if(m->first == m->tail_copy)
+    m->tail_copy = __atomic_load_n(&m->tail, __ATOMIC_ACQUIRE);
+  
+  if(m->first != m->tail_copy)
+    {
+    ret = m->first;
+    m->first = m->first->next;
+    ret->next = NULL;
+    }
+  else
+    ret = bg_msg_create();
+  return ret;
+  }
+
 bg_msg_t * bg_msg_queue_lock_write(bg_msg_queue_t * m)
   {
   pthread_mutex_lock(&m->write_mutex);
+  m->msg_input = get_write_msg(m);
   return m->msg_input;
   }
 
 void bg_msg_queue_unlock_write(bg_msg_queue_t * m)
   {
-  bg_msg_t * message = m->msg_input;
-    
-  pthread_mutex_lock(&m->chain_mutex);
-  if(!m->msg_input->next)
-    {
-    m->msg_input->next = bg_msg_create();
-    m->msg_last = m->msg_input->next;
-    }
+  __atomic_store_n(&m->head->next, m->msg_input, __ATOMIC_RELEASE);
+  m->head = m->msg_input;
+  m->msg_input = NULL;
+
+  __atomic_add_fetch(&m->num_unread, 1, __ATOMIC_SEQ_CST);
   
-  m->msg_input = m->msg_input->next;
-  sem_post(&message->produced);
-  pthread_mutex_unlock(&m->chain_mutex);
-  pthread_mutex_unlock(&m->write_mutex);
+  if(__atomic_exchange_n(&m->waiting, 0, __ATOMIC_SEQ_CST))
+    sem_post(&m->wakeup);
 
+  pthread_mutex_unlock(&m->write_mutex);
   }
 
 typedef struct list_entry_s
@@ -241,6 +241,10 @@ static void interrupt_cmd(bg_player_t * p, int new_state)
     return;
   
   bg_threads_pause(p->threads, PLAYER_MAX_THREADS);
+
+  /* The subtitle source must not be read while the input is seeked */
+  if(DO_VIDEO(p->flags))
+    bg_player_ov_stop_prefetch(p);
   
   bg_player_time_stop(p);
 
@@ -432,6 +432,19 @@ static void wait_or_skip(bg_player_t * p, gavl_time_t diff_time)
     }
   }
 
+/* Render text subtitles ahead of time */
+
+static void start_subtitle_prefetch(bg_player_t * p)
+  {
+  if(DO_SUBTITLE(p->flags) && !DO_SUBTITLE_ONLY(p->flags))
+    bg_subtitle_handler_start(p->video_stream.sh);
+  }
+
+void bg_player_ov_stop_prefetch(bg_player_t * p)
+  {
+  bg_subtitle_handler_stop(p->video_stream.sh);
+  }
+
 void * bg_player_ov_thread(void * data)
   {
   bg_player_video_stream_t * s;
@@ -446,7 +459,6 @@ void * bg_player_ov_thread(void * data)
   bg_player_add_message_queue(p, s->msg_queue);
 
   bg_thread_wait_for_start(s->th);
-
   
   while(1)
     {
@@ -454,6 +466,9 @@ void * bg_player_ov_thread(void * data)
       {
       break;
       }
+
+    /* The prefetch thread is stopped when playback is interrupted */
+    start_subtitle_prefetch(p);
     
     frame = bg_ov_get_frame(s->ov);
     
@@ -506,6 +521,8 @@ void * bg_player_ov_thread(void * data)
     bg_ov_put_frame(s->ov, frame);
     s->frames_written++;
     }
+
+  bg_subtitle_handler_stop(s->sh);
   
   bg_player_delete_message_queue(p, s->msg_queue);
   return NULL;
@@ -0,0 +1,745 @@
+/*****************************************************************
+ * gmerlin - a general purpose multimedia framework and applications
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/* Binary snapshot of the plugin registry.
+ *
+ * The file is written in native byte order after a registry scan and
+ * mapped into memory at the next startup. It is only used if the search
+ * path, the modification times of all plugin directories and the
+ * modification time and size of plugins.xml are unchanged. In this
+ * case, neither plugins.xml needs to be parsed nor every module needs
+ * to be stat()ed. Any mismatch makes the loader return NULL and
+ * the registry falls back to the xml file. */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <config.h>
+
+#include <gmerlin/pluginregistry.h>
+#include <pluginreg_priv.h>
+#include <gmerlin/utils.h>
+
+#include <gmerlin/log.h>
+#define LOG_DOMAIN "pluginregistry"
+
+#define CACHE_MAGIC   "GMPLUGINCACHE"
+#define CACHE_VERSION 1
+
+/* Marks the end of the file to detect truncated writes */
+#define CACHE_END     0x454e4421
+
+typedef struct
+  {
+  uint8_t * data;
+  int len;
+  int alloc;
+  } wbuf_t;
+
+typedef struct
+  {
+  const uint8_t * ptr;
+  const uint8_t * end;
+  int error;
+  } rbuf_t;
+
+/* Writing */
+
+static void put_data(wbuf_t * b, const void * data, int len)
+  {
+  if(b->len + len > b->alloc)
+    {
+    b->alloc = b->len + len + 65536;
+    b->data = realloc(b->data, b->alloc);
+    }
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+  }
+
+static void put_32(wbuf_t * b, uint32_t val)
+  {
+  put_data(b, &val, sizeof(val));
+  }
+
+static void put_64(wbuf_t * b, int64_t val)
+  {
+  put_data(b, &val, sizeof(val));
+  }
+
+/* Strings are stored with length + 1, 0 means NULL */
+
+static void put_str(wbuf_t * b, const char * str)
+  {
+  uint32_t len;
+  if(!str)
+    {
+    put_32(b, 0);
+    return;
+    }
+  len = strlen(str);
+  put_32(b, len + 1);
+  put_data(b, str, len);
+  }
+
+/* NULL terminated string arrays */
+
+static void put_str_array(wbuf_t * b, char const * const * arr)
+  {
+  uint32_t num = 0;
+  if(!arr)
+    {
+    put_32(b, 0);
+    return;
+    }
+  while(arr[num])
+    num++;
+  put_32(b, num + 1);
+
+  num = 0;
+  while(arr[num])
+    put_str(b, arr[num++]);
+  }
+
+/* Reading */
+
+static const uint8_t * get_data(rbuf_t * b, int len)
+  {
+  const uint8_t * ret;
+  if(b->error || (len < 0) || (b->end - b->ptr < len))
+    {
+    b->error = 1;
+    return NULL;
+    }
+  ret = b->ptr;
+  b->ptr += len;
+  return ret;
+  }
+
+static uint32_t get_32(rbuf_t * b)
+  {
+  uint32_t ret = 0;
+  const uint8_t * ptr = get_data(b, sizeof(ret));
+  if(ptr)
+    memcpy(&ret, ptr, sizeof(ret));
+  return ret;
+  }
+
+static int64_t get_64(rbuf_t * b)
+  {
+  int64_t ret = 0;
+  const uint8_t * ptr = get_data(b, sizeof(ret));
+  if(ptr)
+    memcpy(&ret, ptr, sizeof(ret));
+  return ret;
+  }
+
+static char * get_str(rbuf_t * b)
+  {
+  char * ret;
+  const uint8_t * ptr;
+  uint32_t len = get_32(b);
+
+  if(!len)
+    return NULL;
+  len--;
+
+  if(!(ptr = get_data(b, len)))
+    return NULL;
+  ret = malloc(len + 1);
+  memcpy(ret, ptr, len);
+  ret[len] = '\0';
+  return ret;
+  }
+
+/* Compares a string in the file without copying it */
+
+static int skip_str(rbuf_t * b, const char * str)
+  {
+  const uint8_t * ptr;
+  uint32_t len = get_32(b);
+
+  if(!len)
+    return !str;
+  len--;
+  if(!(ptr = get_data(b, len)) || !str)
+    return 0;
+  return (strlen(str) == len) && !memcmp(ptr, str, len);
+  }
+
+static char ** get_str_array(rbuf_t * b, int * num_p)
+  {
+  int i;
+  char ** ret;
+  uint32_t num = get_32(b);
+
+  *num_p = 0;
+
+  if(!num)
+    return NULL;
+  num--;
+
+  /* Each string needs at least 4 bytes */
+  if(num > (b->end - b->ptr) / 4)
+    {
+    b->error = 1;
+    return NULL;
+    }
+  ret = calloc(num + 1, sizeof(*ret));
+  for(i = 0; i < num; i++)
+    ret[i] = get_str(b);
+  *num_p = num;
+  return ret;
+  }
+
+/* Parameters */
+
+static int is_string_type(bg_parameter_type_t type)
+  {
+  switch(type)
+    {
+    case BG_PARAMETER_STRING:
+    case BG_PARAMETER_STRING_HIDDEN:
+    case BG_PARAMETER_STRINGLIST:
+    case BG_PARAMETER_FONT:
+    case BG_PARAMETER_DEVICE:
+    case BG_PARAMETER_FILE:
+    case BG_PARAMETER_DIRECTORY:
+    case BG_PARAMETER_MULTI_MENU:
+    case BG_PARAMETER_MULTI_LIST:
+    case BG_PARAMETER_MULTI_CHAIN:
+      return 1;
+    default:
+      return 0;
+    }
+  }
+
+static void put_parameters(wbuf_t * b, const bg_parameter_info_t * info)
+  {
+  int i, num;
+
+  if(!info)
+    {
+    put_32(b, 0);
+    return;
+    }
+  num = 0;
+  while(info[num].name)
+    num++;
+
+  put_32(b, num + 1);
+
+  for(i = 0; i < num; i++)
+    {
+    put_str(b, info[i].name);
+    put_str(b, info[i].long_name);
+    put_str(b, info[i].opt);
+    put_str(b, info[i].gettext_domain);
+    put_str(b, info[i].gettext_directory);
+    put_str(b, info[i].help_string);
+    put_str(b, info[i].preset_path);
+    put_32(b, info[i].type);
+    put_32(b, info[i].flags);
+    put_32(b, info[i].num_digits);
+
+    if(is_string_type(info[i].type))
+      put_str(b, info[i].val_default.val_str);
+    else
+      {
+      put_data(b, &info[i].val_default, sizeof(info[i].val_default));
+      put_data(b, &info[i].val_min, sizeof(info[i].val_min));
+      put_data(b, &info[i].val_max, sizeof(info[i].val_max));
+      }
+
+    put_str_array(b, info[i].multi_names);
+    put_str_array(b, info[i].multi_labels);
+    put_str_array(b, info[i].multi_descriptions);
+
+    if(info[i].multi_names && info[i].multi_parameters)
+      {
+      int j = 0;
+      put_32(b, 1);
+      while(info[i].multi_names[j])
+        {
+        put_parameters(b, info[i].multi_parameters[j]);
+        j++;
+        }
+      }
+    else
+      put_32(b, 0);
+    }
+  }
+
+static bg_parameter_info_t * get_parameters(rbuf_t * b)
+  {
+  int i, j, num_names;
+  uint32_t num;
+  const uint8_t * ptr;
+  bg_parameter_info_t * ret;
+
+  num = get_32(b);
+  if(!num)
+    return NULL;
+  num--;
+
+  if(num > (b->end - b->ptr) / 32)
+    {
+    b->error = 1;
+    return NULL;
+    }
+
+  ret = calloc(num + 1, sizeof(*ret));
+
+  for(i = 0; i < num; i++)
+    {
+    ret[i].name              = get_str(b);
+    ret[i].long_name         = get_str(b);
+    ret[i].opt               = get_str(b);
+    ret[i].gettext_domain    = get_str(b);
+    ret[i].gettext_directory = get_str(b);
+    ret[i].help_string       = get_str(b);
+    ret[i].preset_path       = get_str(b);
+    ret[i].type              = get_32(b);
+    ret[i].flags             = get_32(b);
+    ret[i].num_digits        = get_32(b);
+
+    if(is_string_type(ret[i].type))
+      ret[i].val_default.val_str = get_str(b);
+    else
+      {
+      if((ptr = get_data(b, sizeof(ret[i].val_default))))
+        memcpy(&ret[i].val_default, ptr, sizeof(ret[i].val_default));
+      if((ptr = get_data(b, sizeof(ret[i].val_min))))
+        memcpy(&ret[i].val_min, ptr, sizeof(ret[i].val_min));
+      if((ptr = get_data(b, sizeof(ret[i].val_max))))
+        memcpy(&ret[i].val_max, ptr, sizeof(ret[i].val_max));
+      }
+
+    ret[i].multi_names_nc        = get_str_array(b, &num_names);
+    ret[i].multi_labels_nc       = get_str_array(b, &j);
+    ret[i].multi_descriptions_nc = get_str_array(b, &j);
+
+    if(get_32(b))
+      {
+      ret[i].multi_parameters_nc =
+        calloc(num_names + 1, sizeof(*ret[i].multi_parameters_nc));
+      for(j = 0; j < num_names; j++)
+        ret[i].multi_parameters_nc[j] = get_parameters(b);
+      }
+
+    bg_parameter_info_set_const_ptrs(&ret[i]);
+
+    if(b->error || !ret[i].name)
+      {
+      /* Leave the array in a state, which can be freed */
+      b->error = 1;
+      if(!ret[i].name)
+        ret[i].name = gavl_strdup("");
+      break;
+      }
+    }
+  return ret;
+  }
+
+/* Plugin infos */
+
+static void put_plugin(wbuf_t * b, const bg_plugin_info_t * info)
+  {
+  int num;
+
+  put_str(b, info->gettext_domain);
+  put_str(b, info->gettext_directory);
+  put_str(b, info->name);
+  put_str(b, info->long_name);
+  put_str(b, info->mimetypes);
+  put_str(b, info->extensions);
+  put_str(b, info->protocols);
+  put_str(b, info->description);
+  put_str(b, info->module_filename);
+  put_64(b, info->module_time);
+  put_32(b, info->api);
+  put_32(b, info->index);
+  put_32(b, info->type);
+  put_32(b, info->flags);
+  put_32(b, info->priority);
+  put_32(b, info->max_audio_streams);
+  put_32(b, info->max_video_streams);
+  put_32(b, info->max_text_streams);
+  put_32(b, info->max_overlay_streams);
+
+  if(info->compressions)
+    {
+    num = 0;
+    while(info->compressions[num] != GAVL_CODEC_ID_NONE)
+      num++;
+    put_32(b, num + 1);
+    put_data(b, info->compressions, num * sizeof(*info->compressions));
+    }
+  else
+    put_32(b, 0);
+
+  num = 0;
+  if(info->devices)
+    {
+    while(info->devices[num].device)
+      num++;
+    }
+  put_32(b, num);
+  num = 0;
+  if(info->devices)
+    {
+    while(info->devices[num].device)
+      {
+      put_str(b, info->devices[num].device);
+      put_str(b, info->devices[num].name);
+      num++;
+      }
+    }
+
+  put_parameters(b, info->parameters);
+  put_parameters(b, info->audio_parameters);
+  put_parameters(b, info->video_parameters);
+  put_parameters(b, info->text_parameters);
+  put_parameters(b, info->overlay_parameters);
+  }
+
+static bg_plugin_info_t * get_plugin(rbuf_t * b)
+  {
+  int i;
+  uint32_t num;
+  const uint8_t * ptr;
+  bg_plugin_info_t * ret;
+
+  ret = calloc(1, sizeof(*ret));
+
+  ret->gettext_domain      = get_str(b);
+  ret->gettext_directory   = get_str(b);
+  ret->name                = get_str(b);
+  ret->long_name           = get_str(b);
+  ret->mimetypes           = get_str(b);
+  ret->extensions          = get_str(b);
+  ret->protocols           = get_str(b);
+  ret->description         = get_str(b);
+  ret->module_filename     = get_str(b);
+  ret->module_time         = get_64(b);
+  ret->api                 = get_32(b);
+  ret->index               = get_32(b);
+  ret->type                = get_32(b);
+  ret->flags               = get_32(b);
+  ret->priority            = get_32(b);
+  ret->max_audio_streams   = get_32(b);
+  ret->max_video_streams   = get_32(b);
+  ret->max_text_streams    = get_32(b);
+  ret->max_overlay_streams = get_32(b);
+
+  if((num = get_32(b)))
+    {
+    num--;
+    if(num > (b->end - b->ptr) / sizeof(*ret->compressions))
+      b->error = 1;
+    else if((ptr = get_data(b, num * sizeof(*ret->compressions))))
+      {
+      ret->compressions = calloc(num + 1, sizeof(*ret->compressions));
+      memcpy(ret->compressions, ptr, num * sizeof(*ret->compressions));
+      }
+    }
+
+  num = get_32(b);
+  for(i = 0; i < num; i++)
+    {
+    char * device = get_str(b);
+    char * name = get_str(b);
+
+    if(device)
+      {
+      ret->devices = bg_device_info_append(ret->devices, device, name);
+      free(device);
+      }
+    if(name)
+      free(name);
+    if(b->error)
+      break;
+    }
+
+  ret->parameters         = get_parameters(b);
+  ret->audio_parameters   = get_parameters(b);
+  ret->video_parameters   = get_parameters(b);
+  ret->text_parameters    = get_parameters(b);
+  ret->overlay_parameters = get_parameters(b);
+
+  if(!ret->name || !ret->module_filename)
+    b->error = 1;
+
+  return ret;
+  }
+
+/* Header */
+
+static int get_file_time(const char * filename, int64_t * mtime, int64_t * size)
+  {
+  struct stat st;
+  if(stat(filename, &st))
+    {
+    *mtime = 0;
+    *size = 0;
+    return 0;
+    }
+  *mtime = st.st_mtime;
+  *size = st.st_size;
+  return 1;
+  }
+
+static void put_header(wbuf_t * b, const char * path, const char * xml_file)
+  {
+  char ** dirs;
+  int64_t mtime, size;
+  int i;
+
+  put_data(b, CACHE_MAGIC, strlen(CACHE_MAGIC));
+  put_32(b, CACHE_VERSION);
+  put_32(b, sizeof(bg_parameter_value_t));
+  put_32(b, sizeof(gavl_codec_id_t));
+
+  put_str(b, path);
+
+  dirs = bg_strbreak(path, ':');
+  i = 0;
+  while(dirs && dirs[i])
+    {
+    get_file_time(dirs[i], &mtime, &size);
+    put_64(b, mtime);
+    i++;
+    }
+  if(dirs)
+    bg_strbreak_free(dirs);
+
+  get_file_time(xml_file, &mtime, &size);
+  put_64(b, mtime);
+  put_64(b, size);
+  }
+
+static int check_header(rbuf_t * b, const char * path, const char * xml_file)
+  {
+  const uint8_t * ptr;
+  char ** dirs;
+  int64_t mtime, size;
+  int i;
+  int ret = 1;
+
+  if(!(ptr = get_data(b, strlen(CACHE_MAGIC))) ||
+     memcmp(ptr, CACHE_MAGIC, strlen(CACHE_MAGIC)) ||
+     (get_32(b) != CACHE_VERSION) ||
+     (get_32(b) != sizeof(bg_parameter_value_t)) ||
+     (get_32(b) != sizeof(gavl_codec_id_t)) ||
+     !skip_str(b, path))
+    return 0;
+
+  dirs = bg_strbreak(path, ':');
+  i = 0;
+  while(dirs && dirs[i])
+    {
+    get_file_time(dirs[i], &mtime, &size);
+    if(get_64(b) != mtime)
+      {
+      ret = 0;
+      break;
+      }
+    i++;
+    }
+  if(dirs)
+    bg_strbreak_free(dirs);
+
+  if(!ret)
+    return 0;
+
+  if(!get_file_time(xml_file, &mtime, &size) ||
+     (get_64(b) != mtime) ||
+     (get_64(b) != size))
+    return 0;
+
+  return !b->error;
+  }
+
+bg_plugin_info_t * bg_plugin_registry_load_cache(const char * filename,
+                                                 const char * path,
+                                                 const char * xml_file)
+  {
+  int fd;
+  struct stat st;
+  void * map;
+  rbuf_t b;
+  int i;
+  uint32_t num;
+  bg_plugin_info_t * ret = NULL;
+  bg_plugin_info_t * end = NULL;
+  bg_plugin_info_t * info;
+
+  if((fd = open(filename, O_RDONLY)) < 0)
+    return NULL;
+
+  if(fstat(fd, &st) || !st.st_size)
+    {
+    close(fd);
+    return NULL;
+    }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if(map == MAP_FAILED)
+    return NULL;
+
+  b.ptr = map;
+  b.end = b.ptr + st.st_size;
+  b.error = 0;
+
+  if(!check_header(&b, path, xml_file))
+    {
+    munmap(map, st.st_size);
+    return NULL;
+    }
+
+  num = get_32(&b);
+
+  for(i = 0; i < num; i++)
+    {
+    info = get_plugin(&b);
+
+    if(!ret)
+      ret = info;
+    else
+      end->next = info;
+    end = info;
+
+    if(b.error)
+      break;
+    }
+
+  if(get_32(&b) != CACHE_END)
+    b.error = 1;
+
+  munmap(map, st.st_size);
+
+  if(b.error)
+    {
+    bg_log(BG_LOG_WARNING, LOG_DOMAIN, "Plugin cache %s is corrupt", filename);
+    while(ret)
+      {
+      info = ret->next;
+      bg_plugin_info_destroy(ret);
+      ret = info;
+      }
+    }
+  return ret;
+  }
+
+void bg_plugin_registry_save_cache(const bg_plugin_info_t * info,
+                                   const char * filename,
+                                   const char * path,
+                                   const char * xml_file)
+  {
+  wbuf_t b;
+  char ** dirs;
+  char * tmp_filename;
+  int fd, result;
+  int i, num;
+  int64_t mtime, size;
+  const bg_plugin_info_t * tmp_info;
+  time_t now;
+
+  /* Don't save the cache if a directory was modified within the
+     timestamp resolution. A plugin installed later in the same second
+     would go unnoticed otherwise. */
+
+  now = time(NULL);
+  dirs = bg_strbreak(path, ':');
+  i = 0;
+  while(dirs && dirs[i])
+    {
+    if(get_file_time(dirs[i], &mtime, &size) && (mtime >= now - 1))
+      {
+      bg_strbreak_free(dirs);
+      return;
+      }
+    i++;
+    }
+  if(dirs)
+    bg_strbreak_free(dirs);
+
+  memset(&b, 0, sizeof(b));
+
+  put_header(&b, path, xml_file);
+
+  num = 0;
+  tmp_info = info;
+  while(tmp_info)
+    {
+    if(tmp_info->module_filename)
+      num++;
+    tmp_info = tmp_info->next;
+    }
+  put_32(&b, num);
+
+  tmp_info = info;
+  while(tmp_info)
+    {
+    if(tmp_info->module_filename)
+      put_plugin(&b, tmp_info);
+    tmp_info = tmp_info->next;
+    }
+  put_32(&b, CACHE_END);
+
+  /* Other processes might have the cache mapped, so we never modify
+     it in place. Instead we write a new file and replace the old one
+     atomically. */
+  
+  tmp_filename = bg_sprintf("%s.XXXXXX", filename);
+  
+  if((fd = mkstemp(tmp_filename)) >= 0)
+    {
+    result = (write(fd, b.data, b.len) == b.len);
+    if(close(fd))
+      result = 0;
+    
+    if(!result)
+      {
+      bg_log(BG_LOG_WARNING, LOG_DOMAIN, "Writing %s failed", tmp_filename);
+      remove(tmp_filename);
+      }
+    else if(rename(tmp_filename, filename))
+      {
+      bg_log(BG_LOG_WARNING, LOG_DOMAIN, "Renaming %s to %s failed",
+             tmp_filename, filename);
+      remove(tmp_filename);
+      }
+    }
+  else
+    bg_log(BG_LOG_WARNING, LOG_DOMAIN, "Creating %s failed", tmp_filename);
+  
+  free(tmp_filename);
+  free(b.data);
+  }
@@ -20,6 +20,7 @@
  * *****************************************************************/
 
 #include <string.h>
+#include <stdio.h>
 #include <locale.h>
 
 #include <gmerlin/pluginregistry.h>
@@ -738,4 +739,13 @@ void bg_plugin_registry_save(bg_plugin_info_t * info)
   bg_xml_save_file(xml_doc, filename, 1);
   xmlFreeDoc(xml_doc);
   free(filename);
+
+  /* The binary cache is outdated now, it will be recreated
+     at the next startup */
+  filename = bg_search_file_read("", "plugins.bin");
+  if(filename)
+    {
+    remove(filename);
+    free(filename);
+    }
   }
@@ -100,14 +100,220 @@ meta_plugins[] =
   };
 
 
+/* Lookup index: Keys (names, extensions, protocols, mimetypes or
+   compression IDs) are kept in an array and looked up through a
+   hash table (chained by index). Chains are in registry order, so
+   lookups return the same plugins as a linear search through the
+   list would. */
+
+typedef struct
+  {
+  const char * key; /* Points into the plugin info */
+  int key_len;
+  int id;
+  uint32_t hash;
+  bg_plugin_info_t * info;
+  int hash_next;
+  } index_entry_t;
+
+typedef struct
+  {
+  index_entry_t * entries;
+  int num_entries;
+  int entries_alloc;
+
+  int * hash;
+  int hash_size;
+  
+  int nocase;
+  } plugin_index_t;
+
 struct bg_plugin_registry_s
   {
   bg_plugin_info_t * entries;
   bg_cfg_section_t * config_section;
 
   int changed;
+
+  plugin_index_t name_index;
+  plugin_index_t extension_index;
+  plugin_index_t protocol_index;
+  plugin_index_t mimetype_index;
+  plugin_index_t compression_index;
   };
 
+static uint32_t hash_key(const char * key, int len)
+  {
+  int i;
+  uint32_t ret = 2166136261u;
+  for(i = 0; i < len; i++)
+    {
+    ret ^= (uint8_t)tolower(key[i]);
+    ret *= 16777619u;
+    }
+  return ret;
+  }
+
+static index_entry_t * index_add(plugin_index_t * idx,
+                                 bg_plugin_info_t * info)
+  {
+  index_entry_t * ret;
+  if(idx->num_entries == idx->entries_alloc)
+    {
+    idx->entries_alloc += 64;
+    idx->entries = realloc(idx->entries,
+                           idx->entries_alloc * sizeof(*idx->entries));
+    }
+  ret = &idx->entries[idx->num_entries++];
+  memset(ret, 0, sizeof(*ret));
+  ret->info = info;
+  return ret;
+  }
+
+static void index_add_string(plugin_index_t * idx,
+                             bg_plugin_info_t * info,
+                             const char * key, int len)
+  {
+  index_entry_t * e = index_add(idx, info);
+  e->key = key;
+  e->key_len = len;
+  e->hash = hash_key(key, len);
+  }
+
+/* Split a key list the same way as bg_string_match() does */
+
+static void index_add_list(plugin_index_t * idx,
+                           bg_plugin_info_t * info,
+                           const char * key_list)
+  {
+  const char * pos;
+  const char * end;
+
+  if(!key_list)
+    return;
+
+  pos = key_list;
+  
+  while(1)
+    {
+    end = pos;
+    while(!isspace(*end) && (*end != '\0'))
+      end++;
+    if(end == pos)
+      break;
+
+    index_add_string(idx, info, pos, end - pos);
+    
+    pos = end;
+    while(isspace(*pos))
+      pos++;
+    }
+  }
+
+static void index_reset(plugin_index_t * idx)
+  {
+  idx->num_entries = 0;
+  }
+
+static void index_free(plugin_index_t * idx)
+  {
+  if(idx->entries)
+    free(idx->entries);
+  if(idx->hash)
+    free(idx->hash);
+  }
+
+static void index_finalize(plugin_index_t * idx)
+  {
+  int i, h;
+  
+  idx->hash_size = 16;
+  while(idx->hash_size < 2 * idx->num_entries)
+    idx->hash_size <<= 1;
+  idx->hash = realloc(idx->hash, idx->hash_size * sizeof(*idx->hash));
+
+  for(i = 0; i < idx->hash_size; i++)
+    idx->hash[i] = -1;
+
+  /* Insert backwards so the chains end up in registry order */
+  for(i = idx->num_entries - 1; i >= 0; i--)
+    {
+    h = idx->entries[i].hash & (idx->hash_size - 1);
+    idx->entries[i].hash_next = idx->hash[h];
+    idx->hash[h] = i;
+    }
+  }
+
+static int index_first(const plugin_index_t * idx, uint32_t hash)
+  {
+  if(!idx->hash)
+    return -1;
+  return idx->hash[hash & (idx->hash_size - 1)];
+  }
+
+static int index_match(const plugin_index_t * idx, int i,
+                       const char * key, int len, uint32_t hash)
+  {
+  const index_entry_t * e = &idx->entries[i];
+
+  if((e->hash != hash) || (e->key_len != len))
+    return 0;
+
+  if(idx->nocase)
+    return !strncasecmp(e->key, key, len);
+  else
+    return !strncmp(e->key, key, len);
+  }
+
+static void build_index(bg_plugin_registry_t * reg)
+  {
+  int i;
+  bg_plugin_info_t * info;
+  index_entry_t * e;
+  
+  index_reset(&reg->name_index);
+  index_reset(&reg->extension_index);
+  index_reset(&reg->protocol_index);
+  index_reset(&reg->mimetype_index);
+  index_reset(&reg->compression_index);
+
+  reg->extension_index.nocase = 1;
+  reg->protocol_index.nocase = 1;
+  reg->mimetype_index.nocase = 1;
+  
+  info = reg->entries;
+
+  while(info)
+    {
+    index_add_string(&reg->name_index, info, info->name, strlen(info->name));
+
+    if(info->flags & BG_PLUGIN_FILE)
+      index_add_list(&reg->extension_index, info, info->extensions);
+    
+    index_add_list(&reg->protocol_index, info, info->protocols);
+    index_add_list(&reg->mimetype_index, info, info->mimetypes);
+
+    if(info->compressions)
+      {
+      i = 0;
+      while(info->compressions[i] != GAVL_CODEC_ID_NONE)
+        {
+        e = index_add(&reg->compression_index, info);
+        e->id = info->compressions[i];
+        e->hash = e->id;
+        i++;
+        }
+      }
+    info = info->next;
+    }
+
+  index_finalize(&reg->name_index);
+  index_finalize(&reg->extension_index);
+  index_finalize(&reg->protocol_index);
+  index_finalize(&reg->mimetype_index);
+  index_finalize(&reg->compression_index);
+  }
+
 void bg_plugin_info_destroy(bg_plugin_info_t * info)
   {
   
@@ -301,18 +507,37 @@ find_by_name(bg_plugin_info_t * info, const char * name)
 const bg_plugin_info_t * bg_plugin_find_by_name(bg_plugin_registry_t * reg,
                                                 const char * name)
   {
-  return find_by_name(reg->entries, name);
+  int i, len;
+  uint32_t hash;
+
+  len = strlen(name);
+  hash = hash_key(name, len);
+
+  i = index_first(&reg->name_index, hash);
+  while(i >= 0)
+    {
+    if(index_match(&reg->name_index, i, name, len, hash))
+      return reg->name_index.entries[i].info;
+    i = reg->name_index.entries[i].hash_next;
+    }
+  return NULL;
   }
 
 const bg_plugin_info_t * bg_plugin_find_by_protocol(bg_plugin_registry_t * reg,
                                                     const char * protocol)
   {
-  const bg_plugin_info_t * info = reg->entries;
-  while(info)
+  int i, len;
+  uint32_t hash;
+
+  len = strlen(protocol);
+  hash = hash_key(protocol, len);
+  
+  i = index_first(&reg->protocol_index, hash);
+  while(i >= 0)
     {
-    if(bg_string_match(protocol, info->protocols))
-      return info;
-    info = info->next;
+    if(index_match(&reg->protocol_index, i, protocol, len, hash))
+      return reg->protocol_index.entries[i].info;
+    i = reg->protocol_index.entries[i].hash_next;
     }
   return NULL;
   }
@@ -324,12 +549,12 @@ const bg_plugin_info_t * bg_plugin_find_by_filename(bg_plugin_registry_t * reg,
   char * extension;
   bg_plugin_info_t * info, *ret = NULL;
   int max_priority = BG_PLUGIN_PRIORITY_MIN - 1;
-
+  int i, len;
+  uint32_t hash;
+  
   if(!filename)
     return NULL;
   
-  
-  info = reg->entries;
   extension = strrchr(filename, '.');
 
   if(!extension)
@@ -337,27 +562,23 @@ const bg_plugin_info_t * bg_plugin_find_by_filename(bg_plugin_registry_t * reg,
     return NULL;
     }
   extension++;
+
+  len = strlen(extension);
+  hash = hash_key(extension, len);
   
-  
-  while(info)
+  i = index_first(&reg->extension_index, hash);
+  while(i >= 0)
     {
-    if(!(info->type & typemask) ||
-       !(info->flags & BG_PLUGIN_FILE) ||
-       !info->extensions)
-      {
-      info = info->next;
-      continue;
-      }
-    if(bg_string_match(extension, info->extensions))
+    info = reg->extension_index.entries[i].info;
+
+    if((info->type & typemask) &&
+       index_match(&reg->extension_index, i, extension, len, hash) &&
+       (max_priority < info->priority))
       {
-      if(max_priority < info->priority)
-        {
-        max_priority = info->priority;
-        ret = info;
-        }
-      // return info;
+      max_priority = info->priority;
+      ret = info;
       }
-    info = info->next;
+    i = reg->extension_index.entries[i].hash_next;
     }
   return ret;
   }
@@ -368,30 +589,28 @@ const bg_plugin_info_t * bg_plugin_find_by_mimetype(bg_plugin_registry_t * reg,
   {
   bg_plugin_info_t * info, *ret = NULL;
   int max_priority = BG_PLUGIN_PRIORITY_MIN - 1;
-
+  int i, len;
+  uint32_t hash;
+  
   if(!mimetype)
     return NULL;
+
+  len = strlen(mimetype);
+  hash = hash_key(mimetype, len);
   
-  info = reg->entries;
-  
-  while(info)
+  i = index_first(&reg->mimetype_index, hash);
+  while(i >= 0)
     {
-    if(!(info->type & typemask) ||
-       !info->mimetypes)
-      {
-      info = info->next;
-      continue;
-      }
-    if(bg_string_match(mimetype, info->mimetypes))
+    info = reg->mimetype_index.entries[i].info;
+
+    if((info->type & typemask) &&
+       index_match(&reg->mimetype_index, i, mimetype, len, hash) &&
+       (max_priority < info->priority))
       {
-      if(max_priority < info->priority)
-        {
-        max_priority = info->priority;
-        ret = info;
-        }
-      // return info;
+      max_priority = info->priority;
+      ret = info;
       }
-    info = info->next;
+    i = reg->mimetype_index.entries[i].hash_next;
     }
   return ret;
   }
@@ -406,38 +625,24 @@ bg_plugin_find_by_compression(bg_plugin_registry_t * reg,
   bg_plugin_info_t * info, *ret = NULL;
   int max_priority = BG_PLUGIN_PRIORITY_MIN - 1;
 
-  info = reg->entries;
-  
-  while(info)
+  i = index_first(&reg->compression_index, id);
+  while(i >= 0)
     {
-    if(!(info->type & typemask) ||
-       !(info->flags & flagmask) ||
-       !info->compressions)
-      {
-      info = info->next;
-      continue;
-      }
-
-    i = 0;
-    while(info->compressions[i] != GAVL_CODEC_ID_NONE)
+    info = reg->compression_index.entries[i].info;
+    
+    if((reg->compression_index.entries[i].id == id) &&
+       (info->type & typemask) &&
+       (info->flags & flagmask) &&
+       (max_priority < info->priority))
       {
-      if(info->compressions[i] == id)
-        {
-        if(max_priority < info->priority)
-          {
-          max_priority = info->priority;
-          ret = info;
-          }
-        }
-      i++;
+      max_priority = info->priority;
+      ret = info;
       }
-    
-    info = info->next;
+    i = reg->compression_index.entries[i].hash_next;
     }
   return ret;
   }
 
-
 static bg_plugin_info_t * remove_from_list(bg_plugin_info_t * list,
                                            bg_plugin_info_t * info)
   {
@@ -755,6 +960,51 @@ static bg_plugin_info_t * get_info(void * test_module,
   }
 
 
+static void create_cfg_items(bg_cfg_section_t * cfg_section,
+                             const bg_plugin_info_t * info)
+  {
+  bg_cfg_section_t * plugin_section;
+  bg_cfg_section_t * stream_section;
+
+  plugin_section =
+    bg_cfg_section_find_subsection(cfg_section, info->name);
+    
+  if(info->parameters)
+    {
+    bg_cfg_section_create_items(plugin_section,
+                                info->parameters);
+    }
+  if(info->audio_parameters)
+    {
+    stream_section = bg_cfg_section_find_subsection(plugin_section,
+                                                    "$audio");
+        
+    bg_cfg_section_create_items(stream_section,
+                                info->audio_parameters);
+    }
+  if(info->video_parameters)
+    {
+    stream_section = bg_cfg_section_find_subsection(plugin_section,
+                                                    "$video");
+    bg_cfg_section_create_items(stream_section,
+                                info->video_parameters);
+    }
+  if(info->text_parameters)
+    {
+    stream_section = bg_cfg_section_find_subsection(plugin_section,
+                                                    "$text");
+    bg_cfg_section_create_items(stream_section,
+                                info->text_parameters);
+    }
+  if(info->overlay_parameters)
+    {
+    stream_section = bg_cfg_section_find_subsection(plugin_section,
+                                                    "$overlay");
+    bg_cfg_section_create_items(stream_section,
+                                info->overlay_parameters);
+    }
+  }
+
 static bg_plugin_info_t *
 scan_directory_internal(const char * directory, bg_plugin_info_t ** _file_info,
                         int * changed,
@@ -773,8 +1023,6 @@ scan_directory_internal(const char * directory, bg_plugin_info_t ** _file_info,
   bg_plugin_info_t * new_info;
   bg_plugin_info_t * tmp_info;
   
-  bg_cfg_section_t * plugin_section;
-  bg_cfg_section_t * stream_section;
   if(_file_info)
     file_info = *_file_info;
   else
@@ -870,44 +1118,7 @@ scan_directory_internal(const char * directory, bg_plugin_info_t ** _file_info,
       tmp_info->module_time = st.st_mtime;
       
       /* Create parameter entries in the registry */
-      
-      plugin_section =
-        bg_cfg_section_find_subsection(cfg_section, tmp_info->name);
-    
-      if(tmp_info->parameters)
-        {
-        bg_cfg_section_create_items(plugin_section,
-                                    tmp_info->parameters);
-        }
-      if(tmp_info->audio_parameters)
-        {
-        stream_section = bg_cfg_section_find_subsection(plugin_section,
-                                                        "$audio");
-        
-        bg_cfg_section_create_items(stream_section,
-                                    tmp_info->audio_parameters);
-        }
-      if(tmp_info->video_parameters)
-        {
-        stream_section = bg_cfg_section_find_subsection(plugin_section,
-                                                        "$video");
-        bg_cfg_section_create_items(stream_section,
-                                    tmp_info->video_parameters);
-        }
-      if(tmp_info->text_parameters)
-        {
-        stream_section = bg_cfg_section_find_subsection(plugin_section,
-                                                        "$text");
-        bg_cfg_section_create_items(stream_section,
-                                    tmp_info->text_parameters);
-        }
-      if(tmp_info->overlay_parameters)
-        {
-        stream_section = bg_cfg_section_find_subsection(plugin_section,
-                                                        "$overlay");
-        bg_cfg_section_create_items(stream_section,
-                                    tmp_info->overlay_parameters);
-        }
+      create_cfg_items(cfg_section, tmp_info);
       tmp_info = tmp_info->next;
       }
 
@@ -1053,64 +1264,103 @@ bg_plugin_registry_t *
   bg_plugin_info_t * tmp_info;
   bg_plugin_info_t * tmp_info_next;
   char * filename;
+  char * cache_filename;
   char * env;
 
   char * path;
-    
+  char * native_path;
+  char * ladspa_path;
+  const char * frei0r_path =
+    "/usr/lib64/frei0r-1:/usr/local/lib64/frei0r-1:/usr/lib/frei0r-1:/usr/local/lib/frei0r-1";
+  int use_cache = 0;
+  
   ret = calloc(1, sizeof(*ret));
   ret->config_section = section;
 
-  /* Load registry file */
-
-  file_info = NULL; 
+  /* Plugin directories */
   
-  filename = bg_search_file_read("", "plugins.xml");
-  if(filename)
-    {
-    file_info = bg_plugin_registry_load(filename);
-    free(filename);
-    }
-  else
-    ret->changed = 1;
-  
-  /* Native plugins */
   env = getenv("GMERLIN_PLUGIN_PATH");
   if(env)
-    path = bg_sprintf("%s:%s", env, PLUGIN_DIR);
+    native_path = bg_sprintf("%s:%s", env, PLUGIN_DIR);
   else
-    path = bg_sprintf("%s", PLUGIN_DIR);
-  
-  tmp_info = scan_multi(path, &file_info, section, BG_PLUGIN_API_GMERLIN, opt, &ret->changed);
-  if(tmp_info)
-    ret->entries = append_to_list(ret->entries, tmp_info);
-  free(path);
-  /* Ladspa plugins */
-  
+    native_path = bg_sprintf("%s", PLUGIN_DIR);
+
   env = getenv("LADSPA_PATH");
   if(env)
-    path = bg_sprintf("%s:/usr/lib64/ladspa:/usr/local/lib64/ladspa:/usr/lib/ladspa:/usr/local/lib/ladspa", env);
+    ladspa_path = bg_sprintf("%s:/usr/lib64/ladspa:/usr/local/lib64/ladspa:/usr/lib/ladspa:/usr/local/lib/ladspa", env);
   else
-    path = bg_sprintf("/usr/lib64/ladspa:/usr/local/lib64/ladspa:/usr/lib/ladspa:/usr/local/lib/ladspa");
+    ladspa_path = bg_sprintf("/usr/lib64/ladspa:/usr/local/lib64/ladspa:/usr/lib/ladspa:/usr/local/lib/ladspa");
 
-  tmp_info = scan_multi(path, &file_info, section, BG_PLUGIN_API_LADSPA, opt, &ret->changed);
-  if(tmp_info)
-    ret->entries = append_to_list(ret->entries, tmp_info);
+#ifdef HAVE_LV
+  path = bg_sprintf("%s:%s:%s:%s", native_path, ladspa_path, frei0r_path,
+                    LV_PLUGIN_DIR);
+#else
+  path = bg_sprintf("%s:%s:%s", native_path, ladspa_path, frei0r_path);
+#endif
   
-  free(path);
+  /* Try the binary cache, it's valid if no plugin directory changed */
+
+  file_info = NULL;
   
-  /* Frei0r */
-  tmp_info = scan_multi("/usr/lib64/frei0r-1:/usr/local/lib64/frei0r-1:/usr/lib/frei0r-1:/usr/local/lib/frei0r-1", &file_info, 
-                        section, BG_PLUGIN_API_FREI0R, opt, &ret->changed);
-  if(tmp_info)
-    ret->entries = append_to_list(ret->entries, tmp_info);
+  filename = bg_search_file_read("", "plugins.xml");
+  cache_filename = bg_search_file_read("", "plugins.bin");
+
+  if(filename && cache_filename)
+    file_info = bg_plugin_registry_load_cache(cache_filename, path, filename);
+
+  if(cache_filename)
+    free(cache_filename);
+
+  if(file_info)
+    {
+    use_cache = 1;
+    ret->entries = file_info;
+
+    tmp_info = ret->entries;
+    while(tmp_info)
+      {
+      if(!bg_cfg_section_has_subsection(section, tmp_info->name))
+        create_cfg_items(section, tmp_info);
+      tmp_info = tmp_info->next;
+      }
+    }
+  else
+    {
+    /* Load registry file */
+    if(filename)
+      file_info = bg_plugin_registry_load(filename);
+    else
+      ret->changed = 1;
+    
+    /* Native plugins */
+    tmp_info = scan_multi(native_path, &file_info, section, BG_PLUGIN_API_GMERLIN, opt, &ret->changed);
+    if(tmp_info)
+      ret->entries = append_to_list(ret->entries, tmp_info);
+
+    /* Ladspa plugins */
+    tmp_info = scan_multi(ladspa_path, &file_info, section, BG_PLUGIN_API_LADSPA, opt, &ret->changed);
+    if(tmp_info)
+      ret->entries = append_to_list(ret->entries, tmp_info);
+  
+    /* Frei0r */
+    tmp_info = scan_multi(frei0r_path, &file_info, 
+                          section, BG_PLUGIN_API_FREI0R, opt, &ret->changed);
+    if(tmp_info)
+      ret->entries = append_to_list(ret->entries, tmp_info);
     
 #ifdef HAVE_LV
-  tmp_info = scan_directory(LV_PLUGIN_DIR,
-                            &file_info, 
-                            section, BG_PLUGIN_API_LV, opt, &ret->changed);
-  if(tmp_info)
-    ret->entries = append_to_list(ret->entries, tmp_info);
+    tmp_info = scan_directory(LV_PLUGIN_DIR,
+                              &file_info, 
+                              section, BG_PLUGIN_API_LV, opt, &ret->changed);
+    if(tmp_info)
+      ret->entries = append_to_list(ret->entries, tmp_info);
 #endif
+    }
+
+  if(filename)
+    free(filename);
+  free(native_path);
+  free(ladspa_path);
   
   /* Now we have all external plugins, time to create the meta plugins */
 
@@ -1135,6 +1385,18 @@ bg_plugin_registry_t *
 
     if(ret->changed && !opt->dont_save)
       bg_plugin_registry_save(ret->entries);
+
+    if(!use_cache && !opt->dont_save &&
+       (filename = bg_search_file_read("", "plugins.xml")))
+      {
+      if((cache_filename = bg_search_file_write("", "plugins.bin")))
+        {
+        bg_plugin_registry_save_cache(ret->entries, cache_filename,
+                                      path, filename);
+        free(cache_filename);
+        }
+      free(filename);
+      }
   
     /* Remove duplicate external plugins */
     ret->entries = remove_duplicate(ret->entries);
@@ -1155,6 +1417,10 @@ bg_plugin_registry_t *
     else
       tmp_info = tmp_info->next;
     }
+
+  free(path);
+  build_index(ret);
+  
 #if 0 /* Shouldn't be neccesary if the above code is bugfree */
   /* Kick out eventually remaining infos from the file */
   tmp_info = file_info;
@@ -1185,6 +1451,11 @@ void bg_plugin_registry_destroy(bg_plugin_registry_t * reg)
     bg_plugin_info_destroy(info);
     info = reg->entries;
     }
+  index_free(&reg->name_index);
+  index_free(&reg->extension_index);
+  index_free(&reg->protocol_index);
+  index_free(&reg->mimetype_index);
+  index_free(&reg->compression_index);
   free(reg);
   }
 
@@ -1315,6 +1586,7 @@ void bg_plugin_registry_set_extensions(bg_plugin_registry_t * reg,
   if(!(info->flags & BG_PLUGIN_FILE))
     return;
   info->extensions = gavl_strrep(info->extensions, extensions);
+  build_index(reg);
   
   bg_plugin_registry_save(reg->entries);
   
@@ -1331,6 +1603,7 @@ void bg_plugin_registry_set_protocols(bg_plugin_registry_t * reg,
   if(!(info->flags & BG_PLUGIN_URL))
     return;
   info->protocols = gavl_strrep(info->protocols, protocols);
+  build_index(reg);
   bg_plugin_registry_save(reg->entries);
 
   }
@@ -1345,6 +1618,7 @@ void bg_plugin_registry_set_priority(bg_plugin_registry_t * reg,
     return;
   info->priority = priority;
   reg->entries = sort_by_priority(reg->entries);
+  build_index(reg);
   bg_plugin_registry_save(reg->entries);
   }
 
@@ -81,6 +81,113 @@ static int ov_motion_callback(void * data, int x, int y, int mask)
   }
 
 
+/* Snapshot writer thread */
+
+static void write_snapshot(bg_recorder_video_stream_t * vs,
+                           bg_recorder_snapshot_t * snap,
+                           gavl_timer_t * timer)
+  {
+  gavl_time_t time;
+  
+  if(snap->init)
+    {
+    if(vs->snapshot_frame)
+      {
+      gavl_video_frame_destroy(vs->snapshot_frame);
+      vs->snapshot_frame = NULL;
+      }
+    vs->snapshot_writer_init = 0;
+    }
+
+  /* Start from the source format until write_header() succeeded once */
+  if(!vs->snapshot_writer_init)
+    gavl_video_format_copy(&vs->snapshot_format, &snap->format);
+  
+  gavl_timer_set(timer, 0);
+  gavl_timer_start(timer);
+  
+  pthread_mutex_lock(&vs->snapshot_write_mutex);
+
+  if(!vs->snapshot_plugin->write_header(vs->snapshot_handle->priv,
+                                        snap->filename,
+                                        &vs->snapshot_format,
+                                        &snap->m))
+    {
+    pthread_mutex_unlock(&vs->snapshot_write_mutex);
+    gavl_timer_stop(timer);
+    return;
+    }
+  
+  /* write_header() can change the format, so we initialize the
+     converter after the first successful call */
+  if(!vs->snapshot_writer_init)
+    {
+    vs->snapshot_writer_init = 1;
+    vs->do_convert_snapshot =
+      gavl_video_converter_init(vs->snapshot_cnv,
+                                &snap->format,
+                                &vs->snapshot_format);
+    
+    if(vs->do_convert_snapshot)
+      vs->snapshot_frame = gavl_video_frame_create(&vs->snapshot_format);
+    }
+  
+  if(vs->do_convert_snapshot)
+    {
+    gavl_video_convert(vs->snapshot_cnv, snap->frame,
+                       vs->snapshot_frame);
+    vs->snapshot_plugin->write_image(vs->snapshot_handle->priv,
+                                     vs->snapshot_frame);
+    }
+  else
+    {
+    vs->snapshot_plugin->write_image(vs->snapshot_handle->priv,
+                                     snap->frame);
+    }
+
+  pthread_mutex_unlock(&vs->snapshot_write_mutex);
+  
+  time = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+
+  bg_log(BG_LOG_INFO, LOG_DOMAIN, "Wrote snapshot %s (%.1f ms)",
+         snap->filename, gavl_time_to_seconds(time) * 1000.0);
+  }
+
+static void * snapshot_thread(void * data)
+  {
+  bg_recorder_snapshot_t * snap;
+  bg_recorder_video_stream_t * vs = data;
+  gavl_timer_t * timer = gavl_timer_create();
+
+  while(1)
+    {
+    pthread_mutex_lock(&vs->snapshot_queue_mutex);
+    while(!vs->snapshot_queue_len && !vs->snapshot_writer_stop)
+      pthread_cond_wait(&vs->snapshot_queue_cond, &vs->snapshot_queue_mutex);
+
+    if(!vs->snapshot_queue_len)
+      {
+      pthread_mutex_unlock(&vs->snapshot_queue_mutex);
+      break;
+      }
+    snap = &vs->snapshot_queue[vs->snapshot_queue_start];
+    pthread_mutex_unlock(&vs->snapshot_queue_mutex);
+
+    /* The slot stays busy until it's written */
+    write_snapshot(vs, snap, timer);
+    
+    pthread_mutex_lock(&vs->snapshot_queue_mutex);
+    vs->snapshot_queue_start =
+      (vs->snapshot_queue_start + 1) % SNAPSHOT_QUEUE_SIZE;
+    vs->snapshot_queue_len--;
+    pthread_mutex_unlock(&vs->snapshot_queue_mutex);
+    }
+  
+  gavl_timer_destroy(timer);
+  return NULL;
+  }
+
 void bg_recorder_create_video(bg_recorder_t * rec)
   {
   bg_recorder_video_stream_t * vs = &rec->vs;
@@ -106,6 +213,11 @@ void bg_recorder_create_video(bg_recorder_t * rec)
   vs->monitor_cb.data = rec;
 
   pthread_mutex_init(&vs->eof_mutex, NULL);
+
+  pthread_mutex_init(&vs->snapshot_queue_mutex, NULL);
+  pthread_mutex_init(&vs->snapshot_write_mutex, NULL);
+  pthread_cond_init(&vs->snapshot_queue_cond, NULL);
+  pthread_create(&vs->snapshot_thread, NULL, snapshot_thread, vs);
   }
 
 void bg_recorder_video_set_eof(bg_recorder_video_stream_t * s, int eof)
@@ -127,7 +239,34 @@ int  bg_recorder_video_get_eof(bg_recorder_video_stream_t * s)
 
 void bg_recorder_destroy_video(bg_recorder_t * rec)
   {
+  int i;
   bg_recorder_video_stream_t * vs = &rec->vs;
+
+  /* Write pending snapshots */
+  pthread_mutex_lock(&vs->snapshot_queue_mutex);
+  vs->snapshot_writer_stop = 1;
+  pthread_cond_broadcast(&vs->snapshot_queue_cond);
+  pthread_mutex_unlock(&vs->snapshot_queue_mutex);
+  pthread_join(vs->snapshot_thread, NULL);
+
+  if(vs->snapshots_skipped)
+    bg_log(BG_LOG_INFO, LOG_DOMAIN, "%d snapshots skipped",
+           vs->snapshots_skipped);
+  
+  for(i = 0; i < SNAPSHOT_QUEUE_SIZE; i++)
+    {
+    if(vs->snapshot_queue[i].frame)
+      gavl_video_frame_destroy(vs->snapshot_queue[i].frame);
+    if(vs->snapshot_queue[i].filename)
+      free(vs->snapshot_queue[i].filename);
+    gavl_metadata_free(&vs->snapshot_queue[i].m);
+    }
+  if(vs->snapshot_frame)
+    gavl_video_frame_destroy(vs->snapshot_frame);
+  
+  pthread_mutex_destroy(&vs->snapshot_queue_mutex);
+  pthread_mutex_destroy(&vs->snapshot_write_mutex);
+  pthread_cond_destroy(&vs->snapshot_queue_cond);
   
   gavl_video_converter_destroy(vs->monitor_cnv);
   gavl_video_converter_destroy(vs->enc_cnv);
@@ -416,6 +555,8 @@ bg_recorder_set_video_snapshot_parameter(void * data,
       return;
     
     bg_recorder_interrupt(rec);
+
+    pthread_mutex_lock(&vs->snapshot_write_mutex);
     
     if(vs->snapshot_handle)
       bg_plugin_unref(vs->snapshot_handle);
@@ -430,11 +571,14 @@ bg_recorder_set_video_snapshot_parameter(void * data,
       vs->snapshot_plugin->set_callbacks(vs->snapshot_handle->priv,
                                          &vs->snapshot_cb);
     
+    pthread_mutex_unlock(&vs->snapshot_write_mutex);
     }
   else
     {
+    pthread_mutex_lock(&vs->snapshot_write_mutex);
     vs->snapshot_plugin->common.set_parameter(vs->snapshot_handle->priv,
                                               name, val);
+    pthread_mutex_unlock(&vs->snapshot_write_mutex);
     }
   }
 
@@ -566,8 +710,9 @@ static char * create_snapshot_filename(bg_recorder_t * rec, int * have_count)
 static void check_snapshot(bg_recorder_t * rec)
   {
   int doit = 0;
-  char * filename;
+  int slot;
   gavl_time_t frame_time;
+  bg_recorder_snapshot_t * snap;
   
   bg_recorder_video_stream_t * vs = &rec->vs;
 
@@ -595,44 +740,59 @@ static void check_snapshot(bg_recorder_t * rec)
   
   if(!doit)
     return;
-  
-  filename = create_snapshot_filename(rec, NULL);
-  
-  /* Initialize snapshot plugin */
-  if(!(vs->flags & STREAM_SNAPSHOT_INIT))
-    gavl_video_format_copy(&vs->snapshot_format,
-                           &vs->pipe_format);
 
-  if(!vs->snapshot_plugin->write_header(vs->snapshot_handle->priv,
-                                        filename,
-                                        &vs->snapshot_format,
-                                        &rec->m))
-    return;
+  /* Get a free slot. If the writer is behind, skip this snapshot
+     instead of stalling the capture */
   
-  if(!(vs->flags & STREAM_SNAPSHOT_INIT))
-    {
-    vs->do_convert_snapshot =
-      gavl_video_converter_init(vs->snapshot_cnv,
-                                &vs->pipe_format,
-                                &vs->snapshot_format);
+  pthread_mutex_lock(&vs->snapshot_queue_mutex);
+  if(vs->snapshot_queue_len < SNAPSHOT_QUEUE_SIZE)
+    slot = (vs->snapshot_queue_start + vs->snapshot_queue_len) %
+      SNAPSHOT_QUEUE_SIZE;
+  else
+    slot = -1;
+  pthread_mutex_unlock(&vs->snapshot_queue_mutex);
 
-    if(vs->do_convert_snapshot)
-      vs->snapshot_frame = gavl_video_frame_create(&vs->snapshot_format);
-    vs->flags |= STREAM_SNAPSHOT_INIT;
+  if(slot < 0)
+    {
+    vs->snapshots_skipped++;
+    bg_log(BG_LOG_WARNING, LOG_DOMAIN,
+           "Skipping snapshot, writer too slow (%d skipped)",
+           vs->snapshots_skipped);
+    vs->last_snapshot_time = frame_time;
+    return;
     }
 
-  if(vs->do_convert_snapshot)
+  snap = &vs->snapshot_queue[slot];
+  
+  if(snap->frame && !gavl_video_formats_equal(&snap->format, &vs->pipe_format))
     {
-    gavl_video_convert(vs->snapshot_cnv, vs->pipe_frame,
-                       vs->snapshot_frame);
-    vs->snapshot_plugin->write_image(vs->snapshot_handle->priv,
-                                     vs->snapshot_frame);
+    gavl_video_frame_destroy(snap->frame);
+    snap->frame = NULL;
     }
-  else
+  if(!snap->frame)
     {
-    vs->snapshot_plugin->write_image(vs->snapshot_handle->priv,
-                                     vs->pipe_frame);
+    gavl_video_format_copy(&snap->format, &vs->pipe_format);
+    snap->frame = gavl_video_frame_create(&snap->format);
     }
+  gavl_video_frame_copy(&snap->format, snap->frame, vs->pipe_frame);
+  snap->frame->timestamp = vs->pipe_frame->timestamp;
+
+  if(snap->filename)
+    free(snap->filename);
+  snap->filename = create_snapshot_filename(rec, NULL);
+
+  gavl_metadata_free(&snap->m);
+  gavl_metadata_init(&snap->m);
+  gavl_metadata_copy(&snap->m, &rec->m);
+
+  snap->init = !(vs->flags & STREAM_SNAPSHOT_INIT);
+  vs->flags |= STREAM_SNAPSHOT_INIT;
+  
+  pthread_mutex_lock(&vs->snapshot_queue_mutex);
+  vs->snapshot_queue_len++;
+  pthread_cond_broadcast(&vs->snapshot_queue_cond);
+  pthread_mutex_unlock(&vs->snapshot_queue_mutex);
+  
   vs->snapshot_counter++;
   vs->last_snapshot_time = frame_time;
   }
@@ -643,6 +803,7 @@ void * bg_recorder_video_thread(void * data)
   bg_recorder_video_stream_t * vs = &rec->vs;
   gavl_video_frame_t * monitor_frame = NULL;
   gavl_time_t idle_time = GAVL_TIME_SCALE / 100; // 10 ms
+  int changed;
   bg_thread_wait_for_start(vs->th);
 
   gavl_timer_set(vs->timer, 0);
@@ -680,6 +841,11 @@ void * bg_recorder_video_thread(void * data)
       bg_recorder_video_set_eof(vs, 1);
       continue; // Need to go to bg_thread_check to stop the thread cleanly
       }
+
+    /* Filters can change the frame even if the input didn't */
+    changed = vs->frame_changed || vs->have_filters;
+    vs->frame_changed = 0;
+    
     /* Check whether to make a snapshot */
     check_snapshot(rec);
     
@@ -694,9 +860,17 @@ void * bg_recorder_video_thread(void * data)
             vs->monitor_frame_priv =
               gavl_video_frame_create(&vs->monitor_format);
           monitor_frame = vs->monitor_frame_priv;
+
+          if(changed || !vs->monitor_frame_valid)
+            {
+            gavl_video_convert(vs->monitor_cnv, vs->pipe_frame, monitor_frame);
+            vs->monitor_frame_valid = 1;
+            }
+          else
+            gavl_video_frame_copy_metadata(monitor_frame, vs->pipe_frame);
           }
-        gavl_video_convert(vs->monitor_cnv, vs->pipe_frame, monitor_frame);
-          
+        else
+          gavl_video_convert(vs->monitor_cnv, vs->pipe_frame, monitor_frame);
         }
       else if(!monitor_frame)
         monitor_frame = vs->pipe_frame;
@@ -714,7 +888,13 @@ void * bg_recorder_video_thread(void * data)
                                                 vs->pipe_frame->timestamp));
       if(vs->do_convert_enc)
         {
-        gavl_video_convert(vs->enc_cnv, vs->pipe_frame, vs->enc_frame);
+        if(changed || !vs->enc_frame_valid)
+          {
+          gavl_video_convert(vs->enc_cnv, vs->pipe_frame, vs->enc_frame);
+          vs->enc_frame_valid = 1;
+          }
+        else
+          gavl_video_frame_copy_metadata(vs->enc_frame, vs->pipe_frame);
         bg_encoder_write_video_frame(rec->enc, vs->enc_frame, vs->enc_index);
         }
       else
@@ -742,6 +922,12 @@ static int read_video_internal(void * data, gavl_video_frame_t * frame, int stre
   ret = vs->input_plugin->read_video(vs->input_handle->priv, frame, 0);
   time_after = gavl_timer_get(vs->timer);
 
+  /* The filter chain might read more than one frame for one
+     pipe frame */
+  if(!vs->input_plugin->video_frame_changed ||
+     vs->input_plugin->video_frame_changed(vs->input_handle->priv, NULL))
+    vs->frame_changed = 1;
+
   vs->last_capture_duration = time_after - cur_time;
   vs->frame_counter++;
 
@@ -795,7 +981,11 @@ int bg_recorder_video_init(bg_recorder_t * rec)
   vs->in_data = vs->fc;
   vs->in_stream = 0;
   
-  bg_video_filter_chain_init(vs->fc, &vs->input_format, &vs->pipe_format);
+  vs->have_filters =
+    bg_video_filter_chain_init(vs->fc, &vs->input_format, &vs->pipe_format);
+  vs->frame_changed = 1;
+  vs->monitor_frame_valid = 0;
+  vs->enc_frame_valid = 0;
   
   /* Set up monitoring */
 
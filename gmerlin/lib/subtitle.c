@@ -23,6 +23,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include <gavl/gavl.h>
 #include <gavl/connectors.h>
@@ -35,6 +36,10 @@
 
 // #define DUMP_SUBTITLE
 
+/* Number of subtitles, which are rendered ahead of time */
+#define PREFETCH_FRAMES 4
+#define NUM_FRAMES (PREFETCH_FRAMES+2)
+
 struct bg_subtitle_handler_s
   {
   gavl_video_format_t video_format;
@@ -46,22 +51,58 @@ struct bg_subtitle_handler_s
   gavl_video_frame_t * cur;
   gavl_video_frame_t * next;
 
-  gavl_video_frame_t * ovl[2];
+  /* All allocated frames, they are passed around between
+     cur, next and the prefetch queue */
+  gavl_video_frame_t * ovl[NUM_FRAMES];
 
 //  gavl_video_frame_t * out_ovl;
   
   int eof;
   int active; // Current subtitle is active
+
+  /* Prefetch queue: Subtitles in presentation order,
+     rendered by the prefetch thread */
+  gavl_video_frame_t * queue[PREFETCH_FRAMES];
+  int queue_start;
+  int queue_len;
+  
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int running; // Prefetch thread was started
+  int stop;    // Prefetch thread should finish
   };
+
 bg_subtitle_handler_t * bg_subtitle_handler_create()
   {
   bg_subtitle_handler_t * ret;
   ret = calloc(1, sizeof(*ret));
+  pthread_mutex_init(&ret->mutex, NULL);
+  pthread_cond_init(&ret->cond, NULL);
   return ret;
   }
 
+static void free_frames(bg_subtitle_handler_t * h)
+  {
+  int i;
+  for(i = 0; i < NUM_FRAMES; i++)
+    {
+    if(h->ovl[i])
+      {
+      gavl_video_frame_destroy(h->ovl[i]);
+      h->ovl[i] = NULL;
+      }
+    }
+  h->cur = NULL;
+  h->next = NULL;
+  }
+
 void bg_subtitle_handler_destroy(bg_subtitle_handler_t * h)
   {
+  bg_subtitle_handler_stop(h);
+  free_frames(h);
+  pthread_mutex_destroy(&h->mutex);
+  pthread_cond_destroy(&h->cond);
   free(h);
   }
 
@@ -70,11 +111,11 @@ void bg_subtitle_handler_init(bg_subtitle_handler_t * h,
                               gavl_video_source_t * src,
                               gavl_video_sink_t * sink)
   {
-  if(h->ovl[0])
-    gavl_video_frame_destroy(h->ovl[0]);
-  if(h->ovl[1])
-    gavl_video_frame_destroy(h->ovl[1]);
- 
+  int i;
+  
+  bg_subtitle_handler_stop(h);
+  free_frames(h);
+  
   h->src = src;
   h->sink = sink;
 
@@ -88,11 +129,15 @@ void bg_subtitle_handler_init(bg_subtitle_handler_t * h,
   
   gavl_video_format_copy(&h->video_format, video_format);
 
-  h->ovl[0] = gavl_video_frame_create(&h->ovl_format);
-  h->ovl[1] = gavl_video_frame_create(&h->ovl_format);
+  for(i = 0; i < NUM_FRAMES; i++)
+    h->ovl[i] = gavl_video_frame_create(&h->ovl_format);
+  
   h->cur = h->ovl[0];
   h->next = h->ovl[1];
 
+  for(i = 0; i < PREFETCH_FRAMES; i++)
+    h->queue[i] = h->ovl[i+2];
+
   bg_subtitle_handler_reset(h);
   }
 
@@ -119,6 +164,110 @@ static void read_subtitle(bg_subtitle_handler_t * h,
     }
   }
 
+/* Take the next subtitle from the prefetch queue. If the prefetch
+   thread isn't running, read it synchronously */
+
+static void get_subtitle(bg_subtitle_handler_t * h,
+                         gavl_video_frame_t ** frame)
+  {
+  gavl_video_frame_t * swp;
+  int running;
+  
+  if((*frame)->src_rect.w > 0)
+    return;
+
+  pthread_mutex_lock(&h->mutex);
+
+  if(h->queue_len)
+    {
+    swp = h->queue[h->queue_start];
+    h->queue[h->queue_start] = *frame;
+    *frame = swp;
+    
+    h->queue_start = (h->queue_start + 1) % PREFETCH_FRAMES;
+    h->queue_len--;
+    pthread_cond_signal(&h->cond);
+    pthread_mutex_unlock(&h->mutex);
+    return;
+    }
+  running = h->running;
+  pthread_mutex_unlock(&h->mutex);
+
+  if(!running)
+    read_subtitle(h, *frame);
+  }
+
+static void * prefetch_thread(void * data)
+  {
+  gavl_source_status_t st;
+  gavl_video_frame_t * frame;
+  gavl_time_t delay_time = GAVL_TIME_SCALE / 100;
+  bg_subtitle_handler_t * h = data;
+  
+  while(1)
+    {
+    pthread_mutex_lock(&h->mutex);
+    
+    while(!h->stop && (h->queue_len == PREFETCH_FRAMES))
+      pthread_cond_wait(&h->cond, &h->mutex);
+
+    if(h->stop)
+      {
+      pthread_mutex_unlock(&h->mutex);
+      break;
+      }
+    
+    /* The slot after the last queued frame is not touched by
+       get_subtitle() so we can render into it without holding the lock */
+    frame = h->queue[(h->queue_start + h->queue_len) % PREFETCH_FRAMES];
+    pthread_mutex_unlock(&h->mutex);
+
+    st = gavl_video_source_read_frame(h->src, &frame);
+
+    if(st == GAVL_SOURCE_OK)
+      {
+      pthread_mutex_lock(&h->mutex);
+      h->queue_len++;
+      pthread_mutex_unlock(&h->mutex);
+      }
+    else if(st == GAVL_SOURCE_EOF)
+      {
+      pthread_mutex_lock(&h->mutex);
+      h->eof = 1;
+      pthread_mutex_unlock(&h->mutex);
+      bg_log(BG_LOG_INFO, LOG_DOMAIN, "Subtitle stream finished");
+      break;
+      }
+    else /* Nothing available yet */
+      gavl_time_delay(&delay_time);
+    }
+  return NULL;
+  }
+
+void bg_subtitle_handler_start(bg_subtitle_handler_t * h)
+  {
+  if(h->running || !h->src || !h->sink || !h->cur || h->eof)
+    return;
+  
+  h->stop = 0;
+  h->running = 1;
+  pthread_create(&h->thread, NULL, prefetch_thread, h);
+  }
+
+void bg_subtitle_handler_stop(bg_subtitle_handler_t * h)
+  {
+  if(!h->running)
+    return;
+  
+  pthread_mutex_lock(&h->mutex);
+  h->stop = 1;
+  pthread_cond_broadcast(&h->cond);
+  pthread_mutex_unlock(&h->mutex);
+
+  pthread_join(h->thread, NULL);
+  h->running = 0;
+  }
+
 static void put_overlay(bg_subtitle_handler_t * h)
   {
   h->active = 1;
@@ -169,8 +318,8 @@ void bg_subtitle_handler_update(bg_subtitle_handler_t * h,
     }
 
   /* Read as many subtitles as possible */
-  read_subtitle(h, h->cur);
-  read_subtitle(h, h->next);
+  get_subtitle(h, &h->cur);
+  get_subtitle(h, &h->next);
 
   /* Check if the current subtitle became valid */
   if(!h->active && h->cur->src_rect.w)
@@ -203,6 +352,21 @@ void bg_subtitle_handler_update(bg_subtitle_handler_t * h,
 
 void bg_subtitle_handler_reset(bg_subtitle_handler_t * h)
   {
+  int i;
+  
+  bg_subtitle_handler_stop(h);
+
+  if(!h->cur)
+    return;
+  
+  for(i = 0; i < PREFETCH_FRAMES; i++)
+    {
+    h->queue[i]->src_rect.w = 0;
+    h->queue[i]->src_rect.h = 0;
+    }
+  h->queue_start = 0;
+  h->queue_len = 0;
+  
   h->cur->src_rect.w = 0;
   h->cur->src_rect.h = 0;
 
@@ -213,6 +213,10 @@ typedef struct
 #endif
   int advance_x, advance_y; /* Advance in integer pixels */
   bbox_t bbox;
+
+  int hash_next;          /* Next entry in the hash chain */
+  int lru_prev, lru_next; /* Neighbours in the LRU list   */
+  int serial;             /* Last string, which used this glyph */
   } cache_entry_t;
 
 struct bg_text_renderer_s
@@ -254,6 +258,13 @@ struct bg_text_renderer_s
   
   int cache_size;
   int cache_alloc;
+
+  int * hash;
+  int hash_size;
+  
+  int lru_first; /* Most recently used  */
+  int lru_last;  /* Least recently used */
+  int serial;
   gavl_video_format_t overlay_format;
   gavl_video_format_t frame_format;
   gavl_video_format_t last_frame_format;
@@ -854,104 +865,212 @@ static void render_graya_float(bg_text_renderer_t * r, cache_entry_t * glyph,
   }
 
 
-static void alloc_glyph_cache(bg_text_renderer_t * r, int size)
+/* Glyph cache: Entries are kept in an array, looked up through a
+   hash table (chained by index) and ordered in a doubly linked
+   LRU list. Entries used by the string currently rendered are
+   never evicted. */
+
+static void free_glyph(cache_entry_t * entry)
+  {
+  FT_Done_Glyph(entry->glyph);
+#ifdef FT_STROKER_H
+  FT_Done_Glyph(entry->glyph_stroke);
+#endif
+  }
+
+static void clear_glyph_cache(bg_text_renderer_t * r)
   {
   int i;
-  if(size > r->cache_alloc)
+  for(i = 0; i < r->cache_size; i++)
+    free_glyph(&r->cache[i]);
+  r->cache_size = 0;
+
+  for(i = 0; i < r->hash_size; i++)
+    r->hash[i] = -1;
+
+  r->lru_first = -1;
+  r->lru_last = -1;
+  }
+
+static void alloc_hash(bg_text_renderer_t * r)
+  {
+  int i;
+  r->hash_size = 16;
+  while(r->hash_size < 2 * r->cache_alloc)
+    r->hash_size <<= 1;
+  r->hash = realloc(r->hash, r->hash_size * sizeof(*r->hash));
+
+  for(i = 0; i < r->hash_size; i++)
+    r->hash[i] = -1;
+
+  for(i = 0; i < r->cache_size; i++)
     {
-    /* Enlarge */
-    r->cache_alloc = size;
-    r->cache = realloc(r->cache, r->cache_alloc * sizeof(*(r->cache)));
+    int h = r->cache[i].unicode & (r->hash_size - 1);
+    r->cache[i].hash_next = r->hash[h];
+    r->hash[h] = i;
     }
-  else if(size < r->cache_alloc)
+  }
+
+static void alloc_glyph_cache(bg_text_renderer_t * r, int size)
+  {
+  if(size == r->cache_alloc)
+    return;
+
+  clear_glyph_cache(r);
+  r->cache_alloc = size;
+  r->cache = realloc(r->cache, r->cache_alloc * sizeof(*(r->cache)));
+  alloc_hash(r);
+  }
+
+static void lru_unlink(bg_text_renderer_t * r, int index)
+  {
+  cache_entry_t * entry = &r->cache[index];
+
+  if(entry->lru_prev >= 0)
+    r->cache[entry->lru_prev].lru_next = entry->lru_next;
+  else
+    r->lru_first = entry->lru_next;
+
+  if(entry->lru_next >= 0)
+    r->cache[entry->lru_next].lru_prev = entry->lru_prev;
+  else
+    r->lru_last = entry->lru_prev;
+  }
+
+static void lru_push_front(bg_text_renderer_t * r, int index)
+  {
+  cache_entry_t * entry = &r->cache[index];
+
+  entry->lru_prev = -1;
+  entry->lru_next = r->lru_first;
+
+  if(r->lru_first >= 0)
+    r->cache[r->lru_first].lru_prev = index;
+  else
+    r->lru_last = index;
+  r->lru_first = index;
+  }
+
+static void hash_remove(bg_text_renderer_t * r, int index)
+  {
+  int * ptr = &r->hash[r->cache[index].unicode & (r->hash_size - 1)];
+
+  while(*ptr >= 0)
     {
-    /* Shrink */
-    if(size < r->cache_size)
+    if(*ptr == index)
       {
-      for(i = size; i < r->cache_size; i++)
-        FT_Done_Glyph(r->cache[i].glyph);
-      r->cache_size = size;
+      *ptr = r->cache[index].hash_next;
+      return;
       }
-    r->cache_alloc = size;
-    r->cache = realloc(r->cache, r->cache_alloc * sizeof(*(r->cache)));
+    ptr = &r->cache[*ptr].hash_next;
     }
-  else
-    return;
   }
 
-static void clear_glyph_cache(bg_text_renderer_t * r)
+/* Return a free slot, evicting the least recently used glyph
+   if necessary */
+
+static int get_cache_slot(bg_text_renderer_t * r)
   {
-  int i;
-  for(i = 0; i < r->cache_size; i++)
+  int index;
+
+  if(r->cache_size < r->cache_alloc)
+    return r->cache_size++;
+
+  index = r->lru_last;
+
+  if(r->cache[index].serial == r->serial)
     {
-    FT_Done_Glyph(r->cache[i].glyph);
-#ifdef FT_STROKER_H
-    FT_Done_Glyph(r->cache[i].glyph_stroke);
-#endif
+    /* All glyphs are used by the current string: Enlarge cache */
+    r->cache_alloc *= 2;
+    r->cache = realloc(r->cache, r->cache_alloc * sizeof(*(r->cache)));
+    alloc_hash(r);
+    return r->cache_size++;
     }
-  r->cache_size = 0;
+
+  lru_unlink(r, index);
+  hash_remove(r, index);
+  free_glyph(&r->cache[index]);
+  return index;
   }
 
-static cache_entry_t * get_glyph(bg_text_renderer_t * r, uint32_t unicode)
+/* Returns the cache index of the glyph or -1. Indices stay valid until
+   the next call of bg_text_renderer_render(), pointers only until
+   the next call of get_glyph(), because the cache might be enlarged. */
+
+static int get_glyph(bg_text_renderer_t * r, uint32_t unicode)
   {
-  int i, index;
+  int index;
   cache_entry_t * entry;
-  
+  FT_Glyph glyph;
+#ifdef FT_STROKER_H
+  FT_Glyph glyph_stroke;
+#endif
   FT_BitmapGlyph bitmap_glyph;
-      
-  for(i = 0; i < r->cache_size; i++)
+
+  index = r->hash[unicode & (r->hash_size - 1)];
+
+  while(index >= 0)
     {
-    if(r->cache[i].unicode == unicode)
-      return &r->cache[i];
+    if(r->cache[index].unicode == unicode)
+      {
+      if(index != r->lru_first)
+        {
+        lru_unlink(r, index);
+        lru_push_front(r, index);
+        }
+      r->cache[index].serial = r->serial;
+      return index;
+      }
+    index = r->cache[index].hash_next;
     }
 
   /* No glyph found, try to load a new one into the cache */
-  if(r->cache_size >= r->cache_alloc)
-    {
-    FT_Done_Glyph(r->cache[0].glyph);
-    index = 0;
-    }
-  else
-    {
-    index = r->cache_size;
-    r->cache_size++;
-    }
-  entry = &r->cache[index];
-  
+
   /* Load the glyph */
   if(FT_Load_Char(r->face, unicode, FT_LOAD_DEFAULT))
-    {
-    return NULL;
-    }
+    return -1;
+
   /* extract glyph image */
-  if(FT_Get_Glyph(r->face->glyph, &entry->glyph))
-    {
-    return NULL;
-    }
+  if(FT_Get_Glyph(r->face->glyph, &glyph))
+    return -1;
+
 #ifdef FT_STROKER_H
   /* Stroke glyph */
-  entry->glyph_stroke = entry->glyph;
-  FT_Glyph_StrokeBorder(&entry->glyph_stroke, r->stroker, 0, 0);
-  //  FT_Glyph_StrokeBorder(&entry->glyph_stroke, r->stroker, 1, 0);
+  glyph_stroke = glyph;
+  FT_Glyph_StrokeBorder(&glyph_stroke, r->stroker, 0, 0);
+  //  FT_Glyph_StrokeBorder(&glyph_stroke, r->stroker, 1, 0);
 #endif
   
   /* Render glyph */
-  if(FT_Glyph_To_Bitmap( &entry->glyph,
-                         FT_RENDER_MODE_NORMAL,
-                         NULL, 1 ))
-    return NULL;
+  if(FT_Glyph_To_Bitmap(&glyph, FT_RENDER_MODE_NORMAL, NULL, 1))
+    {
+    FT_Done_Glyph(glyph);
+#ifdef FT_STROKER_H
+    FT_Done_Glyph(glyph_stroke);
+#endif
+    return -1;
+    }
+  
+#ifdef FT_STROKER_H
+  if(FT_Glyph_To_Bitmap(&glyph_stroke, FT_RENDER_MODE_NORMAL, NULL, 1))
+    {
+    FT_Done_Glyph(glyph);
+    FT_Done_Glyph(glyph_stroke);
+    return -1;
+    }
+#endif
 
+  index = get_cache_slot(r);
+  entry = &r->cache[index];
+
+  entry->glyph = glyph;
+#ifdef FT_STROKER_H
+  entry->glyph_stroke = glyph_stroke;
+#endif
+  
   entry->advance_x = r->face->glyph->advance.x >> 6;
   // entry->advance_y = r->face->glyph->metrics.vertAdvance >> 6;
   entry->advance_y = 0;
-  
-  
-#ifdef FT_STROKER_H
-  if(FT_Glyph_To_Bitmap( &entry->glyph_stroke,
-                         FT_RENDER_MODE_NORMAL,
-                         NULL, 1 ))
-    return NULL;
-#endif
 
   /* Get bounding box and advances */
 
@@ -986,7 +1105,13 @@ static cache_entry_t * get_glyph(bg_text_renderer_t * r, uint32_t unicode)
     }
   
   entry->unicode = unicode;
-  return entry;
+  entry->serial = r->serial;
+
+  entry->hash_next = r->hash[unicode & (r->hash_size - 1)];
+  r->hash[unicode & (r->hash_size - 1)] = index;
+  lru_push_front(r, index);
+  
+  return index;
   }
 
 static void unload_font(bg_text_renderer_t * r)
@@ -1140,6 +1265,9 @@ bg_text_renderer_t * bg_text_renderer_create()
   /* Initialize freetype */
   FT_Init_FreeType(&ret->library);
 
+  ret->lru_first = -1;
+  ret->lru_last = -1;
+  alloc_glyph_cache(ret, 255);
   return ret;
   }
 
@@ -1151,6 +1279,8 @@ void bg_text_renderer_destroy(bg_text_renderer_t * r)
     
   if(r->cache)
     free(r->cache);
+  if(r->hash)
+    free(r->hash);
 
   if(r->font)
     free(r->font);
@@ -1592,8 +1722,9 @@ void bg_text_renderer_render(bg_text_renderer_t * r, const char * string,
                              gavl_overlay_t * ovl)
   {
   cache_entry_t ** glyphs = NULL;
+  int * glyph_indices = NULL;
   uint32_t * string_unicode = NULL;
-  int len, i;
+  int len, i, j;
   int pos_x, pos_y;
   int line_start, line_end;
   int line_width, line_end_y;
@@ -1625,6 +1756,7 @@ void bg_text_renderer_render(bg_text_renderer_t * r, const char * string,
   line_offset = r->face->size->metrics.height >> 6;
   
   glyphs = malloc(len * sizeof(*glyphs));
+  glyph_indices = malloc(len * sizeof(*glyph_indices));
 
   if(r->ignore_linebreaks)
     {
@@ -1634,12 +1766,26 @@ void bg_text_renderer_render(bg_text_renderer_t * r, const char * string,
         string_unicode[i] = ' ';
       }
     }
+  r->serial++;
+  
+  /* Characters, for which not even the fallback glyph can be loaded,
+     are skipped */
+  j = 0;
   for(i = 0; i < len; i++)
     {
-    glyphs[i] = get_glyph(r, string_unicode[i]);
-    if(!glyphs[i])
-      glyphs[i] = get_glyph(r, '?');
+    glyph_indices[j] = get_glyph(r, string_unicode[i]);
+    if(glyph_indices[j] < 0)
+      glyph_indices[j] = get_glyph(r, '?');
+    if(glyph_indices[j] < 0)
+      continue;
+    string_unicode[j] = string_unicode[i];
+    j++;
     }
+  len = j;
+
+  /* The cache doesn't move anymore */
+  for(i = 0; i < len; i++)
+    glyphs[i] = &r->cache[glyph_indices[i]];
 
   line_start = 0;
   line_end   = -1;
@@ -1749,6 +1895,8 @@ void bg_text_renderer_render(bg_text_renderer_t * r, const char * string,
     }
   if(glyphs)
     free(glyphs);
+  if(glyph_indices)
+    free(glyph_indices);
   if(string_unicode)
     free(string_unicode);
 
@@ -28,21 +28,31 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include <gmerlin/utils.h>
 #include <gmerlin/pluginregistry.h>
-#include <gmerlin/subprocess.h>
 
 #include <gmerlin/log.h>
 #define LOG_DOMAIN "thumbnails"
 
+/* Maximum width or height */
+#define THUMB_SIZE 128
+
+/* Seek position (percentage of the duration) */
+#define SEEK_PERCENTAGE 10.0
+
+/* Decoders which can decode at a reduced resolution (currently only
+   JPEG-2000 in avdec) decode at 1/4 of the size. This is still larger
+   than THUMB_SIZE for all practical sources. */
+#define THUMB_SHRINK 2
+
 static int thumbnail_up_to_date(const char * thumbnail_file,
                                 bg_plugin_registry_t * plugin_reg,
                                 gavl_video_frame_t ** frame,
                                 gavl_video_format_t * format,
                                 int64_t mtime)
   {
-  int i;
   gavl_metadata_t metadata;
   int64_t test_mtime;
   int ret = 0;
@@ -55,8 +65,6 @@ static int thumbnail_up_to_date(const char * thumbnail_file,
                                          format,
                                          &metadata);
   
-  i = 0;
-
   val = gavl_metadata_get(&metadata, "Thumb::MTime");
   if(val)
     {
@@ -68,37 +76,47 @@ static int thumbnail_up_to_date(const char * thumbnail_file,
   return ret;
   }
 
-static void make_fail_thumbnail(const char * gml,
-                                const char * thumb_filename,
-                                bg_plugin_registry_t * plugin_reg,
-                                int64_t mtime)
+static gavl_video_frame_t *
+create_fail_thumbnail(const char * gml, int64_t mtime,
+                      gavl_video_format_t * format,
+                      gavl_metadata_t * metadata)
   {
-  gavl_video_format_t format;
   gavl_video_frame_t * frame;
-  gavl_metadata_t metadata;
   char * tmp_string;
   
-  memset(&format, 0, sizeof(format));
-
-  gavl_metadata_init(&metadata);
+  memset(format, 0, sizeof(*format));
   
-  format.image_width = 1;
-  format.image_height = 1;
-  format.frame_width = 1;
-  format.frame_height = 1;
-  format.pixel_width = 1;
-  format.pixel_height = 1;
-  format.pixelformat = GAVL_RGBA_32;
+  format->image_width = 1;
+  format->image_height = 1;
+  format->frame_width = 1;
+  format->frame_height = 1;
+  format->pixel_width = 1;
+  format->pixel_height = 1;
+  format->pixelformat = GAVL_RGBA_32;
   
-  frame = gavl_video_frame_create(&format);
-  gavl_video_frame_clear(frame, &format);
+  frame = gavl_video_frame_create(format);
+  gavl_video_frame_clear(frame, format);
   
   tmp_string = bg_string_to_uri(gml, -1);
-  gavl_metadata_set_nocpy(&metadata, "Thumb::URI", tmp_string);
+  gavl_metadata_set_nocpy(metadata, "Thumb::URI", tmp_string);
 
   tmp_string = bg_sprintf("%"PRId64, mtime);
-  gavl_metadata_set_nocpy(&metadata, "Thumb::MTime", tmp_string);
+  gavl_metadata_set_nocpy(metadata, "Thumb::MTime", tmp_string);
+  return frame;
+  }
+
+static void make_fail_thumbnail(const char * gml,
+                                const char * thumb_filename,
+                                bg_plugin_registry_t * plugin_reg,
+                                int64_t mtime)
+  {
+  gavl_video_format_t format;
+  gavl_video_frame_t * frame;
+  gavl_metadata_t metadata;
 
+  gavl_metadata_init(&metadata);
+  frame = create_fail_thumbnail(gml, mtime, &format, &metadata);
+  
   bg_plugin_registry_save_image(plugin_reg,
                                 thumb_filename,
                                 frame,
@@ -107,54 +125,345 @@ static void make_fail_thumbnail(const char * gml,
   gavl_video_frame_destroy(frame);
   }
 
-int bg_get_thumbnail(const char * gml,
-                     bg_plugin_registry_t * plugin_reg,
-                     char ** thumbnail_filename_ret,
-                     gavl_video_frame_t ** frame_ret,
-                     gavl_video_format_t * format_ret)
+/* Plugin loading accesses the registry and the config sections, which
+   are not thread safe. The thumbnailer therefore serializes everything
+   which loads or unloads plugins. reg_mutex is NULL for the synchronous
+   case. */
+
+static void reg_lock(pthread_mutex_t * reg_mutex)
   {
-  bg_subprocess_t * sp;
-  char hash[33];
-  char * home_dir;
+  if(reg_mutex)
+    pthread_mutex_lock(reg_mutex);
+  }
+
+static void reg_unlock(pthread_mutex_t * reg_mutex)
+  {
+  if(reg_mutex)
+    pthread_mutex_unlock(reg_mutex);
+  }
+
+static void set_shrink(bg_plugin_handle_t * h)
+  {
+  int i;
+  const bg_parameter_info_t * parameters;
+  bg_parameter_value_t val;
   
-  char * thumb_filename_normal = NULL;
-  char * thumb_filename_fail = NULL;
+  if(!h->plugin->get_parameters || !h->plugin->set_parameter)
+    return;
 
-  char * thumbs_dir_normal = NULL;
-  char * thumbs_dir_fail = NULL;
-  char * command;
+  if(!(parameters = h->plugin->get_parameters(h->priv)))
+    return;
+
+  i = 0;
+  while(parameters[i].name)
+    {
+    if(!strcmp(parameters[i].name, "shrink"))
+      {
+      val.val_i = THUMB_SHRINK;
+      h->plugin->set_parameter(h->priv, "shrink", &val);
+      break;
+      }
+    i++;
+    }
+  }
+
+/* Open a file. The handle is reused if the file is handled by the
+   same plugin as the previous one */
+
+static int open_input(bg_plugin_registry_t * plugin_reg,
+                      pthread_mutex_t * reg_mutex,
+                      bg_plugin_handle_t ** input_handle,
+                      const char * gml)
+  {
+  const bg_plugin_info_t * info;
+  bg_input_plugin_t * input_plugin;
+  int ret;
   
-  int ret = 0;
-  gavl_video_frame_t * frame = NULL;
-  gavl_video_format_t format;
-  struct stat st;
+  reg_lock(reg_mutex);
 
-  if(stat(gml, &st))
+  info = bg_plugin_find_by_filename(plugin_reg, gml, BG_PLUGIN_INPUT);
+  
+  if(*input_handle && (!info || ((*input_handle)->info != info)))
     {
-    bg_log(BG_LOG_ERROR, LOG_DOMAIN, "Cannot stat %s: %s",
-           gml, strerror(errno));
-    return 0;
+    bg_plugin_unref(*input_handle);
+    *input_handle = NULL;
     }
   
-  /* Get and create directories */
+  if(info && !(*input_handle))
+    {
+    if((*input_handle = bg_plugin_load(plugin_reg, info)))
+      set_shrink(*input_handle);
+    }
+  
+  reg_unlock(reg_mutex);
+
+  if(*input_handle)
+    {
+    input_plugin = (bg_input_plugin_t*)((*input_handle)->plugin);
+    
+    if(input_plugin->open((*input_handle)->priv, gml))
+      return 1;
+    
+    if(input_plugin->close)
+      input_plugin->close((*input_handle)->priv);
+    }
+  
+  /* Try all plugins */
+  
+  reg_lock(reg_mutex);
+  ret = bg_input_plugin_load(plugin_reg, gml, NULL, input_handle, NULL, 0);
+  reg_unlock(reg_mutex);
+  return ret;
+  }
+
+/* Generate a thumbnail. The first video frame at or after 10 % of the
+   duration is converted to a square pixel RGBA image with a maximum size
+   of THUMB_SIZE. If the track is seekable, only the frames following the
+   keyframe before the seek position are decoded. If time_budget is > 0,
+   give up after that time. */
+
+static gavl_video_frame_t *
+make_thumbnail(bg_plugin_registry_t * plugin_reg,
+               pthread_mutex_t * reg_mutex,
+               bg_plugin_handle_t ** input_handle,
+               const char * gml,
+               const struct stat * st,
+               gavl_time_t time_budget,
+               gavl_video_format_t * output_format,
+               gavl_metadata_t * metadata)
+  {
+  bg_input_plugin_t * input_plugin;
+  bg_track_info_t * info;
+  gavl_video_source_t * src;
+  gavl_video_format_t input_format;
+  gavl_video_frame_t * input_frame = NULL;
+  gavl_video_frame_t * output_frame = NULL;
+  gavl_video_frame_t * frame;
+  gavl_video_converter_t * cnv;
+  gavl_timer_t * timer;
+  gavl_time_t duration;
+  gavl_time_t seek_time;
+  char * tmp_string;
+  int have_frame = 0;
+  
+  timer = gavl_timer_create();
+  gavl_timer_start(timer);
+  
+  if(!open_input(plugin_reg, reg_mutex, input_handle, gml))
+    {
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN, "Cannot open %s", gml);
+    gavl_timer_destroy(timer);
+    return NULL;
+    }
+  
+  input_plugin = (bg_input_plugin_t*)((*input_handle)->plugin);
+  
+  if(input_plugin->get_num_tracks &&
+     !input_plugin->get_num_tracks((*input_handle)->priv))
+    {
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN, "%s has no tracks", gml);
+    goto fail;
+    }
+  
+  info = input_plugin->get_track_info((*input_handle)->priv, 0);
+
+  if(!info->num_video_streams)
+    {
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN, "File %s has no video", gml);
+    goto fail;
+    }
+  
+  /* Copy metadata (extend them later) */
+  gavl_metadata_copy(metadata, &info->metadata);
+  
+  if(input_plugin->set_track)
+    input_plugin->set_track((*input_handle)->priv, 0);
+  
+  input_plugin->set_video_stream((*input_handle)->priv, 0,
+                                 BG_STREAM_ACTION_DECODE);
+  
+  if(input_plugin->start && !input_plugin->start((*input_handle)->priv))
+    {
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN, "Starting %s failed", gml);
+    goto fail;
+    }
+  
+  src = input_plugin->get_video_source((*input_handle)->priv, 0);
+  
+  duration = bg_track_info_get_duration(info);
+
+  /* The format is known only after start() */
+  gavl_video_format_copy(&input_format, &info->video_streams[0].format);
+  
+  if(duration == GAVL_TIME_UNDEFINED)
+    seek_time = 10 * GAVL_TIME_SCALE;
+  else
+    seek_time =
+      (gavl_time_t)((SEEK_PERCENTAGE / 100.0) * (double)(duration)+0.5);
+  
+  if(info->flags & BG_TRACK_SEEKABLE)
+    {
+    input_plugin->seek((*input_handle)->priv, &seek_time, GAVL_TIME_SCALE);
+    
+    if(gavl_video_source_read_frame(src, &input_frame) == GAVL_SOURCE_OK)
+      have_frame = 1;
+    else if(input_plugin->set_track)
+      {
+      /* Seeking failed, reset the stream and try without seeking */
+      input_frame = NULL;
+      input_plugin->set_track((*input_handle)->priv, 0);
+      input_plugin->set_video_stream((*input_handle)->priv, 0,
+                                     BG_STREAM_ACTION_DECODE);
+      if(input_plugin->start)
+        input_plugin->start((*input_handle)->priv);
+      src = input_plugin->get_video_source((*input_handle)->priv, 0);
+      }
+    else
+      {
+      bg_log(BG_LOG_ERROR, LOG_DOMAIN,
+             "Cannot reset stream after failed seek");
+      goto fail;
+      }
+    }
+  
+  /* Decode up to the seek time. Files, which are shorter, get the last
+     frame */
+  
+  while(!have_frame)
+    {
+    frame = NULL;
+    if(gavl_video_source_read_frame(src, &frame) != GAVL_SOURCE_OK)
+      {
+      if(input_frame)
+        have_frame = 1;
+      break;
+      }
+    input_frame = frame;
+    
+    if(gavl_time_unscale(input_format.timescale,
+                         input_frame->timestamp) >= seek_time)
+      have_frame = 1;
+    else if((time_budget > 0) && (gavl_timer_get(timer) > time_budget))
+      {
+      bg_log(BG_LOG_WARNING, LOG_DOMAIN,
+             "Giving up on %s after %.1f seconds", gml,
+             gavl_time_to_seconds(time_budget));
+      break;
+      }
+    }
+  
+  if(!have_frame)
+    {
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN, "Couldn't read frame from %s", gml);
+    goto fail;
+    }
+
+  /* Get the output format: Square pixels, maximum size THUMB_SIZE */
+  
+  gavl_video_format_copy(output_format, &input_format);
+  
+  output_format->image_width *= output_format->pixel_width;
+  output_format->image_height *= output_format->pixel_height;
+  
+  if(output_format->image_width > output_format->image_height)
+    {
+    output_format->image_height = (THUMB_SIZE * output_format->image_height) /
+      output_format->image_width;
+    output_format->image_width = THUMB_SIZE;
+    }
+  else
+    {
+    output_format->image_width = (THUMB_SIZE * output_format->image_width) /
+      output_format->image_height;
+    output_format->image_height = THUMB_SIZE;
+    }
+
+  if(!output_format->image_width)
+    output_format->image_width = 1;
+  if(!output_format->image_height)
+    output_format->image_height = 1;
+  
+  output_format->pixel_width = 1;
+  output_format->pixel_height = 1;
+  output_format->interlace_mode = GAVL_INTERLACE_NONE;
+  output_format->pixelformat = GAVL_RGBA_32;
+  output_format->frame_width = output_format->image_width;
+  output_format->frame_height = output_format->image_height;
+  
+  output_frame = gavl_video_frame_create(output_format);
+  
+  cnv = gavl_video_converter_create();
+  if(gavl_video_converter_init(cnv, &input_format, output_format))
+    gavl_video_convert(cnv, input_frame, output_frame);
+  else
+    gavl_video_frame_copy(output_format, output_frame, input_frame);
+  gavl_video_converter_destroy(cnv);
+  
+  /* Extended metadata */
+  
+  tmp_string = bg_string_to_uri(gml, -1);
+  gavl_metadata_set_nocpy(metadata, "Thumb::URI", tmp_string);
+  
+  tmp_string = bg_sprintf("%"PRId64, (int64_t)st->st_mtime);
+  gavl_metadata_set_nocpy(metadata, "Thumb::MTime", tmp_string);
+  
+  gavl_metadata_set(metadata, "Software", PACKAGE);
+  
+  tmp_string = bg_sprintf("%"PRId64, (int64_t)st->st_size);
+  gavl_metadata_set_nocpy(metadata, "Thumb::Size", tmp_string);
+  
+  if(duration != GAVL_TIME_UNDEFINED)
+    {
+    tmp_string = bg_sprintf("%d", (int)(gavl_time_to_seconds(duration)));
+    gavl_metadata_set_nocpy(metadata, "Thumb::Movie::Length", tmp_string);
+    }
+  
+  fail:
+
+  /* Keep the handle for the next file */
+  if(input_plugin->close)
+    input_plugin->close((*input_handle)->priv);
+  
+  gavl_timer_destroy(timer);
+  return output_frame;
+  }
+
+static char * get_thumbs_dir(const char * subdir)
+  {
+  char * home_dir;
+  char * ret;
+  
   home_dir = getenv("HOME");
   if(!home_dir)
     {
     bg_log(BG_LOG_ERROR, LOG_DOMAIN, "Cannot get home directory");
-    return 0;
+    return NULL;
     }
+  ret = bg_sprintf("%s/.thumbnails/%s", home_dir, subdir);
   
-  thumbs_dir_normal = bg_sprintf("%s/.thumbnails/normal",       home_dir);
-  thumbs_dir_fail   = bg_sprintf("%s/.thumbnails/fail/gmerlin", home_dir);
-  
-  if(!bg_ensure_directory(thumbs_dir_normal) ||
-     !bg_ensure_directory(thumbs_dir_fail))
-    goto done;
-  
-  bg_get_filename_hash(gml, hash);
+  if(!bg_ensure_directory(ret))
+    {
+    free(ret);
+    return NULL;
+    }
+  return ret;
+  }
 
-  thumb_filename_normal = bg_sprintf("%s/%s.png", thumbs_dir_normal, hash);
-  thumb_filename_fail = bg_sprintf("%s/%s.png", thumbs_dir_fail, hash);
+/* Check for an up to date thumbnail or failed thumbnail. Returns 1 if
+   the thumbnail needs to be (re)generated. Outdated files are removed. */
+
+static int check_thumbnail(bg_plugin_registry_t * plugin_reg,
+                           const char * thumb_filename_normal,
+                           const char * thumb_filename_fail,
+                           int64_t mtime,
+                           int * have_thumbnail,
+                           gavl_video_frame_t ** frame_ret,
+                           gavl_video_format_t * format_ret)
+  {
+  gavl_video_frame_t * frame = NULL;
+  gavl_video_format_t format;
+
+  *have_thumbnail = 0;
   
   if(access(thumb_filename_normal, R_OK)) /* Thumbnail file not present */
     {
@@ -162,32 +471,24 @@ int bg_get_thumbnail(const char * gml,
     if(!access(thumb_filename_fail, R_OK))
       {
       if(thumbnail_up_to_date(thumb_filename_fail, plugin_reg, 
-                              &frame, &format, st.st_mtime))
+                              &frame, &format, mtime))
         {
-        gavl_video_frame_destroy(frame);
-        frame = NULL;
-        goto done;
+        if(frame)
+          gavl_video_frame_destroy(frame);
+        return 0;
         }
       else /* Failed thumbnail is *not* up to date, remove it */
-        {
         remove(thumb_filename_fail);
-        gavl_video_frame_destroy(frame);
-        frame = NULL;
-        }
       }
-    /* else: Regenerate */
     }
   else /* Thumbnail file present */
     {
     /* Check if the thumbnail is recent */
     if(thumbnail_up_to_date(thumb_filename_normal, plugin_reg,
-                            &frame, &format, st.st_mtime))
+                            &frame, &format, mtime))
       {
-      if(thumbnail_filename_ret)
-        {
-        *thumbnail_filename_ret = thumb_filename_normal;
-        thumb_filename_normal = NULL;
-        }
+      *have_thumbnail = 1;
+      
       if(frame_ret)
         {
         *frame_ret = frame;
@@ -195,41 +496,99 @@ int bg_get_thumbnail(const char * gml,
         }
       if(format_ret)
         gavl_video_format_copy(format_ret, &format);
-      ret = 1;
-      goto done;
+
+      if(frame)
+        gavl_video_frame_destroy(frame);
+      return 0;
       }
     else
-      {
       remove(thumb_filename_normal);
-      gavl_video_frame_destroy(frame);
-      frame = NULL;
-      }
-    /* else: Regenerate */
     }
+  
+  if(frame)
+    gavl_video_frame_destroy(frame);
+  
+  /* Regenerate */
+  return 1;
+  }
+
+int bg_get_thumbnail(const char * gml,
+                     bg_plugin_registry_t * plugin_reg,
+                     char ** thumbnail_filename_ret,
+                     gavl_video_frame_t ** frame_ret,
+                     gavl_video_format_t * format_ret)
+  {
+  char hash[33];
+  
+  char * thumb_filename_normal = NULL;
+  char * thumb_filename_fail = NULL;
+
+  char * thumbs_dir_normal = NULL;
+  char * thumbs_dir_fail = NULL;
+  
+  int ret = 0;
+  gavl_video_frame_t * frame = NULL;
+  gavl_video_format_t format;
+  gavl_metadata_t metadata;
+  bg_plugin_handle_t * input_handle = NULL;
+  struct stat st;
+
+  if(stat(gml, &st))
+    {
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN, "Cannot stat %s: %s",
+           gml, strerror(errno));
+    return 0;
+    }
+  
+  /* Get and create directories */
+  
+  if(!(thumbs_dir_normal = get_thumbs_dir("normal")) ||
+     !(thumbs_dir_fail = get_thumbs_dir("fail/gmerlin")))
+    goto done;
+  
+  bg_get_filename_hash(gml, hash);
+
+  thumb_filename_normal = bg_sprintf("%s/%s.png", thumbs_dir_normal, hash);
+  thumb_filename_fail = bg_sprintf("%s/%s.png", thumbs_dir_fail, hash);
 
+  if(!check_thumbnail(plugin_reg, thumb_filename_normal, thumb_filename_fail,
+                      st.st_mtime, &ret, frame_ret, format_ret))
+    {
+    if(ret && thumbnail_filename_ret)
+      {
+      *thumbnail_filename_ret = thumb_filename_normal;
+      thumb_filename_normal = NULL;
+      }
+    goto done;
+    }
+  
   /* Regenerate */
-  command = bg_sprintf("gmerlin-video-thumbnailer \"%s\" %s", gml, thumb_filename_normal);
-  sp = bg_subprocess_create(command, 0, 0, 0);
-  bg_subprocess_close(sp);
-  free(command);
+
+  gavl_metadata_init(&metadata);
   
-  if(!access(thumb_filename_normal, R_OK)) /* Thumbnail generation succeeded */
+  frame = make_thumbnail(plugin_reg, NULL, &input_handle, gml, &st,
+                         0, &format, &metadata);
+  if(input_handle)
+    bg_plugin_unref(input_handle);
+  
+  if(frame) /* Thumbnail generation succeeded */
     {
+    bg_plugin_registry_save_image(plugin_reg,
+                                  thumb_filename_normal,
+                                  frame, &format, &metadata);
+    
     if(frame_ret && format_ret)
       {
-      *frame_ret = bg_plugin_registry_load_image(plugin_reg,
-                                                thumb_filename_normal,
-                                                format_ret,
-                                                NULL);
+      *frame_ret = frame;
+      gavl_video_format_copy(format_ret, &format);
+      frame = NULL;
       }
     if(thumbnail_filename_ret)
       {
       *thumbnail_filename_ret = thumb_filename_normal;
       thumb_filename_normal = NULL;
       }
-    
     ret = 1;
-    goto done;
     }
   else /* Thumbnail generation failed */
     {
@@ -237,11 +596,14 @@ int bg_get_thumbnail(const char * gml,
                         plugin_reg,
                         st.st_mtime);
     }
+  gavl_metadata_free(&metadata);
   
   done:
   
-  free(thumbs_dir_normal);
-  free(thumbs_dir_fail);
+  if(thumbs_dir_normal)
+    free(thumbs_dir_normal);
+  if(thumbs_dir_fail)
+    free(thumbs_dir_fail);
 
   if(thumb_filename_normal)
     free(thumb_filename_normal);
@@ -252,3 +614,381 @@ int bg_get_thumbnail(const char * gml,
   
   return ret;
   }
+
+/* Thumbnailer service */
+
+typedef struct job_s
+  {
+  char * gml;
+  char * thumb_filename;
+  
+  /* Image to write (NULL if the thumbnail was up to date) */
+  gavl_video_frame_t * frame;
+  gavl_video_format_t format;
+  gavl_metadata_t metadata;
+  
+  int failed;
+  
+  struct job_s * next;
+  } job_t;
+
+struct bg_thumbnailer_s
+  {
+  bg_plugin_registry_t * plugin_reg;
+  gavl_time_t time_budget;
+  
+  char * thumbs_dir_normal;
+  char * thumbs_dir_fail;
+
+  bg_thumbnailer_callback_t cb;
+  void * cb_data;
+  
+  int num_threads;
+  pthread_t * threads;
+  pthread_t writer;
+
+  /* Image writer, used only by the writer thread */
+  bg_plugin_handle_t * iw_handle;
+  
+  /* Serializes everything which loads plugins */
+  pthread_mutex_t reg_mutex;
+  
+  /* Protects the queues and the counters below */
+  pthread_mutex_t mutex;
+  pthread_cond_t job_cond;
+  pthread_cond_t write_cond;
+  pthread_cond_t done_cond;
+
+  job_t * jobs_first;
+  job_t * jobs_last;
+
+  job_t * write_first;
+  job_t * write_last;
+
+  int num_pending;
+  int quit_workers;
+  int quit_writer;
+  };
+
+static void job_append(job_t ** first, job_t ** last, job_t * job)
+  {
+  job->next = NULL;
+  if(*last)
+    (*last)->next = job;
+  else
+    *first = job;
+  *last = job;
+  }
+
+static job_t * job_remove(job_t ** first, job_t ** last)
+  {
+  job_t * ret = *first;
+  *first = ret->next;
+  if(!(*first))
+    *last = NULL;
+  return ret;
+  }
+
+static void job_destroy(job_t * job)
+  {
+  free(job->gml);
+  if(job->thumb_filename)
+    free(job->thumb_filename);
+  if(job->frame)
+    gavl_video_frame_destroy(job->frame);
+  gavl_metadata_free(&job->metadata);
+  free(job);
+  }
+
+static void process_job(bg_thumbnailer_t * t, job_t * job,
+                        bg_plugin_handle_t ** input_handle)
+  {
+  char hash[33];
+  char * thumb_filename_normal;
+  char * thumb_filename_fail;
+  struct stat st;
+  int have_thumbnail;
+  int regenerate;
+  
+  if(stat(job->gml, &st))
+    {
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN, "Cannot stat %s: %s",
+           job->gml, strerror(errno));
+    job->failed = 1;
+    return;
+    }
+  
+  bg_get_filename_hash(job->gml, hash);
+  
+  thumb_filename_normal = bg_sprintf("%s/%s.png", t->thumbs_dir_normal, hash);
+  thumb_filename_fail = bg_sprintf("%s/%s.png", t->thumbs_dir_fail, hash);
+
+  pthread_mutex_lock(&t->reg_mutex);
+  regenerate = check_thumbnail(t->plugin_reg,
+                               thumb_filename_normal, thumb_filename_fail,
+                               st.st_mtime, &have_thumbnail, NULL, NULL);
+  pthread_mutex_unlock(&t->reg_mutex);
+  
+  if(regenerate)
+    {
+    job->frame = make_thumbnail(t->plugin_reg, &t->reg_mutex, input_handle,
+                                job->gml, &st, t->time_budget,
+                                &job->format, &job->metadata);
+    if(!job->frame)
+      {
+      gavl_metadata_free(&job->metadata);
+      job->frame = create_fail_thumbnail(job->gml, st.st_mtime,
+                                         &job->format, &job->metadata);
+      job->failed = 1;
+      }
+    }
+  else if(!have_thumbnail)
+    job->failed = 1;
+  
+  if(job->failed)
+    {
+    job->thumb_filename = thumb_filename_fail;
+    free(thumb_filename_normal);
+    }
+  else
+    {
+    job->thumb_filename = thumb_filename_normal;
+    free(thumb_filename_fail);
+    }
+  }
+
+static void * worker_thread(void * data)
+  {
+  job_t * job;
+  bg_plugin_handle_t * input_handle = NULL;
+  bg_thumbnailer_t * t = data;
+  
+  while(1)
+    {
+    pthread_mutex_lock(&t->mutex);
+    while(!t->jobs_first && !t->quit_workers)
+      pthread_cond_wait(&t->job_cond, &t->mutex);
+    
+    if(!t->jobs_first)
+      {
+      pthread_mutex_unlock(&t->mutex);
+      break;
+      }
+    job = job_remove(&t->jobs_first, &t->jobs_last);
+    pthread_mutex_unlock(&t->mutex);
+    
+    process_job(t, job, &input_handle);
+
+    /* Hand over to the writer */
+    pthread_mutex_lock(&t->mutex);
+    job_append(&t->write_first, &t->write_last, job);
+    pthread_cond_signal(&t->write_cond);
+    pthread_mutex_unlock(&t->mutex);
+    }
+  
+  if(input_handle)
+    {
+    pthread_mutex_lock(&t->reg_mutex);
+    bg_plugin_unref(input_handle);
+    pthread_mutex_unlock(&t->reg_mutex);
+    }
+  return NULL;
+  }
+
+static int write_image(bg_plugin_handle_t * h, job_t * job)
+  {
+  bg_image_writer_plugin_t * iw;
+  gavl_video_format_t format;
+  gavl_video_converter_t * cnv;
+  gavl_video_frame_t * frame = NULL;
+  int ret = 0;
+  
+  iw = (bg_image_writer_plugin_t*)h->plugin;
+
+  gavl_video_format_copy(&format, &job->format);
+
+  if(!iw->write_header(h->priv, job->thumb_filename, &format, &job->metadata))
+    return 0;
+  
+  cnv = gavl_video_converter_create();
+  
+  if(gavl_video_converter_init(cnv, &job->format, &format))
+    {
+    frame = gavl_video_frame_create(&format);
+    gavl_video_convert(cnv, job->frame, frame);
+    ret = iw->write_image(h->priv, frame);
+    gavl_video_frame_destroy(frame);
+    }
+  else
+    ret = iw->write_image(h->priv, job->frame);
+  
+  gavl_video_converter_destroy(cnv);
+  return ret;
+  }
+
+static void * writer_thread(void * data)
+  {
+  job_t * job;
+  bg_thumbnailer_t * t = data;
+  
+  while(1)
+    {
+    pthread_mutex_lock(&t->mutex);
+    while(!t->write_first && !t->quit_writer)
+      pthread_cond_wait(&t->write_cond, &t->mutex);
+    
+    if(!t->write_first)
+      {
+      pthread_mutex_unlock(&t->mutex);
+      break;
+      }
+    job = job_remove(&t->write_first, &t->write_last);
+    pthread_mutex_unlock(&t->mutex);
+
+    if(job->frame && !write_image(t->iw_handle, job))
+      {
+      bg_log(BG_LOG_ERROR, LOG_DOMAIN, "Writing %s failed",
+             job->thumb_filename);
+      job->failed = 1;
+      }
+    
+    if(t->cb)
+      t->cb(t->cb_data, job->gml,
+            job->failed ? NULL : job->thumb_filename);
+    
+    job_destroy(job);
+    
+    pthread_mutex_lock(&t->mutex);
+    t->num_pending--;
+    if(!t->num_pending)
+      pthread_cond_broadcast(&t->done_cond);
+    pthread_mutex_unlock(&t->mutex);
+    }
+  return NULL;
+  }
+
+bg_thumbnailer_t *
+bg_thumbnailer_create(bg_plugin_registry_t * plugin_reg,
+                      int num_threads, gavl_time_t time_budget,
+                      bg_thumbnailer_callback_t cb, void * cb_data)
+  {
+  int i;
+  bg_thumbnailer_t * ret;
+  const bg_plugin_info_t * info;
+  bg_parameter_value_t val;
+  
+  if(num_threads < 1)
+    num_threads = 1;
+  
+  ret = calloc(1, sizeof(*ret));
+  ret->plugin_reg = plugin_reg;
+  ret->time_budget = time_budget;
+  ret->cb = cb;
+  ret->cb_data = cb_data;
+  
+  if(!(ret->thumbs_dir_normal = get_thumbs_dir("normal")) ||
+     !(ret->thumbs_dir_fail = get_thumbs_dir("fail/gmerlin")))
+    goto fail;
+  
+  if(!(info = bg_plugin_find_by_name(plugin_reg, "iw_png")))
+    {
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN, "No plugin for png images");
+    goto fail;
+    }
+  
+  if(!(ret->iw_handle = bg_plugin_load(plugin_reg, info)))
+    {
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN, "Loading %s failed", info->long_name);
+    goto fail;
+    }
+  
+  /* Don't force file extension */
+  val.val_i = 1;
+  ret->iw_handle->plugin->set_parameter(ret->iw_handle->priv,
+                                        "dont_force_extension", &val);
+  
+  pthread_mutex_init(&ret->reg_mutex, NULL);
+  pthread_mutex_init(&ret->mutex, NULL);
+  pthread_cond_init(&ret->job_cond, NULL);
+  pthread_cond_init(&ret->write_cond, NULL);
+  pthread_cond_init(&ret->done_cond, NULL);
+  
+  ret->num_threads = num_threads;
+  ret->threads = calloc(num_threads, sizeof(*ret->threads));
+  
+  for(i = 0; i < num_threads; i++)
+    pthread_create(&ret->threads[i], NULL, worker_thread, ret);
+  pthread_create(&ret->writer, NULL, writer_thread, ret);
+  
+  return ret;
+  
+  fail:
+  if(ret->thumbs_dir_normal)
+    free(ret->thumbs_dir_normal);
+  if(ret->thumbs_dir_fail)
+    free(ret->thumbs_dir_fail);
+  free(ret);
+  return NULL;
+  }
+
+void bg_thumbnailer_add(bg_thumbnailer_t * t, const char * gml)
+  {
+  job_t * job;
+
+  if(!strncmp(gml, "file://", 7))
+    gml += 7;
+  
+  job = calloc(1, sizeof(*job));
+  job->gml = gavl_strdup(gml);
+  gavl_metadata_init(&job->metadata);
+  
+  pthread_mutex_lock(&t->mutex);
+  job_append(&t->jobs_first, &t->jobs_last, job);
+  t->num_pending++;
+  pthread_cond_signal(&t->job_cond);
+  pthread_mutex_unlock(&t->mutex);
+  }
+
+void bg_thumbnailer_wait(bg_thumbnailer_t * t)
+  {
+  pthread_mutex_lock(&t->mutex);
+  while(t->num_pending)
+    pthread_cond_wait(&t->done_cond, &t->mutex);
+  pthread_mutex_unlock(&t->mutex);
+  }
+
+void bg_thumbnailer_destroy(bg_thumbnailer_t * t)
+  {
+  int i;
+
+  /* Finish the queued files */
+  bg_thumbnailer_wait(t);
+  
+  pthread_mutex_lock(&t->mutex);
+  t->quit_workers = 1;
+  pthread_cond_broadcast(&t->job_cond);
+  pthread_mutex_unlock(&t->mutex);
+
+  for(i = 0; i < t->num_threads; i++)
+    pthread_join(t->threads[i], NULL);
+
+  pthread_mutex_lock(&t->mutex);
+  t->quit_writer = 1;
+  pthread_cond_signal(&t->write_cond);
+  pthread_mutex_unlock(&t->mutex);
+
+  pthread_join(t->writer, NULL);
+  
+  bg_plugin_unref(t->iw_handle);
+  
+  pthread_mutex_destroy(&t->reg_mutex);
+  pthread_mutex_destroy(&t->mutex);
+  pthread_cond_destroy(&t->job_cond);
+  pthread_cond_destroy(&t->write_cond);
+  pthread_cond_destroy(&t->done_cond);
+  
+  free(t->threads);
+  free(t->thumbs_dir_normal);
+  free(t->thumbs_dir_fail);
+  free(t);
+  }
@@ -124,6 +124,7 @@ typedef struct
   int do_encode; /* Whether this stream should be really encoded */
   int do_decode; /* Whether this stream should be decoded */
   int do_copy;   /* Whether this stream should be copied */
+  int auto_copy; /* Copy only if no processing is needed */
   
   gavl_compression_info_t ci;
   gavl_packet_t packet;
@@ -147,6 +148,11 @@ static int set_stream_parameters_general(stream_t * s,
       s->action = STREAM_ACTION_TRANSCODE;
     else if(!strcmp(val->val_str, "copy"))
       s->action = STREAM_ACTION_COPY;
+    else if(!strcmp(val->val_str, "auto"))
+      {
+      s->action = STREAM_ACTION_COPY;
+      s->auto_copy = 1;
+      }
     else if(!strcmp(val->val_str, "transcode_overlay"))
       s->action = STREAM_ACTION_TRANSCODE_OVERLAY;
     else if(!strcmp(val->val_str, "blend"))
@@ -225,6 +231,21 @@ static void set_audio_parameter_general(void * data, const char * name,
 
   }
 
+/* Additional, downscaled encoding of a decoded video stream.
+   Each rung is scaled from the previous one */
+
+typedef struct
+  {
+  int out_index;
+  gavl_metadata_t m;
+  gavl_video_format_t format;
+
+  gavl_video_converter_t * cnv;
+  int do_convert;
+  gavl_video_frame_t * frame;
+  char * stats_file;
+  } video_rung_t;
+
 typedef struct
   {
   stream_t com;
@@ -262,6 +283,13 @@ typedef struct
   
   int b_frames_seen;
   int flush_b_frames;
+  int have_packet; /* Keyframe already read by align_start_time() */
+  int align_start; /* Move the start time to a keyframe when copying */
+
+  /* Additional sizes */
+  int num_rungs;
+  int rung_scale; /* Percent of the previous size */
+  video_rung_t * rungs;
 
   gavl_video_source_t * vsrc;
   gavl_video_sink_t   * vsink;
@@ -279,6 +307,12 @@ static void set_video_parameter_general(void * data,
 
   if(!strcmp(name, "twopass"))
     stream->twopass = val->val_i;
+  else if(!strcmp(name, "copy_align_start"))
+    stream->align_start = val->val_i;
+  else if(!strcmp(name, "ladder_rungs"))
+    stream->num_rungs = val->val_i;
+  else if(!strcmp(name, "ladder_scale"))
+    stream->rung_scale = val->val_i;
   
   if(set_stream_parameters_general(&stream->com,
                                    name, val))
@@ -1021,7 +1055,8 @@ static void set_input_formats(bg_transcoder_t * ret)
                                                   s->com.in_index);
       gavl_audio_format_copy(&s->in_format,
                              gavl_packet_source_get_audio_format(s->com.psrc));
-                             
+      /* Packets are passed unchanged */
+      gavl_audio_format_copy(&s->out_format, &s->in_format);
       }
     else
       {
@@ -1043,8 +1078,12 @@ static void set_input_formats(bg_transcoder_t * ret)
                            &ret->track_info->video_streams[s->com.in_index].format);
 
     if(s->com.do_copy)
+      {
       s->com.psrc = s->com.in_plugin->get_video_packet_source(s->com.in_handle->priv,
                                                               s->com.in_index);
+      /* Packets are passed unchanged */
+      gavl_video_format_copy(&s->out_format, &s->in_format);
+      }
 
     }
   for(i = 0; i < ret->num_overlay_streams; i++)
@@ -1254,6 +1293,122 @@ static void add_video_stream(video_stream_t * ret,
                                 ret->com.in_index, NULL);
   }
 
+/* Scale all bitrates of an encoder section. We don't know the
+   encoder, so we take all integer parameters which have "bitrate"
+   or "bit_rate" in their names */
+
+static void scale_bitrates(bg_cfg_section_t * section,
+                           const bg_parameter_info_t * info,
+                           double factor)
+  {
+  int i;
+  bg_parameter_value_t val;
+  bg_cfg_section_t * subsection;
+  
+  while(info->name)
+    {
+    if((info->type == BG_PARAMETER_INT) &&
+       (strstr(info->name, "bitrate") || strstr(info->name, "bit_rate")))
+      {
+      bg_cfg_section_get_parameter(section, info, &val);
+      val.val_i = (int)(val.val_i * factor + 0.5);
+
+      if((info->val_min.val_i < info->val_max.val_i) &&
+         (val.val_i < info->val_min.val_i))
+        val.val_i = info->val_min.val_i;
+      
+      bg_cfg_section_set_parameter(section, info, &val);
+      }
+    else if((info->type == BG_PARAMETER_MULTI_MENU) &&
+            info->multi_names && info->multi_parameters)
+      {
+      val.val_str = NULL;
+      bg_cfg_section_get_parameter(section, info, &val);
+
+      i = 0;
+      while(val.val_str && info->multi_names[i] &&
+            strcmp(info->multi_names[i], val.val_str))
+        i++;
+      
+      if(val.val_str && info->multi_names[i] && info->multi_parameters[i])
+        {
+        subsection = bg_cfg_section_find_subsection(section, info->name);
+        subsection = bg_cfg_section_find_subsection(subsection, val.val_str);
+        scale_bitrates(subsection, info->multi_parameters[i], factor);
+        }
+      if(val.val_str)
+        free(val.val_str);
+      }
+    info++;
+    }
+  }
+
+static void add_video_rungs(video_stream_t * ret,
+                            bg_transcoder_t * t)
+  {
+  int i;
+  const gavl_video_format_t * prev_format;
+  video_rung_t * r;
+  const bg_parameter_info_t * parameters;
+  bg_cfg_section_t * section;
+  
+  if(!ret->num_rungs)
+    return;
+
+  if(!ret->rungs)
+    ret->rungs = calloc(ret->num_rungs, sizeof(*ret->rungs));
+  
+  prev_format = &ret->out_format;
+  parameters = bg_encoder_get_stream_parameters(t->enc, BG_STREAM_VIDEO);
+  
+  for(i = 0; i < ret->num_rungs; i++)
+    {
+    r = &ret->rungs[i];
+
+    gavl_video_format_copy(&r->format, prev_format);
+    r->format.image_width  =
+      ((prev_format->image_width  * ret->rung_scale) / 200) * 2;
+    r->format.image_height =
+      ((prev_format->image_height * ret->rung_scale) / 200) * 2;
+
+    if((r->format.image_width < 16) || (r->format.image_height < 16))
+      {
+      bg_log(BG_LOG_WARNING, LOG_DOMAIN,
+             "Image too small for %d additional sizes, using %d",
+             ret->num_rungs, i);
+      ret->num_rungs = i;
+      break;
+      }
+    
+    r->format.frame_width  = r->format.image_width;
+    r->format.frame_height = r->format.image_height;
+    
+    gavl_metadata_free(&r->m);
+    gavl_metadata_copy(&r->m, &ret->com.m);
+    
+    /* The encoder settings of the stream with the bitrates scaled
+       by the number of pixels */
+    section = t->transcoder_track->video_streams[ret->com.in_index].encoder_section;
+    if(section)
+      section = bg_cfg_section_copy(section);
+    
+    if(section && parameters)
+      scale_bitrates(section, parameters,
+                     (double)(r->format.image_width * r->format.image_height) /
+                     (double)(ret->out_format.image_width *
+                              ret->out_format.image_height));
+    
+    r->out_index =
+      bg_encoder_add_video_stream(t->enc,
+                                  &r->m,
+                                  &r->format,
+                                  ret->com.in_index, section);
+    if(section)
+      bg_cfg_section_destroy(section);
+    prev_format = &r->format;
+    }
+  }
+
 static void add_video_stream_compressed(video_stream_t * ret,
                                         bg_transcoder_t * t)
   {
@@ -1269,6 +1424,7 @@ static void add_video_stream_compressed(video_stream_t * ret,
 
 static int set_video_pass(bg_transcoder_t * t, int i)
   {
+  int j;
   video_stream_t * s;
 
   s = &t->video_streams[i];
@@ -1284,6 +1440,17 @@ static int set_video_pass(bg_transcoder_t * t, int i)
   bg_encoder_set_video_pass(t->enc,
                             s->com.out_index, t->pass, t->total_passes,
                             s->stats_file);
+
+  for(j = 0; j < s->num_rungs; j++)
+    {
+    if(!s->rungs[j].stats_file)
+      s->rungs[j].stats_file = bg_sprintf("%s/%s_video_%02d_%d.stats",
+                                          t->output_directory, t->name,
+                                          i+1, j+1);
+    bg_encoder_set_video_pass(t->enc,
+                              s->rungs[j].out_index, t->pass, t->total_passes,
+                              s->rungs[j].stats_file);
+    }
   return 1;
   }
 
@@ -1326,9 +1493,18 @@ static int audio_iteration(audio_stream_t*s, bg_transcoder_t * t)
       s->com.status = STREAM_STATE_FINISHED;
       return ret;
       }
+    /* Rebase timestamps to the start time, skip packets before */
+    s->com.packet.pts += s->com.pts_offset;
+
+    if(s->com.packet.pts + s->com.packet.duration <= 0)
+      return ret;
+    
     ret = bg_encoder_write_audio_packet(t->enc, &s->com.packet,
                                         s->com.out_index); 
+
+    /* Only written packets count for the end time */
     s->samples_read += s->com.packet.duration;
+    
     if(s->com.pts_end && (s->com.pts_end <= s->samples_read))
       s->com.status = STREAM_STATE_FINISHED;
 
@@ -1347,6 +1523,15 @@ static int audio_iteration(audio_stream_t*s, bg_transcoder_t * t)
       }
     frame->timestamp += s->com.pts_offset;
 
+    /* Samples before a start time moved by align_start_time() */
+    if(frame->timestamp < 0)
+      {
+      frame->timestamp += gavl_audio_frame_skip(&s->out_format, frame,
+                                                -frame->timestamp);
+      if(!frame->valid_samples)
+        return ret;
+      }
+    
     if(s->com.pts_end && 
        (s->samples_read + frame->valid_samples > s->com.pts_end))
       {
@@ -1589,6 +1774,40 @@ static int check_video_blend(video_stream_t * vs,
   s->in_frame_1=s->in_frame_2;\
   s->in_frame_2=tmp_frame
 
+/* Encode the additional sizes. Each rung is scaled from the
+   previous one, so the largest scaling happens only once */
+
+static int write_video_rungs(video_stream_t * s, bg_transcoder_t * t,
+                             gavl_video_frame_t * frame)
+  {
+  int i;
+  video_rung_t * r;
+  gavl_video_frame_t * src = frame;
+  const gavl_video_format_t * src_format = &s->out_format;
+  
+  for(i = 0; i < s->num_rungs; i++)
+    {
+    r = &s->rungs[i];
+    
+    if(r->do_convert)
+      {
+      gavl_video_convert(r->cnv, src, r->frame);
+      r->frame->timestamp =
+        gavl_time_rescale(src_format->timescale, r->format.timescale,
+                          src->timestamp);
+      r->frame->duration =
+        gavl_time_rescale(src_format->timescale, r->format.timescale,
+                          src->duration);
+      src = r->frame;
+      }
+    src_format = &r->format;
+    
+    if(!bg_encoder_write_video_frame(t->enc, src, r->out_index))
+      return 0;
+    }
+  return 1;
+  }
+
 static int video_iteration(video_stream_t * s, bg_transcoder_t * t)
   {
   int ret = 1;
@@ -1621,9 +1840,11 @@ static int video_iteration(video_stream_t * s, bg_transcoder_t * t)
 
   if(s->com.do_copy)
     {
-    if(!s->com.in_plugin->read_video_packet(s->com.in_handle->priv,
-                                            s->com.in_index,
-                                            &s->com.packet))
+    if(s->have_packet)
+      s->have_packet = 0;
+    else if(!s->com.in_plugin->read_video_packet(s->com.in_handle->priv,
+                                                 s->com.in_index,
+                                                 &s->com.packet))
       {
       /* EOF */
       s->com.status = STREAM_STATE_FINISHED;
@@ -1657,8 +1878,13 @@ static int video_iteration(video_stream_t * s, bg_transcoder_t * t)
       s->b_frames_seen = 1;
       }
     
-    bg_encoder_write_video_packet(t->enc, &s->com.packet,
-                                  s->com.out_index); 
+    /* Rebase timestamps to the start time. Leading B-frames of an
+       open GOP reference the previous GOP and are dropped */
+    s->com.packet.pts += s->com.pts_offset;
+
+    if((t->start_time == GAVL_TIME_UNDEFINED) || (s->com.packet.pts >= 0))
+      bg_encoder_write_video_packet(t->enc, &s->com.packet,
+                                    s->com.out_index); 
     }
   else
     {
@@ -1675,6 +1901,10 @@ static int video_iteration(video_stream_t * s, bg_transcoder_t * t)
       }
     frame->timestamp += s->com.pts_offset;
 
+    /* Frames before a start time moved by align_start_time() */
+    if(frame->timestamp < 0)
+      return ret;
+    
     s->com.time = gavl_time_unscale(s->out_format.timescale,
                                     frame->timestamp + frame->duration);
 
@@ -1702,6 +1932,8 @@ static int video_iteration(video_stream_t * s, bg_transcoder_t * t)
     ret = bg_encoder_write_video_frame(t->enc,
                                        frame,
                                        s->com.out_index);
+    if(ret && s->num_rungs)
+      ret = write_video_rungs(s, t, frame);
     }
   
   
@@ -2200,21 +2432,56 @@ static int open_input(bg_transcoder_t * ret)
   
   }
 
+static int has_filters(bg_cfg_section_t * section, const char * name)
+  {
+  const char * filters = NULL;
+  bg_cfg_section_get_parameter_string(section, name, &filters);
+  return filters && *filters;
+  }
+
 static void check_compressed(bg_transcoder_t * ret)
   {
   int i, j;
+  int log_level;
   
   for(i = 0; i < ret->num_audio_streams; i++)
     {
-    if(!(ret->audio_streams[i].com.action == STREAM_ACTION_COPY))
+    audio_stream_t * s = &ret->audio_streams[i];
+    
+    if(!(s->com.action == STREAM_ACTION_COPY))
       continue;
 
+    /* Copying was not explicitly requested: Fallbacks are normal */
+    log_level = s->com.auto_copy ? BG_LOG_INFO : BG_LOG_WARNING;
+    
+    /* Check if the stream needs processing */
+    if(s->com.auto_copy)
+      {
+      const char * reason = NULL;
+      
+      if(s->normalize)
+        reason = "Normalizing";
+      else if(s->options.fixed_channel_setup)
+        reason = "Fixed channel setup";
+      else if(has_filters(ret->transcoder_track->audio_streams[i].filter_section,
+                          "audio_filters"))
+        reason = "Filters";
+
+      if(reason)
+        {
+        bg_log(log_level, LOG_DOMAIN,
+               "Not copying audio stream %d: %s enabled", i+1, reason);
+        s->com.action = STREAM_ACTION_TRANSCODE;
+        continue;
+        }
+      }
+    
     /* Check if we can read compressed data */
     if(!ret->in_plugin->get_audio_compression_info ||
        !ret->in_plugin->get_audio_compression_info(ret->in_handle->priv,
                                                    i, &ret->audio_streams[i].com.ci))
       {
-      bg_log(BG_LOG_WARNING, LOG_DOMAIN, "Audio stream %d cannot be read compressed", i+1);
+      bg_log(log_level, LOG_DOMAIN, "Audio stream %d cannot be read compressed", i+1);
       ret->audio_streams[i].com.action = STREAM_ACTION_TRANSCODE;
       continue;
       }
@@ -2224,7 +2491,7 @@ static void check_compressed(bg_transcoder_t * ret)
                                            &ret->track_info->audio_streams[i].format,
                                            &ret->audio_streams[i].com.ci))
       {
-      bg_log(BG_LOG_WARNING, LOG_DOMAIN, "Audio stream %d cannot be written compressed", i+1);
+      bg_log(log_level, LOG_DOMAIN, "Audio stream %d cannot be written compressed", i+1);
       ret->audio_streams[i].com.action = STREAM_ACTION_TRANSCODE;
       continue;
       }
@@ -2237,13 +2504,27 @@ static void check_compressed(bg_transcoder_t * ret)
     {
     if(ret->video_streams[i].com.action != STREAM_ACTION_COPY)
       continue;
+
+    log_level = ret->video_streams[i].com.auto_copy ?
+      BG_LOG_INFO : BG_LOG_WARNING;
+    
+    /* Check if the stream needs processing */
+    if(ret->video_streams[i].com.auto_copy &&
+       has_filters(ret->transcoder_track->video_streams[i].filter_section,
+                   "video_filters"))
+      {
+      bg_log(log_level, LOG_DOMAIN,
+             "Not copying video stream %d: Filters enabled", i+1);
+      ret->video_streams[i].com.action = STREAM_ACTION_TRANSCODE;
+      continue;
+      }
     
     /* Check if we can read compressed data */
     if(!ret->in_plugin->get_video_compression_info ||
        !ret->in_plugin->get_video_compression_info(ret->in_handle->priv,
                                                    i, &ret->video_streams[i].com.ci))
       {
-      bg_log(BG_LOG_WARNING, LOG_DOMAIN, "Video stream %d cannot be read compressed", i+1);
+      bg_log(log_level, LOG_DOMAIN, "Video stream %d cannot be read compressed", i+1);
       ret->video_streams[i].com.action = STREAM_ACTION_TRANSCODE;
       continue;
       }
@@ -2251,10 +2532,10 @@ static void check_compressed(bg_transcoder_t * ret)
     /* Check if we need to blend text subtitles */
     for(j = 0; j < ret->num_text_streams; j++)
       {
-      if((ret->text_streams[i].com.com.action == STREAM_ACTION_BLEND) &&
-         (ret->text_streams[i].com.video_stream == i))
+      if((ret->text_streams[j].com.com.action == STREAM_ACTION_BLEND) &&
+         (ret->text_streams[j].com.video_stream == i))
         {
-        bg_log(BG_LOG_WARNING, LOG_DOMAIN,
+        bg_log(log_level, LOG_DOMAIN,
                "Not copying video stream %d: Will blend subtitles", i+1);
         ret->video_streams[i].com.action = STREAM_ACTION_TRANSCODE;
         break;
@@ -2266,10 +2547,10 @@ static void check_compressed(bg_transcoder_t * ret)
     /* Check if we need to blend overlay subtitles */
     for(j = 0; j < ret->num_overlay_streams; j++)
       {
-      if((ret->overlay_streams[i].com.action == STREAM_ACTION_BLEND) &&
-         (ret->overlay_streams[i].video_stream == i))
+      if((ret->overlay_streams[j].com.action == STREAM_ACTION_BLEND) &&
+         (ret->overlay_streams[j].video_stream == i))
         {
-        bg_log(BG_LOG_WARNING, LOG_DOMAIN,
+        bg_log(log_level, LOG_DOMAIN,
                "Not copying video stream %d: Will blend subtitles", i+1);
         ret->video_streams[i].com.action = STREAM_ACTION_TRANSCODE;
         }
@@ -2283,7 +2564,7 @@ static void check_compressed(bg_transcoder_t * ret)
                                            &ret->track_info->video_streams[i].format,
                                            &ret->video_streams[i].com.ci))
       {
-      bg_log(BG_LOG_WARNING, LOG_DOMAIN, "Video stream %d cannot be written compressed", i+1);
+      bg_log(log_level, LOG_DOMAIN, "Video stream %d cannot be written compressed", i+1);
       ret->video_streams[i].com.action = STREAM_ACTION_TRANSCODE;
       continue;
       }
@@ -2374,6 +2655,123 @@ static void create_streams(bg_transcoder_t * ret,
     }
   }
 
+/* Copied video streams can only start cleanly at a keyframe. If
+   requested, skip packets up to the first keyframe at or after the
+   start time and move the start time there, so the decoded and copied
+   streams stay in sync */
+
+static gavl_time_t skip_to_keyframe(video_stream_t * s, gavl_time_t start_time)
+  {
+  gavl_time_t time;
+  
+  while(1)
+    {
+    if(!s->have_packet &&
+       !s->com.in_plugin->read_video_packet(s->com.in_handle->priv,
+                                            s->com.in_index,
+                                            &s->com.packet))
+      {
+      s->have_packet = 0;
+      return GAVL_TIME_UNDEFINED;
+      }
+    s->have_packet = 0;
+    
+    if(!(s->com.packet.flags & GAVL_PACKET_KEYFRAME))
+      continue;
+
+    time = gavl_time_unscale(s->in_format.timescale, s->com.packet.pts);
+    if(time >= start_time)
+      {
+      s->have_packet = 1;
+      return time;
+      }
+    }
+  return GAVL_TIME_UNDEFINED;
+  }
+
+static int align_start_time(bg_transcoder_t * ret)
+  {
+  int i, done = 0;
+  video_stream_t * s;
+  gavl_time_t time;
+  gavl_time_t start_time;
+  char str1[GAVL_TIME_STRING_LEN];
+  char str2[GAVL_TIME_STRING_LEN];
+  
+  if(ret->start_time == GAVL_TIME_UNDEFINED)
+    return 1;
+  
+  start_time = ret->start_time;
+
+  for(i = 0; i < ret->num_video_streams; i++)
+    ret->video_streams[i].have_packet = 0;
+  
+  /* Explicitly copied streams are cut at the start time unless
+     aligning was requested. Keep the first packet for the output */
+  for(i = 0; i < ret->num_video_streams; i++)
+    {
+    s = &ret->video_streams[i];
+    
+    if(!s->com.do_copy || s->com.auto_copy || s->align_start)
+      continue;
+    
+    if(s->com.in_plugin->read_video_packet(s->com.in_handle->priv,
+                                           s->com.in_index,
+                                           &s->com.packet))
+      {
+      s->have_packet = 1;
+      if(!(s->com.packet.flags & GAVL_PACKET_KEYFRAME))
+        bg_log(BG_LOG_WARNING, LOG_DOMAIN,
+               "Start time is not on a keyframe, copied video stream %d starts with an incomplete GOP",
+               i+1);
+      }
+    }
+  
+  /* Repeat until all aligned streams have a keyframe at the same
+     (or a later) time. Automatically copied streams are only copied
+     if they have a keyframe at the start time (see check_copy_start()) */
+  while(!done)
+    {
+    done = 1;
+    for(i = 0; i < ret->num_video_streams; i++)
+      {
+      if(!ret->video_streams[i].com.do_copy ||
+         (!ret->video_streams[i].com.auto_copy &&
+          !ret->video_streams[i].align_start))
+        continue;
+
+      if(ret->video_streams[i].have_packet &&
+         (gavl_time_unscale(ret->video_streams[i].in_format.timescale,
+                            ret->video_streams[i].com.packet.pts) >= start_time))
+        continue;
+      
+      time = skip_to_keyframe(&ret->video_streams[i], start_time);
+      if(time == GAVL_TIME_UNDEFINED)
+        {
+        bg_log(BG_LOG_ERROR, LOG_DOMAIN,
+               "No keyframe found after start point in video stream %d",
+               i+1);
+        return 0;
+        }
+      if(time > start_time)
+        {
+        start_time = time;
+        done = 0;
+        }
+      }
+    }
+
+  if(start_time > ret->start_time)
+    {
+    gavl_time_prettyprint(ret->start_time, str1);
+    gavl_time_prettyprint(start_time, str2);
+    bg_log(BG_LOG_INFO, LOG_DOMAIN,
+           "Moving start time from %s to next keyframe at %s", str1, str2);
+    ret->start_time = start_time;
+    }
+  return 1;
+  }
+
 static int start_input(bg_transcoder_t * ret)
   {
   int i;
@@ -2731,6 +3129,7 @@ static int init_encoder(bg_transcoder_t * ret)
                                                plugin to get the final output format */
       {
       add_video_stream(&ret->video_streams[i], ret);
+      add_video_rungs(&ret->video_streams[i], ret);
       set_video_pass(ret, i);
       }
     else if(ret->video_streams[i].com.do_copy)
@@ -2772,6 +3171,9 @@ static int init_audio_converter(audio_stream_t * ret, bg_transcoder_t * t)
 
 static int init_video_converter(video_stream_t * ret, bg_transcoder_t * t)
   {
+  int i;
+  video_rung_t * r;
+  
   bg_encoder_get_video_format(t->enc,
                               ret->com.out_index, &ret->out_format);
   
@@ -2786,6 +3188,33 @@ static int init_video_converter(video_stream_t * ret, bg_transcoder_t * t)
     // fprintf(stderr, "Created video frame %p %p\n", ret->frame, ret->frame->planes[0]);
     }
   gavl_video_frame_clear(ret->frame, &ret->out_format);
+
+  /* Additional sizes */
+  
+  for(i = 0; i < ret->num_rungs; i++)
+    {
+    r = &ret->rungs[i];
+    bg_encoder_get_video_format(t->enc, r->out_index, &r->format);
+
+    if(!r->cnv)
+      r->cnv = gavl_video_converter_create();
+    gavl_video_options_copy(gavl_video_converter_get_options(r->cnv),
+                            ret->options.opt);
+    
+    r->do_convert = gavl_video_converter_init(r->cnv,
+                                              i ? &ret->rungs[i-1].format :
+                                              &ret->out_format,
+                                              &r->format);
+    if(r->do_convert < 0)
+      {
+      bg_log(BG_LOG_ERROR, LOG_DOMAIN,
+             "Cannot initialize video converter for size %dx%d",
+             r->format.image_width, r->format.image_height);
+      return 0;
+      }
+    if(r->do_convert && !r->frame)
+      r->frame = gavl_video_frame_create(&r->format);
+    }
   
   return 1;
   }
@@ -3001,6 +3430,92 @@ static void init_normalize(bg_transcoder_t * ret)
     }
   }
 
+static void close_input(bg_transcoder_t * t)
+  {
+  if(t->pp_only)
+    return;
+  
+  if(t->in_plugin)
+    {
+    if(t->in_plugin->stop)
+      t->in_plugin->stop(t->in_handle->priv);
+    t->in_plugin->close(t->in_handle->priv);
+    }
+  if(t->in_handle)
+    bg_plugin_unref(t->in_handle);
+  t->in_handle = NULL;
+  }
+
+/* Automatically copied video streams are transcoded if the start
+   time is not on a keyframe. Checking this needs a started input, so
+   the input is opened again afterwards */
+
+static int check_copy_start(bg_transcoder_t * ret)
+  {
+  int i;
+  int num = 0;
+  video_stream_t * s;
+  gavl_time_t start_time;
+  gavl_time_t time;
+  gavl_time_t duration;
+  
+  if(ret->start_time == GAVL_TIME_UNDEFINED)
+    return 1;
+  
+  for(i = 0; i < ret->num_video_streams; i++)
+    {
+    if((ret->video_streams[i].com.action == STREAM_ACTION_COPY) &&
+       ret->video_streams[i].com.auto_copy)
+      num++;
+    }
+  if(!num)
+    return 1;
+
+  /* The seek changes the start time */
+  start_time = ret->start_time;
+  
+  /* The last pass copies the streams */
+  ret->pass = ret->total_passes;
+  setup_pass(ret);
+  
+  if(!start_input(ret))
+    return 0;
+
+  set_input_formats(ret);
+  
+  for(i = 0; i < ret->num_video_streams; i++)
+    {
+    s = &ret->video_streams[i];
+    
+    if(!s->com.do_copy || !s->com.auto_copy)
+      continue;
+
+    s->have_packet = 0;
+    time = skip_to_keyframe(s, start_time);
+    s->have_packet = 0;
+    
+    /* The keyframe must be the frame displayed at the start time */
+    duration = s->com.packet.duration;
+    if(duration <= 0)
+      duration = s->in_format.frame_duration;
+    
+    if((time == GAVL_TIME_UNDEFINED) ||
+       (time - start_time >= gavl_time_unscale(s->in_format.timescale,
+                                               duration)))
+      {
+      bg_log(BG_LOG_INFO, LOG_DOMAIN,
+             "Not copying video stream %d: Start time is not on a keyframe",
+             i+1);
+      s->com.action = STREAM_ACTION_TRANSCODE;
+      s->com.do_copy = 0;
+      }
+    }
+  
+  close_input(ret);
+  ret->start_time = start_time;
+  return open_input(ret);
+  }
+
 int bg_transcoder_init(bg_transcoder_t * ret,
                        bg_plugin_registry_t * plugin_reg,
                        bg_transcoder_track_t * track)
@@ -3051,6 +3566,12 @@ int bg_transcoder_init(bg_transcoder_t * ret,
   
   /* Check how many passes we must do */
   check_passes(ret);
+
+  if(!check_copy_start(ret))
+    goto fail;
+
+  /* Streams might be transcoded now */
+  check_passes(ret);
   ret->pass = 1;
 
   /* Set up this pass */
@@ -3066,6 +3587,9 @@ int bg_transcoder_init(bg_transcoder_t * ret,
     goto fail;
 
   set_input_formats(ret);
+
+  if(!align_start_time(ret))
+    goto fail;
   
   
   /* Set up the streams in the encoders */
@@ -3135,8 +3659,27 @@ static void cleanup_audio_stream(audio_stream_t * s)
 
 static void cleanup_video_stream(video_stream_t * s)
   {
+  int i;
   cleanup_stream(&s->com);
 
+  if(s->rungs)
+    {
+    for(i = 0; i < s->num_rungs; i++)
+      {
+      gavl_metadata_free(&s->rungs[i].m);
+      if(s->rungs[i].cnv)
+        gavl_video_converter_destroy(s->rungs[i].cnv);
+      if(s->rungs[i].frame)
+        gavl_video_frame_destroy(s->rungs[i].frame);
+      if(s->rungs[i].stats_file)
+        {
+        remove(s->rungs[i].stats_file);
+        free(s->rungs[i].stats_file);
+        }
+      }
+    free(s->rungs);
+    }
+
   /* Free all resources */
 
   if(s->frame)
@@ -3191,25 +3734,9 @@ static void reset_streams(bg_transcoder_t * t)
     }
   }
 
-static void close_input(bg_transcoder_t * t)
-  {
-  if(t->pp_only)
-    return;
-  
-  if(t->in_plugin)
-    {
-    if(t->in_plugin->stop)
-      t->in_plugin->stop(t->in_handle->priv);
-    t->in_plugin->close(t->in_handle->priv);
-    }
-  if(t->in_handle)
-    bg_plugin_unref(t->in_handle);
-  t->in_handle = NULL;
-  }
-
 /* Switch to next pass */
 
-static void next_pass(bg_transcoder_t * t)
+static int next_pass(bg_transcoder_t * t)
   {
   char * tmp_string;
 
@@ -3227,22 +3754,29 @@ static void next_pass(bg_transcoder_t * t)
   t->time = 0;
   t->last_seconds = 0.0;
   
-  open_input(t);
+  if(!open_input(t))
+    return 0;
   create_encoder(t);
   
   /* Decide, which stream will be en/decoded*/
   setup_pass(t);
 
-  start_input(t);
+  if(!start_input(t))
+    return 0;
 
   /* Some streams don't have this already */
   set_input_formats(t);
+
+  if(!align_start_time(t))
+    return 0;
   
   /* Initialize encoding plugins */
-  init_encoder(t);
+  if(!init_encoder(t))
+    return 0;
 
   /* Set formats */
-  init_converters(t);
+  if(!init_converters(t))
+    return 0;
 
   /* Init normalizing */
   init_normalize(t);
@@ -3254,6 +3788,7 @@ static void next_pass(bg_transcoder_t * t)
   free(tmp_string);
 
   gavl_timer_start(t->timer);
+  return 1;
   }
 
 /*
@@ -3336,7 +3871,13 @@ int bg_transcoder_iteration(bg_transcoder_t * t)
       {
       log_transcoding_time(t);
       
-      next_pass(t);
+      if(!next_pass(t))
+        {
+        bg_log(BG_LOG_ERROR, LOG_DOMAIN, "Starting pass %d failed", t->pass);
+        t->state = TRANSCODER_STATE_ERROR;
+        bg_transcoder_send_msg_error(t->message_queues);
+        return 0;
+        }
       return 1;
       }
     else
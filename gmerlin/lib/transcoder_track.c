@@ -1310,14 +1310,21 @@ static const bg_parameter_info_t general_parameters_video[] =
       .name =        "action",
       .long_name =   TRS("Action"),
       .type =        BG_PARAMETER_STRINGLIST,
-      .multi_names = (char const *[]){ "transcode", "copy", "forget", NULL },
+      .multi_names = (char const *[]){ "transcode", "auto", "copy", "forget", NULL },
       .multi_labels =  (char const *[]){ TRS("Transcode"),
+                                         TRS("Copy if compatible"),
                                          TRS("Copy (if possible)"),
                                          TRS("Forget"), NULL },
       .val_default = { .val_str = "transcode" },
-      .help_string = TRS("Choose the desired action for the stream. If copying is not possible, the stream will be transcoded"),
+      .help_string = TRS("Choose the desired action for the stream. If copying is not possible, the stream will be transcoded. \"Copy if compatible\" copies the stream only if no filters or format changes are configured for it and if the start time of the track is on a keyframe"),
 
     },
+    {
+      .name =       "copy_align_start",
+      .long_name =  TRS("Move start time to the next keyframe"),
+      .type =       BG_PARAMETER_CHECKBUTTON,
+      .help_string = TRS("If this stream is copied and the start time of the track is not on a keyframe, move the start time of the whole track to the next keyframe. Otherwise the copied stream starts with an incomplete GOP, which might not be decodable."),
+    },
     {
       .name =       "twopass",
       .long_name =  TRS("Enable 2-pass encoding"),
@@ -1325,6 +1332,24 @@ static const bg_parameter_info_t general_parameters_video[] =
       .help_string = TRS("Encode this stream in 2 passes, i.e. analyze it first and do the final\
  transcoding in the second pass. This enables higher quality within the given bitrate constraints but roughly doubles the video encoding time."),
     },
+    {
+      .name =       "ladder_rungs",
+      .long_name =  TRS("Additional sizes"),
+      .type =       BG_PARAMETER_INT,
+      .val_min =    { .val_i = 0 },
+      .val_max =    { .val_i = 3 },
+      .val_default = { .val_i = 0 },
+      .help_string = TRS("Encode this stream additionally in up to 3 smaller sizes (e.g. for adaptive streaming). Each size is scaled from the previous one. The stream is decoded only once and all sizes are encoded with the same encoder settings from the same frames, so encoders with a fixed keyframe interval place the keyframes at the same positions. If the format supports only one video stream, each size is written to a separate file. Bitrates in the encoder settings are scaled by the number of pixels."),
+    },
+    {
+      .name =       "ladder_scale",
+      .long_name =  TRS("Scale factor for additional sizes (%)"),
+      .type =       BG_PARAMETER_INT,
+      .val_min =    { .val_i = 10 },
+      .val_max =    { .val_i = 90 },
+      .val_default = { .val_i = 50 },
+      .help_string = TRS("Width and height of each additional size in percent of the previous size"),
+    },
     BG_GAVL_PARAM_CONVERSION_QUALITY,
     BG_GAVL_PARAM_ALPHA,
     BG_GAVL_PARAM_RESAMPLE_CHROMA,
@@ -1339,12 +1364,13 @@ static const bg_parameter_info_t general_parameters_audio[] =
       .long_name =   TRS("Action"),
       .type =        BG_PARAMETER_STRINGLIST,
 
-      .multi_names = (char const *[]){ "transcode", "copy", "forget", NULL },
+      .multi_names = (char const *[]){ "transcode", "auto", "copy", "forget", NULL },
       .multi_labels =  (char const *[]){ TRS("Transcode"),
+                                         TRS("Copy if compatible"),
                                          TRS("Copy (if possible)"),
                                          TRS("Forget"), NULL },
       .val_default = { .val_str = "transcode" },
-      .help_string = TRS("Choose the desired action for the stream. If copying is not possible, the stream will be transcoded"),
+      .help_string = TRS("Choose the desired action for the stream. If copying is not possible, the stream will be transcoded. \"Copy if compatible\" copies the stream only if no filters or format changes are configured for it"),
     },
     {
       .name =        "in_language",
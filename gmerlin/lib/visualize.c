@@ -34,6 +34,8 @@
 #include <gmerlin/msgqueue.h>
 #include <unistd.h>
 
+#include <bgshm.h>
+
 #include <pthread.h>
 #include <sys/signal.h>
 
@@ -81,6 +83,16 @@ struct bg_visualizer_s
   const char * display_string;
 
   bg_ov_callbacks_t * cb;
+
+  /* Audio frames are passed in shared memory */
+  bg_shm_pool_t * shm_pool;
+  int shm_size;
+  gavl_audio_frame_t * shm_frame;
+
+  /* Pools from previous formats, which still have segments queued
+     for the slave */
+  bg_shm_pool_t ** old_shm_pools;
+  int num_old_shm_pools;
   };
 
 static int proc_write_func(void * data, const uint8_t * ptr, int len)
@@ -138,6 +150,91 @@ static int read_message(bg_visualizer_t * v)
   return 1;
   }
 
+/* Segments are unlinked when their pool is destroyed. A pool is
+   therefore kept until the slave has released all of its segments */
+
+static void free_old_shm(bg_visualizer_t * v, int force)
+  {
+  int i = 0;
+  while(i < v->num_old_shm_pools)
+    {
+    if(force || !bg_shm_pool_num_used(v->old_shm_pools[i]))
+      {
+      bg_shm_pool_destroy(v->old_shm_pools[i]);
+      if(i < v->num_old_shm_pools - 1)
+        memmove(v->old_shm_pools + i, v->old_shm_pools + i + 1,
+                (v->num_old_shm_pools - 1 - i) * sizeof(*v->old_shm_pools));
+      v->num_old_shm_pools--;
+      }
+    else
+      i++;
+    }
+  }
+
+static void init_shm(bg_visualizer_t * v)
+  {
+  if(v->shm_pool)
+    {
+    v->old_shm_pools = realloc(v->old_shm_pools,
+                               (v->num_old_shm_pools+1) *
+                               sizeof(*v->old_shm_pools));
+    v->old_shm_pools[v->num_old_shm_pools] = v->shm_pool;
+    v->num_old_shm_pools++;
+    v->shm_pool = NULL;
+    }
+  free_old_shm(v, 0);
+  
+  v->shm_size = v->audio_format.samples_per_frame *
+    v->audio_format.num_channels *
+    gavl_bytes_per_sample(v->audio_format.sample_format);
+  
+  if(v->shm_size > 0)
+    v->shm_pool = bg_shm_pool_create(v->shm_size, 1);
+  }
+
+static void set_audio_format(bg_visualizer_t * v)
+  {
+  init_shm(v);
+  bg_msg_set_id(v->msg, BG_VIS_MSG_AUDIO_FORMAT);
+  bg_msg_set_arg_audio_format(v->msg, 0, &v->audio_format);
+  bg_msg_set_arg_int(v->msg, 1, v->shm_size);
+  write_message(v);
+  }
+
+/* Copy the samples into a shared memory segment and send only the id */
+
+static int write_audio_shm(bg_visualizer_t * v,
+                           const gavl_audio_frame_t * frame)
+  {
+  bg_shm_t * seg;
+
+  if(v->num_old_shm_pools)
+    free_old_shm(v, 0);
+  
+  if(!v->shm_pool ||
+     (frame->valid_samples > v->audio_format.samples_per_frame) ||
+     !(seg = bg_shm_pool_get_write(v->shm_pool)))
+    return 0;
+
+  if(!v->shm_frame)
+    v->shm_frame = gavl_audio_frame_create(NULL);
+
+  /* Channel pointers are set according to valid_samples */
+  v->shm_frame->valid_samples = v->audio_format.samples_per_frame;
+  gavl_audio_frame_set_channels(v->shm_frame, &v->audio_format,
+                                bg_shm_get_buffer(seg, NULL));
+  
+  gavl_audio_frame_copy(&v->audio_format, v->shm_frame, frame,
+                        0, 0, frame->valid_samples, frame->valid_samples);
+  
+  bg_msg_set_id(v->msg, BG_VIS_MSG_AUDIO_SHM);
+  bg_msg_set_arg_int(v->msg, 0, bg_shm_get_id(seg));
+  bg_msg_set_arg_int(v->msg, 1, frame->valid_samples);
+  bg_msg_set_arg_time(v->msg, 2, frame->timestamp);
+  write_message(v);
+  return 1;
+  }
+
 static void set_gain(bg_visualizer_t * v)
   {
   bg_msg_set_id(v->msg, BG_VIS_MSG_GAIN);
@@ -256,9 +353,7 @@ static int visualizer_start(bg_visualizer_t * v)
   free(command);
   
   /* Audio format */
-  bg_msg_set_id(v->msg, BG_VIS_MSG_AUDIO_FORMAT);
-  bg_msg_set_arg_audio_format(v->msg, 0, &v->audio_format);
-  write_message(v);
+  set_audio_format(v);
   
   /* default ov parameters */
   if(v->ov_info->parameters &&
@@ -329,6 +424,17 @@ void bg_visualizer_destroy(bg_visualizer_t * v)
   {
   pthread_mutex_destroy(&v->mutex);
   bg_msg_destroy(v->msg);
+
+  if(v->shm_pool)
+    bg_shm_pool_destroy(v->shm_pool);
+  free_old_shm(v, 1);
+  if(v->old_shm_pools)
+    free(v->old_shm_pools);
+  if(v->shm_frame)
+    {
+    gavl_audio_frame_null(v->shm_frame);
+    gavl_audio_frame_destroy(v->shm_frame);
+    }
   
   free(v);
   }
@@ -466,11 +572,7 @@ void bg_visualizer_set_audio_format(bg_visualizer_t * v,
   gavl_audio_format_copy(&v->audio_format, format);
 
   if(v->proc)
-    {
-    bg_msg_set_id(v->msg, BG_VIS_MSG_AUDIO_FORMAT);
-    bg_msg_set_arg_audio_format(v->msg, 0, &v->audio_format);
-    write_message(v);
-    }
+    set_audio_format(v);
   
   pthread_mutex_unlock(&v->mutex);
   
@@ -588,7 +690,7 @@ void bg_visualizer_update(bg_visualizer_t * v,
     return;
     }
 
-  if(frame)
+  if(frame && !write_audio_shm(v, frame))
     {
     bg_msg_set_id(v->msg, BG_VIS_MSG_AUDIO_DATA);
     if(!bg_msg_write_audio_frame(v->msg,
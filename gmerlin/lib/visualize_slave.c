@@ -33,7 +33,7 @@
 #include <visualize_priv.h>
 #include <gmerlin/utils.h>
 
-
+#include <bgshm.h>
 
 #include <gmerlin/log.h>
 
@@ -811,6 +811,9 @@ int main(int argc, char ** argv)
   bg_msg_queue_t * log_queue;
   int counter = 0.0;
   bg_parameter_type_t parameter_type;
+  bg_shm_pool_t * shm_pool = NULL;
+  bg_shm_t * shm_segment;
+  gavl_audio_frame_t * shm_frame;
   gavl_dsp_context_t * ctx;
   int big_endian;
   int result;
@@ -831,7 +834,8 @@ int main(int argc, char ** argv)
   s = bg_visualizer_slave_create(argc, argv);
 
   msg = bg_msg_create();
-
+  shm_frame = gavl_audio_frame_create(NULL);
+  
   keep_going = 1;
   
   while(keep_going)
@@ -851,6 +855,34 @@ int main(int argc, char ** argv)
         if(audio_frame)
           gavl_audio_frame_destroy(audio_frame);
         audio_frame = gavl_audio_frame_create(&audio_format);
+
+        if(shm_pool)
+          {
+          bg_shm_pool_destroy(shm_pool);
+          shm_pool = NULL;
+          }
+        if(bg_msg_get_arg_int(msg, 1) > 0)
+          shm_pool = bg_shm_pool_create(bg_msg_get_arg_int(msg, 1), 0);
+        break;
+      case BG_VIS_MSG_AUDIO_SHM:
+        if(!shm_pool ||
+           !(shm_segment = bg_shm_pool_get_read(shm_pool,
+                                                bg_msg_get_arg_int(msg, 0))))
+          break;
+
+        shm_frame->valid_samples = audio_format.samples_per_frame;
+        gavl_audio_frame_set_channels(shm_frame, &audio_format,
+                                      bg_shm_get_buffer(shm_segment, NULL));
+        shm_frame->valid_samples = bg_msg_get_arg_int(msg, 1);
+        shm_frame->timestamp = bg_msg_get_arg_time(msg, 2);
+        
+        if(pthread_mutex_trylock(&s->running_mutex))
+          audio_buffer_put(s->audio_buffer, shm_frame);
+        else
+          pthread_mutex_unlock(&s->running_mutex);
+
+        /* Segment can be reused by the visualizer */
+        bg_shm_unref(shm_segment);
         break;
       case BG_VIS_MSG_AUDIO_DATA:
         bg_msg_read_audio_frame(ctx,
@@ -966,6 +998,11 @@ int main(int argc, char ** argv)
   bg_visualizer_slave_destroy(s);
   bg_msg_free(msg);
 
+  if(shm_pool)
+    bg_shm_pool_destroy(shm_pool);
+  gavl_audio_frame_null(shm_frame);
+  gavl_audio_frame_destroy(shm_frame);
+
   gavl_dsp_context_destroy(ctx);
 
   return 0;
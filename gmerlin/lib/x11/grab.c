@@ -37,6 +37,10 @@
 #include <X11/extensions/Xfixes.h>
 #endif
 
+#ifdef HAVE_XDAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
+
 #include <sys/shm.h>
 
 #define DRAW_CURSOR         (1<<0)
@@ -44,6 +48,7 @@
 #define WIN_ONTOP           (1<<2)
 #define WIN_STICKY          (1<<3)
 #define DISABLE_SCREENSAVER (1<<4)
+#define USE_DAMAGE          (1<<5)
 
 #define LOG_DOMAIN "x11grab"
 #include <gmerlin/log.h>
@@ -52,6 +57,15 @@
 
 #define MAX_CURSOR_SIZE 32
 
+/* With XDamage: Grab the whole area if more than 1/DAMAGE_FULL_RATIO of
+   it changed or if there are more than DAMAGE_MAX_RECTS rectangles */
+#define DAMAGE_FULL_RATIO 2
+#define DAMAGE_MAX_RECTS  64
+
+/* With XDamage: Grab the whole area in regular intervals because
+   not all clients report damage (e.g. direct rendering) */
+#define DAMAGE_REFRESH_SECONDS 5
+
 static const bg_parameter_info_t parameters[] = 
   {
     {
@@ -77,6 +91,13 @@ static const bg_parameter_info_t parameters[] =
       .type = BG_PARAMETER_CHECKBUTTON,
       .val_default = { .val_i = 1 },
     },
+    {
+      .name =      "damage",
+      .long_name = TRS("Grab changed regions only"),
+      .type = BG_PARAMETER_CHECKBUTTON,
+      .val_default = { .val_i = 1 },
+      .help_string = TRS("Use the XDamage extension to read only the changed parts of the screen. This reduces the CPU load for mostly static screen contents."),
+    },
     {
       .name =      "disable_screensaver",
       .long_name = TRS("Disable screensaver"),
@@ -184,9 +205,31 @@ struct bg_x11_grab_window_s
 
   int cursor_x;
   int cursor_y;
-  
+
+  /* Area covered by the cursor in the last frame */
   gavl_rectangle_i_t cursor_rect;
 
+  /* Area changed in the last frame */
+  int changed;
+  gavl_rectangle_i_t changed_rect;
+
+#ifdef HAVE_XDAMAGE
+  int use_xdamage;
+  int xdamage_eventbase;
+  Damage damage;
+  XserverRegion region;
+  
+  int full_grab;
+  int frames_since_full;
+  int full_interval;
+  
+  int last_x, last_y;
+  
+  /* Shared memory for changed rectangles */
+  XShmSegmentInfo rect_shminfo;
+  int have_rect_shm;
+#endif
+
   
   gavl_overlay_blend_context_t * blend;
 
@@ -262,6 +305,13 @@ void bg_x11_grab_window_set_parameter(void * data, const char * name,
     else
       win->cfg_flags &= ~DRAW_CURSOR;
     }
+  else if(!strcmp(name, "damage"))
+    {
+    if(val->val_i)
+      win->cfg_flags |= USE_DAMAGE;
+    else
+      win->cfg_flags &= ~USE_DAMAGE;
+    }
   else if(!strcmp(name, "disable_screensaver"))
     {
     if(val->val_i)
@@ -464,6 +514,9 @@ static int realize_window(bg_x11_grab_window_t * ret)
 #ifdef HAVE_XFIXES
   int xfixes_errorbase;
 #endif
+#ifdef HAVE_XDAMAGE
+  int xdamage_errorbase;
+#endif
   
   /* Open Display */
   ret->dpy = XOpenDisplay(NULL);
@@ -492,6 +545,14 @@ static int realize_window(bg_x11_grab_window_t * ret)
   else
 #endif
     create_cursor_static(ret);
+
+#ifdef HAVE_XDAMAGE
+  /* Regions are XFixes objects */
+  if(ret->use_xfixes)
+    ret->use_xdamage = XDamageQueryExtension(ret->dpy,
+                                             &ret->xdamage_eventbase,
+                                             &xdamage_errorbase);
+#endif
   
   bg_x11_window_get_coords(ret->dpy, ret->root,
                            NULL, NULL,
@@ -566,7 +627,12 @@ static void handle_events(bg_x11_grab_window_t * win)
       continue;
       }
 #endif
-
+#ifdef HAVE_XDAMAGE
+    /* Damage is fetched in bg_x11_grab_window_grab() */
+    if(win->use_xdamage &&
+       (evt.type == win->xdamage_eventbase + XDamageNotify))
+      continue;
+#endif
     
     switch(evt.type)
       {
@@ -626,6 +692,38 @@ static void handle_events(bg_x11_grab_window_t * win)
     }
   }
 
+#ifdef HAVE_XDAMAGE
+static int create_rect_shm(bg_x11_grab_window_t * win)
+  {
+  win->rect_shminfo.shmid = shmget(IPC_PRIVATE,
+                                   win->image->bytes_per_line * win->image->height,
+                                   IPC_CREAT|0777);
+  if(win->rect_shminfo.shmid == -1)
+    return 0;
+  
+  win->rect_shminfo.shmaddr = shmat(win->rect_shminfo.shmid, 0, 0);
+
+  if(!XShmAttach(win->dpy, &win->rect_shminfo))
+    {
+    shmdt(win->rect_shminfo.shmaddr);
+    shmctl(win->rect_shminfo.shmid, IPC_RMID, NULL);
+    return 0;
+    }
+  win->have_rect_shm = 1;
+  return 1;
+  }
+
+static void destroy_rect_shm(bg_x11_grab_window_t * win)
+  {
+  if(!win->have_rect_shm)
+    return;
+  XShmDetach(win->dpy, &win->rect_shminfo);
+  shmdt(win->rect_shminfo.shmaddr);
+  shmctl(win->rect_shminfo.shmid, IPC_RMID, NULL);
+  win->have_rect_shm = 0;
+  }
+#endif
+
 int bg_x11_grab_window_init(bg_x11_grab_window_t * win,
                             gavl_video_format_t * format)
   {
@@ -636,6 +734,13 @@ int bg_x11_grab_window_init(bg_x11_grab_window_t * win,
     if(!realize_window(win))
       return 0;
     }
+
+#ifdef HAVE_XDAMAGE
+  if(!win->use_xdamage)
+    win->flags &= ~USE_DAMAGE;
+#else
+  win->flags &= ~USE_DAMAGE;
+#endif
   
   if(win->flags & GRAB_ROOT)
     {
@@ -717,6 +822,30 @@ int bg_x11_grab_window_init(bg_x11_grab_window_t * win,
                               win->frame->strides[0]);
     }
 
+#ifdef HAVE_XDAMAGE
+  if(win->flags & USE_DAMAGE)
+    {
+    if(win->use_shm && !create_rect_shm(win))
+      {
+      bg_log(BG_LOG_WARNING, LOG_DOMAIN,
+             "Couldn't get shared memory segment, disabling XDamage");
+      win->flags &= ~USE_DAMAGE;
+      }
+    else
+      {
+      win->damage = XDamageCreate(win->dpy, win->root,
+                                  XDamageReportNonEmpty);
+      win->region = XFixesCreateRegion(win->dpy, NULL, 0);
+      win->full_grab = 1;
+      win->full_interval = (int)(win->fps * DAMAGE_REFRESH_SECONDS);
+      bg_log(BG_LOG_INFO, LOG_DOMAIN, "Using XDamage for grabbing");
+      }
+    }
+#endif
+  
+  win->cursor_rect.w = 0;
+  win->cursor_rect.h = 0;
+  
   if(win->flags & DRAW_CURSOR)
     {
     gavl_overlay_blend_context_init(win->blend,
@@ -768,6 +897,15 @@ void bg_x11_grab_window_close(bg_x11_grab_window_t * win)
 
   win->frame = NULL;
   win->image = NULL;
+
+#ifdef HAVE_XDAMAGE
+  if(win->flags & USE_DAMAGE)
+    {
+    XDamageDestroy(win->dpy, win->damage);
+    XFixesDestroyRegion(win->dpy, win->region);
+    destroy_rect_shm(win);
+    }
+#endif
   
   if(!(win->flags & GRAB_ROOT))
     {
@@ -832,8 +970,12 @@ static void get_cursor_xfixes(bg_x11_grab_window_t * win)
   }
 #endif
 
-static void draw_cursor(bg_x11_grab_window_t * win, gavl_rectangle_i_t * rect,
-                        gavl_video_frame_t * frame)
+/* Draw the cursor. rect is the grabbed area, org_x and org_y are the root
+   coordinates of the upper left corner of the frame. Returns 1 if the
+   cursor changed since the last frame. */
+
+static int draw_cursor(bg_x11_grab_window_t * win, gavl_rectangle_i_t * rect,
+                       int org_x, int org_y, gavl_video_frame_t * frame)
   {
   Window root;
   Window child;
@@ -843,28 +985,32 @@ static void draw_cursor(bg_x11_grab_window_t * win, gavl_rectangle_i_t * rect,
   int win_y;
   unsigned int mask;
   int init_blend = 0;
+  int had_cursor = win->cursor_rect.w;
+  
+  win->cursor_rect.w = 0;
+  win->cursor_rect.h = 0;
   
   if(!XQueryPointer(win->dpy, win->root, &root,
                     &child, &root_x,
                     &root_y, &win_x, &win_y,
                     &mask))
-    return;
+    return had_cursor;
   
   /* Bounding box check */
   if(root_x >= rect->x + rect->w + MAX_CURSOR_SIZE)
-    return;
+    return had_cursor;
 
   if(root_x + MAX_CURSOR_SIZE < rect->x)
-    return;
+    return had_cursor;
 
   if(root_y >= rect->y + rect->h + MAX_CURSOR_SIZE)
-    return;
+    return had_cursor;
 
   if(root_y + MAX_CURSOR_SIZE < rect->y)
-    return;
+    return had_cursor;
 
-  win->cursor->dst_x = root_x - rect->x - win->cursor_off_x;
-  win->cursor->dst_y = root_y - rect->y - win->cursor_off_y;
+  win->cursor->dst_x = root_x - org_x - win->cursor_off_x;
+  win->cursor->dst_y = root_y - org_y - win->cursor_off_y;
 
   if((win->cursor->dst_x != win->cursor_x) ||
      (win->cursor->dst_y != win->cursor_y))
@@ -888,7 +1034,211 @@ static void draw_cursor(bg_x11_grab_window_t * win, gavl_rectangle_i_t * rect,
   // fprintf(stderr, "Cursor 2: %d %d\n", win->cursor->dst_x, win->cursor->dst_y);
 
   win->cursor_x = win->cursor->dst_x;
-  win->cursor_x = win->cursor->dst_y;
+  win->cursor_y = win->cursor->dst_y;
+
+  win->cursor_rect.x = win->cursor->dst_x;
+  win->cursor_rect.y = win->cursor->dst_y;
+  win->cursor_rect.w = win->cursor->src_rect.w;
+  win->cursor_rect.h = win->cursor->src_rect.h;
+  gavl_rectangle_i_crop_to_format(&win->cursor_rect, &win->format);
+
+  return init_blend || !had_cursor;
+  }
+
+/* Add a rectangle to the changed area */
+
+static void add_changed(bg_x11_grab_window_t * win,
+                        const gavl_rectangle_i_t * r)
+  {
+  int x2, y2;
+
+  if((r->w <= 0) || (r->h <= 0))
+    return;
+  
+  if(!win->changed)
+    {
+    gavl_rectangle_i_copy(&win->changed_rect, r);
+    win->changed = 1;
+    return;
+    }
+  
+  x2 = win->changed_rect.x + win->changed_rect.w;
+  y2 = win->changed_rect.y + win->changed_rect.h;
+
+  if(x2 < r->x + r->w)
+    x2 = r->x + r->w;
+  if(y2 < r->y + r->h)
+    y2 = r->y + r->h;
+  
+  if(win->changed_rect.x > r->x)
+    win->changed_rect.x = r->x;
+  if(win->changed_rect.y > r->y)
+    win->changed_rect.y = r->y;
+  
+  win->changed_rect.w = x2 - win->changed_rect.x;
+  win->changed_rect.h = y2 - win->changed_rect.y;
+  }
+
+#ifdef HAVE_XDAMAGE
+
+/* Clip r to the grabbed area, return 0 if nothing is left */
+
+static int clip_rect(gavl_rectangle_i_t * r, const gavl_rectangle_i_t * rect)
+  {
+  if(r->x < rect->x)
+    {
+    r->w -= rect->x - r->x;
+    r->x = rect->x;
+    }
+  if(r->y < rect->y)
+    {
+    r->h -= rect->y - r->y;
+    r->y = rect->y;
+    }
+  if(r->x + r->w > rect->x + rect->w)
+    r->w = rect->x + rect->w - r->x;
+  if(r->y + r->h > rect->y + rect->h)
+    r->h = rect->y + rect->h - r->y;
+  
+  return (r->w > 0) && (r->h > 0);
+  }
+
+/* Read a rectangle (in root coordinates) into the frame */
+
+static int get_rect(bg_x11_grab_window_t * win,
+                    const gavl_rectangle_i_t * r,
+                    int dst_x, int dst_y)
+  {
+  int i, bytes;
+  XImage * im;
+  uint8_t * src;
+  uint8_t * dst;
+  
+  if(!win->use_shm)
+    {
+    XGetSubImage(win->dpy, win->root,
+                 r->x, r->y, r->w, r->h,
+                 AllPlanes, ZPixmap, win->image,
+                 dst_x, dst_y);
+    return 1;
+    }
+
+  im = XShmCreateImage(win->dpy, win->visual, win->depth, ZPixmap,
+                       win->rect_shminfo.shmaddr, &win->rect_shminfo,
+                       r->w, r->h);
+  if(!im)
+    return 0;
+  
+  if(!XShmGetImage(win->dpy, win->root, im, r->x, r->y, AllPlanes))
+    {
+    im->data = NULL;
+    XDestroyImage(im);
+    return 0;
+    }
+
+  bytes = r->w * (im->bits_per_pixel / 8);
+  src = (uint8_t*)im->data;
+  dst = win->frame->planes[0] + dst_y * win->frame->strides[0] +
+    dst_x * (im->bits_per_pixel / 8);
+  
+  for(i = 0; i < r->h; i++)
+    {
+    memcpy(dst, src, bytes);
+    src += im->bytes_per_line;
+    dst += win->frame->strides[0];
+    }
+  
+  im->data = NULL;
+  XDestroyImage(im);
+  return 1;
+  }
+
+/* Read the changed parts of rect. org_x and org_y are the root
+   coordinates of the upper left corner of the frame.
+   Returns 0 if the whole area should be grabbed instead. */
+
+static int grab_damage(bg_x11_grab_window_t * win,
+                       const gavl_rectangle_i_t * rect,
+                       int org_x, int org_y)
+  {
+  int i, num;
+  int64_t area = 0;
+  XRectangle * rects;
+  gavl_rectangle_i_t r;
+  int ret = 1;
+  
+  /* Get the damage since the last call */
+  XDamageSubtract(win->dpy, win->damage, None, win->region);
+
+  win->frames_since_full++;
+  
+  if(win->full_grab ||
+     (rect->x != win->last_x) || (rect->y != win->last_y) ||
+     (win->frames_since_full >= win->full_interval))
+    return 0;
+  
+  rects = XFixesFetchRegion(win->dpy, win->region, &num);
+
+  if(num > DAMAGE_MAX_RECTS)
+    ret = 0;
+  else
+    {
+    for(i = 0; i < num; i++)
+      area += (int64_t)rects[i].width * rects[i].height;
+    if(area * DAMAGE_FULL_RATIO > (int64_t)rect->w * rect->h)
+      ret = 0;
+    }
+  
+  if(ret)
+    {
+    for(i = 0; i < num; i++)
+      {
+      r.x = rects[i].x;
+      r.y = rects[i].y;
+      r.w = rects[i].width;
+      r.h = rects[i].height;
+      
+      if(!clip_rect(&r, rect))
+        continue;
+      
+      if(!get_rect(win, &r, r.x - org_x, r.y - org_y))
+        {
+        ret = 0;
+        break;
+        }
+      
+      r.x -= org_x;
+      r.y -= org_y;
+      add_changed(win, &r);
+      }
+    }
+  
+  if(rects)
+    XFree(rects);
+
+  /* Remove the cursor of the last frame */
+  if(ret && win->cursor_rect.w && win->cursor_rect.h)
+    {
+    r.x = win->cursor_rect.x + org_x;
+    r.y = win->cursor_rect.y + org_y;
+    r.w = win->cursor_rect.w;
+    r.h = win->cursor_rect.h;
+    if(clip_rect(&r, rect) &&
+       !get_rect(win, &r, r.x - org_x, r.y - org_y))
+      ret = 0;
+    }
+  
+  return ret;
+  }
+
+#endif
+
+int bg_x11_grab_window_get_changed(bg_x11_grab_window_t * win,
+                                   gavl_rectangle_i_t * rect)
+  {
+  if(win->changed && rect)
+    gavl_rectangle_i_copy(rect, &win->changed_rect);
+  return win->changed;
   }
 
 gavl_source_status_t bg_x11_grab_window_grab(void * win_p,
@@ -898,12 +1248,16 @@ gavl_source_status_t bg_x11_grab_window_grab(void * win_p,
   int crop_right = 0;
   int crop_top = 0;
   int crop_bottom = 0;
+  int org_x, org_y;
   gavl_rectangle_i_t rect;
+  gavl_rectangle_i_t cursor_rect;
   bg_x11_grab_window_t * win = win_p;
   
   handle_events(win);
 
   bg_frame_timer_wait(win->ft);
+
+  win->changed = 0;
   
   /* Crop */
   
@@ -922,12 +1276,8 @@ gavl_source_status_t bg_x11_grab_window_grab(void * win_p,
     if(rect.y + rect.h > win->root_height)
       rect.y = win->root_height - rect.h;
     
-    //    fprintf(stderr, "XShmGetImage %d %d\n", rect.x, rect.y);
-    if(!XShmGetImage(win->dpy, win->root, win->image, rect.x, rect.y, AllPlanes))
-      {
-      bg_log(BG_LOG_ERROR, LOG_DOMAIN, "XShmGetImage failed");
-      return GAVL_SOURCE_EOF;
-      }
+    org_x = rect.x;
+    org_y = rect.y;
     }
   else
     {
@@ -942,27 +1292,68 @@ gavl_source_status_t bg_x11_grab_window_grab(void * win_p,
     if(win->grab_rect.y + win->grab_rect.h > win->root_height)
       crop_bottom = win->grab_rect.y + win->grab_rect.h - win->root_height;
   
-    if(crop_left || crop_right || crop_top || crop_bottom)
-      {
-      gavl_video_frame_clear(win->frame, &win->format);
-      }
-
     gavl_rectangle_i_copy(&rect, &win->grab_rect);
 
     rect.x += crop_left;
     rect.y += crop_top;
     rect.w -= (crop_left + crop_right);
     rect.h -= (crop_top + crop_bottom);
-    
-    XGetSubImage(win->dpy, win->root,
-                 rect.x, rect.y, rect.w, rect.h,
-                 AllPlanes, ZPixmap, win->image,
-                 crop_left, crop_top);
+
+    org_x = win->grab_rect.x;
+    org_y = win->grab_rect.y;
     }
 
-  if(win->flags & DRAW_CURSOR)
-    draw_cursor(win, &rect, win->frame);
+  /* Remember where the cursor was */
+  gavl_rectangle_i_copy(&cursor_rect, &win->cursor_rect);
+  
+#ifdef HAVE_XDAMAGE
+  if(!(win->flags & USE_DAMAGE) ||
+     !grab_damage(win, &rect, org_x, org_y))
+#endif
+    {
+    if(win->use_shm)
+      {
+      //    fprintf(stderr, "XShmGetImage %d %d\n", rect.x, rect.y);
+      if(!XShmGetImage(win->dpy, win->root, win->image, rect.x, rect.y, AllPlanes))
+        {
+        bg_log(BG_LOG_ERROR, LOG_DOMAIN, "XShmGetImage failed");
+        return GAVL_SOURCE_EOF;
+        }
+      }
+    else
+      {
+      if(crop_left || crop_right || crop_top || crop_bottom)
+        gavl_video_frame_clear(win->frame, &win->format);
+      
+      XGetSubImage(win->dpy, win->root,
+                   rect.x, rect.y, rect.w, rect.h,
+                   AllPlanes, ZPixmap, win->image,
+                   crop_left, crop_top);
+      }
 
+    win->changed = 1;
+    win->changed_rect.x = 0;
+    win->changed_rect.y = 0;
+    win->changed_rect.w = win->format.image_width;
+    win->changed_rect.h = win->format.image_height;
+    
+#ifdef HAVE_XDAMAGE
+    win->full_grab = 0;
+    win->frames_since_full = 0;
+    win->last_x = rect.x;
+    win->last_y = rect.y;
+#endif
+    }
+  
+  if(win->flags & DRAW_CURSOR)
+    {
+    if(draw_cursor(win, &rect, org_x, org_y, win->frame))
+      {
+      add_changed(win, &cursor_rect);
+      add_changed(win, &win->cursor_rect);
+      }
+    }
+  
   bg_frame_timer_update(win->ft, win->frame);
   *frame = win->frame;
   return GAVL_SOURCE_OK;
@@ -106,6 +106,12 @@ static gavl_video_source_t * get_video_source_x11(void * priv)
   return x11->src;
   }
 
+static int video_frame_changed_x11(void * priv, gavl_rectangle_i_t * rect)
+  {
+  x11_t * x11 = priv;
+  return bg_x11_grab_window_get_changed(x11->win, rect);
+  }
+
 const bg_recorder_plugin_t the_plugin =
   {
     .common =
@@ -129,6 +135,7 @@ const bg_recorder_plugin_t the_plugin =
     .close =      close_x11,
     .read_video = read_frame_x11,
     .get_video_source = get_video_source_x11,
+    .video_frame_changed = video_frame_changed_x11,
   };
 
 /* Include this into all plugin modules exactly once
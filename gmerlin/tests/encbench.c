@@ -0,0 +1,318 @@
+/*****************************************************************
+ * gmerlin - a general purpose multimedia framework and applications
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/* Benchmark for video encoders: Feeds synthetic frames (a moving box
+   on a gradient) through each video compressor and reports the frames
+   per second for different numbers of encoding threads */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <config.h>
+#include <gmerlin/pluginregistry.h>
+#include <gmerlin/utils.h>
+
+#define NUM_PATTERNS 16
+
+static gavl_video_frame_t * patterns[NUM_PATTERNS];
+
+static void create_patterns(const gavl_video_format_t * format)
+  {
+  int i, x, y;
+  int box_x, box_y, box_size;
+  uint8_t * ptr;
+  gavl_video_format_t rgb_format;
+  gavl_video_frame_t * rgb_frame;
+  gavl_video_converter_t * cnv;
+
+  gavl_video_format_copy(&rgb_format, format);
+  rgb_format.pixelformat = GAVL_RGB_24;
+
+  rgb_frame = gavl_video_frame_create(&rgb_format);
+  cnv = gavl_video_converter_create();
+  gavl_video_converter_init(cnv, &rgb_format, format);
+
+  box_size = format->image_height / 4;
+
+  for(i = 0; i < NUM_PATTERNS; i++)
+    {
+    box_x = (format->image_width - box_size) * i / NUM_PATTERNS;
+    box_y = (format->image_height - box_size) / 2;
+
+    for(y = 0; y < format->image_height; y++)
+      {
+      ptr = rgb_frame->planes[0] + y * rgb_frame->strides[0];
+      for(x = 0; x < format->image_width; x++)
+        {
+        if((x >= box_x) && (x < box_x + box_size) &&
+           (y >= box_y) && (y < box_y + box_size))
+          {
+          ptr[0] = 0xff;
+          ptr[1] = 0xff;
+          ptr[2] = 0x00;
+          }
+        else
+          {
+          ptr[0] = (x * 255) / format->image_width;
+          ptr[1] = (y * 255) / format->image_height;
+          ptr[2] = 0x80;
+          }
+        ptr += 3;
+        }
+      }
+    patterns[i] = gavl_video_frame_create(format);
+    gavl_video_convert(cnv, rgb_frame, patterns[i]);
+    }
+
+  gavl_video_frame_destroy(rgb_frame);
+  gavl_video_converter_destroy(cnv);
+  }
+
+typedef struct
+  {
+  int num_packets;
+  int64_t bytes;
+  } packet_count_t;
+
+static gavl_sink_status_t put_packet(void * priv, gavl_packet_t * p)
+  {
+  packet_count_t * c = priv;
+  c->num_packets++;
+  c->bytes += p->data_len;
+  return GAVL_SINK_OK;
+  }
+
+static void bench_encoder(bg_plugin_registry_t * plugin_reg,
+                          const bg_plugin_info_t * info,
+                          const gavl_video_format_t * format,
+                          int num_threads, int num_frames)
+  {
+  int i;
+  bg_plugin_handle_t * h;
+  const bg_codec_plugin_t * plugin;
+  const bg_parameter_info_t * parameters;
+  bg_cfg_section_t * section;
+  gavl_video_format_t fmt;
+  gavl_compression_info_t ci;
+  gavl_metadata_t m;
+  gavl_video_sink_t * sink;
+  gavl_packet_sink_t * psink;
+  gavl_video_frame_t * frame;
+  packet_count_t count;
+  gavl_timer_t * timer;
+  gavl_time_t time;
+
+  h = bg_plugin_load(plugin_reg, info);
+  if(!h)
+    {
+    fprintf(stderr, "Loading %s failed\n", info->name);
+    return;
+    }
+  plugin = (const bg_codec_plugin_t*)h->plugin;
+
+  /* Default parameters */
+  if(plugin->common.get_parameters &&
+     (parameters = plugin->common.get_parameters(h->priv)))
+    {
+    section = bg_cfg_section_create_from_parameters(info->name, parameters);
+    bg_cfg_section_set_parameter_int(section, "threads", num_threads);
+    bg_cfg_section_apply(section, parameters,
+                         plugin->common.set_parameter, h->priv);
+    bg_cfg_section_destroy(section);
+    }
+  
+  memset(&count, 0, sizeof(count));
+  psink = gavl_packet_sink_create(NULL, put_packet, &count);
+  plugin->set_packet_sink(h->priv, psink);
+
+  memset(&ci, 0, sizeof(ci));
+  gavl_metadata_init(&m);
+  gavl_video_format_copy(&fmt, format);
+
+  if(!(sink = plugin->open_encode_video(h->priv, &ci, &fmt, &m)))
+    {
+    fprintf(stderr, "Opening %s failed\n", info->name);
+    bg_plugin_unref(h);
+    gavl_packet_sink_destroy(psink);
+    return;
+    }
+
+  timer = gavl_timer_create();
+  gavl_timer_start(timer);
+
+  for(i = 0; i < num_frames; i++)
+    {
+    if((frame = gavl_video_sink_get_frame(sink)))
+      gavl_video_frame_copy(&fmt, frame, patterns[i % NUM_PATTERNS]);
+    else
+      frame = patterns[i % NUM_PATTERNS];
+    
+    frame->timestamp = (int64_t)i * fmt.frame_duration;
+    frame->duration = fmt.frame_duration;
+    
+    if(gavl_video_sink_put_frame(sink, frame) != GAVL_SINK_OK)
+      break;
+    }
+
+  /* Closing flushes the encoder */
+  bg_plugin_unref(h);
+  
+  time = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+
+  printf("%-24s %3d threads %8.1f fps %8d packets %10.1f kbit/s\n",
+         info->name, num_threads,
+         (double)i / gavl_time_to_seconds(time), count.num_packets,
+         (double)count.bytes * 8.0 * fmt.timescale /
+         ((double)i * fmt.frame_duration * 1000.0));
+
+  gavl_timer_destroy(timer);
+  gavl_packet_sink_destroy(psink);
+  gavl_compression_info_free(&ci);
+  gavl_metadata_free(&m);
+  }
+
+static void bench_threads(bg_plugin_registry_t * plugin_reg,
+                          const bg_plugin_info_t * info,
+                          const gavl_video_format_t * format,
+                          int max_threads, int num_frames)
+  {
+  int num_threads = 1;
+  
+  while(1)
+    {
+    bench_encoder(plugin_reg, info, format, num_threads, num_frames);
+    if(num_threads >= max_threads)
+      break;
+    num_threads *= 2;
+    if(num_threads > max_threads)
+      num_threads = max_threads;
+    }
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i, num;
+  int arg = 1;
+  int num_frames = 250;
+  int max_threads = 4;
+  gavl_video_format_t format;
+  bg_cfg_registry_t * cfg_reg;
+  bg_cfg_section_t * cfg_section;
+  bg_plugin_registry_t * plugin_reg;
+  const bg_plugin_info_t * info;
+  char * tmp_path;
+
+  memset(&format, 0, sizeof(format));
+  format.image_width = 1280;
+  format.image_height = 720;
+  format.pixelformat = GAVL_YUV_420_P;
+
+  while(arg < argc)
+    {
+    if(!strcmp(argv[arg], "-s") && (arg < argc - 1))
+      {
+      if(sscanf(argv[arg+1], "%dx%d", &format.image_width,
+                &format.image_height) < 2)
+        break;
+      arg += 2;
+      }
+    else if(!strcmp(argv[arg], "-f") && (arg < argc - 1))
+      {
+      num_frames = atoi(argv[arg+1]);
+      arg += 2;
+      }
+    else if(!strcmp(argv[arg], "-t") && (arg < argc - 1))
+      {
+      max_threads = atoi(argv[arg+1]);
+      arg += 2;
+      }
+    else if(argv[arg][0] == '-')
+      {
+      fprintf(stderr,
+              "usage: %s [-s <width>x<height>] [-f <frames>] [-t <max_threads>] [<plugin> ...]\n",
+              argv[0]);
+      return 1;
+      }
+    else
+      break;
+    }
+
+  if((num_frames < 1) || (max_threads < 1))
+    {
+    fprintf(stderr, "Invalid number of frames or threads\n");
+    return 1;
+    }
+  
+  format.frame_width = format.image_width;
+  format.frame_height = format.image_height;
+  format.pixel_width = 1;
+  format.pixel_height = 1;
+  format.timescale = 25;
+  format.frame_duration = 1;
+
+  create_patterns(&format);
+
+  cfg_reg = bg_cfg_registry_create();
+  tmp_path =  bg_search_file_read("generic", "config.xml");
+  bg_cfg_registry_load(cfg_reg, tmp_path);
+  if(tmp_path)
+    free(tmp_path);
+
+  cfg_section = bg_cfg_registry_find_section(cfg_reg, "plugins");
+  plugin_reg = bg_plugin_registry_create(cfg_section);
+
+  printf("%dx%d, %s, %d frames\n", format.image_width, format.image_height,
+         gavl_pixelformat_to_string(format.pixelformat), num_frames);
+
+  if(arg < argc)
+    {
+    while(arg < argc)
+      {
+      if(!(info = bg_plugin_find_by_name(plugin_reg, argv[arg])))
+        fprintf(stderr, "No such plugin %s\n", argv[arg]);
+      else
+        bench_threads(plugin_reg, info, &format, max_threads, num_frames);
+      arg++;
+      }
+    }
+  else
+    {
+    num = bg_plugin_registry_get_num_plugins(plugin_reg,
+                                             BG_PLUGIN_CODEC,
+                                             BG_PLUGIN_VIDEO_COMPRESSOR);
+    for(i = 0; i < num; i++)
+      {
+      info = bg_plugin_find_by_index(plugin_reg, i,
+                                     BG_PLUGIN_CODEC,
+                                     BG_PLUGIN_VIDEO_COMPRESSOR);
+      bench_threads(plugin_reg, info, &format, max_threads, num_frames);
+      }
+    }
+
+  for(i = 0; i < NUM_PATTERNS; i++)
+    gavl_video_frame_destroy(patterns[i]);
+
+  bg_plugin_registry_destroy(plugin_reg);
+  bg_cfg_registry_destroy(cfg_reg);
+  return 0;
+  }
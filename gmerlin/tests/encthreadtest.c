@@ -0,0 +1,413 @@
+/*****************************************************************
+ * gmerlin - a general purpose multimedia framework and applications
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/* Test for threaded lossless audio encoders: Encodes synthetic audio
+   with one and with several threads, decodes both files and checks
+   that the samples are the same as the input. For native FLAC files,
+   the MD5 signatures in the stream info must be equal as well. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <config.h>
+#include <gmerlin/pluginregistry.h>
+#include <gmerlin/utils.h>
+
+#define SAMPLES_PER_FRAME 1000
+
+static gavl_audio_format_t format;
+static int64_t num_samples = 20 * 44100;
+
+static int16_t get_sample(int64_t pos, int channel)
+  {
+  uint32_t noise = (uint32_t)(pos * 2 + channel) * 1103515245 + 12345;
+  return (int16_t)(8000.0 * sin(pos * (channel + 1) * 0.01) +
+                   (int)((noise >> 16) & 0x3ff) - 512);
+  }
+
+static void fill_frame(gavl_audio_frame_t * frame, int64_t pos, int num)
+  {
+  int i, j;
+  for(i = 0; i < num; i++)
+    {
+    for(j = 0; j < format.num_channels; j++)
+      frame->samples.s_16[i * format.num_channels + j] = get_sample(pos + i, j);
+    }
+  frame->valid_samples = num;
+  frame->timestamp = pos;
+  }
+
+/* Encode */
+
+typedef struct
+  {
+  char * filename;
+  } file_cb_t;
+
+static int create_output_file(void * data, const char * filename)
+  {
+  file_cb_t * f = data;
+  f->filename = gavl_strrep(f->filename, filename);
+  return 1;
+  }
+
+typedef struct
+  {
+  const bg_encoder_plugin_t * plugin;
+  void * priv;
+  } stream_param_t;
+
+static void set_audio_parameter(void * data, const char * name,
+                                const bg_parameter_value_t * val)
+  {
+  stream_param_t * p = data;
+  p->plugin->set_audio_parameter(p->priv, 0, name, val);
+  }
+
+static char * encode(bg_plugin_registry_t * plugin_reg,
+                     const bg_plugin_info_t * info,
+                     int num_threads)
+  {
+  char * filename_base;
+  int64_t pos = 0;
+  int num;
+  bg_plugin_handle_t * h;
+  const bg_parameter_info_t * parameters;
+  bg_cfg_section_t * section;
+  bg_encoder_callbacks_t cb;
+  file_cb_t f;
+  stream_param_t sp;
+  gavl_metadata_t m;
+  gavl_audio_sink_t * sink;
+  gavl_audio_frame_t * frame = NULL;
+  int result = 0;
+
+  memset(&f, 0, sizeof(f));
+  gavl_metadata_init(&m);
+
+  if(!(h = bg_plugin_load(plugin_reg, info)))
+    {
+    fprintf(stderr, "Loading %s failed\n", info->name);
+    return NULL;
+    }
+
+  sp.plugin = (const bg_encoder_plugin_t*)h->plugin;
+  sp.priv = h->priv;
+
+  memset(&cb, 0, sizeof(cb));
+  cb.create_output_file = create_output_file;
+  cb.data = &f;
+  if(sp.plugin->set_callbacks)
+    sp.plugin->set_callbacks(sp.priv, &cb);
+
+  filename_base = bg_sprintf("encthreadtest_%d", num_threads);
+
+  if(!sp.plugin->open(sp.priv, filename_base, &m, NULL))
+    {
+    fprintf(stderr, "Opening %s failed\n", filename_base);
+    goto fail;
+    }
+
+  sp.plugin->add_audio_stream(sp.priv, &m, &format);
+
+  if(sp.plugin->get_audio_parameters &&
+     (parameters = sp.plugin->get_audio_parameters(sp.priv)))
+    {
+    section = bg_cfg_section_create_from_parameters("audio", parameters);
+    bg_cfg_section_set_parameter_int(section, "threads", num_threads);
+    bg_cfg_section_apply(section, parameters, set_audio_parameter, &sp);
+    bg_cfg_section_destroy(section);
+    }
+
+  if(sp.plugin->start && !sp.plugin->start(sp.priv))
+    {
+    fprintf(stderr, "Starting %s failed\n", info->name);
+    goto fail;
+    }
+
+  sink = sp.plugin->get_audio_sink(sp.priv, 0);
+
+  if(!gavl_audio_formats_equal(&format, gavl_audio_sink_get_format(sink)))
+    {
+    fprintf(stderr, "%s changed the audio format\n", info->name);
+    goto fail;
+    }
+
+  frame = gavl_audio_frame_create(&format);
+
+  while(pos < num_samples)
+    {
+    num = SAMPLES_PER_FRAME;
+    if(num > num_samples - pos)
+      num = num_samples - pos;
+
+    fill_frame(frame, pos, num);
+    if(gavl_audio_sink_put_frame(sink, frame) != GAVL_SINK_OK)
+      {
+      fprintf(stderr, "Encoding failed\n");
+      goto fail;
+      }
+    pos += num;
+    }
+
+  result = 1;
+  fail:
+
+  if(!sp.plugin->close(sp.priv, !result))
+    result = 0;
+  bg_plugin_unref(h);
+
+  if(frame)
+    gavl_audio_frame_destroy(frame);
+  gavl_metadata_free(&m);
+  free(filename_base);
+
+  if(!result && f.filename)
+    {
+    remove(f.filename);
+    free(f.filename);
+    f.filename = NULL;
+    }
+  return f.filename;
+  }
+
+/* Decode and compare with the input */
+
+static int check_file(bg_plugin_registry_t * plugin_reg,
+                      const char * filename)
+  {
+  int i, j;
+  int64_t pos = 0;
+  int result = 0;
+  bg_plugin_handle_t * h = NULL;
+  bg_input_plugin_t * plugin;
+  bg_track_info_t * ti;
+  gavl_audio_source_t * src;
+  gavl_audio_frame_t * frame;
+
+  if(!bg_input_plugin_load(plugin_reg, filename, NULL, &h, NULL, 0))
+    {
+    fprintf(stderr, "Cannot open %s\n", filename);
+    return 0;
+    }
+  plugin = (bg_input_plugin_t*)h->plugin;
+
+  if(plugin->set_track)
+    plugin->set_track(h->priv, 0);
+
+  ti = plugin->get_track_info(h->priv, 0);
+
+  if(!ti->num_audio_streams)
+    {
+    fprintf(stderr, "%s has no audio\n", filename);
+    goto fail;
+    }
+
+  plugin->set_audio_stream(h->priv, 0, BG_STREAM_ACTION_DECODE);
+
+  if(plugin->start && !plugin->start(h->priv))
+    {
+    fprintf(stderr, "Starting %s failed\n", filename);
+    goto fail;
+    }
+
+  src = plugin->get_audio_source(h->priv, 0);
+  gavl_audio_source_set_dst(src, 0, &format);
+
+  frame = gavl_audio_frame_create(&format);
+
+  while(gavl_audio_source_read_samples(src, frame, SAMPLES_PER_FRAME))
+    {
+    for(i = 0; i < frame->valid_samples; i++)
+      {
+      for(j = 0; j < format.num_channels; j++)
+        {
+        if(frame->samples.s_16[i * format.num_channels + j] !=
+           get_sample(pos + i, j))
+          {
+          fprintf(stderr, "%s: Sample %"PRId64" differs\n",
+                  filename, pos + i);
+          gavl_audio_frame_destroy(frame);
+          goto fail;
+          }
+        }
+      }
+    pos += frame->valid_samples;
+    }
+  gavl_audio_frame_destroy(frame);
+
+  if(pos != num_samples)
+    {
+    fprintf(stderr, "%s: Decoded %"PRId64" samples instead of %"PRId64"\n",
+            filename, pos, num_samples);
+    goto fail;
+    }
+
+  result = 1;
+  fail:
+
+  if(plugin->stop)
+    plugin->stop(h->priv);
+  plugin->close(h->priv);
+  bg_plugin_unref(h);
+  return result;
+  }
+
+/* Get the MD5 signature from the stream info of a native FLAC file */
+
+static int get_flac_md5(const char * filename, uint8_t * md5)
+  {
+  uint8_t buf[42];
+  FILE * f;
+  int result;
+
+  if(!(f = fopen(filename, "rb")))
+    return 0;
+  result = (fread(buf, 1, 42, f) == 42) && !memcmp(buf, "fLaC", 4);
+  fclose(f);
+
+  if(result)
+    memcpy(md5, buf + 26, 16);
+  return result;
+  }
+
+static void print_result(const char * test, int result)
+  {
+  fprintf(stderr, "%-45s[%s]\n", test, (result ? "  ok  " : " fail "));
+  }
+
+int main(int argc, char ** argv)
+  {
+  int arg = 1;
+  int max_threads = 4;
+  int ret = 1;
+  const char * plugin_name = "e_flac";
+  char * files[2] = { NULL, NULL };
+  uint8_t md5[2][16];
+  uint8_t md5_unknown[16];
+  int result;
+  bg_cfg_registry_t * cfg_reg;
+  bg_cfg_section_t * cfg_section;
+  bg_plugin_registry_t * plugin_reg;
+  const bg_plugin_info_t * info;
+  char * tmp_path;
+
+  while(arg < argc)
+    {
+    if(!strcmp(argv[arg], "-t") && (arg < argc - 1))
+      {
+      max_threads = atoi(argv[arg+1]);
+      arg += 2;
+      }
+    else if(!strcmp(argv[arg], "-d") && (arg < argc - 1))
+      {
+      num_samples = (int64_t)(strtod(argv[arg+1], NULL) * 44100.0);
+      arg += 2;
+      }
+    else if(argv[arg][0] == '-')
+      {
+      fprintf(stderr, "usage: %s [-t <threads>] [-d <seconds>] [<plugin>]\n",
+              argv[0]);
+      return 1;
+      }
+    else
+      {
+      plugin_name = argv[arg];
+      arg++;
+      }
+    }
+
+  if((max_threads < 2) || (num_samples < 1))
+    {
+    fprintf(stderr, "Invalid number of threads or duration\n");
+    return 1;
+    }
+
+  memset(&format, 0, sizeof(format));
+  format.samplerate = 44100;
+  format.num_channels = 2;
+  format.sample_format = GAVL_SAMPLE_S16;
+  format.interleave_mode = GAVL_INTERLEAVE_ALL;
+  format.samples_per_frame = SAMPLES_PER_FRAME;
+  gavl_set_channel_setup(&format);
+
+  cfg_reg = bg_cfg_registry_create();
+  tmp_path =  bg_search_file_read("generic", "config.xml");
+  bg_cfg_registry_load(cfg_reg, tmp_path);
+  if(tmp_path)
+    free(tmp_path);
+
+  cfg_section = bg_cfg_registry_find_section(cfg_reg, "plugins");
+  plugin_reg = bg_plugin_registry_create(cfg_section);
+
+  if(!(info = bg_plugin_find_by_name(plugin_reg, plugin_name)))
+    {
+    fprintf(stderr, "No such plugin %s\n", plugin_name);
+    goto fail;
+    }
+
+  files[0] = encode(plugin_reg, info, 1);
+  files[1] = encode(plugin_reg, info, max_threads);
+
+  print_result("Encoding", files[0] && files[1]);
+  if(!files[0] || !files[1])
+    goto fail;
+
+  result = check_file(plugin_reg, files[0]);
+  print_result("Decoding single threaded output", result);
+  if(!result)
+    goto fail;
+
+  result = check_file(plugin_reg, files[1]);
+  print_result("Decoding multi threaded output", result);
+  if(!result)
+    goto fail;
+
+  if(get_flac_md5(files[0], md5[0]) && get_flac_md5(files[1], md5[1]))
+    {
+    /* All zero means unknown */
+    memset(md5_unknown, 0, 16);
+    result = !memcmp(md5[0], md5[1], 16) && memcmp(md5[1], md5_unknown, 16);
+    print_result("MD5 signatures", result);
+    if(!result)
+      goto fail;
+    }
+
+  ret = 0;
+  fail:
+
+  if(files[0])
+    {
+    remove(files[0]);
+    free(files[0]);
+    }
+  if(files[1])
+    {
+    remove(files[1]);
+    free(files[1]);
+    }
+
+  bg_plugin_registry_destroy(plugin_reg);
+  bg_cfg_registry_destroy(cfg_reg);
+  return ret;
+  }
@@ -0,0 +1,281 @@
+/*****************************************************************
+ * gmerlin - a general purpose multimedia framework and applications
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/* Benchmark for video filters: Feeds synthetic frames (a moving box
+   on a gradient) through each filter and reports the frames per
+   second including the pixelformat conversions */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <config.h>
+#include <gmerlin/pluginregistry.h>
+#include <gmerlin/utils.h>
+#include <gmerlin/bggavl.h>
+
+#define NUM_PATTERNS 16
+
+static gavl_video_frame_t * patterns[NUM_PATTERNS];
+static int pattern_index = 0;
+
+static gavl_source_status_t read_func(void * priv, gavl_video_frame_t ** f)
+  {
+  *f = patterns[pattern_index % NUM_PATTERNS];
+  (*f)->timestamp = pattern_index;
+  pattern_index++;
+  return GAVL_SOURCE_OK;
+  }
+
+static void create_patterns(const gavl_video_format_t * format)
+  {
+  int i, x, y;
+  int box_x, box_y, box_size;
+  uint8_t * ptr;
+  gavl_video_format_t rgb_format;
+  gavl_video_frame_t * rgb_frame;
+  gavl_video_converter_t * cnv;
+
+  gavl_video_format_copy(&rgb_format, format);
+  rgb_format.pixelformat = GAVL_RGB_24;
+
+  rgb_frame = gavl_video_frame_create(&rgb_format);
+  cnv = gavl_video_converter_create();
+  gavl_video_converter_init(cnv, &rgb_format, format);
+
+  box_size = format->image_height / 4;
+
+  for(i = 0; i < NUM_PATTERNS; i++)
+    {
+    box_x = (format->image_width - box_size) * i / NUM_PATTERNS;
+    box_y = (format->image_height - box_size) / 2;
+
+    for(y = 0; y < format->image_height; y++)
+      {
+      ptr = rgb_frame->planes[0] + y * rgb_frame->strides[0];
+      for(x = 0; x < format->image_width; x++)
+        {
+        if((x >= box_x) && (x < box_x + box_size) &&
+           (y >= box_y) && (y < box_y + box_size))
+          {
+          ptr[0] = 0xff;
+          ptr[1] = 0xff;
+          ptr[2] = 0x00;
+          }
+        else
+          {
+          ptr[0] = (x * 255) / format->image_width;
+          ptr[1] = (y * 255) / format->image_height;
+          ptr[2] = 0x80;
+          }
+        ptr += 3;
+        }
+      }
+    patterns[i] = gavl_video_frame_create(format);
+    gavl_video_convert(cnv, rgb_frame, patterns[i]);
+    }
+
+  gavl_video_frame_destroy(rgb_frame);
+  gavl_video_converter_destroy(cnv);
+  }
+
+static void bench_filter(bg_plugin_registry_t * plugin_reg,
+                         const bg_plugin_info_t * info,
+                         const gavl_video_format_t * format,
+                         gavl_video_options_t * opt, int num_frames)
+  {
+  int i;
+  bg_plugin_handle_t * h;
+  const bg_fv_plugin_t * plugin;
+  gavl_video_source_t * in_src;
+  gavl_video_source_t * out_src;
+  gavl_video_frame_t * frame;
+  gavl_timer_t * timer;
+  gavl_time_t time;
+
+  h = bg_plugin_load(plugin_reg, info);
+  if(!h)
+    {
+    fprintf(stderr, "Loading %s failed\n", info->name);
+    return;
+    }
+  plugin = (const bg_fv_plugin_t*)h->plugin;
+
+  if(!plugin->connect)
+    {
+    bg_plugin_unref(h);
+    return;
+    }
+
+  in_src = gavl_video_source_create(read_func, NULL,
+                                    GAVL_SOURCE_SRC_ALLOC, format);
+  out_src = plugin->connect(h->priv, in_src, opt);
+
+  /* Warm up */
+  for(i = 0; i < NUM_PATTERNS; i++)
+    {
+    frame = NULL;
+    gavl_video_source_read_frame(out_src, &frame);
+    }
+
+  timer = gavl_timer_create();
+  gavl_timer_start(timer);
+
+  for(i = 0; i < num_frames; i++)
+    {
+    frame = NULL;
+    if(gavl_video_source_read_frame(out_src, &frame) != GAVL_SOURCE_OK)
+      break;
+    }
+
+  time = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+
+  /* Print the format the filter processes */
+  printf("%-24s %-22s %8.1f fps\n", info->name,
+         gavl_pixelformat_to_string(gavl_video_source_get_dst_format(in_src)->pixelformat),
+         (double)i / gavl_time_to_seconds(time));
+
+  gavl_timer_destroy(timer);
+  bg_plugin_unref(h);
+  gavl_video_source_destroy(in_src);
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i, num;
+  int arg = 1;
+  int num_frames = 100;
+  int num_threads = 1;
+  gavl_video_format_t format;
+  gavl_video_options_t * opt;
+  bg_thread_pool_t * pool = NULL;
+  bg_cfg_registry_t * cfg_reg;
+  bg_cfg_section_t * cfg_section;
+  bg_plugin_registry_t * plugin_reg;
+  const bg_plugin_info_t * info;
+  char * tmp_path;
+
+  memset(&format, 0, sizeof(format));
+  format.image_width = 1920;
+  format.image_height = 1080;
+  format.pixelformat = GAVL_YUV_420_P;
+
+  while(arg < argc)
+    {
+    if(!strcmp(argv[arg], "-s") && (arg < argc - 1))
+      {
+      if(sscanf(argv[arg+1], "%dx%d", &format.image_width,
+                &format.image_height) < 2)
+        break;
+      arg += 2;
+      }
+    else if(!strcmp(argv[arg], "-f") && (arg < argc - 1))
+      {
+      num_frames = atoi(argv[arg+1]);
+      arg += 2;
+      }
+    else if(!strcmp(argv[arg], "-t") && (arg < argc - 1))
+      {
+      num_threads = atoi(argv[arg+1]);
+      arg += 2;
+      }
+    else if(!strcmp(argv[arg], "-pf") && (arg < argc - 1))
+      {
+      format.pixelformat = gavl_string_to_pixelformat(argv[arg+1]);
+      arg += 2;
+      }
+    else if(argv[arg][0] == '-')
+      {
+      fprintf(stderr,
+              "usage: %s [-s <width>x<height>] [-f <frames>] [-t <threads>] [-pf <pixelformat>] [<plugin> ...]\n",
+              argv[0]);
+      return 1;
+      }
+    else
+      break;
+    }
+
+  format.frame_width = format.image_width;
+  format.frame_height = format.image_height;
+  format.pixel_width = 1;
+  format.pixel_height = 1;
+  format.timescale = 25;
+  format.frame_duration = 1;
+
+  create_patterns(&format);
+
+  opt = gavl_video_options_create();
+  if(num_threads > 1)
+    {
+    pool = bg_thread_pool_create(num_threads);
+    gavl_video_options_set_num_threads(opt, num_threads);
+    gavl_video_options_set_run_func(opt, bg_thread_pool_run, pool);
+    gavl_video_options_set_stop_func(opt, bg_thread_pool_stop, pool);
+    }
+
+  cfg_reg = bg_cfg_registry_create();
+  tmp_path =  bg_search_file_read("generic", "config.xml");
+  bg_cfg_registry_load(cfg_reg, tmp_path);
+  if(tmp_path)
+    free(tmp_path);
+
+  cfg_section = bg_cfg_registry_find_section(cfg_reg, "plugins");
+  plugin_reg = bg_plugin_registry_create(cfg_section);
+
+  printf("%dx%d, %s, %d threads\n", format.image_width, format.image_height,
+         gavl_pixelformat_to_string(format.pixelformat), num_threads);
+
+  if(arg < argc)
+    {
+    while(arg < argc)
+      {
+      if(!(info = bg_plugin_find_by_name(plugin_reg, argv[arg])))
+        fprintf(stderr, "No such plugin %s\n", argv[arg]);
+      else
+        bench_filter(plugin_reg, info, &format, opt, num_frames);
+      arg++;
+      }
+    }
+  else
+    {
+    num = bg_plugin_registry_get_num_plugins(plugin_reg,
+                                             BG_PLUGIN_FILTER_VIDEO,
+                                             BG_PLUGIN_FILTER_1);
+    for(i = 0; i < num; i++)
+      {
+      info = bg_plugin_find_by_index(plugin_reg, i,
+                                     BG_PLUGIN_FILTER_VIDEO,
+                                     BG_PLUGIN_FILTER_1);
+      bench_filter(plugin_reg, info, &format, opt, num_frames);
+      }
+    }
+
+  for(i = 0; i < NUM_PATTERNS; i++)
+    gavl_video_frame_destroy(patterns[i]);
+
+  bg_plugin_registry_destroy(plugin_reg);
+  bg_cfg_registry_destroy(cfg_reg);
+  gavl_video_options_destroy(opt);
+  if(pool)
+    bg_thread_pool_destroy(pool);
+  return 0;
+  }
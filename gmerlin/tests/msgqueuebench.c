@@ -0,0 +1,163 @@
+/*****************************************************************
+ * gmerlin - a general purpose multimedia framework and applications
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/* Benchmark for message queues: Broadcasts messages like the
+   player does (time updates and strings) to a number of listener
+   threads and reports the throughput */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <gmerlin/parameter.h>
+#include <gmerlin/streaminfo.h>
+#include <gmerlin/msgqueue.h>
+#include <gavl/gavl.h>
+
+#define MSG_QUIT   0
+#define MSG_TIME   1
+#define MSG_STRING 2
+
+typedef struct
+  {
+  bg_msg_queue_t * q;
+  pthread_t thread;
+  int num_received;
+  } listener_t;
+
+static void * listener_func(void * data)
+  {
+  int keep_going = 1;
+  bg_msg_t * msg;
+  char * str;
+  listener_t * l = data;
+
+  while(keep_going)
+    {
+    msg = bg_msg_queue_lock_read(l->q);
+
+    switch(bg_msg_get_id(msg))
+      {
+      case MSG_QUIT:
+        keep_going = 0;
+        break;
+      case MSG_TIME:
+        bg_msg_get_arg_time(msg, 0);
+        break;
+      case MSG_STRING:
+        str = bg_msg_get_arg_string(msg, 0);
+        free(str);
+        break;
+      }
+    bg_msg_queue_unlock_read(l->q);
+    l->num_received++;
+    }
+  return NULL;
+  }
+
+static void set_time(bg_msg_t * msg, const void * data)
+  {
+  bg_msg_set_id(msg, MSG_TIME);
+  bg_msg_set_arg_time(msg, 0, *((const gavl_time_t*)data));
+  bg_msg_set_arg_int(msg, 1, 0);
+  }
+
+static void set_string(bg_msg_t * msg, const void * data)
+  {
+  bg_msg_set_id(msg, MSG_STRING);
+  bg_msg_set_arg_string(msg, 0, data);
+  }
+
+static void set_quit(bg_msg_t * msg, const void * data)
+  {
+  bg_msg_set_id(msg, MSG_QUIT);
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i;
+  int num_messages = 1000000;
+  int num_listeners = 4;
+  listener_t * listeners;
+  bg_msg_queue_list_t * list;
+  gavl_timer_t * timer;
+  gavl_time_t time;
+  int64_t total = 0;
+
+  if(argc > 3)
+    {
+    fprintf(stderr, "usage: %s [<num_messages> [<num_listeners>]]\n",
+            argv[0]);
+    return 1;
+    }
+  if(argc > 1)
+    num_messages = atoi(argv[1]);
+  if(argc > 2)
+    num_listeners = atoi(argv[2]);
+
+  list = bg_msg_queue_list_create();
+  listeners = calloc(num_listeners, sizeof(*listeners));
+
+  for(i = 0; i < num_listeners; i++)
+    {
+    listeners[i].q = bg_msg_queue_create();
+    bg_msg_queue_list_add(list, listeners[i].q);
+    pthread_create(&listeners[i].thread, NULL, listener_func, &listeners[i]);
+    }
+
+  timer = gavl_timer_create();
+  gavl_timer_start(timer);
+
+  for(i = 0; i < num_messages; i++)
+    {
+    /* Every 8th message carries a string (like a track name) */
+    if(i & 7)
+      {
+      time = i;
+      bg_msg_queue_list_send(list, set_time, &time);
+      }
+    else
+      bg_msg_queue_list_send(list, set_string, "Artist - Title of the track");
+    }
+  bg_msg_queue_list_send(list, set_quit, NULL);
+
+  for(i = 0; i < num_listeners; i++)
+    {
+    pthread_join(listeners[i].thread, NULL);
+    total += listeners[i].num_received;
+    }
+  time = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+
+  printf("%d messages to %d listeners: %.3f s, %.0f messages/s\n",
+         num_messages, num_listeners, gavl_time_to_seconds(time),
+         (double)total / gavl_time_to_seconds(time));
+
+  for(i = 0; i < num_listeners; i++)
+    {
+    bg_msg_queue_list_remove(list, listeners[i].q);
+    bg_msg_queue_destroy(listeners[i].q);
+    }
+  bg_msg_queue_list_destroy(list);
+  gavl_timer_destroy(timer);
+  free(listeners);
+  return 0;
+  }
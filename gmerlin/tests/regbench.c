@@ -0,0 +1,238 @@
+/*****************************************************************
+ * gmerlin - a general purpose multimedia framework and applications
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/* Benchmark for the plugin registry: Reports the time needed for
+   creating the registry (like every application does at startup) and
+   for looking up plugins by name, filename, mimetype and compression */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <config.h>
+#include <gmerlin/pluginregistry.h>
+#include <gmerlin/utils.h>
+
+static const char * const filenames[] =
+  {
+    "movie.avi",
+    "movie.mkv",
+    "song.mp3",
+    "song.flac",
+    "image.png",
+    "image.jpg",
+    "stream.ts",
+    "unknown.xyz",
+    NULL
+  };
+
+static const char * const mimetypes[] =
+  {
+    "audio/mpeg",
+    "video/mp4",
+    "application/ogg",
+    "image/png",
+    "text/unknown",
+    NULL
+  };
+
+static const gavl_codec_id_t compressions[] =
+  {
+    GAVL_CODEC_ID_MP3,
+    GAVL_CODEC_ID_H264,
+    GAVL_CODEC_ID_JPEG,
+    GAVL_CODEC_ID_PNG,
+    GAVL_CODEC_ID_NONE
+  };
+
+int main(int argc, char ** argv)
+  {
+  int i, j, num, num_lookups;
+  int num_rounds = 10;
+  int num_lookup_rounds = 10000;
+  bg_cfg_registry_t * cfg_reg;
+  bg_cfg_section_t * cfg_section;
+  bg_plugin_registry_t * plugin_reg;
+  const bg_plugin_info_t * info;
+  char ** names;
+  char * tmp_path;
+  gavl_timer_t * timer;
+  gavl_time_t time;
+
+  if(argc > 1)
+    num_rounds = atoi(argv[1]);
+  if(argc > 2)
+    num_lookup_rounds = atoi(argv[2]);
+
+  if((num_rounds < 1) || (num_lookup_rounds < 1))
+    {
+    fprintf(stderr, "usage: %s [<rounds> [<lookup_rounds>]]\n", argv[0]);
+    return 1;
+    }
+
+  cfg_reg = bg_cfg_registry_create();
+  tmp_path =  bg_search_file_read("generic", "config.xml");
+  bg_cfg_registry_load(cfg_reg, tmp_path);
+  if(tmp_path)
+    free(tmp_path);
+
+  cfg_section = bg_cfg_registry_find_section(cfg_reg, "plugins");
+
+  timer = gavl_timer_create();
+
+  /* The first run brings the registry files up to date */
+
+  gavl_timer_start(timer);
+  plugin_reg = bg_plugin_registry_create(cfg_section);
+  time = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+
+  printf("First creation:    %10.3f ms (changed: %d)\n",
+         gavl_time_to_seconds(time) * 1000.0,
+         bg_plugin_registry_changed(plugin_reg));
+
+  bg_plugin_registry_destroy(plugin_reg);
+
+  gavl_timer_set(timer, 0);
+  gavl_timer_start(timer);
+  for(i = 0; i < num_rounds; i++)
+    {
+    plugin_reg = bg_plugin_registry_create(cfg_section);
+    bg_plugin_registry_destroy(plugin_reg);
+    }
+  time = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+
+  printf("Creation:          %10.3f ms\n",
+         gavl_time_to_seconds(time) * 1000.0 / num_rounds);
+
+  plugin_reg = bg_plugin_registry_create(cfg_section);
+
+  /* Lookups */
+
+  names = bg_plugin_registry_get_plugins(plugin_reg,
+                                         BG_PLUGIN_ALL, BG_PLUGIN_ALL);
+  num = 0;
+  while(names[num])
+    num++;
+
+  printf("Plugins:           %10d\n", num);
+
+  num_lookups = 0;
+  gavl_timer_set(timer, 0);
+  gavl_timer_start(timer);
+  for(i = 0; i < num_lookup_rounds; i++)
+    {
+    for(j = 0; j < num; j++)
+      {
+      info = bg_plugin_find_by_name(plugin_reg, names[j]);
+      num_lookups++;
+      }
+    }
+  time = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+  printf("Name lookup:       %10.1f ns\n",
+         gavl_time_to_seconds(time) * 1.0e9 / num_lookups);
+
+  num_lookups = 0;
+  gavl_timer_set(timer, 0);
+  gavl_timer_start(timer);
+  for(i = 0; i < num_lookup_rounds; i++)
+    {
+    j = 0;
+    while(filenames[j])
+      {
+      info = bg_plugin_find_by_filename(plugin_reg, filenames[j],
+                                        BG_PLUGIN_INPUT | BG_PLUGIN_IMAGE_READER);
+      num_lookups++;
+      j++;
+      }
+    }
+  time = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+  printf("Filename lookup:   %10.1f ns\n",
+         gavl_time_to_seconds(time) * 1.0e9 / num_lookups);
+
+  num_lookups = 0;
+  gavl_timer_set(timer, 0);
+  gavl_timer_start(timer);
+  for(i = 0; i < num_lookup_rounds; i++)
+    {
+    j = 0;
+    while(mimetypes[j])
+      {
+      info = bg_plugin_find_by_mimetype(plugin_reg, mimetypes[j],
+                                        BG_PLUGIN_INPUT | BG_PLUGIN_IMAGE_READER);
+      num_lookups++;
+      j++;
+      }
+    }
+  time = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+  printf("Mimetype lookup:   %10.1f ns\n",
+         gavl_time_to_seconds(time) * 1.0e9 / num_lookups);
+
+  num_lookups = 0;
+  gavl_timer_set(timer, 0);
+  gavl_timer_start(timer);
+  for(i = 0; i < num_lookup_rounds; i++)
+    {
+    j = 0;
+    while(compressions[j] != GAVL_CODEC_ID_NONE)
+      {
+      info = bg_plugin_find_by_compression(plugin_reg, compressions[j],
+                                           BG_PLUGIN_CODEC,
+                                           BG_PLUGIN_AUDIO_DECOMPRESSOR |
+                                           BG_PLUGIN_VIDEO_DECOMPRESSOR);
+      num_lookups++;
+      j++;
+      }
+    }
+  time = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+  printf("Compression lookup:%10.1f ns\n",
+         gavl_time_to_seconds(time) * 1.0e9 / num_lookups);
+
+  /* Print the results once */
+
+  j = 0;
+  while(filenames[j])
+    {
+    info = bg_plugin_find_by_filename(plugin_reg, filenames[j],
+                                      BG_PLUGIN_INPUT | BG_PLUGIN_IMAGE_READER);
+    printf("%-20s %s\n", filenames[j], info ? info->name : "(none)");
+    j++;
+    }
+  j = 0;
+  while(mimetypes[j])
+    {
+    info = bg_plugin_find_by_mimetype(plugin_reg, mimetypes[j],
+                                      BG_PLUGIN_INPUT | BG_PLUGIN_IMAGE_READER);
+    printf("%-20s %s\n", mimetypes[j], info ? info->name : "(none)");
+    j++;
+    }
+
+  bg_plugin_registry_free_plugins(names);
+  bg_plugin_registry_destroy(plugin_reg);
+  bg_cfg_registry_destroy(cfg_reg);
+  gavl_timer_destroy(timer);
+  return 0;
+  }
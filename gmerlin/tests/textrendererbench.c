@@ -0,0 +1,163 @@
+/*****************************************************************
+ * gmerlin - a general purpose multimedia framework and applications
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+
+/* Benchmark for the text renderer: Renders all subtitles of a
+   text file (e.g. a .srt file) and reports the rendering speed */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdio.h>
+
+#include <gmerlin/parameter.h>
+#include <gmerlin/textrenderer.h>
+#include <gmerlin/utils.h>
+
+/* Skip srt counters and timecodes */
+
+static int is_text_line(const char * line)
+  {
+  const char * pos;
+  
+  if(!(*line) || strstr(line, "-->"))
+    return 0;
+
+  pos = line;
+  while(*pos)
+    {
+    if(!isdigit(*pos) && !isspace(*pos))
+      return 1;
+    pos++;
+    }
+  return 0;
+  }
+
+int main(int argc, char ** argv)
+  {
+  gavl_video_format_t frame_format;
+  gavl_video_format_t ovl_format;
+  gavl_overlay_t * ovl;
+  bg_parameter_value_t val;
+  bg_text_renderer_t * r;
+  gavl_timer_t * timer;
+  gavl_time_t time;
+  
+  char * file;
+  char ** lines;
+  char * sub = NULL;
+  int len, i, num_subs = 0, loops = 1, l;
+  
+  if((argc < 3) || (argc > 5))
+    {
+    fprintf(stderr,
+            "usage: %s <font-name|font-file> <subtitle-file> [<cache_size> [<loops>]]\n",
+            argv[0]);
+    return 1;
+    }
+
+  if(!(file = bg_read_file(argv[2], &len)))
+    {
+    fprintf(stderr, "Cannot read %s\n", argv[2]);
+    return 1;
+    }
+  
+  r = bg_text_renderer_create();
+  
+  /* Font (fontconfig name or file) */
+  val.val_str = argv[1];
+  if(strchr(argv[1], '/'))
+    {
+    bg_text_renderer_set_parameter(r, "font_file", &val);
+    val.val_f = 20.0;
+    bg_text_renderer_set_parameter(r, "font_size", &val);
+    }
+  else
+    bg_text_renderer_set_parameter(r, "font", &val);
+
+  val.val_f = 2.0;
+  bg_text_renderer_set_parameter(r, "border_width", &val);
+  
+  val.val_i = (argc > 3) ? atoi(argv[3]) : 255;
+  bg_text_renderer_set_parameter(r, "cache_size", &val);
+
+  if(argc > 4)
+    loops = atoi(argv[4]);
+  
+  memset(&frame_format, 0, sizeof(frame_format));
+  frame_format.image_width  = 1920;
+  frame_format.image_height = 1080;
+  frame_format.frame_width  = 1920;
+  frame_format.frame_height = 1080;
+  frame_format.pixel_width  = 1;
+  frame_format.pixel_height = 1;
+  frame_format.pixelformat =  GAVL_YUVA_32;
+  
+  bg_text_renderer_init(r, &frame_format, &ovl_format);
+  ovl = gavl_video_frame_create(&ovl_format);
+
+  lines = bg_strbreak(file, '\n');
+
+  timer = gavl_timer_create();
+  gavl_timer_start(timer);
+
+  for(l = 0; l < loops; l++)
+    {
+    i = 0;
+    while(1)
+      {
+      /* Subtitles are separated by empty lines */
+      if(!lines[i] || !lines[i][0] || !strcmp(lines[i], "\r"))
+        {
+        if(sub)
+          {
+          bg_text_renderer_render(r, sub, ovl);
+          num_subs++;
+          free(sub);
+          sub = NULL;
+          }
+        if(!lines[i])
+          break;
+        }
+      else if(is_text_line(lines[i]))
+        {
+        if(sub)
+          sub = gavl_strcat(sub, "\n");
+        sub = gavl_strcat(sub, lines[i]);
+        }
+      i++;
+      }
+    }
+  
+  time = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+  
+  printf("Rendered %d subtitles in %.3f seconds (%.1f subtitles/s)\n",
+         num_subs, gavl_time_to_seconds(time),
+         time > 0 ? (double)num_subs / gavl_time_to_seconds(time) : 0.0);
+
+  bg_strbreak_free(lines);
+  gavl_timer_destroy(timer);
+  gavl_video_frame_destroy(ovl);
+  bg_text_renderer_destroy(r);
+  free(file);
+  return 0;
+  }
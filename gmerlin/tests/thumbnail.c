@@ -26,8 +26,16 @@
 #include <gmerlin/utils.h>
 #include <gmerlin/pluginregistry.h>
 
+static void thumbnail_callback(void * data, const char * gml,
+                               const char * thumbnail_file)
+  {
+  fprintf(stderr, "%s: %s\n", gml, thumbnail_file ? thumbnail_file : "failed");
+  }
+
 int main(int argc, char ** argv)
   {
+  int i;
+  bg_thumbnailer_t * th;
   bg_cfg_registry_t    * cfg_reg;
   bg_plugin_registry_t * plugin_reg;
 
@@ -52,9 +60,23 @@ int main(int argc, char ** argv)
   cfg_section = bg_cfg_registry_find_section(cfg_reg, "plugins");
   plugin_reg = bg_plugin_registry_create(cfg_section);
 
+  /* Several files: Use the thumbnailer */
+
+  if(argc > 2)
+    {
+    th = bg_thumbnailer_create(plugin_reg, 4, 10 * GAVL_TIME_SCALE,
+                               thumbnail_callback, NULL);
+    if(th)
+      {
+      for(i = 1; i < argc; i++)
+        bg_thumbnailer_add(th, argv[i]);
+      bg_thumbnailer_destroy(th);
+      }
+    }
+  
   /* Get thumbnail */
   
-  if(bg_get_thumbnail(argv[1],
+  else if(bg_get_thumbnail(argv[1],
                       plugin_reg,
                       &th_filename,
                       &th_frame,
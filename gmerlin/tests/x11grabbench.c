@@ -0,0 +1,176 @@
+/*****************************************************************
+ * gmerlin - a general purpose multimedia framework and applications
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+
+/* Benchmark for X11 screen grabbing: Grabs the root window with and
+   without XDamage and reports the CPU time per frame. A small animated
+   box is drawn on the root window to simulate a mostly static desktop.
+   Run e.g. with Xvfb :1 -screen 0 3840x2160x24 & DISPLAY=:1 x11grabbench */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <X11/Xlib.h>
+
+#include <config.h>
+
+#include <gmerlin/parameter.h>
+#include <x11/x11.h>
+
+static double get_cpu_time(void)
+  {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+    (double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1.0e6;
+  }
+
+static void set_int(bg_x11_grab_window_t * win, const char * name, int i)
+  {
+  bg_parameter_value_t val;
+  val.val_i = i;
+  bg_x11_grab_window_set_parameter(win, name, &val);
+  }
+
+static void bench_grab(int damage, int num_frames, float fps, int box_size)
+  {
+  int i;
+  int num_changed = 0;
+  double changed_area = 0.0;
+  double cpu_time;
+  bg_x11_grab_window_t * win;
+  gavl_video_format_t format;
+  gavl_video_frame_t * frame;
+  gavl_rectangle_i_t rect;
+  bg_parameter_value_t val;
+  Display * dpy;
+  GC gc;
+  int screen;
+  
+  /* Separate connection for drawing */
+  if(!(dpy = XOpenDisplay(NULL)))
+    {
+    fprintf(stderr, "Cannot open display\n");
+    return;
+    }
+  screen = DefaultScreen(dpy);
+  gc = XCreateGC(dpy, RootWindow(dpy, screen), 0, NULL);
+  
+  win = bg_x11_grab_window_create();
+  set_int(win, "root", 1);
+  set_int(win, "draw_cursor", 1);
+  set_int(win, "disable_screensaver", 0);
+  set_int(win, "damage", damage);
+  val.val_f = fps;
+  bg_x11_grab_window_set_parameter(win, "fps", &val);
+  
+  memset(&format, 0, sizeof(format));
+  
+  if(!bg_x11_grab_window_init(win, &format))
+    {
+    fprintf(stderr, "Initializing grab window failed\n");
+    bg_x11_grab_window_destroy(win);
+    XFreeGC(dpy, gc);
+    XCloseDisplay(dpy);
+    return;
+    }
+
+  cpu_time = get_cpu_time();
+  
+  for(i = 0; i < num_frames; i++)
+    {
+    if(box_size > 0)
+      {
+      XSetForeground(dpy, gc, (i & 1) ? BlackPixel(dpy, screen) :
+                     WhitePixel(dpy, screen));
+      XFillRectangle(dpy, RootWindow(dpy, screen), gc,
+                     (i * 8) % (format.image_width - box_size),
+                     format.image_height / 2, box_size, box_size);
+      XSync(dpy, False);
+      }
+    
+    frame = NULL;
+    if(bg_x11_grab_window_grab(win, &frame) != GAVL_SOURCE_OK)
+      break;
+    
+    if(bg_x11_grab_window_get_changed(win, &rect))
+      {
+      num_changed++;
+      changed_area += (double)rect.w * rect.h;
+      }
+    }
+  
+  cpu_time = get_cpu_time() - cpu_time;
+
+  printf("%-8s %dx%d: %8.3f ms CPU/frame, %d/%d frames changed, %5.1f %% changed area\n",
+         damage ? "XDamage" : "Full",
+         format.image_width, format.image_height,
+         cpu_time * 1000.0 / i, num_changed, i,
+         num_changed ? 100.0 * changed_area /
+         ((double)num_changed * format.image_width * format.image_height) : 0.0);
+  
+  bg_x11_grab_window_close(win);
+  bg_x11_grab_window_destroy(win);
+  XFreeGC(dpy, gc);
+  XCloseDisplay(dpy);
+  }
+
+int main(int argc, char ** argv)
+  {
+  int arg = 1;
+  int num_frames = 250;
+  int box_size = 64;
+  float fps = 50.0;
+
+  while(arg < argc)
+    {
+    if(!strcmp(argv[arg], "-f") && (arg < argc - 1))
+      {
+      num_frames = atoi(argv[arg+1]);
+      arg += 2;
+      }
+    else if(!strcmp(argv[arg], "-r") && (arg < argc - 1))
+      {
+      fps = strtod(argv[arg+1], NULL);
+      arg += 2;
+      }
+    else if(!strcmp(argv[arg], "-b") && (arg < argc - 1))
+      {
+      box_size = atoi(argv[arg+1]);
+      arg += 2;
+      }
+    else
+      {
+      fprintf(stderr,
+              "usage: %s [-f <frames>] [-r <fps>] [-b <box_size>]\n",
+              argv[0]);
+      return 1;
+      }
+    }
+  
+  bench_grab(0, num_frames, fps, box_size);
+  bench_grab(1, num_frames, fps, box_size);
+  return 0;
+  }
@@ -431,6 +431,34 @@ void bgav_options_set_http_proxy_pass(bgav_options_t* opt, const char * pass);
 BGAV_PUBLIC
 void bgav_options_set_http_shoutcast_metadata(bgav_options_t* opt, int enable);
 
+/** \ingroup options
+ *  \brief Set the block size for seekable http streams
+ *  \param opt Option container
+ *  \param size Block size in bytes
+ *
+ *  If a http server supports byte ranges, the file is read in blocks
+ *  of this size. Sequential reads request multiple blocks at once.
+ *
+ *  Since 1.3.0
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_http_block_size(bgav_options_t* opt, int size);
+
+/** \ingroup options
+ *  \brief Set the cache size for seekable http streams
+ *  \param opt Option container
+ *  \param size Cache size in bytes
+ *
+ *  The most recently used blocks of seekable http streams are kept in a
+ *  cache of this size.
+ *
+ *  Since 1.3.0
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_http_cache_size(bgav_options_t* opt, int size);
+
 /* Set FTP options */
 
 /** \ingroup options
@@ -499,6 +527,36 @@ void bgav_options_set_audio_dynrange(bgav_options_t* opt,
 BGAV_PUBLIC
 void bgav_options_set_sample_accurate(bgav_options_t*opt, int enable);
 
+/** \ingroup options
+ *  \brief Set the memory budget of the seek cache
+ *  \param opt Option container
+ *  \param size Maximum size (in bytes) of the cached frames per video stream
+ *
+ *  In sample accurate mode, decoded video frames can be kept as
+ *  checkpoints. Seeking to a cached frame with \ref bgav_seek_video
+ *  doesn't need to decode from the previous keyframe, which makes
+ *  repeated and backward seeks in long GOP material much faster.
+ *  Zero (the default) disables the cache.
+ *
+ *  Since 1.3.0
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_seek_cache_size(bgav_options_t*opt, int size);
+
+/** \ingroup options
+ *  \brief Set the checkpoint interval of the seek cache
+ *  \param opt Option container
+ *  \param interval Keep every nth decoded frame
+ *
+ *  The first frame after each seek is always stored. Default is 1.
+ *
+ *  Since 1.3.0
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_seek_cache_interval(bgav_options_t*opt, int interval);
+
 /** \ingroup options
  *  \brief Set the index creation time for caching
  *  \param opt Option container
@@ -621,6 +679,51 @@ BGAV_PUBLIC
 void bgav_options_set_dv_datetime(bgav_options_t* opt,
                                   int datetime);
 
+/** \ingroup options
+ *  \brief Add a track with all programs of multi-program streams
+ *  \param opt Option container
+ *  \param enable 1 to add the track, 0 else
+ *
+ *  MPEG-2 transport streams (e.g. DVB recordings) expose each program
+ *  as a separate track. If this is enabled, an additional last track
+ *  contains the streams of all programs. Selecting it lets one
+ *  decoder instance feed several programs at once with a single
+ *  read and demultiplexing pass. The label metadata of each stream
+ *  tells the program it belongs to. Timestamps are relative to the
+ *  start of the respective program.
+ *
+ *  Since 1.3.0
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_all_programs(bgav_options_t* opt,
+                                   int enable);
+
+/** \ingroup options
+ *  \brief Demultiplex in a separate thread
+ *  \param opt Option container
+ *  \param milliseconds Time to read ahead for each stream, 0 to disable the thread
+ *
+ *  If enabled, the demuxer runs in its own thread while a track is
+ *  started. It reads ahead until each audio and video stream has at
+ *  least the given time buffered. Applications, which read several
+ *  streams from different threads, then don't wait for each other's
+ *  packets to be read from the input. The read functions of
+ *  different streams can be called concurrently, the read functions
+ *  of one stream must not. Seeking, stopping and track selection must
+ *  not be done while streams are read.
+ *
+ *  The thread is not used for sample accurate tracks and for
+ *  formats, which need to know the requested stream. Callbacks
+ *  (e.g. metadata changes) can be called from the demuxer thread.
+ *
+ *  Since 1.3.0
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_demuxer_buffer(bgav_options_t* opt,
+                                     int milliseconds);
+
 /** \ingroup options
  *  \brief Shrink factor
  *  \param opt Option container
@@ -2278,6 +2381,23 @@ void bgav_seek_audio(bgav_t * bgav, int stream, int64_t sample);
 BGAV_PUBLIC
 void bgav_seek_video(bgav_t * bgav, int stream, int64_t time);
 
+/** \ingroup sampleseek
+ *  \brief Get statistics of the seek cache
+ *  \param bgav A decoder handle
+ *  \param stream Video stream index (starting with 0)
+ *  \param hits Returns the number of seeks served from the cache
+ *  \param misses Returns the number of seeks, which needed decoding
+ *  \returns 1 if the stream has a seek cache, 0 else
+ *
+ *  See \ref bgav_options_set_seek_cache_size.
+ *
+ *  Since 1.3.0
+ */
+
+BGAV_PUBLIC
+int bgav_get_seek_cache_stats(bgav_t * bgav, int stream,
+                              int64_t * hits, int64_t * misses);
+
 /** \ingroup sampleseek
  *  \brief Get the time of the closest keyframe before a given time
  *  \param bgav A decoder handle
@@ -71,9 +71,12 @@ typedef struct bgav_track_s bgav_track_t;
 
 typedef struct bgav_timecode_table_s bgav_timecode_table_t;
 typedef struct bgav_keyframe_table_s bgav_keyframe_table_t;
+typedef struct bgav_frame_cache_s bgav_frame_cache_t;
 
 typedef struct bgav_packet_pool_s bgav_packet_pool_t;
 
+typedef struct bgav_demuxer_thread_s bgav_demuxer_thread_t;
+
 typedef struct bgav_video_format_tracker_s bgav_video_format_tracker_t;
 
 #include <id3.h>
@@ -376,6 +379,7 @@ typedef enum
 #define STREAM_DISCONT            (1<<16) // Stream is discontinuous
 #define STREAM_SUBREADER          (1<<17) // External subtitle file
 #define STREAM_STANDALONE         (1<<18) // Standalone decoder
+#define STREAM_CACHED_SEEK        (1<<19) // Frames come from the frame cache
 
 
 /* Stream could not get exact compression info from the
@@ -408,6 +412,10 @@ typedef struct
       
   bgav_video_parser_t * parser;
   bgav_keyframe_table_t * kft;
+
+  /* Checkpoints for sample accurate seeking */
+  bgav_frame_cache_t * fc;
+  int64_t decoder_time; /* Decoder position while STREAM_CACHED_SEEK is set */
       
   int max_ref_frames; /* Needed for VDPAU */
       
@@ -540,6 +548,11 @@ struct bgav_stream_s
   bgav_packet_pool_t * pp;  /* Where to put consumed
                                packets for later use */
 
+  /* Buffered time range if the demuxer runs in a separate thread
+     (see demuxthread.c) */
+  int64_t dt_in_time;
+  int64_t dt_out_time;
+
   bgav_packet_t * out_packet_b;
   gavl_packet_t out_packet_g;
   
@@ -832,6 +845,9 @@ struct bgav_options_s
   int sample_accurate;
   int cache_time;
   int cache_size;
+
+  int seek_cache_size;
+  int seek_cache_interval;
   
   /* Generic network options */
   int connect_timeout;
@@ -858,6 +874,9 @@ struct bgav_options_s
   
   int http_shoutcast_metadata;
 
+  int http_block_size;
+  int http_cache_size;
+
   /* ftp options */
     
   char * ftp_anonymous_password;
@@ -880,6 +899,12 @@ struct bgav_options_s
   int prefer_ffmpeg_demuxers;
 
   int dv_datetime;
+
+  /* Add a track with the streams of all programs */
+  int all_programs;
+
+  /* Read ahead time of the demuxer thread (milliseconds, 0 = off) */
+  int demuxer_buffer;
   
   int shrink;
 
@@ -1082,7 +1107,7 @@ BGAV_PUBLIC int bgav_input_open(bgav_input_context_t *, const char * url);
 
 BGAV_PUBLIC void bgav_input_close(bgav_input_context_t * ctx);
 
-void bgav_input_destroy(bgav_input_context_t * ctx);
+BGAV_PUBLIC void bgav_input_destroy(bgav_input_context_t * ctx);
 
 void bgav_input_skip(bgav_input_context_t *, int64_t);
 
@@ -1098,9 +1123,9 @@ void bgav_input_skip_dump(bgav_input_context_t *, int);
 
 void bgav_input_get_dump(bgav_input_context_t *, int);
 
-void bgav_input_seek(bgav_input_context_t * ctx,
-                     int64_t position,
-                     int whence);
+BGAV_PUBLIC void bgav_input_seek(bgav_input_context_t * ctx,
+                                 int64_t position,
+                                 int whence);
 
 void bgav_input_seek_sector(bgav_input_context_t * ctx,
                             int64_t sector);
@@ -1347,6 +1372,8 @@ struct bgav_demuxer_s
 
 #define BGAV_DEMUXER_BUILD_INDEX          (1<<8) /* We're just building
                                                     an index */
+#define BGAV_DEMUXER_REQUEST_STREAM       (1<<9) /* next_packet() needs
+                                                    request_stream */
 
 #define INDEX_MODE_NONE   0 /* Default: No sample accuracy */
 /* Packets have precise timestamps and durations and are adjacent in the file */
@@ -1423,7 +1450,9 @@ struct bgav_demuxer_context_s
   gavl_edl_t * edl;
   
   bgav_redirector_context_t * redirector;
-  
+
+  /* Demuxer thread (if running) */
+  bgav_demuxer_thread_t * thread;
   };
 
 /* demuxer.c */
@@ -1466,6 +1495,11 @@ bgav_demuxer_seek(bgav_demuxer_context_t * demuxer,
 int
 bgav_demuxer_next_packet(bgav_demuxer_context_t * demuxer);
 
+/* Like bgav_demuxer_next_packet() but doesn't touch the stream flags */
+
+int
+bgav_demuxer_next_packet_thread(bgav_demuxer_context_t * demuxer);
+
 /*
  *  Start a demuxer. Some demuxers (most notably quicktime)
  *  can contain nothing but urls for the real streams.
@@ -1477,6 +1511,23 @@ int bgav_demuxer_start(bgav_demuxer_context_t * ctx,
                        bgav_yml_node_t * yml);
 void bgav_demuxer_stop(bgav_demuxer_context_t * ctx);
 
+/* demuxthread.c */
+
+void bgav_demuxer_start_thread(bgav_demuxer_context_t * ctx);
+void bgav_demuxer_stop_thread(bgav_demuxer_context_t * ctx);
+
+void bgav_demuxer_thread_append(bgav_demuxer_thread_t * t,
+                                bgav_stream_t * s, bgav_packet_t * p);
+
+gavl_source_status_t
+bgav_demuxer_thread_get_packet(bgav_demuxer_thread_t * t,
+                               bgav_stream_t * s, bgav_packet_t ** ret);
+
+gavl_source_status_t
+bgav_demuxer_thread_peek_packet(bgav_demuxer_thread_t * t,
+                                bgav_stream_t * s, bgav_packet_t ** ret,
+                                int force);
+
 
 // bgav_packet_t *
 // bgav_demuxer_get_packet_write(bgav_demuxer_context_t * demuxer, int stream);
@@ -1892,6 +1943,7 @@ int bgav_set_sample_accurate(bgav_t * b);
 
 int64_t bgav_video_stream_keyframe_after(bgav_stream_t * s, int64_t time);
 int64_t bgav_video_stream_keyframe_before(bgav_stream_t * s, int64_t time);
+void bgav_video_stream_seek(bgav_stream_t * s, int64_t time);
 
 /* Translation specific stuff */
 
@@ -1927,6 +1979,27 @@ bgav_keyframe_table_t * bgav_keyframe_table_create_si(bgav_superindex_t * si,
 
 void bgav_keyframe_table_destroy(bgav_keyframe_table_t *);
 
+/* framecache.c */
+
+bgav_frame_cache_t * bgav_frame_cache_create(const gavl_video_format_t * format,
+                                             int size, int interval);
+
+void bgav_frame_cache_destroy(bgav_frame_cache_t *);
+
+/* Store frames (every interval frames after a seek) */
+void bgav_frame_cache_put(bgav_frame_cache_t *, const gavl_video_frame_t * f);
+
+/* Restart the interval after a seek */
+void bgav_frame_cache_seek(bgav_frame_cache_t *);
+
+/* Get the frame displayed at time */
+const gavl_video_frame_t * bgav_frame_cache_get(bgav_frame_cache_t *,
+                                                int64_t time);
+
+void bgav_frame_cache_count(bgav_frame_cache_t *, int hit);
+void bgav_frame_cache_get_stats(bgav_frame_cache_t *,
+                                int64_t * hits, int64_t * misses);
+
 /* formattracker.c */
 
 bgav_video_format_tracker_t *
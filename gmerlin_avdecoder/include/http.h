@@ -66,8 +66,27 @@ bgav_http_t * bgav_http_open(const char * url,
                              char ** redirect_url,
                              bgav_http_header_t* extra_header);
 
+/*
+ *  Like bgav_http_open but use a persistent connection. If the response
+ *  has a Content-Length and the body is read completely with
+ *  bgav_http_read, bgav_http_close returns the connection to a pool
+ *  for subsequent requests to the same server.
+ */
+
+bgav_http_t * bgav_http_open_keepalive(const char * url,
+                                       const bgav_options_t * opt,
+                                       char ** redirect_url,
+                                       bgav_http_header_t* extra_header);
+
 void bgav_http_close(bgav_http_t *);
 
+/* Read from the response body, never beyond its end */
+
+int bgav_http_read(bgav_http_t *, uint8_t * data, int len);
+
+int bgav_http_is_keepalive(bgav_http_t *);
+int bgav_http_was_reused(bgav_http_t *);
+
 int bgav_http_get_fd(bgav_http_t *);
 
 bgav_http_header_t* bgav_http_get_header(bgav_http_t *);
@@ -75,6 +75,19 @@ void bgav_transport_packet_dump(transport_packet_t * p);
 int bgav_transport_packet_parse(const bgav_options_t * opt,
                                 uint8_t ** data, transport_packet_t * ret);
 
+/* Batched header scan: Validates the sync bytes and extracts PIDs and
+   flags of many packets at once. Returns the number of consecutive
+   packets with a valid sync byte. */
+
+#define TS_HEADER_TRANSPORT_ERROR (1<<0)
+#define TS_HEADER_PAYLOAD_START   (1<<1)
+#define TS_HEADER_ADAPTION_FIELD  (1<<2)
+#define TS_HEADER_PAYLOAD         (1<<3)
+
+int bgav_transport_packet_scan(const uint8_t * data, int packet_size,
+                               int num_packets,
+                               uint16_t * pids, uint8_t * flags);
+
 
 /* Program association table section */
 
@@ -244,6 +244,8 @@ void bgav_close(bgav_t * b)
   
   if(b->is_running)
     {
+    if(b->demuxer)
+      bgav_demuxer_stop_thread(b->demuxer);
     bgav_track_stop(b->tt->cur);
     b->is_running = 0;
     }
@@ -289,6 +291,8 @@ const char * bgav_get_track_name(bgav_t * b, int track)
 
 void bgav_stop(bgav_t * b)
   {
+  if(b->demuxer)
+    bgav_demuxer_stop_thread(b->demuxer);
   bgav_track_stop(b->tt->cur);
   b->is_running = 0;
   }
@@ -342,6 +346,8 @@ int bgav_select_track(bgav_t * b, int track)
   
   if(b->is_running)
     {
+    if(b->demuxer)
+      bgav_demuxer_stop_thread(b->demuxer);
     bgav_track_stop(b->tt->cur);
     bgav_track_clear_eof_d(b->tt->cur);
     b->is_running = 0;
@@ -497,6 +503,8 @@ int bgav_start(bgav_t * b)
     {
     return 0;
     }
+  if(b->demuxer)
+    bgav_demuxer_start_thread(b->demuxer);
   return 1;
   }
 
@@ -221,6 +221,8 @@ static int open_dxa(bgav_demuxer_context_t * ctx)
   gavl_metadata_set(&ctx->tt->cur->metadata, 
                     GAVL_META_FORMAT, "DXA");
 
+  /* Audio and video are stored separately */
+  ctx->flags |= BGAV_DEMUXER_REQUEST_STREAM;
   return 1;
   }
 
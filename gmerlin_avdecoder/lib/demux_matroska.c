@@ -30,6 +30,24 @@
 
 #define LOG_DOMAIN "demux_matroska"
 
+/* Seek index, built from the cues or (for files without cues)
+   from the cluster headers */
+
+typedef struct
+  {
+  int64_t time;     /* Cluster timecode or CueTime */
+  int64_t position; /* Absolute file position of the cluster */
+  int64_t rel_pos;  /* Block position relative to the cluster data or 0 */
+  int64_t block;    /* Block number inside the cluster (1 = first) */
+  } mkv_index_entry_t;
+
+typedef struct
+  {
+  int num_entries;
+  int entries_alloc;
+  mkv_index_entry_t * entries;
+  } mkv_index_t;
+
 typedef struct
   {
   bgav_mkv_ebml_header_t ebml_header;
@@ -61,9 +79,379 @@ typedef struct
   int64_t cluster_pos; // Start position of last cluster
   
   bgav_mkv_chapters_t chapters;
+
+  mkv_index_t cue_index;
+  
+  /* Built lazily if we have no cues */
+  mkv_index_t cluster_index;
+  int cluster_index_complete;
+  gavl_time_t cluster_index_time; /* Time spent scanning */
   
   } mkv_t;
- 
+
+static void index_append(mkv_index_t * idx, int64_t time, int64_t position,
+                         int64_t rel_pos, int64_t block)
+  {
+  if(idx->num_entries + 1 > idx->entries_alloc)
+    {
+    idx->entries_alloc += 1024;
+    idx->entries = realloc(idx->entries,
+                           idx->entries_alloc * sizeof(*idx->entries));
+    }
+  idx->entries[idx->num_entries].time     = time;
+  idx->entries[idx->num_entries].position = position;
+  idx->entries[idx->num_entries].rel_pos  = rel_pos;
+  idx->entries[idx->num_entries].block    = block;
+  idx->num_entries++;
+  }
+
+/* Last entry with a time <= time or the first entry */
+
+static const mkv_index_entry_t * index_find(const mkv_index_t * idx, int64_t time)
+  {
+  int lo = 0, hi = idx->num_entries - 1, mid;
+
+  if(!idx->num_entries)
+    return NULL;
+  
+  while(lo < hi)
+    {
+    mid = (lo + hi + 1) / 2;
+    if(idx->entries[mid].time <= time)
+      lo = mid;
+    else
+      hi = mid - 1;
+    }
+  return &idx->entries[lo];
+  }
+
+static int compare_index_entry(const void * p1, const void * p2)
+  {
+  const mkv_index_entry_t * e1 = p1;
+  const mkv_index_entry_t * e2 = p2;
+
+  if(e1->time < e2->time)
+    return -1;
+  else if(e1->time > e2->time)
+    return 1;
+  return 0;
+  }
+
+/* Build the index from the cue points of one track. We prefer the first
+   video track, then the first audio track and finally the track of the
+   first cue point. */
+
+static void init_cue_index(mkv_t * p)
+  {
+  int i, j, k;
+  uint64_t tracks[3];
+  const bgav_mkv_cue_track_t * ct;
+
+  memset(tracks, 0, sizeof(tracks));
+  
+  for(i = 0; i < p->num_tracks; i++)
+    {
+    if((p->tracks[i].TrackType == MKV_TRACK_VIDEO) && !tracks[0])
+      tracks[0] = p->tracks[i].TrackNumber;
+    else if((p->tracks[i].TrackType == MKV_TRACK_AUDIO) && !tracks[1])
+      tracks[1] = p->tracks[i].TrackNumber;
+    }
+  if(p->cues.num_points && p->cues.points[0].num_tracks)
+    tracks[2] = p->cues.points[0].tracks[0].CueTrack;
+  
+  for(k = 0; k < 3; k++)
+    {
+    if(!tracks[k])
+      continue;
+    
+    for(i = 0; i < p->cues.num_points; i++)
+      {
+      for(j = 0; j < p->cues.points[i].num_tracks; j++)
+        {
+        ct = &p->cues.points[i].tracks[j];
+        if(ct->CueTrack == tracks[k])
+          {
+          index_append(&p->cue_index, p->cues.points[i].CueTime,
+                       ct->CueClusterPosition + p->segment_start,
+                       ct->CueRelativePosition, ct->CueBlockNumber);
+          break;
+          }
+        }
+      }
+    if(p->cue_index.num_entries)
+      break;
+    }
+  
+  /* Cues should be sorted but we don't rely on that */
+  qsort(p->cue_index.entries, p->cue_index.num_entries,
+        sizeof(*p->cue_index.entries), compare_index_entry);
+  }
+
+/* Cluster index */
+
+#define CLUSTER_INDEX_EXT ".mkvclusters"
+
+static int size_unknown(int64_t size)
+  {
+  int i;
+  for(i = 1; i <= 8; i++)
+    {
+    if(size == (1LL << (7*i)) - 1)
+      return 1;
+    }
+  return 0;
+  }
+
+static int is_cluster_child(int id)
+  {
+  switch(id)
+    {
+    case MKV_ID_Timecode:
+    case MKV_ID_SilentTracks:
+    case MKV_ID_Position:
+    case MKV_ID_PrevSize:
+    case MKV_ID_BlockGroup:
+    case MKV_ID_Block:
+    case MKV_ID_SimpleBlock:
+    case MKV_ID_Void:
+    case MKV_ID_CRC32:
+      return 1;
+    }
+  return 0;
+  }
+
+/* Read the cluster header at pos and leave the input at the first block */
+
+static int read_cluster_header(bgav_demuxer_context_t * ctx, int64_t pos,
+                               bgav_mkv_cluster_t * cluster,
+                               bgav_mkv_element_t * e, int64_t * data_start)
+  {
+  bgav_input_seek(ctx->input, pos, SEEK_SET);
+
+  if(!bgav_mkv_element_read(ctx->input, e) ||
+     (e->id != MKV_ID_Cluster))
+    return 0;
+
+  *data_start = ctx->input->position;
+  
+  if(!bgav_mkv_cluster_read(ctx->input, cluster, e))
+    return 0;
+  return 1;
+  }
+
+static void cluster_index_save(bgav_demuxer_context_t * ctx)
+  {
+  int i;
+  FILE * output;
+  char * filename;
+  char * index_file;
+  uint8_t buf[8];
+  mkv_t * p = ctx->priv;
+
+  if(!ctx->input->index_file || !ctx->input->filename)
+    return;
+
+  if(ctx->opt->cache_time &&
+     ((p->cluster_index_time*1000)/GAVL_TIME_SCALE < ctx->opt->cache_time))
+    return;
+  
+  index_file = bgav_sprintf("%s"CLUSTER_INDEX_EXT, ctx->input->index_file);
+  filename = bgav_search_file_write(ctx->opt, "indices", index_file);
+  free(index_file);
+
+  if(!filename)
+    return;
+  
+  if(!(output = fopen(filename, "w")))
+    {
+    free(filename);
+    return;
+    }
+  
+  bgav_file_index_write_header(ctx->input->filename, output, 1);
+
+  BGAV_32BE_2_PTR(p->cluster_index.num_entries, buf);
+  fwrite(buf, 4, 1, output);
+
+  for(i = 0; i < p->cluster_index.num_entries; i++)
+    {
+    BGAV_64BE_2_PTR(p->cluster_index.entries[i].position, buf);
+    fwrite(buf, 8, 1, output);
+    BGAV_64BE_2_PTR(p->cluster_index.entries[i].time, buf);
+    fwrite(buf, 8, 1, output);
+    }
+  fclose(output);
+  free(filename);
+  }
+
+static int cluster_index_load(bgav_demuxer_context_t * ctx)
+  {
+  int i;
+  int num_tracks;
+  uint32_t num_entries;
+  uint64_t position, time;
+  char * filename = NULL;
+  char * index_file;
+  bgav_input_context_t * input = NULL;
+  mkv_t * p = ctx->priv;
+  int ret = 0;
+  
+  if(!ctx->input->index_file || !ctx->input->filename)
+    return 0;
+
+  index_file = bgav_sprintf("%s"CLUSTER_INDEX_EXT, ctx->input->index_file);
+  filename = bgav_search_file_read(ctx->opt, "indices", index_file);
+  free(index_file);
+  
+  if(!filename)
+    goto fail;
+
+  input = bgav_input_create(ctx->opt);
+  if(!bgav_input_open(input, filename))
+    goto fail;
+  
+  if(!bgav_file_index_read_header(ctx->input->filename, input, &num_tracks) ||
+     (num_tracks != 1) ||
+     !bgav_input_read_32_be(input, &num_entries))
+    goto fail;
+
+  for(i = 0; i < num_entries; i++)
+    {
+    if(!bgav_input_read_64_be(input, &position) ||
+       !bgav_input_read_64_be(input, &time))
+      goto fail;
+    index_append(&p->cluster_index, time, position, 0, 1);
+    }
+  p->cluster_index_complete = 1;
+  ret = 1;
+  
+  fail:
+
+  if(!ret)
+    p->cluster_index.num_entries = 0;
+  
+  if(input)
+    bgav_input_destroy(input);
+  if(filename)
+    free(filename);
+  return ret;
+  }
+
+/* Called for each cluster during normal parsing. We append it only
+   if it follows the last indexed cluster so the index has no holes. */
+
+static void cluster_index_update(bgav_demuxer_context_t * ctx, int64_t pos)
+  {
+  mkv_t * p = ctx->priv;
+  mkv_index_t * idx = &p->cluster_index;
+  
+  if(p->have_cues || p->cluster_index_complete)
+    return;
+
+  if(idx->num_entries)
+    {
+    if((idx->entries[idx->num_entries-1].position != p->cluster_pos) ||
+       (pos <= p->cluster_pos))
+      return;
+    }
+  else if(pos != ctx->data_start)
+    return;
+  
+  index_append(idx, p->cluster.Timecode, pos, 0, 1);
+  }
+
+/* Append the next cluster to the index by skipping the blocks
+   of the last one. Returns 0 if the index is complete. */
+
+static int cluster_index_next(bgav_demuxer_context_t * ctx)
+  {
+  mkv_t * p = ctx->priv;
+  mkv_index_t * idx = &p->cluster_index;
+  bgav_mkv_element_t e;
+  bgav_mkv_cluster_t cluster;
+  int64_t pos, data_start;
+  int ret = 0;
+  gavl_timer_t * timer;
+  
+  if(p->cluster_index_complete)
+    return 0;
+
+  timer = gavl_timer_create();
+  gavl_timer_start(timer);
+  
+  memset(&cluster, 0, sizeof(cluster));
+  
+  if(!idx->num_entries)
+    pos = ctx->data_start;
+  else
+    {
+    /* Find the end of the last indexed cluster */
+    if(!read_cluster_header(ctx, idx->entries[idx->num_entries-1].position,
+                            &cluster, &e, &data_start))
+      goto end;
+    
+    if(!size_unknown(e.size))
+      bgav_input_seek(ctx->input, e.end, SEEK_SET);
+    else
+      {
+      /* Live streams: Skip the children one by one */
+      while(1)
+        {
+        pos = ctx->input->position;
+        if(!bgav_mkv_element_read(ctx->input, &e))
+          break;
+        if(!is_cluster_child(e.id))
+          {
+          bgav_input_seek(ctx->input, pos, SEEK_SET);
+          break;
+          }
+        bgav_input_skip(ctx->input, e.size);
+        }
+      }
+    pos = ctx->input->position;
+    }
+
+  /* Skip top level elements until the next cluster */
+  while(1)
+    {
+    if(ctx->input->total_bytes && (pos >= ctx->input->total_bytes))
+      goto end;
+    
+    bgav_input_seek(ctx->input, pos, SEEK_SET);
+    
+    if(!bgav_mkv_element_read(ctx->input, &e))
+      goto end;
+    
+    if(e.id == MKV_ID_Cluster)
+      break;
+    
+    if(size_unknown(e.size) || (e.id == MKV_ID_Segment))
+      goto end;
+    pos = e.end;
+    }
+
+  if(!read_cluster_header(ctx, pos, &cluster, &e, &data_start))
+    goto end;
+
+  index_append(idx, cluster.Timecode, pos, 0, 1);
+  ret = 1;
+  
+  end:
+
+  p->cluster_index_time += gavl_timer_get(timer);
+  gavl_timer_destroy(timer);
+  bgav_mkv_cluster_free(&cluster);
+
+  if(!ret)
+    {
+    p->cluster_index_complete = 1;
+    bgav_log(ctx->opt, BGAV_LOG_INFO, LOG_DOMAIN,
+             "Built cluster index (%d clusters)", idx->num_entries);
+    cluster_index_save(ctx);
+    }
+  return ret;
+  }
+
 static int probe_matroska(bgav_input_context_t * input)
   {
   bgav_mkv_ebml_header_t h;
@@ -844,9 +1232,21 @@ static int open_matroska(bgav_demuxer_context_t * ctx)
       gavl_seconds_to_time(p->segment_info.Duration * 
                            p->segment_info.TimecodeScale * 1.0e-9);
 
-  /* Set seekable flag */
-  if(p->have_cues && ctx->input->input->seek_byte)
-    ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
+  /* Set seekable flag. Without cues, we build a cluster index on demand */
+  if(ctx->input->input->seek_byte)
+    {
+    if(p->have_cues)
+      init_cue_index(p);
+    
+    if(p->cue_index.num_entries)
+      ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
+    else
+      {
+      p->have_cues = 0;
+      cluster_index_load(ctx);
+      ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
+      }
+    }
 
   if(!strcmp(p->ebml_header.DocType, "matroska"))
     gavl_metadata_set(&ctx->tt->cur->metadata, 
@@ -961,7 +1361,7 @@ static void setup_packet(mkv_t * m, bgav_stream_t * s,
     if(m->do_sync && !STREAM_HAS_SYNC(s))
       {
       p->pts =
-        gavl_time_rescale(m->segment_info.TimecodeScale/1000,
+        gavl_time_rescale(1000000000 / m->segment_info.TimecodeScale,
                           s->data.audio.format.samplerate,
                           pts);
       STREAM_SET_SYNC(s, p->pts);
@@ -977,7 +1377,11 @@ static void setup_packet(mkv_t * m, bgav_stream_t * s,
     {
     //    if(s->type == BGAV_STREAM_VIDEO)
     //      fprintf(stderr, "Video PTS: %"PRId64"\n", pts);
-    p->pts = pts;
+
+    /* Some codecs (e.g. A_MS/ACM) set the stream timescale to the
+       samplerate */
+    p->pts = gavl_time_rescale(1000000000 / m->segment_info.TimecodeScale,
+                               s->timescale, pts);
     if(m->do_sync && !STREAM_HAS_SYNC(s))
       STREAM_SET_SYNC(s, p->pts);
     if(keyframe)
@@ -1190,6 +1594,7 @@ static int next_packet_matroska(bgav_demuxer_context_t * ctx)
 
         if(priv->pts_offset == GAVL_TIME_UNDEFINED)
           priv->pts_offset = priv->cluster.Timecode;
+        cluster_index_update(ctx, pos);
         priv->cluster_pos = pos;
         break;
       case MKV_ID_BlockGroup:
@@ -1248,6 +1653,10 @@ static void close_matroska(bgav_demuxer_context_t * ctx)
   bgav_mkv_meta_seek_info_free(&priv->meta_seek_info);
   
   bgav_mkv_cues_free(&priv->cues);
+  if(priv->cue_index.entries)
+    free(priv->cue_index.entries);
+  if(priv->cluster_index.entries)
+    free(priv->cluster_index.entries);
   bgav_mkv_chapters_free(&priv->chapters);
   bgav_mkv_cluster_free(&priv->cluster);
   bgav_mkv_tags_free(priv->tags, priv->num_tags);
@@ -1260,35 +1669,126 @@ static void close_matroska(bgav_demuxer_context_t * ctx)
   free(priv);
   }
 
+/* Go to the cluster of an index entry and, if the entry tells us,
+   directly to the block */
+
+static void seek_to_entry(bgav_demuxer_context_t * ctx,
+                          const mkv_index_entry_t * entry)
+  {
+  bgav_mkv_element_t e;
+  int64_t data_start, pos, first_block;
+  int64_t block;
+  mkv_t * priv = ctx->priv;
+  
+  bgav_mkv_cluster_free(&priv->cluster);
+  memset(&priv->cluster, 0, sizeof(priv->cluster));
+  
+  if(!read_cluster_header(ctx, entry->position, &priv->cluster, &e, &data_start))
+    {
+    /* Let next_packet_matroska sort it out */
+    bgav_input_seek(ctx->input, entry->position, SEEK_SET);
+    return;
+    }
+  priv->cluster_pos = entry->position;
+  first_block = ctx->input->position;
+  
+  if(entry->rel_pos)
+    {
+    /* CueRelativePosition */
+    pos = data_start + entry->rel_pos;
+    
+    if((pos > first_block) &&
+       (size_unknown(e.size) || (pos < e.end)))
+      {
+      bgav_input_seek(ctx->input, pos, SEEK_SET);
+
+      if(bgav_mkv_element_read(ctx->input, &e) &&
+         ((e.id == MKV_ID_SimpleBlock) || (e.id == MKV_ID_BlockGroup)))
+        {
+        bgav_input_seek(ctx->input, pos, SEEK_SET);
+        return;
+        }
+      }
+    bgav_input_seek(ctx->input, first_block, SEEK_SET);
+    }
+  else if(entry->block > 1)
+    {
+    /* CueBlockNumber: Skip the blocks before */
+    block = 1;
+    pos = first_block;
+    
+    while(block < entry->block)
+      {
+      if(!bgav_mkv_element_read(ctx->input, &e) ||
+         !is_cluster_child(e.id))
+        break;
+      
+      bgav_input_skip(ctx->input, e.size);
+      
+      if((e.id == MKV_ID_SimpleBlock) ||
+         (e.id == MKV_ID_BlockGroup) ||
+         (e.id == MKV_ID_Block))
+        {
+        block++;
+        pos = ctx->input->position;
+        }
+      }
+    bgav_input_seek(ctx->input, pos, SEEK_SET);
+    }
+  }
+
 static void
 seek_matroska(bgav_demuxer_context_t * ctx, int64_t time, int scale)
   {
   int64_t time_scaled;
-  int i;
+  const mkv_index_entry_t * entry;
   mkv_t * priv = ctx->priv;
+  bgav_mkv_element_t e;
+  int64_t data_start;
+  
+  /* Timecodes of the clusters are absolute, so we need the offset */
+  if(priv->pts_offset == GAVL_TIME_UNDEFINED)
+    {
+    if(read_cluster_header(ctx, ctx->data_start, &priv->cluster, &e, &data_start))
+      priv->pts_offset = priv->cluster.Timecode;
+    else
+      priv->pts_offset = 0;
+    }
   
   time_scaled = gavl_time_rescale(scale,
-                                  priv->segment_info.TimecodeScale/1000, time);
+                                  1000000000 / priv->segment_info.TimecodeScale,
+                                  time) +
+    priv->pts_offset;
 
-  for(i = priv->cues.num_points - 1; i >= 0; i--)
+  if(priv->cue_index.num_entries)
+    entry = index_find(&priv->cue_index, time_scaled);
+  else
     {
-    if(priv->cues.points[i].CueTime <= time_scaled)
-      break;
+    /* Make sure we indexed the cluster after the seek point */
+    while(!priv->cluster_index.num_entries ||
+          (priv->cluster_index.entries[priv->cluster_index.num_entries-1].time <=
+           time_scaled))
+      {
+      if(!cluster_index_next(ctx))
+        break;
+      }
+    entry = index_find(&priv->cluster_index, time_scaled);
     }
-  if(i < 0)
-    i = 0;
   
-  bgav_input_seek(ctx->input,
-                  priv->cues.points[i].tracks[0].CueClusterPosition +
-                  priv->segment_start, SEEK_SET);
-
+  if(entry)
+    seek_to_entry(ctx, entry);
+  else
+    bgav_input_seek(ctx->input, ctx->data_start, SEEK_SET);
+  
   /* Resync */
 
   priv->do_sync = 1;
   
   while(!bgav_track_has_sync(ctx->tt->cur))
-    next_packet_matroska(ctx);
-
+    {
+    if(!next_packet_matroska(ctx))
+      break;
+    }
   priv->do_sync = 0;
   }
 
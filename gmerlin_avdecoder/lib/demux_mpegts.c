@@ -100,6 +100,8 @@ typedef struct
   int64_t last_pts;
   int64_t pts_offset;
   int64_t pts_offset_2nd;
+
+  int program; /* For the track with all programs */
   } stream_priv_t;
 
 typedef struct
@@ -121,6 +123,10 @@ typedef struct
   pmt_section_t pmts;
   
   stream_priv_t * streams;
+
+  /* Timestamp offset if the track with all programs is selected */
+  int64_t timestamp_offset;
+  int have_timestamp_offset;
   } program_priv_t;
 
 static void init_streams_priv(program_priv_t * program,
@@ -219,6 +225,11 @@ typedef struct
   int64_t first_packet_pos;
 
   int current_program;
+
+  /* Track with the streams of all programs (or -1) */
+  int all_programs_track;
+  stream_priv_t * all_programs_streams;
+  int all_programs; /* Track with all programs is selected */
   
   transport_packet_t packet;
 
@@ -227,6 +238,11 @@ typedef struct
   uint8_t * packet_start; 
   
   int buffer_size;
+
+  /* PIDs and header flags of the packets in the buffer */
+  uint16_t * pids;
+  uint8_t * flags;
+  
   int do_sync;
 
   int error_counter;
@@ -513,6 +529,7 @@ static int get_program_durations(bgav_demuxer_context_t * ctx)
   int program_index = -1;
   int64_t total_packets;
   int64_t position;
+  bgav_track_t * track;
   
   priv = ctx->priv;
   
@@ -636,6 +653,19 @@ static int get_program_durations(bgav_demuxer_context_t * ctx)
         return 0;
       }
     }
+
+  if(priv->all_programs_track >= 0)
+    {
+    track = &ctx->tt->tracks[priv->all_programs_track];
+    track->duration = 0;
+    
+    for(i = 0; i < priv->num_programs; i++)
+      {
+      if(priv->programs[i].initialized &&
+         (track->duration < ctx->tt->tracks[i].duration))
+        track->duration = ctx->tt->tracks[i].duration;
+      }
+    }
   return 1;
   }
 
@@ -645,6 +675,93 @@ static int get_program_durations(bgav_demuxer_context_t * ctx)
  *  of the parsed buffer.
  */
 
+/* Track with all programs: The streams are set up from the PMTs like
+   the ones of the single programs. The label of each stream tells
+   the program. */
+
+static void init_all_programs_track(bgav_demuxer_context_t * ctx)
+  {
+  int i, j;
+  int program;
+  int num_streams;
+  int index;
+  char * label;
+  bgav_track_t * track;
+  bgav_track_t * program_track;
+  mpegts_t * priv = ctx->priv;
+
+  track = &ctx->tt->tracks[priv->all_programs_track];
+  
+  for(program = 0; program < priv->num_programs; program++)
+    {
+    if(!priv->programs[program].initialized)
+      continue;
+    bgav_pmt_section_setup_track(&priv->programs[program].pmts,
+                                 track, ctx->opt, -1, -1, -1, NULL, NULL);
+    }
+  
+  num_streams = track->num_audio_streams + track->num_video_streams;
+  priv->all_programs_streams =
+    calloc(num_streams, sizeof(*priv->all_programs_streams));
+  
+  /* Get the program of each stream */
+  index = 0;
+  for(program = 0; program < priv->num_programs; program++)
+    {
+    if(!priv->programs[program].initialized)
+      continue;
+    
+    program_track = &ctx->tt->tracks[program];
+    
+    label = bgav_sprintf("Program %d",
+                         priv->programs[program].pmts.program_number);
+    
+    for(i = 0; i < program_track->num_audio_streams; i++)
+      {
+      for(j = 0; j < track->num_audio_streams; j++)
+        {
+        if(!track->audio_streams[j].priv &&
+           (track->audio_streams[j].stream_id ==
+            program_track->audio_streams[i].stream_id))
+          {
+          priv->all_programs_streams[index].last_pts =
+            BGAV_TIMESTAMP_UNDEFINED;
+          priv->all_programs_streams[index].program = program;
+          track->audio_streams[j].priv = &priv->all_programs_streams[index];
+          gavl_metadata_set(&track->audio_streams[j].m,
+                            GAVL_META_LABEL, label);
+          index++;
+          break;
+          }
+        }
+      }
+    for(i = 0; i < program_track->num_video_streams; i++)
+      {
+      for(j = 0; j < track->num_video_streams; j++)
+        {
+        if(!track->video_streams[j].priv &&
+           (track->video_streams[j].stream_id ==
+            program_track->video_streams[i].stream_id))
+          {
+          priv->all_programs_streams[index].last_pts =
+            BGAV_TIMESTAMP_UNDEFINED;
+          priv->all_programs_streams[index].program = program;
+          track->video_streams[j].priv = &priv->all_programs_streams[index];
+          gavl_metadata_set(&track->video_streams[j].m,
+                            GAVL_META_LABEL, label);
+          index++;
+          break;
+          }
+        }
+      }
+    free(label);
+    }
+  
+  gavl_metadata_set(&track->metadata, GAVL_META_FORMAT, "MPEGTS");
+  gavl_metadata_set(&track->metadata, GAVL_META_MIMETYPE, "video/MP2T");
+  gavl_metadata_set(&track->metadata, GAVL_META_LABEL, "All programs");
+  }
+
 static int init_psi(bgav_demuxer_context_t * ctx,
                     int input_can_seek)
   {
@@ -690,7 +807,16 @@ static int init_psi(bgav_demuxer_context_t * ctx,
   /* Allocate programs and track table */
   
   priv->programs = calloc(priv->num_programs, sizeof(*(priv->programs)));
-  ctx->tt = bgav_track_table_create(priv->num_programs);
+
+  /* Streams keep a pointer to their track, so the track with all
+     programs must be created here */
+  if(ctx->opt->all_programs && (priv->num_programs > 1))
+    {
+    ctx->tt = bgav_track_table_create(priv->num_programs + 1);
+    priv->all_programs_track = priv->num_programs;
+    }
+  else
+    ctx->tt = bgav_track_table_create(priv->num_programs);
   
   /* Assign program map pids */
 
@@ -814,6 +940,10 @@ static int init_psi(bgav_demuxer_context_t * ctx,
 #endif
       }
     }
+
+  if(priv->all_programs_track >= 0)
+    init_all_programs_track(ctx);
+  
   return 1;
   }
 
@@ -1090,7 +1220,8 @@ static int open_mpegts(bgav_demuxer_context_t * ctx)
   
   priv = calloc(1, sizeof(*priv));
   ctx->priv = priv;
-
+  priv->all_programs_track = -1;
+  
   priv->packet_size = guess_packet_size(ctx->input);
 
   if(ctx->input->input->seek_byte)
@@ -1109,6 +1240,8 @@ static int open_mpegts(bgav_demuxer_context_t * ctx)
              priv->packet_size);
   
   priv->buffer = malloc(priv->packet_size * SCAN_PACKETS);
+  priv->pids   = malloc(SCAN_PACKETS * sizeof(*priv->pids));
+  priv->flags  = malloc(SCAN_PACKETS * sizeof(*priv->flags));
 
   
   priv->input_mem =
@@ -1474,14 +1607,90 @@ static void predict_pcr_wrap(const bgav_options_t * opt, int64_t pcr)
   }
 #endif
 
-#define NUM_PACKETS 5 /* Packets to be processed at once */
+#define NUM_PACKETS 32 /* Packets to be processed at once */
 
-static int process_packet(bgav_demuxer_context_t * ctx)
+/* Fill the packet from the batched header scan. Packets with
+   adaption field or transport errors go through the full parser */
+
+static inline int
+parse_transport_packet_fast(bgav_demuxer_context_t * ctx, int index)
+  {
+  mpegts_t * priv = ctx->priv;
+  uint8_t flags = priv->flags[index];
+
+  if(flags & (TS_HEADER_TRANSPORT_ERROR|TS_HEADER_ADAPTION_FIELD))
+    return parse_transport_packet(ctx);
+  
+  priv->packet.transport_error = 0;
+  priv->packet.pid = priv->pids[index];
+  priv->packet.payload_start = !!(flags & TS_HEADER_PAYLOAD_START);
+  priv->packet.has_adaption_field = 0;
+  priv->packet.has_payload = !!(flags & TS_HEADER_PAYLOAD);
+  priv->packet.continuity_counter = priv->ptr[3] & 0x0f;
+  priv->packet.payload_size = 184;
+  priv->packet.adaption_field.pcr = -1;
+  priv->ptr += 4;
+  
+  priv->error_counter = 0;
+  return 1;
+  }
+
+/* Append the payloads of num consecutive packets starting with
+   the current one. All but the first are known to have no
+   adaption field. */
+
+static void append_payloads(mpegts_t * priv, bgav_packet_t * p, int num)
   {
   int i;
-  bgav_stream_t * s;
+  int size;
+  uint8_t * ptr;
+  
+  size = p->data_size + priv->packet.payload_size + (num - 1) * 184;
+
+  /* PES packets of video streams span hundreds of transport packets,
+     so grow exponentially */
+  if(size + GAVL_PACKET_PADDING > p->data_alloc)
+    bgav_packet_alloc(p, size < 2 * p->data_alloc ? 2 * p->data_alloc : size);
+  
+  memcpy(p->data + p->data_size, priv->ptr, priv->packet.payload_size);
+  p->data_size += priv->packet.payload_size;
+
+  ptr = priv->packet_start;
+  for(i = 1; i < num; i++)
+    {
+    ptr += priv->packet_size;
+    memcpy(p->data + p->data_size, ptr + 4, 184);
+    p->data_size += 184;
+    }
+  bgav_packet_pad(p);
+  }
+
+/* Track with all programs: Get the timestamp offsets from the PCRs */
+
+static void check_program_pcr(mpegts_t * priv)
+  {
+  int i;
+  for(i = 0; i < priv->num_programs; i++)
+    {
+    if((priv->programs[i].pcr_pid == priv->packet.pid) &&
+       !priv->programs[i].have_timestamp_offset)
+      {
+      priv->programs[i].timestamp_offset = -priv->packet.adaption_field.pcr;
+      priv->programs[i].have_timestamp_offset = 1;
+      }
+    }
+  }
+
+static int process_packet(bgav_demuxer_context_t * ctx)
+  {
+  int i, j;
+  bgav_stream_t * s = NULL;
+  int last_pid = -1;
+  int64_t timestamp_offset;
+  program_priv_t * program;
   mpegts_t * priv;
   int num_packets;
+  int num_valid;
   int bytes_to_copy;
   bgav_pes_header_t pes_header;
   int64_t position;
@@ -1507,10 +1716,20 @@ static int process_packet(bgav_demuxer_context_t * ctx)
   priv->packet_start = priv->buffer;
   
   num_packets = priv->buffer_size / priv->packet_size;
+
+  /* Validate sync bytes and get PIDs and flags of all packets at once */
+  num_valid = bgav_transport_packet_scan(priv->buffer, priv->packet_size,
+                                         num_packets,
+                                         priv->pids, priv->flags);
   
   for(i = 0; i < num_packets; i++)
     {
-    if(!parse_transport_packet(ctx))
+    if(i < num_valid)
+      {
+      if(!parse_transport_packet_fast(ctx, i))
+        return 0;
+      }
+    else if(!parse_transport_packet(ctx))
       {
       return 0;
       }
@@ -1522,6 +1741,9 @@ static int process_packet(bgav_demuxer_context_t * ctx)
       }
     
     
+    if(priv->all_programs && (priv->packet.adaption_field.pcr >= 0))
+      check_program_pcr(priv);
+    
 #if 1
     //    bgav_transport_packet_dump(&priv->packet);
         
@@ -1611,7 +1833,11 @@ static int process_packet(bgav_demuxer_context_t * ctx)
         }
 #endif
     
-    s = bgav_track_find_stream(ctx, priv->packet.pid);
+    if(priv->packet.pid != last_pid)
+      {
+      s = bgav_track_find_stream(ctx, priv->packet.pid);
+      last_pid = priv->packet.pid;
+      }
     
     if(!s)
       {
@@ -1658,6 +1884,29 @@ static int process_packet(bgav_demuxer_context_t * ctx)
         ctx->flags |= BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET;
         }
 #endif
+
+      if(priv->all_programs)
+        {
+        program =
+          &priv->programs[((stream_priv_t*)s->priv)->program];
+        
+        if(!program->have_timestamp_offset)
+          {
+          /* Wait for the PCR or the first PES timestamp */
+          if((program->pcr_pid > 0) || (pes_header.pts < 0))
+            {
+            next_packet(priv);
+            position += priv->packet_size;
+            continue;
+            }
+          program->timestamp_offset = -pes_header.pts;
+          program->have_timestamp_offset = 1;
+          }
+        timestamp_offset = program->timestamp_offset;
+        }
+      else
+        timestamp_offset = ctx->timestamp_offset;
+      
       if(!s->packet)
         {
         if(priv->do_sync)
@@ -1675,7 +1924,7 @@ static int process_packet(bgav_demuxer_context_t * ctx)
             }
           else
             {
-            STREAM_SET_SYNC(s, pes_header.pts + ctx->timestamp_offset);
+            STREAM_SET_SYNC(s, pes_header.pts + timestamp_offset);
             s->packet = bgav_stream_get_packet_write(s);
             s->packet->position = position;
             }
@@ -1712,20 +1961,32 @@ static int process_packet(bgav_demuxer_context_t * ctx)
         {
         s->packet->pts = pes_header.pts;
         check_pts_wrap(s, &s->packet->pts);
-        s->packet->pts += ctx->timestamp_offset;
+        s->packet->pts += timestamp_offset;
         }
       }
     else if(s->packet)
       {
-      /* Read data */
+      /* Read data of this and all directly following
+         continuation packets of the same PID */
+      j = 1;
       
-      bgav_packet_alloc(s->packet,
-                        s->packet->data_size +
-                        priv->packet.payload_size);
+      if(ctx->flags & BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET)
+        {
+        while((i + j < num_valid) &&
+              (priv->pids[i + j] == priv->packet.pid) &&
+              (priv->flags[i + j] == TS_HEADER_PAYLOAD))
+          j++;
+        }
       
-      memcpy(s->packet->data + s->packet->data_size, priv->ptr,
-             priv->packet.payload_size);
-      s->packet->data_size  += priv->packet.payload_size;
+      append_payloads(priv, s->packet, j);
+
+      /* Skip the appended packets */
+      while(--j)
+        {
+        next_packet(priv);
+        position += priv->packet_size;
+        i++;
+        }
       }
     next_packet(priv);
     position += priv->packet_size;
@@ -1836,6 +2097,12 @@ static void close_mpegts(bgav_demuxer_context_t * ctx)
     }
   if(priv->buffer)
     free(priv->buffer);
+  if(priv->pids)
+    free(priv->pids);
+  if(priv->flags)
+    free(priv->flags);
+  if(priv->all_programs_streams)
+    free(priv->all_programs_streams);
   if(priv->programs)
     {
     for(i = 0; i < priv->num_programs; i++)
@@ -1851,18 +2118,43 @@ static void close_mpegts(bgav_demuxer_context_t * ctx)
 static int select_track_mpegts(bgav_demuxer_context_t * ctx,
                                 int track)
   {
+  int i;
   mpegts_t * priv;
   priv = ctx->priv;
-  priv->current_program = track;
   priv->error_counter = 0;
-  
-  if(ctx->flags & BGAV_DEMUXER_CAN_SEEK)
+
+  if(track == priv->all_programs_track)
     {
+    /* Each program has its own timestamp offset */
+    priv->all_programs = 1;
+    priv->current_program = 0;
+    
+    for(i = 0; i < priv->num_programs; i++)
+      {
+      if(ctx->flags & BGAV_DEMUXER_CAN_SEEK)
+        {
+        priv->programs[i].have_timestamp_offset = 1;
+        priv->programs[i].timestamp_offset = -priv->programs[i].start_pcr;
+        }
+      else
+        priv->programs[i].have_timestamp_offset = 0;
+      }
     ctx->flags |= BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET;
-    ctx->timestamp_offset = -priv->programs[track].start_pcr;
+    ctx->timestamp_offset = 0;
     }
   else
-    ctx->flags &= ~BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET;
+    {
+    priv->all_programs = 0;
+    priv->current_program = track;
+  
+    if(ctx->flags & BGAV_DEMUXER_CAN_SEEK)
+      {
+      ctx->flags |= BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET;
+      ctx->timestamp_offset = -priv->programs[track].start_pcr;
+      }
+    else
+      ctx->flags &= ~BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET;
+    }
 
   reset_streams_priv(ctx->tt->cur);
   
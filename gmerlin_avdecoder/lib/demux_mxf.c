@@ -637,7 +637,7 @@ static int open_mxf(bgav_demuxer_context_t * ctx)
     build_edl_mxf(ctx);    
   
   ctx->data_start = priv->mxf.data_start;
-  ctx->flags |= BGAV_DEMUXER_HAS_DATA_START;
+  ctx->flags |= BGAV_DEMUXER_HAS_DATA_START | BGAV_DEMUXER_REQUEST_STREAM;
 
   /* Decide index mode */
   ctx->index_mode = INDEX_MODE_MIXED;
@@ -913,6 +913,11 @@ int bgav_demux_rm_open_with_header(bgav_demuxer_context_t * ctx,
 
   ctx->data_start = ctx->input->position;
   ctx->flags |= BGAV_DEMUXER_HAS_DATA_START;
+
+  /* Multirate streams are stored separately and next_packet() reads
+     the one, which needs data */
+  if(priv->is_multirate)
+    ctx->flags |= BGAV_DEMUXER_REQUEST_STREAM;
   
   return 1;
   }
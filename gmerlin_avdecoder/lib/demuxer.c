@@ -325,6 +325,8 @@ bgav_demuxer_create(const bgav_options_t * opt, const bgav_demuxer_t * demuxer,
 
 void bgav_demuxer_destroy(bgav_demuxer_context_t * ctx)
   {
+  bgav_demuxer_stop_thread(ctx);
+  
   if(ctx->demuxer->close)
     ctx->demuxer->close(ctx);
   if(ctx->tt)
@@ -510,6 +512,8 @@ int bgav_demuxer_start(bgav_demuxer_context_t * ctx,
 
 void bgav_demuxer_stop(bgav_demuxer_context_t * ctx)
   {
+  bgav_demuxer_stop_thread(ctx);
+  
   ctx->demuxer->close(ctx);
   ctx->priv = NULL;
     
@@ -647,9 +651,39 @@ static int next_packet_noninterleaved(bgav_demuxer_context_t * ctx)
   
   }
 
+/* Some demuxers have packets stored in the streams,
+   we flush them at EOF */
+
+static int flush_packets(bgav_demuxer_context_t * demuxer)
+  {
+  int i, ret = 0;
+  
+  for(i = 0; i < demuxer->tt->cur->num_audio_streams; i++)
+    {
+    if(demuxer->tt->cur->audio_streams[i].packet)
+      {
+      bgav_stream_done_packet_write(&demuxer->tt->cur->audio_streams[i],
+                                    demuxer->tt->cur->audio_streams[i].packet);
+      demuxer->tt->cur->audio_streams[i].packet = NULL;
+      ret = 1;
+      }
+    }
+  for(i = 0; i < demuxer->tt->cur->num_video_streams; i++)
+    {
+    if(demuxer->tt->cur->video_streams[i].packet)
+      {
+      bgav_stream_done_packet_write(&demuxer->tt->cur->video_streams[i],
+                                    demuxer->tt->cur->video_streams[i].packet);
+      demuxer->tt->cur->video_streams[i].packet = NULL;
+      ret = 1;
+      }
+    }
+  return ret;
+  }
+
 int bgav_demuxer_next_packet(bgav_demuxer_context_t * demuxer)
   {
-  int ret = 0, i;
+  int ret = 0;
   //   fprintf(stderr, "bgav_demuxer_next_packet\n");
   switch(demuxer->demux_mode)
     {
@@ -679,29 +713,7 @@ int bgav_demuxer_next_packet(bgav_demuxer_context_t * demuxer)
       
       if(!ret)
         {
-        /* Some demuxers have packets stored in the streams,
-           we flush them here */
-        
-        for(i = 0; i < demuxer->tt->cur->num_audio_streams; i++)
-          {
-          if(demuxer->tt->cur->audio_streams[i].packet)
-            {
-            bgav_stream_done_packet_write(&demuxer->tt->cur->audio_streams[i],
-                                          demuxer->tt->cur->audio_streams[i].packet);
-            demuxer->tt->cur->audio_streams[i].packet = NULL;
-            ret = 1;
-            }
-          }
-        for(i = 0; i < demuxer->tt->cur->num_video_streams; i++)
-          {
-          if(demuxer->tt->cur->video_streams[i].packet)
-            {
-            bgav_stream_done_packet_write(&demuxer->tt->cur->video_streams[i],
-                                          demuxer->tt->cur->video_streams[i].packet);
-            demuxer->tt->cur->video_streams[i].packet = NULL;
-            ret = 1;
-            }
-          }
+        ret = flush_packets(demuxer);
         bgav_track_set_eof_d(demuxer->tt->cur);
         }
       break;
@@ -710,11 +722,30 @@ int bgav_demuxer_next_packet(bgav_demuxer_context_t * demuxer)
   return ret;
   }
 
+int bgav_demuxer_next_packet_thread(bgav_demuxer_context_t * demuxer)
+  {
+  switch(demuxer->demux_mode)
+    {
+    case DEMUX_MODE_SI_I:
+      return bgav_demuxer_next_packet_interleaved(demuxer);
+      break;
+    case DEMUX_MODE_STREAM:
+      if(demuxer->demuxer->next_packet(demuxer))
+        return 1;
+      flush_packets(demuxer);
+      break;
+    }
+  return 0;
+  }
+
 gavl_source_status_t
 bgav_demuxer_get_packet_read(void * stream1, bgav_packet_t ** ret)
   {
   bgav_stream_t * s = stream1;
   bgav_demuxer_context_t * demuxer = s->demuxer;
+
+  if(demuxer->thread)
+    return bgav_demuxer_thread_get_packet(demuxer->thread, s, ret);
   
   demuxer->request_stream = s;
   
@@ -747,6 +778,9 @@ bgav_demuxer_peek_packet_read(void * stream1, bgav_packet_t ** ret,
   if(demuxer->flags & BGAV_DEMUXER_PEEK_FORCES_READ)
     force = 1;
 
+  if(demuxer->thread)
+    return bgav_demuxer_thread_peek_packet(demuxer->thread, s, ret, force);
+
   p = bgav_packet_buffer_peek_packet_read(s->packet_buffer);
 
   if(p)
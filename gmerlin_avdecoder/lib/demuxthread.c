@@ -0,0 +1,339 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Optional demuxer thread: Reads ahead and distributes the packets
+ *  into the packet buffers of the streams, while the streams are
+ *  decoded in other threads.
+ *
+ *  The packet buffers themselves are lock-free, the mutex protects the
+ *  fill levels and is used for sleeping when there is nothing to do.
+ *  The thread pauses, when all A/V streams have at least the configured
+ *  time buffered or the total buffer size exceeds MAX_BUFFER_BYTES.
+ *  It always continues, if a stream waits for a packet, so a stream,
+ *  which is not read at all, can never block the others.
+ *
+ *  The thread is stopped before seeking, track switching and stopping
+ *  and is restarted afterwards, so all other operations on the demuxer
+ *  happen with the thread stopped.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <avdec_private.h>
+
+#define LOG_DOMAIN "demuxthread"
+
+#define MAX_BUFFER_BYTES (64*1024*1024)
+
+struct bgav_demuxer_thread_s
+  {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t read_cond;  /* Signalled after packets were appended */
+  pthread_cond_t write_cond; /* Signalled after packets were consumed */
+  
+  bgav_demuxer_context_t * demuxer;
+  gavl_time_t buffer_time;
+  
+  int do_stop;
+  int eof;
+  int paused;
+  int num_waiting; /* Number of readers waiting for packets */
+  int64_t bytes;
+  };
+
+/* Fill levels */
+
+static int64_t packet_time(bgav_packet_t * p)
+  {
+  return (p->pts != GAVL_TIME_UNDEFINED) ? p->pts : p->dts;
+  }
+
+static int stream_full(bgav_demuxer_thread_t * t, bgav_stream_t * s)
+  {
+  if(s->action == BGAV_STREAM_MUTE)
+    return 1;
+  
+  if(!s->timescale ||
+     (s->dt_in_time == GAVL_TIME_UNDEFINED) ||
+     (s->dt_out_time == GAVL_TIME_UNDEFINED))
+    return 0;
+
+  return gavl_time_unscale(s->timescale, s->dt_in_time - s->dt_out_time) >=
+    t->buffer_time;
+  }
+
+static int buffer_full(bgav_demuxer_thread_t * t)
+  {
+  int i;
+  bgav_track_t * track = t->demuxer->tt->cur;
+  
+  if(t->num_waiting)
+    return 0;
+  if(t->bytes >= MAX_BUFFER_BYTES)
+    return 1;
+
+  /* Subtitles are too sparse to be considered here */
+  
+  for(i = 0; i < track->num_audio_streams; i++)
+    {
+    if(!stream_full(t, &track->audio_streams[i]))
+      return 0;
+    }
+  for(i = 0; i < track->num_video_streams; i++)
+    {
+    if(!stream_full(t, &track->video_streams[i]))
+      return 0;
+    }
+  return 1;
+  }
+
+static void reset_stream(bgav_stream_t * s)
+  {
+  s->dt_in_time = GAVL_TIME_UNDEFINED;
+  s->dt_out_time = GAVL_TIME_UNDEFINED;
+  }
+
+static void reset_streams(bgav_track_t * t)
+  {
+  int i;
+  for(i = 0; i < t->num_audio_streams; i++)
+    reset_stream(&t->audio_streams[i]);
+  for(i = 0; i < t->num_video_streams; i++)
+    reset_stream(&t->video_streams[i]);
+  for(i = 0; i < t->num_text_streams; i++)
+    reset_stream(&t->text_streams[i]);
+  for(i = 0; i < t->num_overlay_streams; i++)
+    reset_stream(&t->overlay_streams[i]);
+  }
+
+static void * thread_func(void * data)
+  {
+  int result;
+  bgav_demuxer_thread_t * t = data;
+  
+  pthread_mutex_lock(&t->mutex);
+  
+  while(1)
+    {
+    while(!t->do_stop && buffer_full(t))
+      {
+      t->paused = 1;
+      pthread_cond_wait(&t->write_cond, &t->mutex);
+      t->paused = 0;
+      }
+    if(t->do_stop)
+      break;
+    
+    pthread_mutex_unlock(&t->mutex);
+    result = bgav_demuxer_next_packet_thread(t->demuxer);
+    pthread_mutex_lock(&t->mutex);
+    
+    if(!result)
+      {
+      t->eof = 1;
+      pthread_cond_broadcast(&t->read_cond);
+      break;
+      }
+    }
+  
+  pthread_mutex_unlock(&t->mutex);
+  return NULL;
+  }
+
+void bgav_demuxer_start_thread(bgav_demuxer_context_t * ctx)
+  {
+  bgav_demuxer_thread_t * t;
+  
+  if((ctx->opt->demuxer_buffer <= 0) || ctx->thread ||
+     (ctx->flags & BGAV_DEMUXER_REQUEST_STREAM) ||
+     (ctx->tt->cur->flags & TRACK_SAMPLE_ACCURATE) ||
+     ((ctx->demux_mode != DEMUX_MODE_STREAM) &&
+      (ctx->demux_mode != DEMUX_MODE_SI_I)))
+    return;
+
+  /* Nothing left to read */
+  if(bgav_track_eof_d(ctx->tt->cur))
+    return;
+  
+  t = calloc(1, sizeof(*t));
+  t->demuxer = ctx;
+  t->buffer_time = gavl_time_unscale(1000, ctx->opt->demuxer_buffer);
+  
+  pthread_mutex_init(&t->mutex, NULL);
+  pthread_cond_init(&t->read_cond, NULL);
+  pthread_cond_init(&t->write_cond, NULL);
+
+  reset_streams(ctx->tt->cur);
+  
+  ctx->thread = t;
+  
+  if(pthread_create(&t->thread, NULL, thread_func, t))
+    {
+    bgav_log(ctx->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+             "Creating demuxer thread failed, demultiplexing synchronously");
+    ctx->thread = NULL;
+    pthread_mutex_destroy(&t->mutex);
+    pthread_cond_destroy(&t->read_cond);
+    pthread_cond_destroy(&t->write_cond);
+    free(t);
+    }
+  }
+
+void bgav_demuxer_stop_thread(bgav_demuxer_context_t * ctx)
+  {
+  bgav_demuxer_thread_t * t = ctx->thread;
+  
+  if(!t)
+    return;
+  
+  pthread_mutex_lock(&t->mutex);
+  t->do_stop = 1;
+  pthread_cond_broadcast(&t->write_cond);
+  pthread_mutex_unlock(&t->mutex);
+  
+  pthread_join(t->thread, NULL);
+
+  /* Packets still in the buffers are the next ones from the current
+     position, so synchronous demultiplexing can continue with them. If
+     the thread reached the end, streams get their EOF flag when their
+     buffer is empty. */
+  
+  if(t->eof)
+    bgav_track_set_eof_d(ctx->tt->cur);
+  
+  ctx->thread = NULL;
+  
+  pthread_mutex_destroy(&t->mutex);
+  pthread_cond_destroy(&t->read_cond);
+  pthread_cond_destroy(&t->write_cond);
+  free(t);
+  }
+
+/* Called from bgav_stream_done_packet_write() in the demuxer thread */
+
+void bgav_demuxer_thread_append(bgav_demuxer_thread_t * t,
+                                bgav_stream_t * s, bgav_packet_t * p)
+  {
+  int64_t time = packet_time(p);
+  
+  pthread_mutex_lock(&t->mutex);
+  
+  bgav_packet_buffer_append(s->packet_buffer, p);
+  t->bytes += p->data_size;
+
+  if(time != GAVL_TIME_UNDEFINED)
+    {
+    if((s->dt_in_time == GAVL_TIME_UNDEFINED) || (time > s->dt_in_time))
+      s->dt_in_time = time;
+    if(s->dt_out_time == GAVL_TIME_UNDEFINED)
+      s->dt_out_time = time;
+    }
+  
+  if(t->num_waiting)
+    pthread_cond_broadcast(&t->read_cond);
+  
+  pthread_mutex_unlock(&t->mutex);
+  }
+
+/* Called with the mutex locked. Returns 0 on EOF */
+
+static int wait_packet(bgav_demuxer_thread_t * t, bgav_stream_t * s)
+  {
+  while(!bgav_packet_buffer_peek_packet_read(s->packet_buffer))
+    {
+    if(t->eof)
+      return 0;
+    
+    t->num_waiting++;
+    if(t->paused)
+      pthread_cond_signal(&t->write_cond);
+    pthread_cond_wait(&t->read_cond, &t->mutex);
+    t->num_waiting--;
+    }
+  return 1;
+  }
+
+gavl_source_status_t
+bgav_demuxer_thread_get_packet(bgav_demuxer_thread_t * t,
+                               bgav_stream_t * s, bgav_packet_t ** ret)
+  {
+  int64_t time;
+  bgav_packet_t * p;
+  
+  pthread_mutex_lock(&t->mutex);
+
+  if(!wait_packet(t, s))
+    {
+    pthread_mutex_unlock(&t->mutex);
+    s->flags |= STREAM_EOF_D;
+    return GAVL_SOURCE_EOF;
+    }
+  
+  p = bgav_packet_buffer_get_packet_read(s->packet_buffer);
+
+  t->bytes -= p->data_size;
+  if(t->bytes < 0) /* Packets buffered before the thread was started */
+    t->bytes = 0;
+
+  if((time = packet_time(p)) != GAVL_TIME_UNDEFINED)
+    s->dt_out_time = time;
+
+  if(t->paused && !buffer_full(t))
+    pthread_cond_signal(&t->write_cond);
+  
+  pthread_mutex_unlock(&t->mutex);
+  
+  *ret = p;
+  return GAVL_SOURCE_OK;
+  }
+
+gavl_source_status_t
+bgav_demuxer_thread_peek_packet(bgav_demuxer_thread_t * t,
+                                bgav_stream_t * s, bgav_packet_t ** ret,
+                                int force)
+  {
+  bgav_packet_t * p;
+
+  if((p = bgav_packet_buffer_peek_packet_read(s->packet_buffer)))
+    {
+    if(ret)
+      *ret = p;
+    return GAVL_SOURCE_OK;
+    }
+  
+  if(!force)
+    return GAVL_SOURCE_AGAIN;
+  
+  pthread_mutex_lock(&t->mutex);
+  if(!wait_packet(t, s))
+    {
+    pthread_mutex_unlock(&t->mutex);
+    return GAVL_SOURCE_EOF;
+    }
+  pthread_mutex_unlock(&t->mutex);
+
+  if(ret)
+    *ret = bgav_packet_buffer_peek_packet_read(s->packet_buffer);
+  return GAVL_SOURCE_OK;
+  }
@@ -0,0 +1,157 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+
+#include <stdlib.h>
+
+#include <avdec_private.h>
+
+/*
+ *  Decoded frames are stored as checkpoints for sample accurate
+ *  seeking. A seek to a cached frame doesn't need to decode from the
+ *  previous keyframe. The least recently used frames are dropped
+ *  when the memory budget is exceeded.
+ */
+
+typedef struct
+  {
+  gavl_video_frame_t * f;
+  int64_t last_used;
+  } cache_entry_t;
+
+struct bgav_frame_cache_s
+  {
+  gavl_video_format_t format;
+  int interval;
+
+  int num_entries;
+  int entries_alloc;
+  cache_entry_t * entries;
+
+  int64_t counter;
+  int frames_since_checkpoint;
+
+  int64_t hits;
+  int64_t misses;
+  };
+
+bgav_frame_cache_t * bgav_frame_cache_create(const gavl_video_format_t * format,
+                                             int size, int interval)
+  {
+  int image_size;
+  bgav_frame_cache_t * ret;
+
+  image_size = gavl_video_format_get_image_size(format);
+  if((image_size <= 0) || (size < image_size))
+    return NULL;
+  
+  ret = calloc(1, sizeof(*ret));
+  gavl_video_format_copy(&ret->format, format);
+  ret->entries_alloc = size / image_size;
+  ret->entries = calloc(ret->entries_alloc, sizeof(*ret->entries));
+  ret->interval = (interval > 0) ? interval : 1;
+  return ret;
+  }
+
+void bgav_frame_cache_destroy(bgav_frame_cache_t * c)
+  {
+  int i;
+  for(i = 0; i < c->num_entries; i++)
+    gavl_video_frame_destroy(c->entries[i].f);
+  free(c->entries);
+  free(c);
+  }
+
+static cache_entry_t * find_entry(bgav_frame_cache_t * c, int64_t time)
+  {
+  int i;
+  for(i = 0; i < c->num_entries; i++)
+    {
+    if((c->entries[i].f->timestamp <= time) &&
+       (c->entries[i].f->timestamp + c->entries[i].f->duration > time))
+      return &c->entries[i];
+    }
+  return NULL;
+  }
+
+void bgav_frame_cache_seek(bgav_frame_cache_t * c)
+  {
+  c->frames_since_checkpoint = 0;
+  }
+
+void bgav_frame_cache_put(bgav_frame_cache_t * c, const gavl_video_frame_t * f)
+  {
+  int i;
+  cache_entry_t * e;
+
+  if((f->timestamp == GAVL_TIME_UNDEFINED) || (f->duration <= 0))
+    return;
+  
+  if(c->frames_since_checkpoint++ % c->interval)
+    return;
+  
+  if(find_entry(c, f->timestamp))
+    return;
+  
+  if(c->num_entries < c->entries_alloc)
+    {
+    e = &c->entries[c->num_entries++];
+    e->f = gavl_video_frame_create(&c->format);
+    }
+  else
+    {
+    e = &c->entries[0];
+    for(i = 1; i < c->num_entries; i++)
+      {
+      if(c->entries[i].last_used < e->last_used)
+        e = &c->entries[i];
+      }
+    }
+  
+  gavl_video_frame_copy(&c->format, e->f, f);
+  gavl_video_frame_copy_metadata(e->f, f);
+  e->last_used = ++c->counter;
+  }
+
+const gavl_video_frame_t * bgav_frame_cache_get(bgav_frame_cache_t * c,
+                                                int64_t time)
+  {
+  cache_entry_t * e;
+  if(!(e = find_entry(c, time)))
+    return NULL;
+  e->last_used = ++c->counter;
+  return e->f;
+  }
+
+void bgav_frame_cache_count(bgav_frame_cache_t * c, int hit)
+  {
+  if(hit)
+    c->hits++;
+  else
+    c->misses++;
+  }
+
+void bgav_frame_cache_get_stats(bgav_frame_cache_t * c,
+                                int64_t * hits, int64_t * misses)
+  {
+  *hits = c->hits;
+  *misses = c->misses;
+  }
@@ -26,6 +26,8 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdio.h>
+#include <time.h>
+#include <pthread.h>
 
 #include <http.h>
 
@@ -180,23 +182,182 @@ struct bgav_http_s
   const bgav_options_t * opt;
   bgav_http_header_t * header;
   int fd;
+
+  /* For persistent connections */
+  char * host;
+  int port;
+  int keepalive;
+  int reused;
+  int64_t body_left; /* -1 if unknown */
   };
 
+/*
+ *  Pool of idle persistent connections. It is shared by all decoder
+ *  instances so probing many files on the same server doesn't need
+ *  a new TCP connection for each request.
+ */
+
+#define MAX_IDLE_CONNECTIONS 8
+#define IDLE_TIMEOUT         10 /* Seconds */
+
+static struct
+  {
+  char * host;
+  int port;
+  int fd;
+  time_t time;
+  } idle_connections[MAX_IDLE_CONNECTIONS];
+
+static int num_idle_connections = 0;
+static pthread_mutex_t idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void idle_connection_remove(int idx)
+  {
+  free(idle_connections[idx].host);
+  if(idx < num_idle_connections - 1)
+    memmove(idle_connections + idx, idle_connections + idx + 1,
+            (num_idle_connections - 1 - idx) * sizeof(idle_connections[0]));
+  num_idle_connections--;
+  }
+
+static void idle_connections_expire(time_t now)
+  {
+  int i = 0;
+  while(i < num_idle_connections)
+    {
+    if(now - idle_connections[i].time > IDLE_TIMEOUT)
+      {
+      closesocket(idle_connections[i].fd);
+      idle_connection_remove(i);
+      }
+    else
+      i++;
+    }
+  }
+
+/* An idle connection must not have anything to read. If it has,
+   the server closed it (or sent garbage) */
+
+static int idle_connection_alive(int fd)
+  {
+  fd_set rset;
+  struct timeval timeout;
+  
+  FD_ZERO(&rset);
+  FD_SET (fd, &rset);
+  timeout.tv_sec  = 0;
+  timeout.tv_usec = 0;
+  return !select(fd+1, &rset, NULL, NULL, &timeout);
+  }
+
+static int idle_connection_get(const char * host, int port)
+  {
+  int i;
+  int ret = -1;
+  pthread_mutex_lock(&idle_mutex);
+  idle_connections_expire(time(NULL));
+
+  /* Take the most recently used one */
+  for(i = num_idle_connections - 1; i >= 0; i--)
+    {
+    if((idle_connections[i].port == port) &&
+       !strcmp(idle_connections[i].host, host))
+      {
+      ret = idle_connections[i].fd;
+      idle_connection_remove(i);
+
+      if(idle_connection_alive(ret))
+        break;
+      closesocket(ret);
+      ret = -1;
+      }
+    }
+  pthread_mutex_unlock(&idle_mutex);
+  return ret;
+  }
+
+static void idle_connection_put(const char * host, int port, int fd)
+  {
+  time_t now = time(NULL);
+  pthread_mutex_lock(&idle_mutex);
+  idle_connections_expire(now);
+
+  if(num_idle_connections == MAX_IDLE_CONNECTIONS)
+    {
+    closesocket(idle_connections[0].fd);
+    idle_connection_remove(0);
+    }
+  idle_connections[num_idle_connections].host = gavl_strdup(host);
+  idle_connections[num_idle_connections].port = port;
+  idle_connections[num_idle_connections].fd   = fd;
+  idle_connections[num_idle_connections].time = now;
+  num_idle_connections++;
+  pthread_mutex_unlock(&idle_mutex);
+  }
+
+static int do_request(bgav_http_t * ret,
+                      bgav_http_header_t * request_header,
+                      bgav_http_header_t * extra_header)
+  {
+  if(!bgav_http_header_send(ret->opt, request_header, ret->fd))
+    return 0;
+
+  if(extra_header)
+    {
+    //    bgav_http_header_dump(extra_header);
+    if(!bgav_http_header_send(ret->opt, extra_header, ret->fd))
+      return 0;
+    }
+  if(!bgav_tcp_send(ret->opt, ret->fd, (uint8_t*)"\r\n", 2))
+    return 0;
+  
+  if(ret->header)
+    bgav_http_header_reset(ret->header);
+  else
+    ret->header = bgav_http_header_create();
+  
+  if(!bgav_http_header_revc(ret->opt, ret->header, ret->fd))
+    return 0;
+  return 1;
+  }
+
+static void init_keepalive(bgav_http_t * ret)
+  {
+  const char * var;
+  
+  ret->body_left = -1;
+  
+  if(!ret->header->num_lines ||
+     strncmp(ret->header->lines[0].line, "HTTP/1.1", 8))
+    return;
+  
+  var = bgav_http_header_get_var(ret->header, "Connection");
+  if(var && !strcasecmp(var, "close"))
+    return;
+  
+  var = bgav_http_header_get_var(ret->header, "Transfer-Encoding");
+  if(var && strcasecmp(var, "identity"))
+    return;
+  
+  var = bgav_http_header_get_var(ret->header, "Content-Length");
+  if(!var)
+    return;
+  
+  ret->body_left = strtoll(var, NULL, 10);
+  ret->keepalive = 1;
+  }
+
 static bgav_http_t *
 do_connect(const char * host, int port, const bgav_options_t * opt,
            bgav_http_header_t * request_header,
-           bgav_http_header_t * extra_header)
+           bgav_http_header_t * extra_header, int keepalive)
   {
   bgav_http_t * ret = NULL;
   
   ret = calloc(1, sizeof(*ret));
   ret->opt = opt;
-
-  ret->fd = bgav_tcp_connect(ret->opt, host, port);
-
-  if(ret->fd == -1)
-    goto fail;
-
+  ret->body_left = -1;
+  
   if(opt->dump_headers)
     {
     bgav_dprintf("Sending header\n");
@@ -205,27 +366,49 @@ do_connect(const char * host, int port, const bgav_options_t * opt,
       bgav_http_header_dump(extra_header);
     }
 
-  if(!bgav_http_header_send(ret->opt, request_header, ret->fd))
-    goto fail;
+  if(keepalive)
+    {
+    ret->host = gavl_strdup(host);
+    ret->port = port;
 
-  if(extra_header)
+    /* Try an idle connection first. The server might have closed
+       it in the meantime, so we silently fall back to a new one */
+    
+    while((ret->fd = idle_connection_get(host, port)) >= 0)
+      {
+      if(do_request(ret, request_header, extra_header))
+        {
+        ret->reused = 1;
+        break;
+        }
+      closesocket(ret->fd);
+      }
+    }
+  else
+    ret->fd = -1;
+  
+  if(ret->fd < 0)
     {
-    //    bgav_http_header_dump(extra_header);
-    if(!bgav_http_header_send(ret->opt, extra_header, ret->fd))
+    ret->fd = bgav_tcp_connect(ret->opt, host, port);
+    
+    if(ret->fd == -1)
       goto fail;
+    
+    if(!do_request(ret, request_header, extra_header))
+      {
+      bgav_log(ret->opt, BGAV_LOG_ERROR, LOG_DOMAIN, "Reading response failed");
+      goto fail;
+      }
     }
-  if(!bgav_tcp_send(ret->opt, ret->fd, (uint8_t*)"\r\n", 2))
-    goto fail;
-  
-  ret->header = bgav_http_header_create();
-  
-  if(!bgav_http_header_revc(ret->opt, ret->header, ret->fd))
+
+  if(opt->dump_headers)
     {
-    bgav_log(ret->opt, BGAV_LOG_ERROR, LOG_DOMAIN, "Reading response failed");
-    goto fail;
+    bgav_dprintf("Got response\n");
+    bgav_http_header_dump(ret->header);
     }
-  fprintf(stderr, "Got response\n");
-  bgav_http_header_dump(ret->header);
+
+  if(keepalive)
+    init_keepalive(ret);
   
   return ret;
   
@@ -257,9 +440,10 @@ static char * encode_user_pass(const char * user, const char * pass)
   return ret;
   }
 
-bgav_http_t * bgav_http_open(const char * url, const bgav_options_t * opt,
-                             char ** redirect_url,
-                             bgav_http_header_t * extra_header)
+static bgav_http_t * http_open(const char * url, const bgav_options_t * opt,
+                               char ** redirect_url,
+                               bgav_http_header_t * extra_header,
+                               int keepalive)
   {
   int port;
   int status;
@@ -344,7 +528,8 @@ bgav_http_t * bgav_http_open(const char * url, const bgav_options_t * opt,
   bgav_http_header_add_line(request_header, line);
   free(line);
   
-  ret = do_connect(real_host, real_port, opt, request_header, extra_header);
+  ret = do_connect(real_host, real_port, opt, request_header, extra_header,
+                   keepalive);
   if(!ret)
     goto fail;
 
@@ -378,7 +563,8 @@ bgav_http_t * bgav_http_open(const char * url, const bgav_options_t * opt,
     free(line);
     free(userpass_enc);
     
-    ret = do_connect(real_host, real_port, opt, request_header, extra_header);
+    ret = do_connect(real_host, real_port, opt, request_header, extra_header,
+                   keepalive);
     if(!ret)
       goto fail;
     /* Check status code */
@@ -460,23 +646,74 @@ bgav_http_t * bgav_http_open(const char * url, const bgav_options_t * opt,
     bgav_http_header_destroy(request_header);
   
   if(ret)
-    {
-    if(ret->header)
-      bgav_http_header_destroy(ret->header);
-    free(ret);
-    }
+    bgav_http_close(ret);
   return NULL;
   }
 
+bgav_http_t * bgav_http_open(const char * url, const bgav_options_t * opt,
+                             char ** redirect_url,
+                             bgav_http_header_t * extra_header)
+  {
+  return http_open(url, opt, redirect_url, extra_header, 0);
+  }
+
+bgav_http_t * bgav_http_open_keepalive(const char * url,
+                                       const bgav_options_t * opt,
+                                       char ** redirect_url,
+                                       bgav_http_header_t * extra_header)
+  {
+  return http_open(url, opt, redirect_url, extra_header, 1);
+  }
+
 void bgav_http_close(bgav_http_t * h)
   {
   if(h->fd >= 0)
-    closesocket(h->fd);
+    {
+    /* Keep the connection if the response body was read completely */
+    if(h->keepalive && !h->body_left)
+      idle_connection_put(h->host, h->port, h->fd);
+    else
+      closesocket(h->fd);
+    }
   if(h->header)
     bgav_http_header_destroy(h->header);
+  if(h->host)
+    free(h->host);
   free(h);
   }
 
+int bgav_http_read(bgav_http_t * h, uint8_t * data, int len)
+  {
+  int result;
+  
+  if((h->body_left >= 0) && (len > h->body_left))
+    len = h->body_left;
+
+  if(!len)
+    return 0;
+  
+  result = bgav_read_data_fd(h->opt, h->fd, data, len, h->opt->read_timeout);
+
+  if(h->body_left >= 0)
+    {
+    h->body_left -= result;
+    /* Connection is in an undefined state */
+    if(result < len)
+      h->keepalive = 0;
+    }
+  return result;
+  }
+
+int bgav_http_is_keepalive(bgav_http_t * h)
+  {
+  return h->keepalive;
+  }
+
+int bgav_http_was_reused(bgav_http_t * h)
+  {
+  return h->reused;
+  }
+
 int bgav_http_get_fd(bgav_http_t * h)
   {
   return h->fd;
@@ -26,10 +26,25 @@
 #include <avdec_private.h>
 #include <http.h>
 
+#define LOG_DOMAIN "in_http"
+
 #define NUM_REDIRECTIONS 5
 
 /* Generic http input module */
 
+/*
+ *  If the server supports byte ranges, we read the file in blocks,
+ *  which are kept in a small LRU cache. This makes the stream seekable.
+ */
+
+typedef struct
+  {
+  int64_t index; /* -1 if unused */
+  int size;
+  int64_t last_used;
+  uint8_t * data;
+  } http_block_t;
+
 typedef struct
   {
   int icy_metaint;
@@ -49,8 +64,25 @@ typedef struct
   char * chunk_buffer;
 
   bgav_charset_converter_t * charset_cnv;
+
+  /* Byte range mode */
+  int64_t pos;
+  int block_size;
+  int num_blocks;
+  http_block_t * blocks;
+  http_block_t * cur;      /* Last accessed block */
+  int64_t use_counter;
+
+  int64_t stream_pos;      /* Position of the open response body */
+  int64_t stream_end;      /* End of the open response body */
+
+  int64_t next_block;      /* Block after the last fetched one */
+  int readahead;           /* Blocks to request at once */
+  int max_readahead;
   } http_priv;
 
+static const bgav_input_t input_http_range;
+
 static char const * const title_vars[] =
   {
     "icy-name",
@@ -99,6 +131,37 @@ static void set_metadata_string(bgav_http_header_t * header,
     }
   }
 
+static void init_range(bgav_input_context_t * ctx)
+  {
+  int i;
+  http_priv * p = ctx->priv;
+
+  p->block_size = ctx->opt->http_block_size;
+  p->num_blocks = ctx->opt->http_cache_size / p->block_size;
+  if(p->num_blocks < 4)
+    p->num_blocks = 4;
+
+  p->blocks = calloc(p->num_blocks, sizeof(*p->blocks));
+  for(i = 0; i < p->num_blocks; i++)
+    {
+    p->blocks[i].index = -1;
+    p->blocks[i].data = malloc(p->block_size);
+    }
+  p->max_readahead = p->num_blocks / 2;
+  p->readahead = 1;
+
+  /* Continue reading the response body of the initial request */
+  p->stream_pos = 0;
+  p->stream_end = ctx->total_bytes;
+
+  ctx->input = &input_http_range;
+  ctx->do_buffer = 0;
+
+  bgav_log(ctx->opt, BGAV_LOG_DEBUG, LOG_DOMAIN,
+           "Server supports byte ranges, %d blocks of %d bytes",
+           p->num_blocks, p->block_size);
+  }
+
 static int open_http(bgav_input_context_t * ctx, const char * url, char ** r)
   {
   const char * var;
@@ -116,7 +179,7 @@ static int open_http(bgav_input_context_t * ctx, const char * url, char ** r)
   if(ctx->opt->http_shoutcast_metadata)
     bgav_http_header_add_line(header, "Icy-MetaData:1");
   
-  p->h = bgav_http_open(url, ctx->opt, r, header);
+  p->h = bgav_http_open_keepalive(url, ctx->opt, r, header);
   
   if(!p->h)
     {
@@ -134,7 +197,7 @@ static int open_http(bgav_input_context_t * ctx, const char * url, char ** r)
   
   var = bgav_http_header_get_var(header, "Content-Length");
   if(var)
-    ctx->total_bytes = atoi(var);
+    ctx->total_bytes = strtoll(var, NULL, 10);
   
   var = bgav_http_header_get_var(header, "Content-Type");
   if(var)
@@ -175,6 +238,12 @@ static int open_http(bgav_input_context_t * ctx, const char * url, char ** r)
     ctx->do_buffer = 1;
 
   ctx->url = gavl_strdup(url);
+
+  var = bgav_http_header_get_var(header, "Accept-Ranges");
+  if(var && !strcasecmp(var, "bytes") && (ctx->total_bytes > 0) &&
+     !p->chunked && !p->icy_metaint && (ctx->opt->http_block_size > 0))
+    init_range(ctx);
+  
   return 1;
   }
 
@@ -425,13 +494,225 @@ static int read_nonblock_http(bgav_input_context_t * ctx,
   }
 
 
+/* Byte range mode */
+
+static bgav_http_t * open_range(bgav_input_context_t * ctx,
+                                int64_t start, int64_t end)
+  {
+  int status;
+  int64_t range_start;
+  const char * var;
+  char * line;
+  char * redirect = NULL;
+  bgav_http_t * ret;
+  bgav_http_header_t * header;
+
+  header = bgav_http_header_create();
+  bgav_http_header_add_line(header, "User-Agent: "PACKAGE"/"VERSION);
+  bgav_http_header_add_line(header, "Accept: */*");
+  line = bgav_sprintf("Range: bytes=%"PRId64"-%"PRId64, start, end - 1);
+  bgav_http_header_add_line(header, line);
+  free(line);
+
+  ret = bgav_http_open_keepalive(ctx->url, ctx->opt, &redirect, header);
+  bgav_http_header_destroy(header);
+
+  if(redirect)
+    free(redirect);
+
+  if(!ret)
+    return NULL;
+  
+  status = bgav_http_header_status_code(bgav_http_get_header(ret));
+
+  /* Some servers send the whole file for ranges starting at 0 */
+  if((status == 200) && !start)
+    return ret;
+  
+  var = bgav_http_header_get_var(bgav_http_get_header(ret), "Content-Range");
+
+  if((status != 206) || !var ||
+     (sscanf(var, "bytes %"SCNd64"-", &range_start) < 1) ||
+     (range_start != start))
+    {
+    bgav_log(ctx->opt, BGAV_LOG_ERROR, LOG_DOMAIN,
+             "Range request for bytes %"PRId64"-%"PRId64" failed",
+             start, end - 1);
+    bgav_http_close(ret);
+    return NULL;
+    }
+  
+  bgav_log(ctx->opt, BGAV_LOG_DEBUG, LOG_DOMAIN,
+           "Requested bytes %"PRId64"-%"PRId64"%s",
+           start, end - 1,
+           (bgav_http_was_reused(ret) ? " (reused connection)" : ""));
+  return ret;
+  }
+
+static http_block_t * find_block(http_priv * p, int64_t index)
+  {
+  int i;
+
+  if(p->cur && (p->cur->index == index))
+    return p->cur;
+  
+  for(i = 0; i < p->num_blocks; i++)
+    {
+    if(p->blocks[i].index == index)
+      return &p->blocks[i];
+    }
+  return NULL;
+  }
+
+static http_block_t * get_free_block(http_priv * p)
+  {
+  int i;
+  http_block_t * ret = &p->blocks[0];
+
+  for(i = 0; i < p->num_blocks; i++)
+    {
+    if(p->blocks[i].index < 0)
+      return &p->blocks[i];
+    if(p->blocks[i].last_used < ret->last_used)
+      ret = &p->blocks[i];
+    }
+  return ret;
+  }
+
+static int fetch_blocks(bgav_input_context_t * ctx, int64_t index)
+  {
+  int i;
+  int num;
+  int64_t start, end;
+  http_block_t * b;
+  http_priv * p = ctx->priv;
+
+  /* Read ahead more for sequential access */
+  if(index == p->next_block)
+    {
+    p->readahead *= 2;
+    if(p->readahead > p->max_readahead)
+      p->readahead = p->max_readahead;
+    }
+  else
+    p->readahead = 1;
+
+  start = index * p->block_size;
+
+  num = 1;
+  while((num < p->readahead) &&
+        ((index + num) * p->block_size < ctx->total_bytes) &&
+        !find_block(p, index + num))
+    num++;
+
+  end = (index + num) * p->block_size;
+  if(end > ctx->total_bytes)
+    end = ctx->total_bytes;
+
+  /* Continue the last response if possible */
+  if(!p->h || (p->stream_pos != start))
+    {
+    if(p->h)
+      bgav_http_close(p->h);
+    
+    if(!(p->h = open_range(ctx, start, end)))
+      return 0;
+    p->stream_pos = start;
+    p->stream_end = end;
+    }
+  
+  for(i = 0; i < num; i++)
+    {
+    if(p->stream_pos >= p->stream_end)
+      break;
+    
+    b = get_free_block(p);
+    b->index = -1;
+    b->size = p->block_size;
+    if(b->size > p->stream_end - p->stream_pos)
+      b->size = p->stream_end - p->stream_pos;
+    
+    if(bgav_http_read(p->h, b->data, b->size) < b->size)
+      {
+      bgav_http_close(p->h);
+      p->h = NULL;
+      break;
+      }
+    b->index = index + i;
+    b->last_used = ++p->use_counter;
+    p->stream_pos += b->size;
+    }
+  
+  /* Response complete: The connection goes back to the pool */
+  if(p->h && (p->stream_pos >= p->stream_end))
+    {
+    bgav_http_close(p->h);
+    p->h = NULL;
+    }
+  
+  p->next_block = index + i;
+  return (i > 0);
+  }
+
+static int read_range(bgav_input_context_t * ctx,
+                      uint8_t * buffer, int len)
+  {
+  int bytes_read = 0;
+  int bytes_to_copy;
+  int64_t index;
+  int offset;
+  http_priv * p = ctx->priv;
+
+  while((bytes_read < len) && (p->pos < ctx->total_bytes))
+    {
+    index = p->pos / p->block_size;
+
+    if(!(p->cur = find_block(p, index)))
+      {
+      if(!fetch_blocks(ctx, index) ||
+         !(p->cur = find_block(p, index)))
+        break;
+      }
+    p->cur->last_used = ++p->use_counter;
+    
+    offset = p->pos - index * p->block_size;
+    bytes_to_copy = p->cur->size - offset;
+    if(bytes_to_copy <= 0)
+      break;
+    if(bytes_to_copy > len - bytes_read)
+      bytes_to_copy = len - bytes_read;
+
+    memcpy(buffer + bytes_read, p->cur->data + offset, bytes_to_copy);
+    bytes_read += bytes_to_copy;
+    p->pos += bytes_to_copy;
+    }
+  return bytes_read;
+  }
+
+static int64_t seek_byte_range(bgav_input_context_t * ctx,
+                               int64_t pos, int whence)
+  {
+  http_priv * p = ctx->priv;
+  p->pos = ctx->position;
+  return p->pos;
+  }
+
 static void close_http(bgav_input_context_t * ctx)
   {
+  int i;
   http_priv * p = ctx->priv;
 
+  if(p->blocks)
+    {
+    for(i = 0; i < p->num_blocks; i++)
+      free(p->blocks[i].data);
+    free(p->blocks);
+    }
+
   if(p->chunk_buffer)
     free(p->chunk_buffer);
-  bgav_http_close(p->h);
+  if(p->h)
+    bgav_http_close(p->h);
   if(p->charset_cnv)
     bgav_charset_converter_destroy(p->charset_cnv);
   free(p);
@@ -446,3 +727,11 @@ const bgav_input_t bgav_input_http =
     .close =         close_http,
   };
 
+static const bgav_input_t input_http_range =
+  {
+    .name =          "http",
+    .open =          open_http,
+    .read =          read_range,
+    .seek_byte =     seek_byte_range,
+    .close =         close_http,
+  };
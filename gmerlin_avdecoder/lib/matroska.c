@@ -1807,6 +1807,10 @@ static int mkv_cue_track_read(bgav_input_context_t * ctx,
         if(!mkv_read_uint(ctx, &ret->CueClusterPosition, e.size))
           return 0;
         break;
+      case MKV_ID_CueRelativePosition:
+        if(!mkv_read_uint(ctx, &ret->CueRelativePosition, e.size))
+          return 0;
+        break;
       case MKV_ID_CueBlockNumber:
         if(!mkv_read_uint(ctx, &ret->CueBlockNumber, e.size))
           return 0;
@@ -1917,6 +1921,8 @@ void bgav_mkv_cues_dump(const bgav_mkv_cues_t * cues)
       bgav_dprintf("    Track: %"PRId64"\n", cues->points[i].tracks[j].CueTrack);
       bgav_dprintf("      CueClusterPosition: %"PRId64"\n",
                    cues->points[i].tracks[j].CueClusterPosition);
+      bgav_dprintf("      CueRelativePosition: %"PRId64"\n",
+                   cues->points[i].tracks[j].CueRelativePosition);
       bgav_dprintf("      CueBlockNumber:     %"PRId64"\n",
                    cues->points[i].tracks[j].CueBlockNumber);
       bgav_dprintf("      CueCodecState:      %"PRId64"\n",
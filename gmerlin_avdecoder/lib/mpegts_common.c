@@ -373,6 +373,120 @@ int bgav_transport_packet_parse(const bgav_options_t * opt,
   return 1;
   }
 
+/* Batched header scan */
+
+/* Header word with the first byte in the least significant bits */
+#define HEADER_WORD(ptr) \
+  ((uint32_t)(ptr)[0] | ((uint32_t)(ptr)[1] << 8) |     \
+   ((uint32_t)(ptr)[2] << 16) | ((uint32_t)(ptr)[3] << 24))
+
+#define HEADER_PID(h)   (((h) & 0x1f00) | (((h) >> 16) & 0xff))
+
+#define HEADER_FLAGS(h)                         \
+  ((((h) >> 15) & TS_HEADER_TRANSPORT_ERROR) |  \
+   (((h) >> 13) & TS_HEADER_PAYLOAD_START) |    \
+   (((h) >> 27) & TS_HEADER_ADAPTION_FIELD) |   \
+   (((h) >> 25) & TS_HEADER_PAYLOAD))
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+/* Process 8 packets at once. Returns a bitmask of the packets with
+   a valid sync byte */
+
+static inline int scan_8_sse2(const uint8_t * data, int packet_size,
+                              uint16_t * pids, uint8_t * flags)
+  {
+  __m128i h1, h2, pid1, pid2, fl1, fl2;
+  const __m128i sync = _mm_set1_epi32(0x47);
+  const __m128i mask_ff = _mm_set1_epi32(0xff);
+  
+  h1 = _mm_set_epi32(HEADER_WORD(data + 3 * packet_size),
+                     HEADER_WORD(data + 2 * packet_size),
+                     HEADER_WORD(data + 1 * packet_size),
+                     HEADER_WORD(data));
+  data += 4 * packet_size;
+  h2 = _mm_set_epi32(HEADER_WORD(data + 3 * packet_size),
+                     HEADER_WORD(data + 2 * packet_size),
+                     HEADER_WORD(data + 1 * packet_size),
+                     HEADER_WORD(data));
+  
+  /* PIDs */
+  pid1 = _mm_or_si128(_mm_and_si128(h1, _mm_set1_epi32(0x1f00)),
+                      _mm_and_si128(_mm_srli_epi32(h1, 16), mask_ff));
+  pid2 = _mm_or_si128(_mm_and_si128(h2, _mm_set1_epi32(0x1f00)),
+                      _mm_and_si128(_mm_srli_epi32(h2, 16), mask_ff));
+  _mm_storeu_si128((__m128i*)pids, _mm_packs_epi32(pid1, pid2));
+
+  /* Flags */
+  fl1 = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(h1, 15),
+                                                _mm_set1_epi32(TS_HEADER_TRANSPORT_ERROR)),
+                                  _mm_and_si128(_mm_srli_epi32(h1, 13),
+                                                _mm_set1_epi32(TS_HEADER_PAYLOAD_START))),
+                     _mm_or_si128(_mm_and_si128(_mm_srli_epi32(h1, 27),
+                                                _mm_set1_epi32(TS_HEADER_ADAPTION_FIELD)),
+                                  _mm_and_si128(_mm_srli_epi32(h1, 25),
+                                                _mm_set1_epi32(TS_HEADER_PAYLOAD))));
+  fl2 = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(h2, 15),
+                                                _mm_set1_epi32(TS_HEADER_TRANSPORT_ERROR)),
+                                  _mm_and_si128(_mm_srli_epi32(h2, 13),
+                                                _mm_set1_epi32(TS_HEADER_PAYLOAD_START))),
+                     _mm_or_si128(_mm_and_si128(_mm_srli_epi32(h2, 27),
+                                                _mm_set1_epi32(TS_HEADER_ADAPTION_FIELD)),
+                                  _mm_and_si128(_mm_srli_epi32(h2, 25),
+                                                _mm_set1_epi32(TS_HEADER_PAYLOAD))));
+  fl1 = _mm_packs_epi32(fl1, fl2);
+  _mm_storel_epi64((__m128i*)flags, _mm_packus_epi16(fl1, fl1));
+  
+  /* Sync bytes */
+  h1 = _mm_cmpeq_epi32(_mm_and_si128(h1, mask_ff), sync);
+  h2 = _mm_cmpeq_epi32(_mm_and_si128(h2, mask_ff), sync);
+  return _mm_movemask_epi8(_mm_packs_epi16(_mm_packs_epi32(h1, h2),
+                                           _mm_setzero_si128()));
+  }
+#endif
+
+int bgav_transport_packet_scan(const uint8_t * data, int packet_size,
+                               int num_packets,
+                               uint16_t * pids, uint8_t * flags)
+  {
+  int i = 0;
+  uint32_t h;
+  
+#ifdef __SSE2__
+  int mask;
+  
+  while(i + 8 <= num_packets)
+    {
+    mask = scan_8_sse2(data, packet_size, pids + i, flags + i);
+    if(mask != 0xff)
+      {
+      /* Index of the first packet without sync byte */
+      while(mask & 1)
+        {
+        mask >>= 1;
+        i++;
+        }
+      return i;
+      }
+    data += 8 * packet_size;
+    i += 8;
+    }
+#endif
+
+  while(i < num_packets)
+    {
+    if(data[0] != 0x47)
+      break;
+    h = HEADER_WORD(data);
+    pids[i]  = HEADER_PID(h);
+    flags[i] = HEADER_FLAGS(h);
+    data += packet_size;
+    i++;
+    }
+  return i;
+  }
+
 static uint8_t * find_descriptor(uint8_t * data, int len,
                                  int tag, int * desc_len)
   {
@@ -84,6 +84,16 @@ void bgav_options_set_sample_accurate(bgav_options_t*b, int p)
   b->sample_accurate = p;
   }
 
+void bgav_options_set_seek_cache_size(bgav_options_t*opt, int size)
+  {
+  opt->seek_cache_size = size;
+  }
+
+void bgav_options_set_seek_cache_interval(bgav_options_t*opt, int interval)
+  {
+  opt->seek_cache_interval = interval;
+  }
+
 void bgav_options_set_cache_time(bgav_options_t*opt, int t)
   {
   opt->cache_time = t;
@@ -119,6 +129,16 @@ void bgav_options_set_http_shoutcast_metadata(bgav_options_t*b, int m)
   b->http_shoutcast_metadata = m;
   }
 
+void bgav_options_set_http_block_size(bgav_options_t*b, int size)
+  {
+  b->http_block_size = size;
+  }
+
+void bgav_options_set_http_cache_size(bgav_options_t*b, int size)
+  {
+  b->http_cache_size = size;
+  }
+
 void bgav_options_set_ftp_anonymous_password(bgav_options_t*b, const char * h)
   {
   if(b->ftp_anonymous_password)
@@ -194,6 +214,18 @@ void bgav_options_set_dv_datetime(bgav_options_t* opt,
   opt->dv_datetime = datetime;
   }
 
+void bgav_options_set_all_programs(bgav_options_t* opt,
+                                   int enable)
+  {
+  opt->all_programs = enable;
+  }
+
+void bgav_options_set_demuxer_buffer(bgav_options_t* opt,
+                                     int milliseconds)
+  {
+  opt->demuxer_buffer = milliseconds;
+  }
+
 void bgav_options_set_shrink(bgav_options_t* opt,
                              int shrink)
   {
@@ -248,10 +280,13 @@ void bgav_options_set_defaults(bgav_options_t * b)
   b->connect_timeout = 10000;
   b->read_timeout = 10000;
   b->ftp_anonymous = 1;
+  b->http_block_size = 64 * 1024;
+  b->http_cache_size = 4 * 1024 * 1024;
   b->default_subtitle_encoding = gavl_strdup("LATIN1");
   b->audio_dynrange = 1;
   b->cache_time = 500;
   b->cache_size = 20;
+  b->seek_cache_interval = 1;
   b->vdpau = 1;
   b->threads = 1;
   b->log_level =
@@ -288,6 +323,8 @@ void bgav_options_copy(bgav_options_t * dst, const bgav_options_t * src)
   CP_INT(sample_accurate);
   CP_INT(cache_time);
   CP_INT(cache_size);
+  CP_INT(seek_cache_size);
+  CP_INT(seek_cache_interval);
   /* Generic network options */
   CP_INT(connect_timeout);
   CP_INT(read_timeout);
@@ -310,6 +347,8 @@ void bgav_options_copy(bgav_options_t * dst, const bgav_options_t * src)
   CP_STR(http_proxy_pass);
   
   CP_INT(http_shoutcast_metadata);
+  CP_INT(http_block_size);
+  CP_INT(http_cache_size);
 
   /* ftp options */
     
@@ -337,6 +376,8 @@ void bgav_options_copy(bgav_options_t * dst, const bgav_options_t * src)
   
   CP_INT(prefer_ffmpeg_demuxers);
   CP_INT(dv_datetime);
+  CP_INT(all_programs);
+  CP_INT(demuxer_buffer);
   CP_INT(shrink);
 
   CP_INT(vdpau);
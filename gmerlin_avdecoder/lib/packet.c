@@ -50,11 +50,28 @@ void bgav_packet_destroy(bgav_packet_t * p)
   free(p);
   }
 
+/* Round allocations up to size classes (4 per octave, at least 1024
+   bytes). Since packets are recycled by the packet pool, this lets
+   them quickly reach a size, where no further reallocs are needed. */
+
+static uint32_t get_size_class(uint32_t size)
+  {
+  uint32_t step = 256;
+
+  if(size <= 1024)
+    return 1024;
+  
+  while((step << 1) <= (size >> 2))
+    step <<= 1;
+
+  return (size + step - 1) & ~(step - 1);
+  }
+
 void bgav_packet_alloc(bgav_packet_t * p, int size)
   {
   if(size + GAVL_PACKET_PADDING > p->data_alloc)
     {
-    p->data_alloc = size + GAVL_PACKET_PADDING + 1024;
+    p->data_alloc = get_size_class(size + GAVL_PACKET_PADDING);
     p->data = realloc(p->data, p->data_alloc);
     }
   /* Pad in advance */
@@ -20,13 +20,25 @@
  * *****************************************************************/
 
 #include <stdlib.h>
+#include <sched.h>
 
 #include <avdec_private.h>
 
+/*
+ *  The packet buffer is an intrusive lock-free FIFO (Vyukov style
+ *  MPSC queue with a stub node). Packets can be appended from any
+ *  thread (e.g. a demuxer thread), while get, peek, clear and is_empty
+ *  must be called by only one consumer at a time (the thread decoding
+ *  the stream).
+ *
+ *  head is the last appended packet, tail the oldest one (or the stub).
+ */
+
 struct bgav_packet_buffer_s
   {
-  bgav_packet_t * packets;
-  bgav_packet_t * packets_end;
+  bgav_packet_t * head;
+  bgav_packet_t * tail;
+  bgav_packet_t stub;
   bgav_packet_pool_t * pp;
   };
 
@@ -35,77 +47,94 @@ bgav_packet_buffer_t * bgav_packet_buffer_create(bgav_packet_pool_t * pp)
   bgav_packet_buffer_t * ret;
   ret = calloc(1, sizeof(*ret));
   ret->pp = pp;
+  ret->head = &ret->stub;
+  ret->tail = &ret->stub;
   return ret;
   }
 
-void bgav_packet_buffer_destroy(bgav_packet_buffer_t * b)
+void bgav_packet_buffer_append(bgav_packet_buffer_t * b,
+                               bgav_packet_t * p)
   {
-  bgav_packet_t * tmp;
-  while(b->packets)
+  bgav_packet_t * prev;
+  
+  p->next = NULL;
+  prev = __atomic_exchange_n(&b->head, p, __ATOMIC_ACQ_REL);
+
+  /* Between the exchange and this store, the consumer can see a
+     broken chain (see get_packet below) */
+  __atomic_store_n(&prev->next, p, __ATOMIC_RELEASE);
+  }
+
+/* Skip the stub and return the oldest packet without removing it */
+
+static bgav_packet_t * get_tail(bgav_packet_buffer_t * b)
+  {
+  bgav_packet_t * next;
+  
+  if(b->tail == &b->stub)
     {
-    tmp = b->packets->next;
-    bgav_packet_destroy(b->packets);
-    b->packets = tmp;
+    if(!(next = __atomic_load_n(&b->stub.next, __ATOMIC_ACQUIRE)))
+      return NULL;
+    b->stub.next = NULL;
+    b->tail = next;
     }
-  free(b);
+  return b->tail;
   }
 
-bgav_packet_t *
-bgav_packet_buffer_get_packet_read(bgav_packet_buffer_t* b)
+static bgav_packet_t * get_packet(bgav_packet_buffer_t * b)
   {
   bgav_packet_t * ret;
-  if(b->packets)
+  bgav_packet_t * next;
+  
+  if(!(ret = get_tail(b)))
+    return NULL;
+
+  if(!(next = __atomic_load_n(&ret->next, __ATOMIC_ACQUIRE)))
     {
-    ret = b->packets;
-    b->packets = b->packets->next;
-    ret->next = NULL;
-    return ret;
+    /* ret is the last packet in the chain: Append the stub such
+       that it can be removed */
+    if(__atomic_load_n(&b->head, __ATOMIC_ACQUIRE) == ret)
+      bgav_packet_buffer_append(b, &b->stub);
+
+    /* Either the stub or another packet will be linked to ret.
+       Wait until the producer completed the append. */
+    while(!(next = __atomic_load_n(&ret->next, __ATOMIC_ACQUIRE)))
+      sched_yield();
     }
-  else
-    return NULL;
+  
+  b->tail = next;
+  ret->next = NULL;
+  return ret;
+  }
+
+void bgav_packet_buffer_destroy(bgav_packet_buffer_t * b)
+  {
+  bgav_packet_t * tmp;
+  while((tmp = get_packet(b)))
+    bgav_packet_destroy(tmp);
+  free(b);
+  }
+
+bgav_packet_t *
+bgav_packet_buffer_get_packet_read(bgav_packet_buffer_t* b)
+  {
+  return get_packet(b);
   }
 
 bgav_packet_t *
 bgav_packet_buffer_peek_packet_read(bgav_packet_buffer_t * b)
   {
-  return b->packets;
+  return get_tail(b);
   }
 
 void bgav_packet_buffer_clear(bgav_packet_buffer_t * b)
   {
   bgav_packet_t * tmp;
-  //  fprintf(stderr, "bgav_packet_buffer_clear()...\n");
-  while(b->packets)
-    {
-    tmp = b->packets->next;
-    bgav_packet_pool_put(b->pp, b->packets);
-    //    fprintf(stderr, "bgav_packet_buffer_clear %p %p\n", b->packets, tmp);
-
-    b->packets = tmp;
-    }
-  b->packets_end = NULL;
-  //  fprintf(stderr, "bgav_packet_buffer_clear()...done\n");
+  while((tmp = get_packet(b)))
+    bgav_packet_pool_put(b->pp, tmp);
   }
 
 int bgav_packet_buffer_is_empty(bgav_packet_buffer_t * b)
   {
-  return !b->packets ? 1 : 0;
+  return !get_tail(b) ? 1 : 0;
   }
-
-void bgav_packet_buffer_append(bgav_packet_buffer_t * b,
-                               bgav_packet_t * p)
-  {
-  p->next = NULL;
-  
-  if(!b->packets)
-    {
-    b->packets = p;
-    b->packets_end = p;
-    }
-  else
-    {
-    b->packets_end->next = p;
-    b->packets_end = b->packets_end->next;
-    }
-  }
-
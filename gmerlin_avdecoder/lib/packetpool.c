@@ -25,10 +25,23 @@
 
 // #define DEBUG_PP
 
+/*
+ *  The pool is a lock-free stack, so a demuxer thread and the
+ *  decoder threads can return packets concurrently.
+ *
+ *  put() pushes with a compare and swap from any thread, which is safe
+ *  because nodes are never removed by a push.
+ *
+ *  get() pops only while it holds the getter flag. With a single popper
+ *  the head can only be replaced by pushes, so the classic ABA problem
+ *  of lock-free stacks cannot happen. A getter, which finds the flag
+ *  taken, doesn't wait but creates a new packet instead.
+ */
 
 struct bgav_packet_pool_s
   {
   bgav_packet_t * packets;
+  int getting;
   };
 
 bgav_packet_pool_t * bgav_packet_pool_create()
@@ -38,15 +51,31 @@ bgav_packet_pool_t * bgav_packet_pool_create()
   return ret;
   }
 
-bgav_packet_t * bgav_packet_pool_get(bgav_packet_pool_t * pp)
+static bgav_packet_t * pop_packet(bgav_packet_pool_t * pp)
   {
   bgav_packet_t * ret;
-  if(pp->packets)
+  bgav_packet_t * next;
+  
+  if(__atomic_exchange_n(&pp->getting, 1, __ATOMIC_ACQUIRE))
+    return NULL;
+
+  ret = __atomic_load_n(&pp->packets, __ATOMIC_ACQUIRE);
+  while(ret)
     {
-    ret = pp->packets;
-    pp->packets = pp->packets->next;
+    next = ret->next;
+    if(__atomic_compare_exchange_n(&pp->packets, &ret, next, 1,
+                                   __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+      break;
     }
-  else
+  
+  __atomic_store_n(&pp->getting, 0, __ATOMIC_RELEASE);
+  return ret;
+  }
+
+bgav_packet_t * bgav_packet_pool_get(bgav_packet_pool_t * pp)
+  {
+  bgav_packet_t * ret;
+  if(!(ret = pop_packet(pp)))
     ret = bgav_packet_create();
 
   ret->next = NULL;
@@ -58,6 +87,7 @@ void bgav_packet_pool_put(bgav_packet_pool_t * pp,
                           bgav_packet_t * p)
   {
 #ifdef DEBUG_PP
+  /* Not thread safe */
   bgav_packet_t * tmp = pp->packets;
   while(tmp)
     {
@@ -69,8 +99,10 @@ void bgav_packet_pool_put(bgav_packet_pool_t * pp,
     }
 #endif
 
-  p->next = pp->packets;
-  pp->packets = p;
+  p->next = __atomic_load_n(&pp->packets, __ATOMIC_RELAXED);
+  while(!__atomic_compare_exchange_n(&pp->packets, &p->next, p, 1,
+                                     __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ;
   }
 
 void bgav_packet_pool_destroy(bgav_packet_pool_t * pp)
@@ -166,13 +166,18 @@ void bgav_seek_audio(bgav_t * bgav, int stream, int64_t sample)
   
   }
 
-void bgav_seek_video(bgav_t * bgav, int stream, int64_t time)
+void bgav_video_stream_seek(bgav_stream_t * s, int64_t time)
   {
-  bgav_stream_t * s;
   int64_t frame_time;
-  s = &bgav->tt->cur->video_streams[stream];
   
   //  fprintf(stderr, "Seek video: %ld\n", time);
+
+  if(s->flags & STREAM_CACHED_SEEK)
+    {
+    /* Continue from where the decoder really is */
+    s->flags &= ~STREAM_CACHED_SEEK;
+    s->out_time = s->data.video.decoder_time;
+    }
   
   if(time >= s->duration) /* EOF */
     {
@@ -182,12 +187,15 @@ void bgav_seek_video(bgav_t * bgav, int stream, int64_t time)
   
   s->flags &= ~(STREAM_EOF_C|STREAM_EOF_D);
   
+  if(s->data.video.fc)
+    bgav_frame_cache_seek(s->data.video.fc);
+  
   if(time == s->out_time)
     {
     return;
     }
   if((time > s->out_time) &&
-     (bgav_video_keyframe_after(bgav, stream, s->out_time) > time))
+     (bgav_video_stream_keyframe_after(s, s->out_time) > time))
     {
     //    fprintf(stderr, "Skip to: %ld\n", time);
     bgav_video_skipto(s, &time, s->data.video.format.timescale);
@@ -197,11 +205,11 @@ void bgav_seek_video(bgav_t * bgav, int stream, int64_t time)
 
   bgav_stream_clear(s);
 
-  if(bgav->demuxer->index_mode == INDEX_MODE_SI_SA)
+  if(s->demuxer->index_mode == INDEX_MODE_SI_SA)
     {
     frame_time = time;
-    bgav_superindex_seek(bgav->demuxer->si, s, &frame_time, s->timescale);
-    s->out_time = bgav->demuxer->si->entries[s->index_position].pts;
+    bgav_superindex_seek(s->demuxer->si, s, &frame_time, s->timescale);
+    s->out_time = s->demuxer->si->entries[s->index_position].pts;
     }
   else /* Fileindex */
     {
@@ -226,8 +234,8 @@ void bgav_seek_video(bgav_t * bgav, int stream, int64_t time)
     // if(s->data.video.parser)
     //   bgav_video_parser_reset(s->data.video.parser, GAVL_TIME_UNDEFINED, frame_time);
     
-    if(bgav->demuxer->demuxer->resync)
-      bgav->demuxer->demuxer->resync(bgav->demuxer, s);
+    if(s->demuxer->demuxer->resync)
+      s->demuxer->demuxer->resync(s->demuxer, s);
     }
 
   bgav_video_resync(s);
@@ -240,6 +248,44 @@ void bgav_seek_video(bgav_t * bgav, int stream, int64_t time)
   //  fprintf(stderr, "Skipped to: %ld %ld\n", time, s->out_time);
   }
 
+void bgav_seek_video(bgav_t * bgav, int stream, int64_t time)
+  {
+  bgav_stream_t * s;
+  const gavl_video_frame_t * cached;
+  s = &bgav->tt->cur->video_streams[stream];
+
+  if(s->data.video.fc && (time < s->duration))
+    {
+    /* Checkpoint: Defer the real seek until the next frame isn't cached */
+    if((cached = bgav_frame_cache_get(s->data.video.fc,
+                                      time + s->start_time)))
+      {
+      bgav_frame_cache_count(s->data.video.fc, 1);
+      if(!(s->flags & STREAM_CACHED_SEEK))
+        {
+        s->data.video.decoder_time = s->out_time;
+        s->flags |= STREAM_CACHED_SEEK;
+        }
+      s->flags &= ~(STREAM_EOF_C|STREAM_EOF_D);
+      s->out_time = cached->timestamp;
+      return;
+      }
+    bgav_frame_cache_count(s->data.video.fc, 0);
+    }
+  bgav_video_stream_seek(s, time);
+  }
+
+int bgav_get_seek_cache_stats(bgav_t * bgav, int stream,
+                              int64_t * hits, int64_t * misses)
+  {
+  bgav_stream_t * s;
+  s = &bgav->tt->cur->video_streams[stream];
+  if(!s->data.video.fc)
+    return 0;
+  bgav_frame_cache_get_stats(s->data.video.fc, hits, misses);
+  return 1;
+  }
+
 int64_t bgav_video_stream_keyframe_before(bgav_stream_t * s, int64_t time)
   {
   int pos;
@@ -433,6 +433,9 @@ bgav_seek_scaled(bgav_t * b, int64_t * time, int scale)
   //  fprintf(stderr, "bgav_seek_scaled: %f\n",
   //          gavl_time_to_seconds(gavl_time_unscale(scale, *time)));
   
+  /* The demuxer must not run while seeking */
+  bgav_demuxer_stop_thread(b->demuxer);
+  
   /* Clear EOF */
 
   bgav_track_clear_eof_d(track);
@@ -470,6 +473,8 @@ bgav_seek_scaled(bgav_t * b, int64_t * time, int scale)
   
   bgav_streams_foreach(track->text_streams, track->num_text_streams, seek_subreader, &ss);
   bgav_streams_foreach(track->overlay_streams, track->num_overlay_streams, seek_subreader, &ss);
+
+  bgav_demuxer_start_thread(b->demuxer);
   }
 
 void
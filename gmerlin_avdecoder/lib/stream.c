@@ -317,7 +317,10 @@ void bgav_stream_done_packet_write(bgav_stream_t * s, bgav_packet_t * p)
     s->index_position++;
     }
   
-  bgav_packet_buffer_append(s->packet_buffer, p);
+  if(s->demuxer && s->demuxer->thread)
+    bgav_demuxer_thread_append(s->demuxer->thread, s, p);
+  else
+    bgav_packet_buffer_append(s->packet_buffer, p);
   }
 
 int bgav_stream_get_index(bgav_stream_t * s)
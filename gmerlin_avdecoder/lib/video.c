@@ -79,17 +79,50 @@ int bgav_video_has_still(bgav_t * bgav, int stream)
   return check_still(s);
   }
 
+/* After a seek to a cached frame, we read from the frame cache
+   until the next frame isn't there */
+
+static const gavl_video_frame_t * get_cached_frame(bgav_stream_t * s)
+  {
+  const gavl_video_frame_t * ret;
+
+  if(!(s->flags & STREAM_CACHED_SEEK))
+    return NULL;
+
+  if((ret = bgav_frame_cache_get(s->data.video.fc, s->out_time)))
+    {
+    s->out_time = ret->timestamp + ret->duration;
+    return ret;
+    }
+  
+  /* Do the real seek now */
+  bgav_video_stream_seek(s, s->out_time - s->start_time);
+  return NULL;
+  }
+
 static gavl_source_status_t
 read_video_nocopy(void * sp,
                   gavl_video_frame_t ** frame)
   {
   gavl_source_status_t st;
+  const gavl_video_frame_t * cached;
   bgav_stream_t * s = sp;
   //  fprintf(stderr, "Read video nocopy\n");
   if(!check_still(s))
     return GAVL_SOURCE_AGAIN;
+
+  if((cached = get_cached_frame(s)))
+    {
+    /* Like decoder frames, these are read only for the caller */
+    if(frame)
+      *frame = (gavl_video_frame_t*)cached;
+    return GAVL_SOURCE_OK;
+    }
+  
   if((st = s->data.video.decoder->decode(sp, NULL)) != GAVL_SOURCE_OK)
     return st;
+  if(s->data.video.fc)
+    bgav_frame_cache_put(s->data.video.fc, s->vframe);
   if(frame)
     *frame = s->vframe;
 #ifdef DUMP_TIMESTAMPS
@@ -104,15 +137,28 @@ static gavl_source_status_t read_video_copy(void * sp,
                                             gavl_video_frame_t ** frame)
   {
   gavl_source_status_t st;
+  const gavl_video_frame_t * cached;
   bgav_stream_t * s = sp;
   if(!check_still(s))
     return GAVL_SOURCE_AGAIN;
+
+  if((cached = get_cached_frame(s)))
+    {
+    if(frame)
+      {
+      gavl_video_frame_copy(&s->data.video.format, *frame, cached);
+      gavl_video_frame_copy_metadata(*frame, cached);
+      }
+    return GAVL_SOURCE_OK;
+    }
   
   if(frame)
     {
     if((st = s->data.video.decoder->decode(sp, *frame)) != GAVL_SOURCE_OK)
       return st;
     s->out_time = (*frame)->timestamp + (*frame)->duration;
+    if(s->data.video.fc)
+      bgav_frame_cache_put(s->data.video.fc, *frame);
     }
   else
     {
@@ -257,6 +303,13 @@ int bgav_video_start(bgav_stream_t * s)
     if(!result)
       return 0;
 
+    if(s->opt->seek_cache_size && (s->track->flags & TRACK_SAMPLE_ACCURATE) &&
+       (s->data.video.format.framerate_mode != GAVL_FRAMERATE_STILL))
+      s->data.video.fc =
+        bgav_frame_cache_create(&s->data.video.format,
+                                s->opt->seek_cache_size,
+                                s->opt->seek_cache_interval);
+
     if(s->data.video.format.interlace_mode == GAVL_INTERLACE_UNKNOWN)
       s->data.video.format.interlace_mode = GAVL_INTERLACE_NONE;
     if(s->data.video.format.framerate_mode == GAVL_FRAMERATE_UNKNOWN)
@@ -380,10 +433,18 @@ void bgav_video_stop(bgav_stream_t * s)
     bgav_keyframe_table_destroy(s->data.video.kft);
     s->data.video.kft = NULL;
     }
+  if(s->data.video.fc)
+    {
+    bgav_frame_cache_destroy(s->data.video.fc);
+    s->data.video.fc = NULL;
+    }
+  s->flags &= ~STREAM_CACHED_SEEK;
   }
 
 void bgav_video_resync(bgav_stream_t * s)
   {
+  s->flags &= ~STREAM_CACHED_SEEK;
+  
   if(s->out_time == GAVL_TIME_UNDEFINED)
     {
     s->out_time =
@@ -198,6 +198,24 @@ static const bg_parameter_info_t parameters[] =
       .type =        BG_PARAMETER_CHECKBUTTON,
       .val_default = { .val_i = 1 }
     },
+    {
+      .name =        "http_block_size",
+      .long_name =   TRS("Block size (kB)"),
+      .type =        BG_PARAMETER_INT,
+      .val_default = { .val_i = 64 },
+      .val_min =     { .val_i = 4 },
+      .val_max =     { .val_i = 4096 },
+      .help_string = TRS("Servers, which support byte ranges, are accessed in blocks of this size. This makes http streams seekable."),
+    },
+    {
+      .name =        "http_cache_size",
+      .long_name =   TRS("Cache size (kB)"),
+      .type =        BG_PARAMETER_INT,
+      .val_default = { .val_i = 4096 },
+      .val_min =     { .val_i = 64 },
+      .val_max =     { .val_i = 1000000 },
+      .help_string = TRS("Cache for the most recently used blocks of seekable http streams"),
+    },
     {
       .name =        "http_use_proxy",
       .long_name =   TRS("Use proxy"),
@@ -339,12 +357,36 @@ supported encodings."),
       .val_default = { .val_i = 20 },
       .help_string = TRS("Set the maximum total size of the cache directory."),
     },
+    {
+      .name =        "seek_cache_size",
+      .long_name =   TRS("Seek cache size (Megabytes)"),
+      .type =        BG_PARAMETER_INT,
+      .val_default = { .val_i = 0 },
+      .val_min =     { .val_i = 0 },
+      .val_max =     { .val_i = 4096 },
+      .help_string = TRS("Keep decoded video frames for sample accurate seeking. Seeking to a cached frame needs no decoding from the previous keyframe. 0 disables the cache."),
+    },
     PARAM_THREADS, 
     {
       .name =        "dv_datetime",
       .long_name =   TRS("Export date and time as timecodes for DV"),
       .type =        BG_PARAMETER_CHECKBUTTON,
     },
+    {
+      .name =        "all_programs",
+      .long_name =   TRS("Track with all programs"),
+      .type =        BG_PARAMETER_CHECKBUTTON,
+      .help_string = TRS("Add a track containing the streams of all programs of multi-program transport streams. Selecting it lets one decoder feed several programs at once with a single read and demultiplexing pass."),
+    },
+    {
+      .name =        "demuxer_buffer",
+      .long_name =   TRS("Demuxer thread buffer (milliseconds)"),
+      .type =        BG_PARAMETER_INT,
+      .val_default = { .val_i = 0 },
+      .val_min =     { .val_i = 0 },
+      .val_max =     { .val_i = 10000 },
+      .help_string = TRS("Read ahead in a separate thread until each audio and video stream has this time buffered. This lets audio and video be decoded in parallel without waiting for the input. 0 disables the thread."),
+    },
     { /* End of parameters */ }
   };
 
@@ -53,6 +53,14 @@ bg_avdec_option_set_parameter(bgav_options_t * opt, const char * name,
     {
     bgav_options_set_http_shoutcast_metadata(opt, val->val_i);
     }
+  else if(!strcmp(name, "http_block_size"))
+    {
+    bgav_options_set_http_block_size(opt, val->val_i * 1024);
+    }
+  else if(!strcmp(name, "http_cache_size"))
+    {
+    bgav_options_set_http_cache_size(opt, val->val_i * 1024);
+    }
   else if(!strcmp(name, "http_use_proxy"))
     {
     bgav_options_set_http_use_proxy(opt, val->val_i);
@@ -137,6 +145,10 @@ bg_avdec_option_set_parameter(bgav_options_t * opt, const char * name,
     {
     bgav_options_set_cache_size(opt, val->val_i);
     }
+  else if(!strcmp(name, "seek_cache_size"))
+    {
+    bgav_options_set_seek_cache_size(opt, val->val_i * 1024 * 1024);
+    }
   else if(!strcmp(name, "cache_time"))
     {
     bgav_options_set_cache_time(opt, val->val_i);
@@ -145,6 +157,14 @@ bg_avdec_option_set_parameter(bgav_options_t * opt, const char * name,
     {
     bgav_options_set_dv_datetime(opt, val->val_i);
     }
+  else if(!strcmp(name, "all_programs"))
+    {
+    bgav_options_set_all_programs(opt, val->val_i);
+    }
+  else if(!strcmp(name, "demuxer_buffer"))
+    {
+    bgav_options_set_demuxer_buffer(opt, val->val_i);
+    }
   else if(!strcmp(name, "shrink"))
     {
     bgav_options_set_shrink(opt, val->val_i);
@@ -0,0 +1,375 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/* Test for the byte range mode of the http input: Starts a small
+   http server on localhost, which supports byte ranges and persistent
+   connections, and checks the data after sequential reads and seeks.
+   It also checks that cached blocks don't cause new requests and that
+   connections are reused. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <avdec_private.h>
+
+#define FILE_SIZE   (1024 * 1024 + 1234)
+#define BLOCK_SIZE  (4 * 1024)
+#define CACHE_SIZE  (64 * 1024)
+
+/* The server closes the connection silently after this many
+   responses, so the client has to cope with stale connections */
+#define MAX_RESPONSES 4
+
+typedef struct
+  {
+  int connections;
+  int requests;
+  int range_requests;
+  } server_stats_t;
+
+static server_stats_t * stats;
+
+static uint8_t file_byte(int64_t pos)
+  {
+  return (pos ^ (pos >> 8) ^ (pos >> 16)) & 0xff;
+  }
+
+/* Server */
+
+static int write_all(int fd, const char * data, int len)
+  {
+  int result;
+  while(len)
+    {
+    result = write(fd, data, len);
+    if(result <= 0)
+      return 0;
+    data += result;
+    len -= result;
+    }
+  return 1;
+  }
+
+static int read_request(int fd, int64_t * start, int64_t * end)
+  {
+  char line[1024];
+  int len = 0;
+  int num_lines = 0;
+
+  *start = -1;
+  *end = -1;
+
+  while(1)
+    {
+    if(read(fd, line + len, 1) < 1)
+      return 0;
+
+    if(line[len] != '\n')
+      {
+      if(len < sizeof(line) - 2)
+        len++;
+      continue;
+      }
+    if(len && (line[len-1] == '\r'))
+      len--;
+    line[len] = '\0';
+
+    if(!len)
+      return num_lines;
+
+    if(sscanf(line, "Range: bytes=%"SCNd64"-%"SCNd64, start, end) == 1)
+      *end = -1;
+    num_lines++;
+    len = 0;
+    }
+  }
+
+static void serve_connection(int fd)
+  {
+  int64_t start, end, pos;
+  int responses = 0;
+  char buf[4096];
+  int len;
+
+  while(responses < MAX_RESPONSES)
+    {
+    if(!read_request(fd, &start, &end))
+      break;
+
+    __sync_fetch_and_add(&stats->requests, 1);
+
+    if(start >= 0)
+      {
+      if((end < 0) || (end >= FILE_SIZE))
+        end = FILE_SIZE - 1;
+      __sync_fetch_and_add(&stats->range_requests, 1);
+      len = snprintf(buf, sizeof(buf),
+                     "HTTP/1.1 206 Partial Content\r\n"
+                     "Content-Type: application/octet-stream\r\n"
+                     "Accept-Ranges: bytes\r\n"
+                     "Content-Range: bytes %"PRId64"-%"PRId64"/%d\r\n"
+                     "Content-Length: %"PRId64"\r\n\r\n",
+                     start, end, FILE_SIZE, end - start + 1);
+      }
+    else
+      {
+      start = 0;
+      end = FILE_SIZE - 1;
+      len = snprintf(buf, sizeof(buf),
+                     "HTTP/1.1 200 OK\r\n"
+                     "Content-Type: application/octet-stream\r\n"
+                     "Accept-Ranges: bytes\r\n"
+                     "Content-Length: %d\r\n\r\n", FILE_SIZE);
+      }
+
+    if(!write_all(fd, buf, len))
+      break;
+
+    pos = start;
+    while(pos <= end)
+      {
+      len = sizeof(buf);
+      if(len > end - pos + 1)
+        len = end - pos + 1;
+      for(start = 0; start < len; start++)
+        buf[start] = file_byte(pos + start);
+      if(!write_all(fd, buf, len))
+        return;
+      pos += len;
+      }
+    responses++;
+    }
+  }
+
+static void run_server(int listen_fd)
+  {
+  int fd;
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGCHLD, SIG_IGN);
+
+  while((fd = accept(listen_fd, NULL, NULL)) >= 0)
+    {
+    __sync_fetch_and_add(&stats->connections, 1);
+
+    if(!fork())
+      {
+      close(listen_fd);
+      serve_connection(fd);
+      close(fd);
+      _exit(0);
+      }
+    close(fd);
+    }
+  _exit(0);
+  }
+
+/* Client */
+
+static int check_read(bgav_input_context_t * ctx, int64_t pos, int len)
+  {
+  uint8_t * buf;
+  int result, i;
+  int ret = 1;
+
+  if(pos + len > FILE_SIZE)
+    len = FILE_SIZE - pos;
+
+  buf = malloc(len);
+
+  bgav_input_seek(ctx, pos, SEEK_SET);
+  result = bgav_input_read_data(ctx, buf, len);
+
+  if(result < len)
+    {
+    fprintf(stderr, "  Reading %d bytes at %"PRId64" returned %d\n",
+            len, pos, result);
+    ret = 0;
+    }
+  else
+    {
+    for(i = 0; i < len; i++)
+      {
+      if(buf[i] != file_byte(pos + i))
+        {
+        fprintf(stderr, "  Wrong data at %"PRId64"\n", pos + i);
+        ret = 0;
+        break;
+        }
+      }
+    }
+  free(buf);
+  return ret;
+  }
+
+static void print_result(const char * test, int result)
+  {
+  fprintf(stderr, "%-45s[%s]\n", test, (result ? "  ok  " : " fail "));
+  }
+
+static int run_client(const char * url)
+  {
+  int i, result;
+  int ret = 1;
+  int64_t pos;
+  int len;
+  int requests;
+  uint32_t seed = 1;
+  bgav_options_t * opt;
+  bgav_input_context_t * ctx;
+
+  opt = bgav_options_create();
+  bgav_options_set_http_block_size(opt, BLOCK_SIZE);
+  bgav_options_set_http_cache_size(opt, CACHE_SIZE);
+
+  ctx = bgav_input_create(opt);
+
+  if(!bgav_input_open(ctx, url))
+    {
+    print_result("Opening", 0);
+    bgav_input_destroy(ctx);
+    bgav_options_destroy(opt);
+    return 0;
+    }
+
+  result = ctx->input->seek_byte && (ctx->total_bytes == FILE_SIZE);
+  print_result("Input is seekable", result);
+  if(!result)
+    {
+    bgav_input_destroy(ctx);
+    bgav_options_destroy(opt);
+    return 0;
+    }
+
+  /* Sequential read in odd sized chunks */
+  result = 1;
+  pos = 0;
+  while(pos < FILE_SIZE)
+    {
+    if(!check_read(ctx, pos, 3001))
+      result = 0;
+    pos += 3001;
+    }
+  print_result("Sequential read", result);
+  if(!result)
+    ret = 0;
+
+  /* Random seeks */
+  result = 1;
+  for(i = 0; i < 200; i++)
+    {
+    seed = seed * 1103515245 + 12345;
+    pos = (seed >> 8) % FILE_SIZE;
+    seed = seed * 1103515245 + 12345;
+    len = 1 + (seed >> 8) % (3 * BLOCK_SIZE);
+    if(!check_read(ctx, pos, len))
+      result = 0;
+    }
+  print_result("Random seeks", result);
+  if(!result)
+    ret = 0;
+
+  /* Reads from blocks in the cache must not cause requests */
+  check_read(ctx, 500000, 2 * BLOCK_SIZE);
+  requests = stats->requests;
+
+  result = 1;
+  for(i = 0; i < 20; i++)
+    {
+    if(!check_read(ctx, 500000 + (i * 97) % BLOCK_SIZE, BLOCK_SIZE))
+      result = 0;
+    }
+  result = result && (stats->requests == requests);
+  print_result("Block cache hits", result);
+  if(!result)
+    ret = 0;
+
+  bgav_input_destroy(ctx);
+  bgav_options_destroy(opt);
+
+  fprintf(stderr, "%d requests (%d range requests), %d connections\n",
+          stats->requests, stats->range_requests, stats->connections);
+
+  /* Each connection serves up to MAX_RESPONSES requests. The initial
+     response is abandoned, so allow a few more connections */
+  result = (stats->range_requests > 0) &&
+    (stats->connections < stats->requests / 2 + 2);
+  print_result("Connection reuse", result);
+  if(!result)
+    ret = 0;
+
+  return ret;
+  }
+
+int main(int argc, char ** argv)
+  {
+  int fd;
+  int ret;
+  pid_t server;
+  char url[64];
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+
+  stats = mmap(NULL, sizeof(*stats), PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  memset(stats, 0, sizeof(*stats));
+
+  /* Listen on a free port */
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+
+  if((fd < 0) ||
+     bind(fd, (struct sockaddr*)&addr, sizeof(addr)) ||
+     listen(fd, 16) ||
+     getsockname(fd, (struct sockaddr*)&addr, &addr_len))
+    {
+    fprintf(stderr, "Cannot start server\n");
+    return 1;
+    }
+
+  server = fork();
+  if(!server)
+    run_server(fd);
+  close(fd);
+
+  snprintf(url, sizeof(url), "http://127.0.0.1:%d/test.bin",
+           ntohs(addr.sin_port));
+  ret = run_client(url);
+
+  kill(server, SIGTERM);
+  waitpid(server, NULL, 0);
+
+  return ret ? 0 : 1;
+  }
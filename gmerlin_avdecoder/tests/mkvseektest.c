@@ -0,0 +1,449 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/* Regression test for seeking in matroska files: Writes small PCM files
+   with cues (CueRelativePosition and CueBlockNumber), without cues and
+   with unknown sized clusters (live recordings). Each sample contains
+   its own index, so we can check that seeking is sample accurate. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include <avdec.h>
+
+#define SAMPLERATE      8000
+#define BLOCK_SAMPLES   160  /* 20 ms */
+#define CLUSTER_BLOCKS  50   /* 1 s */
+#define NUM_CLUSTERS    30
+#define SAMPLES_TO_READ 1024
+
+#define TOTAL_SAMPLES (NUM_CLUSTERS * CLUSTER_BLOCKS * BLOCK_SAMPLES)
+
+#define SAMPLE_VALUE(idx) ((int16_t)((idx) & 0x7fff))
+
+typedef enum
+  {
+    MODE_CUES_REL,
+    MODE_CUES_BLOCK,
+    MODE_NOCUES,
+    MODE_LIVE,
+  } file_mode_t;
+
+static const char * const mode_names[] =
+  {
+    "cues_rel",
+    "cues_block",
+    "nocues",
+    "live",
+  };
+
+/* Sample positions to seek to. 100000 and 48000 are at block boundaries
+   in the middle of a cluster */
+static const int64_t targets[] =
+  {
+    100000, 0, 1, 159, 8000, 12345, 48000, 150001, 230000, 4000
+  };
+
+/* EBML writer. All sizes are written with 8 bytes, so the sizes of
+   the elements don't depend on their contents */
+
+typedef struct
+  {
+  uint8_t * data;
+  int len;
+  int alloc;
+  } buf_t;
+
+static void buf_append(buf_t * b, const void * data, int len)
+  {
+  if(b->len + len > b->alloc)
+    {
+    b->alloc = b->len + len + 4096;
+    b->data = realloc(b->data, b->alloc);
+    }
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+  }
+
+static void buf_free(buf_t * b)
+  {
+  if(b->data)
+    free(b->data);
+  memset(b, 0, sizeof(*b));
+  }
+
+static void put_be(buf_t * b, uint64_t val, int bytes)
+  {
+  uint8_t data[8];
+  int i;
+  for(i = 0; i < bytes; i++)
+    data[i] = (val >> (8 * (bytes - 1 - i))) & 0xff;
+  buf_append(b, data, bytes);
+  }
+
+static void put_id(buf_t * b, uint32_t id)
+  {
+  int bytes = 1;
+  while((bytes < 4) && (id >> (8 * bytes)))
+    bytes++;
+  put_be(b, id, bytes);
+  }
+
+static void put_size(buf_t * b, uint64_t size)
+  {
+  put_be(b, 0x0100000000000000LL | size, 8);
+  }
+
+static void put_element(buf_t * b, uint32_t id, const buf_t * payload)
+  {
+  put_id(b, id);
+  put_size(b, payload->len);
+  buf_append(b, payload->data, payload->len);
+  }
+
+static void put_element_unknown(buf_t * b, uint32_t id, const buf_t * payload)
+  {
+  put_id(b, id);
+  put_be(b, 0x01ffffffffffffffLL, 8);
+  buf_append(b, payload->data, payload->len);
+  }
+
+static void put_uint(buf_t * b, uint32_t id, uint64_t val)
+  {
+  put_id(b, id);
+  put_size(b, 8);
+  put_be(b, val, 8);
+  }
+
+static void put_header_uint(buf_t * b, uint32_t id, uint8_t val)
+  {
+  put_id(b, id);
+  put_be(b, 0x81, 1);
+  put_be(b, val, 1);
+  }
+
+static void put_float(buf_t * b, uint32_t id, double val)
+  {
+  union { double d; uint64_t i; } u;
+  u.d = val;
+  put_id(b, id);
+  put_size(b, 8);
+  put_be(b, u.i, 8);
+  }
+
+static void put_string(buf_t * b, uint32_t id, const char * str)
+  {
+  put_id(b, id);
+  put_size(b, strlen(str));
+  buf_append(b, str, strlen(str));
+  }
+
+static void put_le(buf_t * b, uint32_t val, int bytes)
+  {
+  uint8_t data[4];
+  int i;
+  for(i = 0; i < bytes; i++)
+    data[i] = (val >> (8 * i)) & 0xff;
+  buf_append(b, data, bytes);
+  }
+
+/* Segment children before the clusters */
+
+static void make_head(buf_t * ret, file_mode_t mode, int64_t cues_pos)
+  {
+  buf_t seek = { 0 }, tmp = { 0 }, wf = { 0 }, audio = { 0 }, track = { 0 };
+
+  if((mode == MODE_CUES_REL) || (mode == MODE_CUES_BLOCK))
+    {
+    put_id(&tmp, 0x53AB); /* SeekID */
+    put_size(&tmp, 4);
+    put_be(&tmp, 0x1C53BB6B, 4);
+    put_uint(&tmp, 0x53AC, cues_pos); /* SeekPosition */
+    put_element(&seek, 0x4DBB, &tmp); /* Seek */
+    put_element(ret, 0x114D9B74, &seek); /* SeekHead */
+    buf_free(&tmp);
+    }
+
+  /* Info */
+  put_uint(&tmp, 0x2AD7B1, 1000000); /* TimecodeScale */
+  put_float(&tmp, 0x4489, (double)TOTAL_SAMPLES * 1000.0 / SAMPLERATE);
+  put_element(ret, 0x1549A966, &tmp);
+  buf_free(&tmp);
+
+  /* WAVEFORMATEX: 16 bit mono PCM */
+  put_le(&wf, 1, 2);
+  put_le(&wf, 1, 2);
+  put_le(&wf, SAMPLERATE, 4);
+  put_le(&wf, SAMPLERATE * 2, 4);
+  put_le(&wf, 2, 2);
+  put_le(&wf, 16, 2);
+  put_le(&wf, 0, 2);
+
+  put_float(&audio, 0xB5, SAMPLERATE); /* SamplingFrequency */
+  put_uint(&audio, 0x9F, 1);           /* Channels */
+
+  put_uint(&track, 0xD7, 1);     /* TrackNumber */
+  put_uint(&track, 0x73C5, 1234); /* TrackUID */
+  put_uint(&track, 0x83, 2);     /* TrackType */
+  put_string(&track, 0x86, "A_MS/ACM");
+  put_element(&track, 0x63A2, &wf);
+  put_element(&track, 0xE1, &audio);
+
+  put_element(&tmp, 0xAE, &track); /* TrackEntry */
+  put_element(ret, 0x1654AE6B, &tmp); /* Tracks */
+
+  buf_free(&seek);
+  buf_free(&tmp);
+  buf_free(&wf);
+  buf_free(&audio);
+  buf_free(&track);
+  }
+
+static int write_file(const char * filename, file_mode_t mode)
+  {
+  int c, b, i;
+  int64_t sample = 0;
+  int64_t cluster_pos[NUM_CLUSTERS];
+  int block_pos[CLUSTER_BLOCKS];
+  buf_t head = { 0 }, clusters = { 0 }, cluster = { 0 };
+  buf_t block = { 0 }, cues = { 0 }, tmp = { 0 }, tmp1 = { 0 };
+  buf_t segment = { 0 }, file = { 0 };
+  int64_t cues_pos;
+  FILE * out;
+  int ret = 0;
+
+  /* The head has the same size for all cue positions */
+  make_head(&head, mode, 0);
+
+  for(c = 0; c < NUM_CLUSTERS; c++)
+    {
+    cluster_pos[c] = head.len + clusters.len;
+
+    put_uint(&cluster, 0xE7, c * CLUSTER_BLOCKS * BLOCK_SAMPLES * 1000 /
+             SAMPLERATE); /* Timecode */
+
+    for(b = 0; b < CLUSTER_BLOCKS; b++)
+      {
+      /* Track number, relative timecode, flags (keyframe) */
+      put_be(&block, 0x81, 1);
+      put_be(&block, b * BLOCK_SAMPLES * 1000 / SAMPLERATE, 2);
+      put_be(&block, 0x80, 1);
+      for(i = 0; i < BLOCK_SAMPLES; i++)
+        {
+        put_le(&block, (uint16_t)SAMPLE_VALUE(sample), 2);
+        sample++;
+        }
+      block_pos[b] = cluster.len;
+      put_element(&cluster, 0xA3, &block); /* SimpleBlock */
+      block.len = 0;
+      }
+
+    if(mode == MODE_LIVE)
+      put_element_unknown(&clusters, 0x1F43B675, &cluster);
+    else
+      put_element(&clusters, 0x1F43B675, &cluster);
+    cluster.len = 0;
+
+    if((mode != MODE_CUES_REL) && (mode != MODE_CUES_BLOCK))
+      continue;
+
+    /* Cue points at the first block and in the middle of the cluster.
+       A cue entry for another (nonexistent) track comes first */
+    for(b = 0; b < CLUSTER_BLOCKS; b += CLUSTER_BLOCKS / 2)
+      {
+      put_uint(&tmp1, 0xF7, 5);
+      put_uint(&tmp1, 0xF1, 3);
+      put_element(&tmp, 0xB7, &tmp1);
+      tmp1.len = 0;
+
+      put_uint(&tmp1, 0xF7, 1);
+      put_uint(&tmp1, 0xF1, cluster_pos[c]);
+      if(mode == MODE_CUES_REL)
+        put_uint(&tmp1, 0xF0, block_pos[b]);
+      else
+        put_uint(&tmp1, 0x5378, b + 1);
+      put_uint(&tmp, 0xB3, (c * CLUSTER_BLOCKS + b) * BLOCK_SAMPLES * 1000 /
+               SAMPLERATE);
+      put_element(&tmp, 0xB7, &tmp1);
+      tmp1.len = 0;
+
+      put_element(&cues, 0xBB, &tmp);
+      tmp.len = 0;
+      }
+    }
+
+  cues_pos = head.len + clusters.len;
+  head.len = 0;
+  make_head(&head, mode, cues_pos);
+
+  buf_append(&segment, head.data, head.len);
+  buf_append(&segment, clusters.data, clusters.len);
+  if(cues.len)
+    put_element(&segment, 0x1C53BB6B, &cues);
+
+  /* EBML header: Must fit into the first 64 bytes for probing */
+  put_header_uint(&tmp, 0x4286, 1);
+  put_header_uint(&tmp, 0x42F7, 1);
+  put_header_uint(&tmp, 0x42F2, 4);
+  put_header_uint(&tmp, 0x42F3, 8);
+  put_id(&tmp, 0x4282);
+  put_be(&tmp, 0x80 | 8, 1);
+  buf_append(&tmp, "matroska", 8);
+  put_header_uint(&tmp, 0x4287, 2);
+  put_header_uint(&tmp, 0x4285, 2);
+  put_id(&file, 0x1A45DFA3);
+  put_be(&file, 0x80 | tmp.len, 1);
+  buf_append(&file, tmp.data, tmp.len);
+  tmp.len = 0;
+
+  if(mode == MODE_LIVE)
+    put_element_unknown(&file, 0x18538067, &segment);
+  else
+    put_element(&file, 0x18538067, &segment);
+
+  if((out = fopen(filename, "wb")))
+    {
+    ret = (fwrite(file.data, 1, file.len, out) == file.len);
+    fclose(out);
+    }
+
+  buf_free(&head);
+  buf_free(&clusters);
+  buf_free(&cluster);
+  buf_free(&block);
+  buf_free(&cues);
+  buf_free(&tmp);
+  buf_free(&tmp1);
+  buf_free(&segment);
+  buf_free(&file);
+  return ret;
+  }
+
+static int check_seek(bgav_t * b, gavl_audio_frame_t * f, int64_t target)
+  {
+  int i, result;
+  int64_t t = target;
+  const char * error = NULL;
+
+  bgav_seek_scaled(b, &t, SAMPLERATE);
+
+  result = bgav_read_audio(b, f, 0, SAMPLES_TO_READ);
+
+  if(result != SAMPLES_TO_READ)
+    error = "EOF";
+  else if(f->timestamp != target)
+    error = "wrong timestamp";
+  else
+    {
+    for(i = 0; i < result; i++)
+      {
+      if(f->samples.s_16[i] != SAMPLE_VALUE(target + i))
+        {
+        error = "wrong samples";
+        break;
+        }
+      }
+    }
+
+  fprintf(stderr, "  Seek to %6"PRId64": timestamp %6"PRId64", first sample %6d [%s]\n",
+          target, f->timestamp, result ? f->samples.s_16[0] : -1,
+          error ? error : "ok");
+  return !error;
+  }
+
+static int test_file(const char * filename)
+  {
+  int i, ret = 1;
+  bgav_t * b;
+  bgav_options_t * opt;
+  gavl_audio_format_t format;
+  gavl_audio_frame_t * f;
+
+  b = bgav_create();
+  opt = bgav_get_options(b);
+
+  /* Don't save cluster indices */
+  bgav_options_set_cache_time(opt, 1000000);
+
+  if(!bgav_open(b, filename))
+    {
+    fprintf(stderr, "  Opening %s failed\n", filename);
+    bgav_close(b);
+    return 0;
+    }
+  if(!bgav_can_seek(b))
+    {
+    fprintf(stderr, "  %s is not seekable\n", filename);
+    bgav_close(b);
+    return 0;
+    }
+
+  bgav_select_track(b, 0);
+  bgav_set_audio_stream(b, 0, BGAV_STREAM_DECODE);
+  bgav_start(b);
+
+  gavl_audio_format_copy(&format, bgav_get_audio_format(b, 0));
+  format.samples_per_frame = SAMPLES_TO_READ;
+  f = gavl_audio_frame_create(&format);
+
+  for(i = 0; i < sizeof(targets) / sizeof(targets[0]); i++)
+    {
+    if(!check_seek(b, f, targets[i]))
+      ret = 0;
+    }
+  gavl_audio_frame_destroy(f);
+  bgav_close(b);
+  return ret;
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i, ret = 1;
+  char filename[256];
+  const char * dir = getenv("TMPDIR");
+
+  if(!dir)
+    dir = "/tmp";
+
+  for(i = 0; i < sizeof(mode_names) / sizeof(mode_names[0]); i++)
+    {
+    snprintf(filename, sizeof(filename), "%s/mkvseektest-%d-%s.mkv",
+             dir, getpid(), mode_names[i]);
+
+    fprintf(stderr, "Testing %s\n", mode_names[i]);
+
+    if(!write_file(filename, i))
+      {
+      fprintf(stderr, "  Writing %s failed\n", filename);
+      ret = 0;
+      continue;
+      }
+    if(!test_file(filename))
+      ret = 0;
+    remove(filename);
+    }
+
+  fprintf(stderr, "%s\n", ret ? "All seeks sample accurate" : "Seek test failed");
+  return ret ? 0 : 1;
+  }
@@ -0,0 +1,517 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/* Benchmark for the MPEG-2 transport stream demuxer: Writes a synthetic
+   multi-program transport stream (MPEG-1 video and MPEG audio per
+   program) and reports the demultiplexing throughput for each program */
+
+#include <avdec.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PAT_PID        0x0000
+#define PMT_PID(p)     (0x1000 + (p))
+#define VIDEO_PID(p)   (0x0100 + 0x10 * (p))
+#define AUDIO_PID(p)   (0x0101 + 0x10 * (p))
+
+#define FRAMERATE      25
+#define AUDIO_RATE     48000
+#define AUDIO_FRAME    576  /* Layer II, 192 kbps, 48 kHz */
+#define AUDIO_SAMPLES  1152
+
+#define PTS_OFFSET     90000
+
+static FILE * out;
+static int packet_size = 188;
+static uint8_t continuity[0x2000];
+static int64_t packets_written = 0;
+
+/* MPEG-2 CRC for PSI sections */
+
+static uint32_t crc32_mpeg(const uint8_t * data, int len)
+  {
+  int i;
+  uint32_t crc = 0xffffffff;
+  while(len--)
+    {
+    crc ^= (uint32_t)(*data++) << 24;
+    for(i = 0; i < 8; i++)
+      crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : (crc << 1);
+    }
+  return crc;
+  }
+
+/* Write payload as a sequence of transport packets. The last packet is
+   filled with adaption field stuffing for PES packets and with 0xff
+   for PSI sections. If pcr >= 0, the first packet carries a PCR */
+
+static void write_ts(int pid, const uint8_t * data, int len, int64_t pcr,
+                     int psi)
+  {
+  uint8_t pkt[204];
+  uint8_t * ptr;
+  int af_len;
+  int payload;
+  int first = 1;
+
+  while(len > 0)
+    {
+    ptr = pkt;
+    memset(pkt, 0xff, sizeof(pkt));
+    *(ptr++) = 0x47;
+    *(ptr++) = (first ? 0x40 : 0x00) | (pid >> 8);
+    *(ptr++) = pid & 0xff;
+
+    af_len = -1;
+    if(first && (pcr >= 0))
+      af_len = 7;
+
+    payload = 184 - (af_len >= 0 ? af_len + 1 : 0);
+    if(psi && (len < payload))
+      payload = len;
+    else if(len < payload)
+      {
+      /* Stuffing */
+      af_len = (af_len >= 0 ? af_len : -1) + (payload - len);
+      payload = len;
+      }
+
+    *(ptr++) = ((af_len >= 0) ? 0x30 : 0x10) | continuity[pid];
+    continuity[pid] = (continuity[pid] + 1) & 0x0f;
+
+    if(af_len >= 0)
+      {
+      *ptr = af_len;
+      if(af_len)
+        {
+        ptr[1] = 0x00;
+        if(first && (pcr >= 0))
+          {
+          ptr[1] = 0x10;
+          ptr[2] = pcr >> 25;
+          ptr[3] = pcr >> 17;
+          ptr[4] = pcr >> 9;
+          ptr[5] = pcr >> 1;
+          ptr[6] = ((pcr & 1) << 7) | 0x7e;
+          ptr[7] = 0x00;
+          }
+        }
+      ptr += af_len + 1;
+      }
+    memcpy(ptr, data, payload);
+
+    /* 192 and 204 byte packets: Timestamp prefix resp. FEC suffix
+       are ignored by the demuxer */
+    fwrite(pkt, 1, packet_size, out);
+    packets_written++;
+
+    data += payload;
+    len -= payload;
+    first = 0;
+    }
+  }
+
+static int write_section(uint8_t * data, int len)
+  {
+  uint32_t crc;
+  /* Section length: Bytes after the length field including CRC */
+  data[2] = 0xb0 | (len >> 8);
+  data[3] = len & 0xff;
+  crc = crc32_mpeg(data + 1, len - 1);
+  data[len++] = crc >> 24;
+  data[len++] = crc >> 16;
+  data[len++] = crc >> 8;
+  data[len++] = crc;
+  return len;
+  }
+
+static void write_psi(int num_programs)
+  {
+  int i;
+  uint8_t buf[1024];
+  uint8_t * ptr;
+  int len;
+
+  /* PAT */
+  ptr = buf;
+  *(ptr++) = 0x00; /* Pointer field */
+  *(ptr++) = 0x00; /* Table ID */
+  ptr += 2;        /* Section length */
+  *(ptr++) = 0x00; /* Transport stream ID */
+  *(ptr++) = 0x01;
+  *(ptr++) = 0xc1; /* Version, current_next */
+  *(ptr++) = 0x00; /* Section number */
+  *(ptr++) = 0x00; /* Last section number */
+  for(i = 0; i < num_programs; i++)
+    {
+    *(ptr++) = (i + 1) >> 8;
+    *(ptr++) = (i + 1) & 0xff;
+    *(ptr++) = 0xe0 | (PMT_PID(i) >> 8);
+    *(ptr++) = PMT_PID(i) & 0xff;
+    }
+  len = write_section(buf, ptr - buf);
+  write_ts(PAT_PID, buf, len, -1, 1);
+
+  /* PMTs */
+  for(i = 0; i < num_programs; i++)
+    {
+    ptr = buf;
+    *(ptr++) = 0x00; /* Pointer field */
+    *(ptr++) = 0x02; /* Table ID */
+    ptr += 2;        /* Section length */
+    *(ptr++) = (i + 1) >> 8;
+    *(ptr++) = (i + 1) & 0xff;
+    *(ptr++) = 0xc1;
+    *(ptr++) = 0x00;
+    *(ptr++) = 0x00;
+    *(ptr++) = 0xe0 | (VIDEO_PID(i) >> 8); /* PCR PID */
+    *(ptr++) = VIDEO_PID(i) & 0xff;
+    *(ptr++) = 0xf0; /* Program info length */
+    *(ptr++) = 0x00;
+
+    *(ptr++) = 0x01; /* MPEG-1 video */
+    *(ptr++) = 0xe0 | (VIDEO_PID(i) >> 8);
+    *(ptr++) = VIDEO_PID(i) & 0xff;
+    *(ptr++) = 0xf0;
+    *(ptr++) = 0x00;
+
+    *(ptr++) = 0x03; /* MPEG-1 audio */
+    *(ptr++) = 0xe0 | (AUDIO_PID(i) >> 8);
+    *(ptr++) = AUDIO_PID(i) & 0xff;
+    *(ptr++) = 0xf0;
+    *(ptr++) = 0x00;
+
+    len = write_section(buf, ptr - buf);
+    write_ts(PMT_PID(i), buf, len, -1, 1);
+    }
+  }
+
+static uint8_t * write_pes_header(uint8_t * ptr, int stream_id,
+                                  int payload_len, int64_t pts)
+  {
+  int len = payload_len + 8;
+
+  *(ptr++) = 0x00;
+  *(ptr++) = 0x00;
+  *(ptr++) = 0x01;
+  *(ptr++) = stream_id;
+  /* Video PES packets can be larger than 64k */
+  if(len > 0xffff)
+    len = 0;
+  *(ptr++) = len >> 8;
+  *(ptr++) = len & 0xff;
+  *(ptr++) = 0x80;
+  *(ptr++) = 0x80; /* PTS only */
+  *(ptr++) = 0x05;
+  *(ptr++) = 0x21 | ((pts >> 29) & 0x0e);
+  *(ptr++) = pts >> 22;
+  *(ptr++) = 0x01 | ((pts >> 14) & 0xfe);
+  *(ptr++) = pts >> 7;
+  *(ptr++) = 0x01 | ((pts << 1) & 0xfe);
+  return ptr;
+  }
+
+/* Intra only MPEG-1 video frame with random slice data */
+
+static int make_video_frame(uint8_t * ret, int size)
+  {
+  uint8_t * ptr = ret;
+  uint8_t * end = ret + size;
+  uint8_t * slice_end;
+  int slice;
+
+  /* Sequence header: 352x288, 1:1, 25 fps */
+  *(ptr++) = 0x00; *(ptr++) = 0x00; *(ptr++) = 0x01; *(ptr++) = 0xb3;
+  *(ptr++) = 0x16; *(ptr++) = 0x01; *(ptr++) = 0x20;
+  *(ptr++) = 0x13; /* Aspect 1, frame rate code 3 */
+  *(ptr++) = 0xff; *(ptr++) = 0xff; *(ptr++) = 0xe0; *(ptr++) = 0xa0;
+
+  /* GOP */
+  *(ptr++) = 0x00; *(ptr++) = 0x00; *(ptr++) = 0x01; *(ptr++) = 0xb8;
+  *(ptr++) = 0x00; *(ptr++) = 0x08; *(ptr++) = 0x00; *(ptr++) = 0x00;
+
+  /* Picture header: I-frame */
+  *(ptr++) = 0x00; *(ptr++) = 0x00; *(ptr++) = 0x01; *(ptr++) = 0x00;
+  *(ptr++) = 0x00; *(ptr++) = 0x0f; *(ptr++) = 0xff; *(ptr++) = 0xf8;
+
+  /* 18 slices */
+  for(slice = 1; slice <= 18; slice++)
+    {
+    *(ptr++) = 0x00; *(ptr++) = 0x00; *(ptr++) = 0x01;
+    *(ptr++) = slice;
+
+    slice_end = (slice == 18) ? end : ret + slice * (size / 18);
+    while(ptr < slice_end)
+      *(ptr++) = 0x80 | (rand() & 0x7f);
+    }
+  return ptr - ret;
+  }
+
+static void make_audio_frame(uint8_t * ret)
+  {
+  memset(ret, 0, AUDIO_FRAME);
+  ret[0] = 0xff;
+  ret[1] = 0xfd; /* MPEG-1 Layer II, no CRC */
+  ret[2] = 0xa4; /* 192 kbps, 48 kHz */
+  ret[3] = 0x00; /* Stereo */
+  }
+
+static int write_file(const char * filename, int num_programs,
+                      int seconds, int video_bitrate)
+  {
+  int i;
+  int frame;
+  int num_frames;
+  int video_size;
+  int len;
+  uint8_t * video_frame;
+  uint8_t * pes;
+  uint8_t audio_frame[AUDIO_FRAME];
+  int64_t pts;
+  int64_t * audio_samples;
+
+  out = fopen(filename, "wb");
+  if(!out)
+    {
+    fprintf(stderr, "Cannot open %s\n", filename);
+    return 0;
+    }
+
+  video_size = video_bitrate / 8 / FRAMERATE;
+  video_frame = malloc(video_size);
+  pes = malloc(video_size + 32);
+  audio_samples = calloc(num_programs, sizeof(*audio_samples));
+  make_audio_frame(audio_frame);
+
+  num_frames = seconds * FRAMERATE;
+
+  for(frame = 0; frame < num_frames; frame++)
+    {
+    if(!(frame % 5))
+      write_psi(num_programs);
+
+    pts = PTS_OFFSET + (int64_t)frame * 90000 / FRAMERATE;
+
+    for(i = 0; i < num_programs; i++)
+      {
+      /* Video */
+      len = make_video_frame(video_frame, video_size);
+      memcpy(write_pes_header(pes, 0xe0, len, pts), video_frame, len);
+      write_ts(VIDEO_PID(i), pes, len + 14, pts - 9000, 0);
+
+      /* Audio up to the end of the video frame */
+      while(audio_samples[i] * FRAMERATE < (int64_t)(frame + 1) * AUDIO_RATE)
+        {
+        memcpy(write_pes_header(pes, 0xc0, AUDIO_FRAME,
+                                PTS_OFFSET + audio_samples[i] * 90000 / AUDIO_RATE),
+               audio_frame, AUDIO_FRAME);
+        write_ts(AUDIO_PID(i), pes, AUDIO_FRAME + 14, -1, 0);
+        audio_samples[i] += AUDIO_SAMPLES;
+        }
+      }
+    }
+
+  free(video_frame);
+  free(pes);
+  free(audio_samples);
+  fclose(out);
+  return 1;
+  }
+
+static int bench_track(const char * filename, int track,
+                       int64_t file_size)
+  {
+  int i;
+  bgav_t * b;
+  gavl_packet_t p;
+  gavl_timer_t * timer;
+  gavl_time_t time;
+  int num_audio, num_video;
+  int num_active;
+  int * active;
+  int64_t num_packets = 0;
+  int64_t num_bytes = 0;
+
+  b = bgav_create();
+  if(!bgav_open(b, filename))
+    {
+    fprintf(stderr, "Cannot open %s\n", filename);
+    bgav_close(b);
+    return 0;
+    }
+
+  timer = gavl_timer_create();
+  gavl_timer_start(timer);
+
+  bgav_select_track(b, track);
+
+  num_audio = bgav_num_audio_streams(b, track);
+  num_video = bgav_num_video_streams(b, track);
+
+  for(i = 0; i < num_audio; i++)
+    bgav_set_audio_stream(b, i, BGAV_STREAM_READRAW);
+  for(i = 0; i < num_video; i++)
+    bgav_set_video_stream(b, i, BGAV_STREAM_READRAW);
+
+  if(!bgav_start(b))
+    {
+    fprintf(stderr, "Starting track %d failed\n", track + 1);
+    bgav_close(b);
+    gavl_timer_destroy(timer);
+    return 0;
+    }
+
+  memset(&p, 0, sizeof(p));
+  gavl_packet_init(&p);
+
+  active = malloc((num_audio + num_video) * sizeof(*active));
+  for(i = 0; i < num_audio + num_video; i++)
+    active[i] = 1;
+  num_active = num_audio + num_video;
+
+  while(num_active)
+    {
+    for(i = 0; i < num_audio + num_video; i++)
+      {
+      if(!active[i])
+        continue;
+      if((i < num_audio) ?
+         bgav_read_audio_packet(b, i, &p) :
+         bgav_read_video_packet(b, i - num_audio, &p))
+        {
+        num_packets++;
+        num_bytes += p.data_len;
+        }
+      else
+        {
+        active[i] = 0;
+        num_active--;
+        }
+      }
+    }
+
+  time = gavl_timer_get(timer);
+  gavl_timer_stop(timer);
+
+  printf("Program %d: %"PRId64" packets, %"PRId64" bytes, %.3f s, %.1f MB/s\n",
+         track + 1, num_packets, num_bytes, gavl_time_to_seconds(time),
+         (double)file_size / (1024.0 * 1024.0) / gavl_time_to_seconds(time));
+
+  gavl_packet_free(&p);
+  gavl_timer_destroy(timer);
+  free(active);
+  bgav_close(b);
+  return 1;
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i;
+  int arg = 1;
+  int num_programs = 4;
+  int seconds = 20;
+  int video_bitrate = 15000000;
+  int num_tracks;
+  int keep = 0;
+  const char * filename = "tsbench.ts";
+  bgav_t * b;
+  FILE * f;
+  int64_t file_size;
+
+  while(arg < argc)
+    {
+    if(!strcmp(argv[arg], "-p") && (arg < argc - 1))
+      {
+      num_programs = atoi(argv[arg+1]);
+      arg += 2;
+      }
+    else if(!strcmp(argv[arg], "-d") && (arg < argc - 1))
+      {
+      seconds = atoi(argv[arg+1]);
+      arg += 2;
+      }
+    else if(!strcmp(argv[arg], "-b") && (arg < argc - 1))
+      {
+      video_bitrate = atoi(argv[arg+1]) * 1000;
+      arg += 2;
+      }
+    else if(!strcmp(argv[arg], "-s") && (arg < argc - 1))
+      {
+      packet_size = atoi(argv[arg+1]);
+      arg += 2;
+      }
+    else if(!strcmp(argv[arg], "-k"))
+      {
+      keep = 1;
+      arg++;
+      }
+    else if((argv[arg][0] != '-') && (arg == argc - 1))
+      {
+      filename = argv[arg];
+      arg++;
+      }
+    else
+      {
+      fprintf(stderr,
+              "usage: %s [-p <programs>] [-d <seconds>] [-b <video_kbps>] [-s <188|192|204>] [-k] [<file>]\n",
+              argv[0]);
+      return 1;
+      }
+    }
+
+  if((packet_size != 188) && (packet_size != 192) && (packet_size != 204))
+    {
+    fprintf(stderr, "Invalid packet size %d\n", packet_size);
+    return 1;
+    }
+
+  if(!write_file(filename, num_programs, seconds, video_bitrate))
+    return 1;
+
+  f = fopen(filename, "rb");
+  fseek(f, 0, SEEK_END);
+  file_size = ftell(f);
+  fclose(f);
+
+  printf("%d programs, %d s, %d kbps video, %d byte packets: %"PRId64" packets, %.1f MB\n",
+         num_programs, seconds, video_bitrate / 1000, packet_size,
+         packets_written, (double)file_size / (1024.0 * 1024.0));
+
+  /* Get the number of tracks */
+  b = bgav_create();
+  if(!bgav_open(b, filename))
+    {
+    fprintf(stderr, "Cannot open %s\n", filename);
+    return 1;
+    }
+  num_tracks = bgav_num_tracks(b);
+  bgav_close(b);
+
+  for(i = 0; i < num_tracks; i++)
+    bench_track(filename, i, file_size);
+
+  if(!keep)
+    unlink(filename);
+  return 0;
+  }
@@ -68,6 +68,12 @@ typedef struct
   int UtoG[256], UtoB[256];
   } yuv2rgb_t;
 
+struct _effect;
+
+/* Process the scanlines [start, end[ of a frame */
+typedef void (*effect_rows_func)(struct _effect*, void * data,
+                                 int start, int end);
+
 
 typedef struct _effect
   {
@@ -75,6 +81,12 @@ typedef struct _effect
   int (*stop)(struct _effect*);
   int (*draw)(struct _effect*, RGB32 *src, RGB32 *dest);
   //	int (*event)(SDL_Event *event);
+
+  /* Effects, which can process horizontal bands independently,
+     set draw_rows. It is called from multiple threads after draw
+     (which can be NULL then) did the serial part of the frame */
+  void (*draw_rows)(struct _effect*, RGB32 *src, RGB32 *dest,
+                    int start, int end);
   
   void * priv;
   int video_width;
@@ -94,6 +106,13 @@ typedef struct _effect
 
   rgb2yuv_t * rgb2yuv;
   yuv2rgb_t * yuv2rgb;
+
+  /* Pixels are YUVA (Y in the first byte) instead of BGR
+     (see BG_EFFECTV_LUMA) */
+  int yuv;
+
+  /* Private data of effect_run_rows() */
+  void * run_priv;
   
   } effect;
 
@@ -28,6 +28,10 @@
 
 #define BG_EFFECTV_REUSE_OUTPUT   (1<<0)
 #define BG_EFFECTV_COLOR_AGNOSTIC (1<<1)
+/* The effect only needs the luminance (through the image_*_y()
+   functions) and copies the pixels otherwise. It gets YUVA
+   frames if the source is YUV. */
+#define BG_EFFECTV_LUMA           (1<<2)
 
 typedef struct
   {
@@ -46,6 +50,16 @@ typedef struct
 
   gavl_video_source_t * in_src;
   gavl_video_source_t * out_src;
+
+  /* Multithreading stuff */
+  gavl_video_run_func run_func;
+  void * run_data;
+  gavl_video_stop_func stop_func;
+  void * stop_data;
+  int num_threads;
+
+  effect_rows_func rows_func;
+  void * rows_data;
   } bg_effectv_plugin_t;
 
 void bg_effectv_destroy(void * priv);
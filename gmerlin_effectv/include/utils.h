@@ -77,6 +77,14 @@ unsigned char *image_edge(effect * e, RGB32 *src);
 
 void image_hflip(effect * e, RGB32 *src, RGB32 *dest, int width, int height);
 
+/*
+ * plugin.c
+ */
+
+/* Call func for horizontal bands of the image in multiple threads.
+   Returns when all bands are done. */
+void effect_run_rows(effect * e, effect_rows_func func, void * data);
+
 /*
  * yuv.c
  */
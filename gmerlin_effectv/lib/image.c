@@ -111,59 +111,72 @@ void image_stretch_to_screen(void)
 
 /*
  * Collection of background subtraction functions
+ *
+ * They process the image in horizontal bands with effect_run_rows().
  */
 
 /* checks only fake-Y value */
 /* In these function Y value is treated as R*2+G*4+B. */
+/* For YUVA pixels (e->yuv) it's Y*7 */
+
+static inline int fake_y(int yuv, const RGB32 * p)
+  {
+  if(yuv)
+    return ((const unsigned char*)p)[0] * 7;
+  return (((*p)&0xff0000)>>(16-1)) + (((*p)&0xff00)>>(8-2)) + ((*p)&0xff);
+  }
 
 void image_set_threshold_y(effect * e, int threshold)
   {
   e->y_threshold = threshold * 7; /* fake-Y value is timed by 7 */
   }
 
-void image_bgset_y(effect * e, RGB32 *src)
+static void bgset_y_rows(effect * e, void * data, int start, int end)
   {
+  const int yuv = e->yuv;
   int i;
-  int R, G, B;
   RGB32 *p;
   short *q;
 
-  p = src;
-  q = (short *)e->background;
-  for(i=0; i<e->video_area; i++) {
-  R = ((*p)&0xff0000)>>(16-1);
-  G = ((*p)&0xff00)>>(8-2);
-  B = (*p)&0xff;
-  *q = (short)(R + G + B);
+  p = (RGB32*)data + start * e->video_width;
+  q = (short *)e->background + start * e->video_width;
+  for(i=start * e->video_width; i<end * e->video_width; i++) {
+  *q = (short)fake_y(yuv, p);
   p++;
   q++;
   }
   }
 
-unsigned char *image_bgsubtract_y(effect * e, RGB32 *src)
+void image_bgset_y(effect * e, RGB32 *src)
   {
+  effect_run_rows(e, bgset_y_rows, src);
+  }
+
+static void bgsubtract_y_rows(effect * e, void * data, int start, int end)
+  {
+  const int yuv = e->yuv;
   int i;
-  int R, G, B;
   RGB32 *p;
   short *q;
   unsigned char *r;
   int v;
 
-  p = src;
-  q = (short *)e->background;
-  r = e->diff;
-  for(i=0; i<e->video_area; i++) {
-  R = ((*p)&0xff0000)>>(16-1);
-  G = ((*p)&0xff00)>>(8-2);
-  B = (*p)&0xff;
-  v = (R + G + B) - (int)(*q);
+  p = (RGB32*)data + start * e->video_width;
+  q = (short *)e->background + start * e->video_width;
+  r = e->diff + start * e->video_width;
+  for(i=start * e->video_width; i<end * e->video_width; i++) {
+  v = fake_y(yuv, p) - (int)(*q);
   *r = ((v + e->y_threshold)>>24) | ((e->y_threshold - v)>>24);
 
   p++;
   q++;
   r++;
   }
+  }
 
+unsigned char *image_bgsubtract_y(effect * e, RGB32 *src)
+  {
+  effect_run_rows(e, bgsubtract_y_rows, src);
   return e->diff;
   /* The origin of subtraction function is;
    * diff(src, dest) = (abs(src - dest) > threshold) ? 0xff : 0;
@@ -178,32 +191,35 @@ unsigned char *image_bgsubtract_y(effect * e, RGB32 *src)
    */
   }
 
-/* Background image is refreshed every frame */
-unsigned char *image_bgsubtract_update_y(effect * e, RGB32 *src)
+static void bgsubtract_update_y_rows(effect * e, void * data,
+                                     int start, int end)
   {
+  const int yuv = e->yuv;
   int i;
-  int R, G, B;
   RGB32 *p;
   short *q;
   unsigned char *r;
-  int v;
-
-  p = src;
-  q = (short *)e->background;
-  r = e->diff;
-  for(i=0; i<e->video_area; i++) {
-  R = ((*p)&0xff0000)>>(16-1);
-  G = ((*p)&0xff00)>>(8-2);
-  B = (*p)&0xff;
-  v = (R + G + B) - (int)(*q);
-  *q = (short)(R + G + B);
+  int v, y;
+
+  p = (RGB32*)data + start * e->video_width;
+  q = (short *)e->background + start * e->video_width;
+  r = e->diff + start * e->video_width;
+  for(i=start * e->video_width; i<end * e->video_width; i++) {
+  y = fake_y(yuv, p);
+  v = y - (int)(*q);
+  *q = (short)y;
   *r = ((v + e->y_threshold)>>24) | ((e->y_threshold - v)>>24);
 
   p++;
   q++;
   r++;
   }
+  }
 
+/* Background image is refreshed every frame */
+unsigned char *image_bgsubtract_update_y(effect * e, RGB32 *src)
+  {
+  effect_run_rows(e, bgsubtract_update_y_rows, src);
   return e->diff;
   }
 
@@ -220,28 +236,34 @@ void image_set_threshold_RGB(effect * e, int r, int g, int b)
   e->rgb_threshold = (RGB32)(R<<16 | G<<8 | B);
   }
 
-void image_bgset_RGB(effect * e, RGB32 *src)
+static void bgset_RGB_rows(effect * e, void * data, int start, int end)
   {
   int i;
-  RGB32 *p;
+  RGB32 *p, *src;
 
-  p = e->background;
-  for(i=0; i<e->video_area; i++) {
+  src = (RGB32*)data + start * e->video_width;
+  p = e->background + start * e->video_width;
+  for(i=start * e->video_width; i<end * e->video_width; i++) {
   *p++ = (*src++) & 0xfefefe;
   }
   }
 
-unsigned char *image_bgsubtract_RGB(effect * e, RGB32 *src)
+void image_bgset_RGB(effect * e, RGB32 *src)
+  {
+  effect_run_rows(e, bgset_RGB_rows, src);
+  }
+
+static void bgsubtract_RGB_rows(effect * e, void * data, int start, int end)
   {
   int i;
   RGB32 *p, *q;
   unsigned a, b;
   unsigned char *r;
 
-  p = src;
-  q = e->background;
-  r = e->diff;
-  for(i=0; i<e->video_area; i++) {
+  p = (RGB32*)data + start * e->video_width;
+  q = e->background + start * e->video_width;
+  r = e->diff + start * e->video_width;
+  for(i=start * e->video_width; i<end * e->video_width; i++) {
   a = (*p++)|0x1010100;
   b = *q++;
   a = a - b;
@@ -252,20 +274,26 @@ unsigned char *image_bgsubtract_RGB(effect * e, RGB32 *src)
   a = a & e->rgb_threshold;
   *r++ = (0 - a)>>24;
   }
+  }
+
+unsigned char *image_bgsubtract_RGB(effect * e, RGB32 *src)
+  {
+  effect_run_rows(e, bgsubtract_RGB_rows, src);
   return e->diff;
   }
 
-unsigned char *image_bgsubtract_update_RGB(effect * e, RGB32 *src)
+static void bgsubtract_update_RGB_rows(effect * e, void * data,
+                                       int start, int end)
   {
   int i;
   RGB32 *p, *q;
   unsigned a, b;
   unsigned char *r;
 
-  p = src;
-  q = e->background;
-  r = e->diff;
-  for(i=0; i<e->video_area; i++) {
+  p = (RGB32*)data + start * e->video_width;
+  q = e->background + start * e->video_width;
+  r = e->diff + start * e->video_width;
+  for(i=start * e->video_width; i<end * e->video_width; i++) {
   a = *p|0x1010100;
   b = *q&0xfefefe;
   *q++ = *p++;
@@ -277,11 +305,16 @@ unsigned char *image_bgsubtract_update_RGB(effect * e, RGB32 *src)
   a = a & e->rgb_threshold;
   *r++ = (0 - a)>>24;
   }
+  }
+
+unsigned char *image_bgsubtract_update_RGB(effect * e, RGB32 *src)
+  {
+  effect_run_rows(e, bgsubtract_update_RGB_rows, src);
   return e->diff;
   }
 
 /* noise filter for subtracted image. */
-unsigned char *image_diff_filter(effect * e, unsigned char *diff)
+static void diff_filter_rows(effect * e, void * data, int start, int end)
   {
   int x, y;
   unsigned char *src, *dest;
@@ -289,9 +322,14 @@ unsigned char *image_diff_filter(effect * e, unsigned char *diff)
   unsigned int sum1, sum2, sum3;
   const int width = e->video_width;
 
-  src = diff;
-  dest = e->diff2 + width +1;
-  for(y=1; y<e->video_height-1; y++) {
+  if(start < 1)
+    start = 1;
+  if(end > e->video_height-1)
+    end = e->video_height-1;
+
+  src = (unsigned char*)data + (start-1) * width;
+  dest = e->diff2 + start * width + 1;
+  for(y=start; y<end; y++) {
   sum1 = src[0] + src[width] + src[width*2];
   sum2 = src[1] + src[width+1] + src[width*2+1];
   src += 2;
@@ -305,46 +343,54 @@ unsigned char *image_diff_filter(effect * e, unsigned char *diff)
   }
   dest += 2;
   }
-	
+  }
+
+unsigned char *image_diff_filter(effect * e, unsigned char *diff)
+  {
+  effect_run_rows(e, diff_filter_rows, diff);
   return e->diff2;
   }
 
 /* Y value filters */
-unsigned char *image_y_over(effect * e, RGB32 *src)
+static void y_over_rows(effect * e, void * data, int start, int end)
   {
-  int i;
-  int R, G, B, v;
-  unsigned char *p = e->diff;
-
-  for(i = e->video_area; i>0; i--) {
-  R = ((*src)&0xff0000)>>(16-1);
-  G = ((*src)&0xff00)>>(8-2);
-  B = (*src)&0xff;
-  v = e->y_threshold - (R + G + B);
+  const int yuv = e->yuv;
+  int i, v;
+  RGB32 *src = (RGB32*)data + start * e->video_width;
+  unsigned char *p = e->diff + start * e->video_width;
+
+  for(i = (end - start) * e->video_width; i>0; i--) {
+  v = e->y_threshold - fake_y(yuv, src);
   *p = (unsigned char)(v>>24);
   src++;
   p++;
   }
+  }
 
+unsigned char *image_y_over(effect * e, RGB32 *src)
+  {
+  effect_run_rows(e, y_over_rows, src);
   return e->diff;
   }
 
-unsigned char *image_y_under(effect * e, RGB32 *src)
+static void y_under_rows(effect * e, void * data, int start, int end)
   {
-  int i;
-  int R, G, B, v;
-  unsigned char *p = e->diff;
-
-  for(i = e->video_area; i>0; i--) {
-  R = ((*src)&0xff0000)>>(16-1);
-  G = ((*src)&0xff00)>>(8-2);
-  B = (*src)&0xff;
-  v = (R + G + B) - e->y_threshold;
+  const int yuv = e->yuv;
+  int i, v;
+  RGB32 *src = (RGB32*)data + start * e->video_width;
+  unsigned char *p = e->diff + start * e->video_width;
+
+  for(i = (end - start) * e->video_width; i>0; i--) {
+  v = fake_y(yuv, src) - e->y_threshold;
   *p = (unsigned char)(v>>24);
   src++;
   p++;
   }
+  }
 
+unsigned char *image_y_under(effect * e, RGB32 *src)
+  {
+  effect_run_rows(e, y_under_rows, src);
   return e->diff;
   }
 
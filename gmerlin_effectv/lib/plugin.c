@@ -20,6 +20,7 @@
  * *****************************************************************/
 
 #include <gmerlin_effectv.h>
+#include <utils.h>
 
 static gavl_pixelformat_t agn_formats[] =
   {
@@ -34,12 +35,20 @@ static gavl_pixelformat_t agn_formats[] =
     GAVL_PIXELFORMAT_NONE,
   };
 
+static gavl_pixelformat_t luma_formats[] =
+  {
+    GAVL_BGR_32,
+    GAVL_YUVA_32,
+    GAVL_PIXELFORMAT_NONE,
+  };
+
 
 void * bg_effectv_create(effectRegisterFunc * f, int flags)
   {
   bg_effectv_plugin_t * ret;
   ret = calloc(1, sizeof(*ret));
   ret->e = f();
+  ret->e->run_priv = ret;
   ret->flags = flags;
 
 #ifdef WORDS_BIGENDIAN
@@ -80,6 +89,57 @@ void bg_effectv_destroy(void*priv)
   free(vp);
   }
 
+static void process_rows(void * priv, int start, int end)
+  {
+  bg_effectv_plugin_t * vp = priv;
+  vp->rows_func(vp->e, vp->rows_data, start, end);
+  }
+
+void effect_run_rows(effect * e, effect_rows_func func, void * data)
+  {
+  int j, nt, scanline, delta;
+  bg_effectv_plugin_t * vp = e->run_priv;
+
+  nt = vp->num_threads;
+  if(nt > e->video_height)
+    nt = e->video_height;
+
+  if(nt < 2)
+    {
+    func(e, data, 0, e->video_height);
+    return;
+    }
+
+  vp->rows_func = func;
+  vp->rows_data = data;
+
+  delta = e->video_height / nt;
+  scanline = 0;
+
+  for(j = 0; j < nt - 1; j++)
+    {
+    vp->run_func(process_rows, vp, scanline, scanline+delta, vp->run_data, j);
+    scanline += delta;
+    }
+  vp->run_func(process_rows, vp, scanline, e->video_height,
+               vp->run_data, nt - 1);
+
+  for(j = 0; j < nt; j++)
+    vp->stop_func(vp->stop_data, j);
+  }
+
+static void draw_rows(effect * e, void * data, int start, int end)
+  {
+  bg_effectv_plugin_t * vp = data;
+  e->draw_rows(e, (RGB32*)vp->in_frame->planes[0],
+               (RGB32*)vp->out_frame->planes[0], start, end);
+  }
+
+#ifdef WORDS_BIGENDIAN
+#define NEED_SWAP(vp) \
+  (!((vp)->flags & BG_EFFECTV_COLOR_AGNOSTIC) && !(vp)->e->yuv)
+#endif
+
 static gavl_source_status_t
 read_func(void * priv, gavl_video_frame_t ** frame)
   {
@@ -98,8 +158,8 @@ read_func(void * priv, gavl_video_frame_t ** frame)
     return st;
 
 #ifdef WORDS_BIGENDIAN
-  if(!(vp->flags & BG_EFFECTV_COLOR_AGNOSTIC))
-    gavl_dsp_video_frame_swap_endian(ret->dsp_ctx,
+  if(NEED_SWAP(vp))
+    gavl_dsp_video_frame_swap_endian(vp->dsp_ctx,
                                      vp->in_frame, &vp->format);
 #endif
 
@@ -108,12 +168,16 @@ read_func(void * priv, gavl_video_frame_t ** frame)
     vp->out_frame = gavl_video_frame_create_nopad(&vp->format);
     gavl_video_frame_clear(vp->in_frame, &vp->format);
     }
-  vp->e->draw(vp->e, (RGB32*)vp->in_frame->planes[0],
+
+  if(vp->e->draw)
+    vp->e->draw(vp->e, (RGB32*)vp->in_frame->planes[0],
                 (RGB32*)vp->out_frame->planes[0]);
+  if(vp->e->draw_rows)
+    effect_run_rows(vp->e, draw_rows, vp);
 
 #ifdef WORDS_BIGENDIAN
-  if(!(vp->flags & BG_EFFECTV_COLOR_AGNOSTIC))
-    gavl_dsp_video_frame_swap_endian(ret->dsp_ctx,
+  if(NEED_SWAP(vp))
+    gavl_dsp_video_frame_swap_endian(vp->dsp_ctx,
                                      vp->out_frame, &vp->format);
 #endif
 
@@ -131,6 +195,11 @@ static void set_format(bg_effectv_plugin_t * vp, const gavl_video_format_t * for
     vp->format.pixelformat = gavl_pixelformat_get_best(vp->format.pixelformat,
                                                     agn_formats, NULL);
     }
+  else if(vp->flags & BG_EFFECTV_LUMA)
+    {
+    vp->format.pixelformat = gavl_pixelformat_get_best(vp->format.pixelformat,
+                                                    luma_formats, NULL);
+    }
   else
     {
     vp->format.pixelformat = GAVL_BGR_32;
@@ -145,6 +214,7 @@ static void set_format(bg_effectv_plugin_t * vp, const gavl_video_format_t * for
   vp->e->video_width = vp->format.image_width;
   vp->e->video_height = vp->format.image_height;
   vp->e->video_area = vp->format.image_width * vp->format.image_height;
+  vp->e->yuv = (vp->format.pixelformat == GAVL_YUVA_32);
 
   vp->e->start(vp->e);
   vp->started = 1;
@@ -178,6 +248,12 @@ gavl_video_source_t * bg_effectv_connect(void * priv,
     {
     gavl_video_options_copy(gavl_video_source_get_options(vp->in_src), opt);
     }
+  else
+    opt = gavl_video_source_get_options(vp->in_src);
+
+  vp->run_func  = gavl_video_options_get_run_func(opt, &vp->run_data);
+  vp->stop_func = gavl_video_options_get_stop_func(opt, &vp->stop_data);
+  vp->num_threads = gavl_video_options_get_num_threads(opt);
   gavl_video_source_set_dst(vp->in_src, 0, &vp->format);
   
   vp->out_src = gavl_video_source_create_source(read_func,
@@ -59,13 +59,12 @@ static effect *edgeRegister(void)
 static int start(effect * e)
   {
   edge_t * priv = e->priv;
-  memset(priv->map, 0, priv->map_width * priv->map_height * PIXEL_SIZE * 2);
 
   priv->map_width = e->video_width / 4;
   priv->map_height = e->video_height / 4;
   priv->video_width_margin = e->video_width - priv->map_width * 4;
 
-  priv->map = malloc(priv->map_width*priv->map_height*PIXEL_SIZE*2);
+  priv->map = calloc(priv->map_width*priv->map_height*2, PIXEL_SIZE);
   if(priv->map == NULL)
     {
     return 0;
@@ -82,17 +81,43 @@ static int stop(effect * e)
   return 0;
   }
 
-static int draw(effect * e, RGB32 *src, RGB32 *dest)
+/* The image is processed in 2 passes: First the edges are
+   calculated for all map cells, then they are drawn.
+   Both passes work on horizontal bands */
+
+typedef struct
+  {
+  RGB32 * src;
+  RGB32 * dest;
+  } edge_frame_t;
+
+static void get_map_rows(edge_t * priv, int start, int end,
+                         int * map_start, int * map_end)
+  {
+  *map_start = (start + 3) / 4;
+  *map_end = (end + 3) / 4;
+
+  if(*map_start < 1)
+    *map_start = 1;
+  if(*map_end > priv->map_height - 1)
+    *map_end = priv->map_height - 1;
+  }
+
+static void edge_rows(effect * e, void * data, int start, int end)
   {
   int x, y;
   int r, g, b;
   RGB32 p, q;
-  RGB32 v0, v1, v2, v3;
+  RGB32 v2, v3;
+  RGB32 * src;
+  int map_start, map_end;
+  edge_frame_t * f = data;
   edge_t * priv = e->priv;
-  
-  src += e->video_width*4+4;
-  dest += e->video_width*4+4;
-  for(y=1; y<priv->map_height-1; y++) {
+
+  get_map_rows(priv, start, end, &map_start, &map_end);
+
+  for(y=map_start; y<map_end; y++) {
+  src = f->src + y * 4 * e->video_width + 4;
   for(x=1; x<priv->map_width-1; x++) {
   p = *src;
   q = *(src - 4);
@@ -128,10 +153,32 @@ static int draw(effect * e, RGB32 *src, RGB32 *dest)
   if(b>255) b = 255;
   v3 = (r<<17)|(g<<9)|b;
 
-  v0 = priv->map[(y-1)*priv->map_width*2+x*2];
-  v1 = priv->map[y*priv->map_width*2+(x-1)*2+1];
   priv->map[y*priv->map_width*2+x*2] = v2;
   priv->map[y*priv->map_width*2+x*2+1] = v3;
+  src += 4;
+  }
+  }
+  }
+
+static void draw_rows(effect * e, void * data, int start, int end)
+  {
+  int x, y;
+  int r, g;
+  RGB32 v0, v1, v2, v3;
+  RGB32 * dest;
+  int map_start, map_end;
+  edge_frame_t * f = data;
+  edge_t * priv = e->priv;
+
+  get_map_rows(priv, start, end, &map_start, &map_end);
+
+  for(y=map_start; y<map_end; y++) {
+  dest = f->dest + y * 4 * e->video_width + 4;
+  for(x=1; x<priv->map_width-1; x++) {
+  v0 = priv->map[(y-1)*priv->map_width*2+x*2];
+  v1 = priv->map[y*priv->map_width*2+(x-1)*2+1];
+  v2 = priv->map[y*priv->map_width*2+x*2];
+  v3 = priv->map[y*priv->map_width*2+x*2+1];
   r = v0 + v1;
   g = r & 0x01010100;
   dest[0] = r | (g - (g>>8));
@@ -153,13 +200,19 @@ static int draw(effect * e, RGB32 *src, RGB32 *dest)
   dest[e->video_width*3] = v2;
   dest[e->video_width*3+1] = v2;
 
-  src += 4;
   dest += 4;
   }
-  src += e->video_width*3+8+priv->video_width_margin;
-  dest += e->video_width*3+8+priv->video_width_margin;
   }
+  }
+
+static int draw(effect * e, RGB32 *src, RGB32 *dest)
+  {
+  edge_frame_t f;
+  f.src = src;
+  f.dest = dest;
 
+  effect_run_rows(e, edge_rows, &f);
+  effect_run_rows(e, draw_rows, &f);
   return 0;
   }
 
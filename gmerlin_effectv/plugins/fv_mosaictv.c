@@ -122,7 +122,7 @@ mosaic_t * priv = e->priv;
 
 static void * create_mosaictv()
   {
-  return bg_effectv_create(mosaicRegister, 0);
+  return bg_effectv_create(mosaicRegister, BG_EFFECTV_LUMA);
   }
 
 const bg_fv_plugin_t the_plugin = 
@@ -21,6 +21,7 @@
 static int start(effect * e);
 static int stop(effect * e);
 static int draw(effect * e, RGB32 *src, RGB32 *dest);
+static void draw_rows(effect * e, RGB32 *src, RGB32 *dest, int start, int end);
 
 
 typedef struct
@@ -34,6 +35,7 @@ typedef struct
   int timer;
   int stride;
   int readplane;
+  int writeplane;
   } nervous_t;
 
 
@@ -54,6 +56,7 @@ static effect *nervousRegister(void)
   entry->start = start;
   entry->stop = stop;
   entry->draw = draw;
+  entry->draw_rows = draw_rows;
   
   return entry;
   }
@@ -94,7 +97,7 @@ static int stop(effect * e)
 static int draw(effect * e, RGB32 *src, RGB32 *dest)
   {
   nervous_t * priv = e->priv;
-  memcpy(priv->planetable[priv->plane], src, e->video_area * PIXEL_SIZE);
+  priv->writeplane = priv->plane;
   if(priv->stock < PLANES)
     {
     priv->stock++;
@@ -122,13 +125,25 @@ static int draw(effect * e, RGB32 *src, RGB32 *dest)
     if(priv->stock > 0)
       priv->readplane = inline_fastrand(e) % priv->stock;
     }
-  memcpy(dest, priv->planetable[priv->readplane], e->video_area * PIXEL_SIZE);
   priv->plane++;
   if (priv->plane == PLANES) priv->plane=0;
   
   return 0;
   }
 
+/* The frames are copied in bands, the read plane can be the
+   one we just wrote */
+
+static void draw_rows(effect * e, RGB32 *src, RGB32 *dest, int start, int end)
+  {
+  nervous_t * priv = e->priv;
+  int offset = start * e->video_width;
+  int len = (end - start) * e->video_width * PIXEL_SIZE;
+
+  memcpy(priv->planetable[priv->writeplane] + offset, src + offset, len);
+  memcpy(dest + offset, priv->planetable[priv->readplane] + offset, len);
+  }
+
 
 static const bg_parameter_info_t parameters[] =
   {
@@ -17,6 +17,7 @@
 static int start(effect*);
 static int stop(effect*);
 static int draw(effect*,RGB32 *src, RGB32 *dest);
+static void draw_rows(effect*, RGB32 *src, RGB32 *dest, int start, int end);
 
 
 typedef struct
@@ -25,6 +26,8 @@ typedef struct
   RGB32 *buffer;
   RGB32 *planetable[PLANES];
   int plane;
+  int cur;           /* Plane of the current frame */
+  unsigned int seed; /* Random seed for the current frame */
   } quarktv_t;
 
 static effect *quarkRegister(void)
@@ -43,6 +46,7 @@ static effect *quarkRegister(void)
 	entry->start = start;
 	entry->stop = stop;
 	entry->draw = draw;
+	entry->draw_rows = draw_rows;
 
 	return entry;
 }
@@ -83,17 +87,9 @@ static int stop(effect * e)
 static int draw(effect * e, RGB32 *src, RGB32 *dest)
 {
         quarktv_t * priv = e->priv;
-	int i;
-	int cf;
 
-	memcpy(priv->planetable[priv->plane], src, e->video_area * PIXEL_SIZE);
-
-	for(i=0; i<e->video_area; i++) {
-		cf = (inline_fastrand(e)>>24)&(PLANES-1);
-		dest[i] = (priv->planetable[cf])[i];
-		/* The reason why I use high order 8 bits is written in utils.c
-		(or, 'man rand') */
-	}
+	priv->seed = inline_fastrand(e);
+	priv->cur = priv->plane;
 
 	priv->plane--;
 	if(priv->plane<0)
@@ -102,9 +98,32 @@ static int draw(effect * e, RGB32 *src, RGB32 *dest)
 	return 0;
 }
 
+static void draw_rows(effect * e, RGB32 *src, RGB32 *dest, int start, int end)
+{
+        quarktv_t * priv = e->priv;
+	int i;
+	int cf;
+	int first = start * e->video_width;
+	int last = end * e->video_width;
+	/* Each band has its own random generator, seeded from the
+	   frame seed and the first row */
+	unsigned int rand_val = priv->seed + (unsigned int)start * 2654435761U;
+
+	memcpy(priv->planetable[priv->cur] + first, src + first,
+	       (last - first) * PIXEL_SIZE);
+
+	for(i=first; i<last; i++) {
+		rand_val = rand_val*1103515245+12345;
+		cf = (rand_val>>24)&(PLANES-1);
+		dest[i] = (priv->planetable[cf])[i];
+		/* The reason why I use high order 8 bits is written in utils.c
+		(or, 'man rand') */
+	}
+}
+
 static void * create_quarktv()
   {
-  return bg_effectv_create(quarkRegister, 0);
+  return bg_effectv_create(quarkRegister, BG_EFFECTV_COLOR_AGNOSTIC);
   }
 
 const bg_fv_plugin_t the_plugin = 
@@ -139,7 +139,7 @@ static int draw(effect * e, RGB32 *src, RGB32 *dest)
 
 static void * create_timedisttv()
   {
-  return bg_effectv_create(timeDistortionRegister, 0);
+  return bg_effectv_create(timeDistortionRegister, BG_EFFECTV_LUMA);
   }
 
 
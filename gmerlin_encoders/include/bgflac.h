@@ -57,7 +57,8 @@ int bg_flac_start(bg_flac_t * flac,
 
 // int bg_flac_encode_audio_frame(bg_flac_t * flac, gavl_audio_frame_t * frame);
 
-void bg_flac_free(bg_flac_t * flac);
+/* Flushes the encoder, returns 0 if encoding or writing failed */
+int bg_flac_free(bg_flac_t * flac);
 
 void bg_flac_set_callbacks(bg_flac_t * flac,
                            int (*streaminfo_callback)(void*, uint8_t *, int),
@@ -40,3 +40,56 @@ int bgen_id3v2_write(gavf_io_t * output, const bgen_id3v2_t *, int encoding);
 
 void bgen_id3v1_destroy(bgen_id3v1_t *);
 void bgen_id3v2_destroy(bgen_id3v2_t *);
+
+/* Threaded encoding: The input is collected into segments, which are
+   encoded by worker threads. The packets are passed to the output
+   function in the order of the segments */
+
+typedef struct bgen_segment_encoder_s bgen_segment_encoder_t;
+
+typedef struct
+  {
+  void * data; /* Input data, allocated by the codec         */
+  int fill;    /* Frames or samples in data, set by the codec */
+
+  gavl_packet_t * packets;
+  int num_packets;
+  int packets_alloc;
+
+  int64_t seq; /* Sequence number, starting with 0 */
+  int error;
+  int state;
+  } bgen_segment_t;
+
+/* Called from the worker threads */
+typedef int (*bgen_segment_encode_func)(void * priv, bgen_segment_t * seg);
+
+/* Called from the thread of the caller */
+typedef gavl_sink_status_t (*bgen_segment_output_func)(void * priv,
+                                                       gavl_packet_t * p);
+
+typedef void (*bgen_segment_free_func)(void * priv, void * data);
+
+bgen_segment_encoder_t *
+bgen_segment_encoder_create(int num_threads, int num_segments,
+                            bgen_segment_encode_func encode,
+                            bgen_segment_output_func output,
+                            bgen_segment_free_func free_data,
+                            void * priv);
+
+/* Get the segment to fill. Blocks if all segments are busy */
+bgen_segment_t * bgen_segment_encoder_get(bgen_segment_encoder_t * enc);
+
+/* Queue the segment for encoding */
+void bgen_segment_encoder_submit(bgen_segment_encoder_t * enc);
+
+/* Output finished segments without waiting */
+gavl_sink_status_t bgen_segment_encoder_output(bgen_segment_encoder_t * enc);
+
+/* Submit the last segment and output everything */
+gavl_sink_status_t bgen_segment_encoder_flush(bgen_segment_encoder_t * enc);
+
+void bgen_segment_encoder_destroy(bgen_segment_encoder_t * enc);
+
+/* Append a packet to the segment (for the encode function) */
+gavl_packet_t * bgen_segment_add_packet(bgen_segment_t * seg);
@@ -20,6 +20,7 @@
  * *****************************************************************/
 
 #include <string.h>
+#include <pthread.h>
 
 #include <gmerlin/plugin.h>
 #include <gmerlin/utils.h>
@@ -29,10 +30,28 @@
 
 #include <config.h>
 #include <bgflac.h>
+#include <gmerlin_encoders.h>
+#include <md5.h>
 
 #include <gmerlin/log.h>
 #define LOG_DOMAIN "flacenc"
 
+/*
+ *  Threaded encoding: The samples are split into segments of
+ *  SEGMENT_FRAMES frames, which are encoded by worker threads with
+ *  separate encoder instances. Since FLAC frames are independent,
+ *  the segments can be concatenated after setting the frame numbers
+ *  in the frame headers. The MD5 sum of the samples is calculated
+ *  here in the order of the input.
+ */
+
+#define SEGMENT_FRAMES 64
+
+typedef struct
+  {
+  int32_t * buffer[GAVL_MAX_CHANNELS];
+  } segment_data_t;
+
 struct bg_flac_s
   {
   int clevel; /* Compression level 0..8 */
@@ -68,8 +87,58 @@ struct bg_flac_s
   gavl_compression_info_t ci;
 
   FLAC__StreamMetadata_StreamInfo si;
+
+  /* Threaded encoding */
+  int num_threads;
+  int segment_samples;
+  bgen_segment_encoder_t * segenc;
+
+  struct md5_ctx md5;
+  uint8_t * md5_buf;
+  int md5_buf_alloc;
   };
 
+/* CRCs for rewriting frame headers */
+
+static uint16_t crc16_table[256];
+static pthread_once_t crc16_once = PTHREAD_ONCE_INIT;
+
+static void init_crc16(void)
+  {
+  int i, j;
+  uint16_t crc;
+  
+  for(i = 0; i < 256; i++)
+    {
+    crc = i << 8;
+    for(j = 0; j < 8; j++)
+      crc = (crc & 0x8000) ? ((crc << 1) ^ 0x8005) : (crc << 1);
+    crc16_table[i] = crc;
+    }
+  }
+
+static uint16_t crc16(const uint8_t * data, int len)
+  {
+  uint16_t crc = 0;
+  while(len--)
+    crc = (crc << 8) ^ crc16_table[((crc >> 8) ^ *(data++)) & 0xff];
+  return crc;
+  }
+
+static uint8_t crc8(const uint8_t * data, int len)
+  {
+  int i;
+  uint8_t crc = 0;
+
+  while(len--)
+    {
+    crc ^= *(data++);
+    for(i = 0; i < 8; i++)
+      crc = (crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1);
+    }
+  return crc;
+  }
+
 
 /* Copy functions */
 
@@ -144,6 +213,15 @@ static const bg_parameter_info_t audio_parameters[] =
       .help_string = TRS("0: Fastest encoding, biggest files\n\
 8: Slowest encoding, smallest files")
     },
+    {
+      .name =        "threads",
+      .long_name =   TRS("Threads"),
+      .type =        BG_PARAMETER_INT,
+      .val_min =     { .val_i = 1 },
+      .val_max =     { .val_i = 64 },
+      .val_default = { .val_i = 1 },
+      .help_string = TRS("Number of encoding threads. With more than one thread, segments of the input are encoded in parallel.")
+    },
     { /* End of parameters */ }
   };
 
@@ -170,6 +248,10 @@ void bg_flac_set_parameter(void * data, const char * name,
     {
     flac->bits_per_sample = atoi(val->val_str);
     }
+  else if(!strcmp(name, "threads"))
+    {
+    flac->num_threads = val->val_i;
+    }
   
   //  fprintf(stderr, "set_audio_parameter_flac %s\n", name);
   }
@@ -183,12 +265,24 @@ static void metadata_callback(const FLAC__StreamEncoder *enc,
   if((m->type == FLAC__METADATA_TYPE_STREAMINFO) && flac->streaminfo_callback)
     {
     const FLAC__StreamMetadata_StreamInfo * si;
+    FLAC__StreamMetadata_StreamInfo si_threads;
     uint8_t * ptr;
     uint32_t i;
     
     /* Re-write stream info */
 
-    si = &m->data.stream_info;
+    if(flac->segment_samples)
+      {
+      /* The frames didn't go through this encoder */
+      memcpy(&si_threads, &m->data.stream_info, sizeof(si_threads));
+      si_threads.min_framesize = flac->si.min_framesize;
+      si_threads.max_framesize = flac->si.max_framesize;
+      si_threads.total_samples = flac->si.total_samples;
+      memcpy(si_threads.md5sum, flac->si.md5sum, 16);
+      si = &si_threads;
+      }
+    else
+      si = &m->data.stream_info;
     ptr = flac->ci.global_header + 8; // Signature + metadata header
     
     GAVL_16BE_2_PTR(si->min_blocksize, ptr); ptr += 2;
@@ -362,11 +456,9 @@ bg_flac_start_compressed(bg_flac_t * flac,
   return gavl_packet_sink_create(NULL, write_audio_packet_func_flac, flac);;
   }
 
-static gavl_sink_status_t
-encode_audio_func(void * priv, gavl_audio_frame_t * frame)
+static void prepare_frame(bg_flac_t * flac, gavl_audio_frame_t * frame)
   {
   int i;
-  bg_flac_t * flac = priv;
   
   /* Reallocate sample buffer */
   if(flac->buffer_alloc < frame->valid_samples)
@@ -384,6 +476,14 @@ encode_audio_func(void * priv, gavl_audio_frame_t * frame)
   if(flac->shift_bits)
     do_shift(flac->buffer, flac->format->num_channels,
              frame->valid_samples, flac->divisor);
+  }
+
+static gavl_sink_status_t
+encode_audio_func(void * priv, gavl_audio_frame_t * frame)
+  {
+  bg_flac_t * flac = priv;
+
+  prepare_frame(flac, frame);
 
   if(!FLAC__stream_encoder_process(flac->enc,
                                    (const FLAC__int32 **) flac->buffer,
@@ -393,6 +493,316 @@ encode_audio_func(void * priv, gavl_audio_frame_t * frame)
   return 1;
   }
 
+static void setup_encoder(bg_flac_t * flac, FLAC__StreamEncoder * enc)
+  {
+  FLAC__stream_encoder_set_sample_rate(enc, flac->format->samplerate);
+  FLAC__stream_encoder_set_channels(enc, flac->format->num_channels);
+
+  /* */
+  FLAC__stream_encoder_set_compression_level(enc, flac->clevel);
+  
+  FLAC__stream_encoder_set_bits_per_sample(enc, flac->bits_per_sample);
+
+  if(flac->num_threads > 1)
+    FLAC__stream_encoder_set_do_md5(enc, 0);
+  }
+
+/* Threaded encoding */
+
+static int write_utf8(uint8_t * ptr, uint32_t val)
+  {
+  int i, len;
+
+  if(val < 0x80)
+    {
+    ptr[0] = val;
+    return 1;
+    }
+
+  /* n bytes hold 5n+1 bits */
+  len = 2;
+  while((len < 6) && (val >= (1 << (5 * len + 1))))
+    len++;
+
+  for(i = len - 1; i > 0; i--)
+    {
+    ptr[i] = 0x80 | (val & 0x3f);
+    val >>= 6;
+    }
+  ptr[0] = (0xff << (8 - len)) | val;
+  return len;
+  }
+
+/* Copy a frame and replace the frame number in the header */
+
+static int set_frame_number(gavl_packet_t * p, const uint8_t * buf, int len,
+                            uint32_t frame_number)
+  {
+  int num_len;
+  int extra_len = 0;
+  int header_len;
+  int new_num_len;
+  int new_header_len;
+  int new_len;
+  uint8_t num[6];
+  uint16_t crc;
+  
+  /* Length of the old frame number */
+  if(!(buf[4] & 0x80))
+    num_len = 1;
+  else
+    {
+    uint8_t b = buf[4];
+    num_len = 0;
+    while(b & 0x80)
+      {
+      num_len++;
+      b <<= 1;
+      }
+    }
+
+  /* Blocksize */
+  switch(buf[2] >> 4)
+    {
+    case 6:
+      extra_len += 1;
+      break;
+    case 7:
+      extra_len += 2;
+      break;
+    }
+  /* Samplerate */
+  switch(buf[2] & 0x0f)
+    {
+    case 12:
+      extra_len += 1;
+      break;
+    case 13:
+    case 14:
+      extra_len += 2;
+      break;
+    }
+  
+  header_len = 4 + num_len + extra_len; // Without CRC-8
+  
+  if(len < header_len + 1 + 2)
+    return 0;
+  
+  new_num_len = write_utf8(num, frame_number);
+  new_header_len = 4 + new_num_len + extra_len;
+  new_len = len - num_len + new_num_len;
+
+  gavl_packet_alloc(p, new_len);
+  
+  memcpy(p->data, buf, 4);
+  memcpy(p->data + 4, num, new_num_len);
+  memcpy(p->data + 4 + new_num_len, buf + 4 + num_len, extra_len);
+  p->data[new_header_len] = crc8(p->data, new_header_len);
+
+  memcpy(p->data + new_header_len + 1, buf + header_len + 1,
+         len - header_len - 1 - 2);
+
+  crc = crc16(p->data, new_len - 2);
+  GAVL_16BE_2_PTR(crc, p->data + new_len - 2);
+  p->data_len = new_len;
+  return 1;
+  }
+
+static FLAC__StreamEncoderWriteStatus
+segment_write_callback(const FLAC__StreamEncoder *encoder,
+                       const FLAC__byte buffer[],
+                       size_t bytes,
+                       unsigned samples,
+                       unsigned current_frame,
+                       void *data)
+  {
+  gavl_packet_t * p;
+  bgen_segment_t * seg = data;
+
+  /* Skip headers */
+  if(!samples)
+    return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+
+  p = bgen_segment_add_packet(seg);
+  
+  if(!set_frame_number(p, buffer, bytes,
+                       seg->seq * SEGMENT_FRAMES + current_frame))
+    {
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN, "Got invalid frame from encoder");
+    seg->error = 1;
+    return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+    }
+  p->duration = samples;
+  return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+  }
+
+static int encode_segment(void * data, bgen_segment_t * seg)
+  {
+  int ret = 0;
+  bg_flac_t * flac = data;
+  segment_data_t * sd = seg->data;
+  FLAC__StreamEncoder * enc = FLAC__stream_encoder_new();
+  
+  setup_encoder(flac, enc);
+
+  if(FLAC__stream_encoder_init_stream(enc,
+                                      segment_write_callback,
+                                      NULL,
+                                      NULL,
+                                      NULL,
+                                      seg) != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+    {
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN,  "FLAC__stream_encoder_init_stream failed");
+    goto fail;
+    }
+  
+  if(!FLAC__stream_encoder_process(enc,
+                                   (const FLAC__int32 **) sd->buffer,
+                                   seg->fill) ||
+     !FLAC__stream_encoder_finish(enc))
+    goto fail;
+  
+  ret = !seg->error;
+  fail:
+  FLAC__stream_encoder_delete(enc);
+  return ret;
+  }
+
+static void free_segment_data(void * data, void * sd_p)
+  {
+  int i;
+  segment_data_t * sd = sd_p;
+  bg_flac_t * flac = data;
+
+  for(i = 0; i < flac->format->num_channels; i++)
+    free(sd->buffer[i]);
+  free(sd);
+  }
+
+static gavl_sink_status_t put_packet(void * data, gavl_packet_t * p)
+  {
+  bg_flac_t * flac = data;
+  
+  p->pts = flac->pts;
+  flac->pts += p->duration;
+
+  if(!flac->si.min_framesize || (p->data_len < flac->si.min_framesize))
+    flac->si.min_framesize = p->data_len;
+  if(p->data_len > flac->si.max_framesize)
+    flac->si.max_framesize = p->data_len;
+  flac->si.total_samples += p->duration;
+  
+  return gavl_packet_sink_put_packet(flac->psink_out, p);
+  }
+
+static void start_threads(bg_flac_t * flac)
+  {
+  pthread_once(&crc16_once, init_crc16);
+  
+  flac->segment_samples =
+    SEGMENT_FRAMES * FLAC__stream_encoder_get_blocksize(flac->enc);
+
+  flac->segenc = bgen_segment_encoder_create(flac->num_threads,
+                                             flac->num_threads + 1,
+                                             encode_segment,
+                                             put_packet,
+                                             free_segment_data,
+                                             flac);
+  bgen_md5_init_ctx(&flac->md5);
+  
+  bg_log(BG_LOG_INFO, LOG_DOMAIN,
+         "Using %d threads (%d samples per segment)",
+         flac->num_threads, flac->segment_samples);
+  }
+
+/* MD5 sum of the samples like libFLAC calculates it: Interleaved,
+   little endian and with the smallest number of bytes holding
+   bits_per_sample */
+
+static void update_md5(bg_flac_t * flac, int num_samples)
+  {
+  int i, j, k;
+  int32_t val;
+  uint8_t * ptr;
+  int bytes = (flac->bits_per_sample + 7) / 8;
+  int len = num_samples * flac->format->num_channels * bytes;
+
+  if(flac->md5_buf_alloc < len)
+    {
+    flac->md5_buf_alloc = len + 1024;
+    flac->md5_buf = realloc(flac->md5_buf, flac->md5_buf_alloc);
+    }
+
+  ptr = flac->md5_buf;
+  
+  for(i = 0; i < num_samples; i++)
+    {
+    for(j = 0; j < flac->format->num_channels; j++)
+      {
+      val = flac->buffer[j][i];
+      for(k = 0; k < bytes; k++)
+        {
+        *(ptr++) = val & 0xff;
+        val >>= 8;
+        }
+      }
+    }
+  bgen_md5_process_bytes(flac->md5_buf, len, &flac->md5);
+  }
+
+static gavl_sink_status_t
+encode_audio_func_threaded(void * priv, gavl_audio_frame_t * frame)
+  {
+  int i, num, pos = 0;
+  bgen_segment_t * seg;
+  segment_data_t * sd;
+  bg_flac_t * flac = priv;
+  
+  prepare_frame(flac, frame);
+  update_md5(flac, frame->valid_samples);
+  
+  while(pos < frame->valid_samples)
+    {
+    seg = bgen_segment_encoder_get(flac->segenc);
+
+    if(!seg->data)
+      {
+      sd = calloc(1, sizeof(*sd));
+      for(i = 0; i < flac->format->num_channels; i++)
+        sd->buffer[i] = malloc(flac->segment_samples * sizeof(sd->buffer[i][0]));
+      seg->data = sd;
+      }
+    sd = seg->data;
+    
+    num = flac->segment_samples - seg->fill;
+    if(num > frame->valid_samples - pos)
+      num = frame->valid_samples - pos;
+
+    for(i = 0; i < flac->format->num_channels; i++)
+      memcpy(sd->buffer[i] + seg->fill,
+             flac->buffer[i] + pos, num * sizeof(flac->buffer[0][0]));
+
+    seg->fill += num;
+    pos += num;
+
+    if(seg->fill == flac->segment_samples)
+      bgen_segment_encoder_submit(flac->segenc);
+    }
+  
+  return bgen_segment_encoder_output(flac->segenc);
+  }
+
+static int finish_threads(bg_flac_t * flac)
+  {
+  gavl_sink_status_t st;
+  
+  st = bgen_segment_encoder_flush(flac->segenc);
+  bgen_segment_encoder_destroy(flac->segenc);
+  flac->segenc = NULL;
+  bgen_md5_finish_ctx(&flac->md5, flac->si.md5sum);
+  return (st == GAVL_SINK_OK);
+  }
+
 gavl_audio_sink_t *
 bg_flac_start_uncompressed(bg_flac_t * flac,
                            gavl_audio_format_t * fmt,
@@ -435,13 +845,7 @@ bg_flac_start_uncompressed(bg_flac_t * flac,
 
   /* Set compression parameters from presets */
   
-  FLAC__stream_encoder_set_sample_rate(flac->enc, flac->format->samplerate);
-  FLAC__stream_encoder_set_channels(flac->enc, flac->format->num_channels);
-
-  /* */
-  FLAC__stream_encoder_set_compression_level(flac->enc, flac->clevel);
-  
-  FLAC__stream_encoder_set_bits_per_sample(flac->enc, flac->bits_per_sample);
+  setup_encoder(flac, flac->enc);
 
   /* Initialize */
 
@@ -465,17 +869,32 @@ bg_flac_start_uncompressed(bg_flac_t * flac,
   //    FLAC__stream_encoder_get_blocksize(flac->enc);
   
   gavl_compression_info_copy(ci, &flac->ci);
+
+  if(flac->num_threads > 1)
+    {
+    start_threads(flac);
+    return gavl_audio_sink_create(NULL, encode_audio_func_threaded, flac,
+                                  flac->format);
+    }
   return gavl_audio_sink_create(NULL, encode_audio_func, flac, flac->format);
   }
 
 
-void bg_flac_free(bg_flac_t * flac)
+int bg_flac_free(bg_flac_t * flac)
   {
   int i;
+  int ret = 1;
+
+  if(flac->segenc && !finish_threads(flac))
+    ret = 0;
   
-  FLAC__stream_encoder_finish(flac->enc);
+  if(!FLAC__stream_encoder_finish(flac->enc))
+    ret = 0;
   FLAC__stream_encoder_delete(flac->enc);
 
+  if(!ret)
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN, "Finishing the stream failed");
+
   if(flac->buffer[0])
     {
     for(i = 0; i < flac->format->num_channels; i++)
@@ -484,8 +903,11 @@ void bg_flac_free(bg_flac_t * flac)
       flac->buffer[i] = NULL;
       }
     }
+  if(flac->md5_buf)
+    free(flac->md5_buf);
   gavl_compression_info_free(&flac->ci);  
   free(flac);
+  return ret;
   }
 
 /* Metadata -> vorbis comment */
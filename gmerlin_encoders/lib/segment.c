@@ -0,0 +1,305 @@
+/*****************************************************************
+ * gmerlin-encoders - encoder plugins for gmerlin
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <gmerlin_encoders.h>
+
+#define SEGMENT_FREE     0
+#define SEGMENT_FILLING  1
+#define SEGMENT_QUEUED   2
+#define SEGMENT_ENCODING 3
+#define SEGMENT_DONE     4
+
+#define OUTPUT_NOWAIT   0
+#define OUTPUT_WAIT_ONE 1
+#define OUTPUT_WAIT_ALL 2
+
+struct bgen_segment_encoder_s
+  {
+  bgen_segment_t * segments;
+  int num_segments;
+  bgen_segment_t * cur;
+
+  int64_t seq_in;
+  int64_t seq_out;
+  int error;
+
+  pthread_t * threads;
+  int num_threads;
+  int stop;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+  bgen_segment_encode_func encode;
+  bgen_segment_output_func output;
+  bgen_segment_free_func free_data;
+  void * priv;
+  };
+
+static bgen_segment_t * next_queued(bgen_segment_encoder_t * enc)
+  {
+  int i;
+  bgen_segment_t * ret = NULL;
+
+  for(i = 0; i < enc->num_segments; i++)
+    {
+    if((enc->segments[i].state == SEGMENT_QUEUED) &&
+       (!ret || (enc->segments[i].seq < ret->seq)))
+      ret = &enc->segments[i];
+    }
+  return ret;
+  }
+
+static void * encode_thread(void * data)
+  {
+  bgen_segment_t * seg;
+  bgen_segment_encoder_t * enc = data;
+
+  while(1)
+    {
+    pthread_mutex_lock(&enc->mutex);
+
+    while(!(seg = next_queued(enc)) && !enc->stop)
+      pthread_cond_wait(&enc->cond, &enc->mutex);
+
+    if(!seg)
+      {
+      pthread_mutex_unlock(&enc->mutex);
+      break;
+      }
+    seg->state = SEGMENT_ENCODING;
+    pthread_mutex_unlock(&enc->mutex);
+
+    if(!enc->encode(enc->priv, seg))
+      seg->error = 1;
+
+    pthread_mutex_lock(&enc->mutex);
+    seg->state = SEGMENT_DONE;
+    pthread_cond_broadcast(&enc->cond);
+    pthread_mutex_unlock(&enc->mutex);
+    }
+  return NULL;
+  }
+
+bgen_segment_encoder_t *
+bgen_segment_encoder_create(int num_threads, int num_segments,
+                            bgen_segment_encode_func encode,
+                            bgen_segment_output_func output,
+                            bgen_segment_free_func free_data,
+                            void * priv)
+  {
+  int i;
+  bgen_segment_encoder_t * ret = calloc(1, sizeof(*ret));
+
+  ret->encode = encode;
+  ret->output = output;
+  ret->free_data = free_data;
+  ret->priv = priv;
+
+  ret->num_segments = num_segments;
+  ret->segments = calloc(ret->num_segments, sizeof(*ret->segments));
+
+  pthread_mutex_init(&ret->mutex, NULL);
+  pthread_cond_init(&ret->cond, NULL);
+
+  ret->num_threads = num_threads;
+  ret->threads = calloc(ret->num_threads, sizeof(*ret->threads));
+  for(i = 0; i < ret->num_threads; i++)
+    pthread_create(&ret->threads[i], NULL, encode_thread, ret);
+  return ret;
+  }
+
+/* Pass finished segments to the output in order */
+
+static gavl_sink_status_t output_segments(bgen_segment_encoder_t * enc,
+                                          int wait)
+  {
+  int i;
+  bgen_segment_t * seg;
+  gavl_sink_status_t st = GAVL_SINK_OK;
+
+  while(1)
+    {
+    pthread_mutex_lock(&enc->mutex);
+
+    seg = NULL;
+    for(i = 0; i < enc->num_segments; i++)
+      {
+      if((enc->segments[i].state >= SEGMENT_QUEUED) &&
+         (enc->segments[i].seq == enc->seq_out))
+        {
+        seg = &enc->segments[i];
+        break;
+        }
+      }
+
+    if(!seg || ((seg->state != SEGMENT_DONE) && (wait == OUTPUT_NOWAIT)))
+      {
+      pthread_mutex_unlock(&enc->mutex);
+      break;
+      }
+
+    if(seg->state != SEGMENT_DONE)
+      {
+      pthread_cond_wait(&enc->cond, &enc->mutex);
+      pthread_mutex_unlock(&enc->mutex);
+      continue;
+      }
+    pthread_mutex_unlock(&enc->mutex);
+
+    if(seg->error || enc->error)
+      st = GAVL_SINK_ERROR;
+
+    for(i = 0; i < seg->num_packets; i++)
+      {
+      if(st != GAVL_SINK_OK)
+        break;
+      st = enc->output(enc->priv, &seg->packets[i]);
+      }
+
+    pthread_mutex_lock(&enc->mutex);
+    seg->state = SEGMENT_FREE;
+    enc->seq_out++;
+    pthread_cond_broadcast(&enc->cond);
+    pthread_mutex_unlock(&enc->mutex);
+
+    if(st != GAVL_SINK_OK)
+      enc->error = 1;
+
+    if(wait == OUTPUT_WAIT_ONE)
+      wait = OUTPUT_NOWAIT;
+    }
+
+  if(enc->error)
+    return GAVL_SINK_ERROR;
+  return st;
+  }
+
+bgen_segment_t * bgen_segment_encoder_get(bgen_segment_encoder_t * enc)
+  {
+  int i;
+
+  while(!enc->cur)
+    {
+    pthread_mutex_lock(&enc->mutex);
+    for(i = 0; i < enc->num_segments; i++)
+      {
+      if(enc->segments[i].state == SEGMENT_FREE)
+        {
+        enc->cur = &enc->segments[i];
+        enc->cur->state = SEGMENT_FILLING;
+        enc->cur->fill = 0;
+        enc->cur->num_packets = 0;
+        enc->cur->error = 0;
+        break;
+        }
+      }
+    pthread_mutex_unlock(&enc->mutex);
+
+    /* All segments busy: Wait for the oldest one */
+    if(!enc->cur)
+      output_segments(enc, OUTPUT_WAIT_ONE);
+    }
+  return enc->cur;
+  }
+
+void bgen_segment_encoder_submit(bgen_segment_encoder_t * enc)
+  {
+  if(!enc->cur)
+    return;
+
+  pthread_mutex_lock(&enc->mutex);
+  enc->cur->state = SEGMENT_QUEUED;
+  enc->cur->seq = enc->seq_in++;
+  pthread_cond_broadcast(&enc->cond);
+  pthread_mutex_unlock(&enc->mutex);
+  enc->cur = NULL;
+  }
+
+gavl_sink_status_t bgen_segment_encoder_output(bgen_segment_encoder_t * enc)
+  {
+  return output_segments(enc, OUTPUT_NOWAIT);
+  }
+
+gavl_sink_status_t bgen_segment_encoder_flush(bgen_segment_encoder_t * enc)
+  {
+  if(enc->cur)
+    {
+    if(enc->cur->fill)
+      bgen_segment_encoder_submit(enc);
+    else
+      {
+      enc->cur->state = SEGMENT_FREE;
+      enc->cur = NULL;
+      }
+    }
+  return output_segments(enc, OUTPUT_WAIT_ALL);
+  }
+
+void bgen_segment_encoder_destroy(bgen_segment_encoder_t * enc)
+  {
+  int i, j;
+
+  pthread_mutex_lock(&enc->mutex);
+  enc->stop = 1;
+  pthread_cond_broadcast(&enc->cond);
+  pthread_mutex_unlock(&enc->mutex);
+
+  for(i = 0; i < enc->num_threads; i++)
+    pthread_join(enc->threads[i], NULL);
+  free(enc->threads);
+
+  for(i = 0; i < enc->num_segments; i++)
+    {
+    if(enc->segments[i].data && enc->free_data)
+      enc->free_data(enc->priv, enc->segments[i].data);
+
+    for(j = 0; j < enc->segments[i].packets_alloc; j++)
+      gavl_packet_free(&enc->segments[i].packets[j]);
+    if(enc->segments[i].packets)
+      free(enc->segments[i].packets);
+    }
+  free(enc->segments);
+
+  pthread_mutex_destroy(&enc->mutex);
+  pthread_cond_destroy(&enc->cond);
+  free(enc);
+  }
+
+gavl_packet_t * bgen_segment_add_packet(bgen_segment_t * seg)
+  {
+  gavl_packet_t * ret;
+
+  if(seg->num_packets == seg->packets_alloc)
+    {
+    seg->packets_alloc += 64;
+    seg->packets = realloc(seg->packets,
+                           seg->packets_alloc * sizeof(*seg->packets));
+    memset(seg->packets + seg->num_packets, 0,
+           (seg->packets_alloc - seg->num_packets) * sizeof(*seg->packets));
+    }
+  ret = &seg->packets[seg->num_packets++];
+  gavl_packet_reset(ret);
+  return ret;
+  }
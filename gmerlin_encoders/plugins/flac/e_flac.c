@@ -450,13 +450,15 @@ static void finalize(flac_t * flac)
 
 static int close_flac(void * data, int do_delete)
   {
+  int ret = 1;
   flac_t * flac;
   flac = data;
 
   /* Flush and free the codec */
   if(flac->enc)
     {
-    bg_flac_free(flac->enc);
+    if(!bg_flac_free(flac->enc))
+      ret = 0;
     flac->enc = NULL;
     }
 
@@ -509,7 +511,7 @@ static int close_flac(void * data, int do_delete)
 
   gavl_metadata_free(&flac->m_stream);
   
-  return 1;
+  return ret;
   }
 
 static void destroy_flac(void * priv)
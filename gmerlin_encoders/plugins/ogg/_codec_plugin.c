@@ -19,6 +19,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  * *****************************************************************/
 
+#include <gmerlin/log.h>
+
 typedef struct
   {
   void * priv;
@@ -38,7 +40,9 @@ static void * create_codec()
 static void destroy_codec(void * priv)
   {
   stream_codec_t * c = priv;
-  c->codec->close(c->priv);
+  /* Codec plugins can't return errors when they are finished */
+  if(!c->codec->close(c->priv))
+    bg_log(BG_LOG_ERROR, CODEC_NAME, "Closing the encoder failed");
   free(c);
   }
 
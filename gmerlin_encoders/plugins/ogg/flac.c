@@ -168,7 +168,8 @@ static int close_flacogg(void * data)
   flacogg_t * flacogg;
   flacogg = data;
 
-  bg_flac_free(flacogg->enc);
+  if(!bg_flac_free(flacogg->enc))
+    ret = 0;
   flacogg->enc = NULL;
  
   if(flacogg->frame)
@@ -37,6 +37,7 @@
 
 #include <theora/theoraenc.h>
 
+#include <gmerlin_encoders.h>
 #include "ogg_common.h"
 
 /*
@@ -49,6 +50,21 @@
 #define THEORA_1_1
 #endif
 
+/*
+ *  Threaded encoding: Frames are collected into segments, which are
+ *  encoded by worker threads and output in order.
+ *
+ *  For VBR single pass encoding, each segment is encoded with its own
+ *  encoder instance (the first frame is always a keyframe) so
+ *  segments can be encoded in parallel (GOP parallel).
+ *  Rate control of CBR and 2-pass encoding needs all frames in
+ *  sequence, so there we have only one worker using the main encoder,
+ *  which runs pipelined with the caller.
+ */
+
+#define PIPE_SEGMENT_FRAMES 4
+#define PIPE_SEGMENTS       3
+
 typedef struct
   {
   /* Ogg theora stuff */
@@ -85,7 +101,12 @@ typedef struct
   int64_t pts;
 
   gavl_video_format_t * format;
-  
+
+  /* Threaded encoding */
+  int num_threads;
+  int gop_parallel;
+  int segment_frames;
+  bgen_segment_encoder_t * segenc;
   } theora_t;
 
 static void set_packet_sink(void * data, gavl_packet_sink_t * psink)
@@ -173,6 +194,15 @@ static const bg_parameter_info_t parameters[] =
       .num_digits  = 2,
       .help_string = TRS("Higher speed levels favor quicker encoding over better quality per bit. Depending on the encoding mode, and the internal algorithms used, quality may actually improve, but in this case bitrate will also likely increase. In any case, overall rate/distortion performance will probably decrease."),
     },
+    {
+      .name =      "threads",
+      .long_name = TRS("Threads"),
+      .type =      BG_PARAMETER_INT,
+      .val_min =     { .val_i = 1  },
+      .val_max =     { .val_i = 64 },
+      .val_default = { .val_i = 1  },
+      .help_string = TRS("Number of encoding threads. For single pass VBR encoding, the segments between the forced keyframes (see maximum keyframe interval) are encoded in parallel, which needs memory for (threads + 1) segments. For CBR and 2-pass encoding, one thread encodes while the caller prepares the next frames."),
+    },
     BG_ENCODER_FRAMERATE_PARAMS,
     { /* End of parameters */ }
   };
@@ -201,6 +231,8 @@ static void set_parameter_theora(void * data, const char * name,
     theora->max_keyframe_interval = v->val_i;
   else if(!strcmp(name, "speed"))
     theora->speed = v->val_f;
+  else if(!strcmp(name, "threads"))
+    theora->num_threads = v->val_i;
 #ifdef THEORA_1_1
   else if(!strcmp(name, "drop_frames"))
     {
@@ -336,26 +368,11 @@ static int init_compressed_theora(bg_ogg_stream_t * s)
   return 1;
   }
 
-static gavl_sink_status_t
-write_video_frame_theora(void * data, gavl_video_frame_t * frame)
-  {
-  theora_t * theora;
-  int result;
-  int i;
-  ogg_packet op;
-  gavl_packet_t gp;
-  //  int64_t frame_index;
-
-  //  fprintf(stderr, "Write frame theora\n");
-  
-  theora = data;
-  
-  for(i = 0; i < 3; i++)
-    {
-    theora->buf[i].stride = frame->strides[i];
-    theora->buf[i].data   = frame->planes[i];
-    }
+/* Encode one frame, op is valid until the next call */
 
+static int encode_frame(theora_t * theora, th_enc_ctx * ts,
+                        th_ycbcr_buffer buf, ogg_packet * op)
+  {
 #ifdef THEORA_1_1
   if(theora->pass == 2)
     {
@@ -365,7 +382,7 @@ write_video_frame_theora(void * data, gavl_video_frame_t * frame)
     while(theora->stats_ptr - theora->stats_buf < theora->stats_size)
       {
       
-      ret = th_encode_ctl(theora->ts,
+      ret = th_encode_ctl(ts,
                           TH_ENCCTL_2PASS_IN,
                           theora->stats_ptr,
                           theora->stats_size -
@@ -374,7 +391,7 @@ write_video_frame_theora(void * data, gavl_video_frame_t * frame)
       if(ret < 0)
         {
         bg_log(BG_LOG_ERROR, LOG_DOMAIN, "passing 2 pass data failed");
-        return GAVL_SINK_ERROR;
+        return 0;
         }
       else if(!ret)
         break;
@@ -386,48 +403,54 @@ write_video_frame_theora(void * data, gavl_video_frame_t * frame)
     }
 #endif
   
-  result = th_encode_ycbcr_in(theora->ts, theora->buf);
+  th_encode_ycbcr_in(ts, buf);
 
 #ifdef THEORA_1_1
   /* Output pass data */
   if(theora->pass == 1)
     {
     int ret;
-    char * buf;
-    ret = th_encode_ctl(theora->ts,
+    char * stats;
+    ret = th_encode_ctl(ts,
                         TH_ENCCTL_2PASS_OUT,
-                        &buf, sizeof(buf));
+                        &stats, sizeof(stats));
     if(ret < 0)
       {
       bg_log(BG_LOG_ERROR, LOG_DOMAIN, "getting 2 pass data failed");
-      return GAVL_SINK_ERROR;
+      return 0;
       }
-    fwrite(buf, 1, ret, theora->stats_file);
+    fwrite(stats, 1, ret, theora->stats_file);
     }
 #endif
 
   /* Output packet */
   
-  if(!th_encode_packetout(theora->ts, 0, &op))
+  if(!th_encode_packetout(ts, 0, op))
     {
     bg_log(BG_LOG_ERROR, LOG_DOMAIN,
            "Theora encoder produced no packet");
-    return GAVL_SINK_ERROR;
+    return 0;
     }
+  return 1;
+  }
+
+static void set_packet_flags(ogg_packet * op, gavl_packet_t * gp)
+  {
+  if(op->bytes && !(op->packet[0] & 0x40)) // Keyframe
+    gp->flags |= GAVL_PACKET_TYPE_I | GAVL_PACKET_KEYFRAME;
+  else
+    gp->flags |= GAVL_PACKET_TYPE_P;
+  }
+
+static gavl_sink_status_t put_packet(void * data, gavl_packet_t * gp)
+  {
+  theora_t * theora = data;
   
-  gavl_packet_init(&gp);
-  bg_ogg_packet_to_gavl(&op, &gp, NULL);
-  
-  gp.pts      = theora->pts;
-  gp.duration = theora->format->frame_duration;
+  gp->pts      = theora->pts;
+  gp->duration = theora->format->frame_duration;
 
   theora->pts += theora->format->frame_duration;
   
-  if(op.bytes && !(op.packet[0] & 0x40)) // Keyframe
-    gp.flags |= GAVL_PACKET_TYPE_I | GAVL_PACKET_KEYFRAME;
-  else
-    gp.flags |= GAVL_PACKET_TYPE_P;
-  
 #if 0
   fprintf(stderr, "Encoding granulepos: %lld %lld / %d\n",
           op.granulepos,
@@ -435,10 +458,226 @@ write_video_frame_theora(void * data, gavl_video_frame_t * frame)
           op.granulepos & ((1<<theora->ti.keyframe_granule_shift)-1));
 #endif
   //  fprintf(stderr, "Write frame theora done\n");
-  //  gavl_packet_dump(&gp);
-  return gavl_packet_sink_put_packet(theora->psink, &gp);
+  //  gavl_packet_dump(gp);
+  return gavl_packet_sink_put_packet(theora->psink, gp);
   }
 
+static gavl_sink_status_t
+write_video_frame_theora(void * data, gavl_video_frame_t * frame)
+  {
+  theora_t * theora;
+  int i;
+  ogg_packet op;
+  gavl_packet_t gp;
+  
+  //  fprintf(stderr, "Write frame theora\n");
+  
+  theora = data;
+  
+  for(i = 0; i < 3; i++)
+    {
+    theora->buf[i].stride = frame->strides[i];
+    theora->buf[i].data   = frame->planes[i];
+    }
+
+  if(!encode_frame(theora, theora->ts, theora->buf, &op))
+    return GAVL_SINK_ERROR;
+  
+  gavl_packet_init(&gp);
+  bg_ogg_packet_to_gavl(&op, &gp, NULL);
+  set_packet_flags(&op, &gp);
+  
+  return put_packet(theora, &gp);
+  }
+
+static th_enc_ctx * create_encoder(theora_t * theora)
+  {
+  th_enc_ctx * ret;
+  int arg_i1, arg_i2;
+  
+  if(!(ret = th_encode_alloc(&theora->ti)))
+    {
+    bg_log(BG_LOG_ERROR, LOG_DOMAIN,  "th_encode_alloc failed");
+    return NULL;
+    }
+
+  /* Call encode CTLs */
+  
+  // Keyframe frequency
+
+  th_encode_ctl(ret,
+                TH_ENCCTL_SET_KEYFRAME_FREQUENCY_FORCE,
+                &theora->max_keyframe_interval, sizeof(theora->max_keyframe_interval));
+
+#ifdef THEORA_1_1  
+  // Rate flags
+
+  th_encode_ctl(ret,
+                TH_ENCCTL_SET_RATE_FLAGS,
+                &theora->rate_flags,sizeof(theora->rate_flags));
+#endif
+  // Maximum speed
+
+  if(th_encode_ctl(ret,
+                   TH_ENCCTL_GET_SPLEVEL_MAX,
+                   &arg_i1, sizeof(arg_i1)) != TH_EIMPL)
+    {
+    arg_i2 = (int)((float)arg_i1 * theora->speed + 0.5);
+
+    if(arg_i2 > arg_i1)
+      arg_i2 = arg_i1;
+    
+    th_encode_ctl(ret, TH_ENCCTL_SET_SPLEVEL,
+                  &arg_i2, sizeof(arg_i2));
+    }
+  return ret;
+  }
+
+/* Threaded encoding */
+
+static int encode_segment(void * data, bgen_segment_t * seg)
+  {
+  int i, j;
+  th_enc_ctx * ts;
+  th_ycbcr_buffer buf;
+  ogg_packet op;
+  gavl_packet_t gp;
+  gavl_packet_t * p;
+  gavl_video_frame_t ** frames = seg->data;
+  theora_t * theora = data;
+  int ret = 0;
+  
+  if(theora->gop_parallel)
+    {
+    th_comment tc;
+    
+    /* Fresh encoder, the first frame will be a keyframe */
+    if(!(ts = create_encoder(theora)))
+      return 0;
+
+    /* Headers are the same as the ones of the main encoder */
+    th_comment_init(&tc);
+    while(th_encode_flushheader(ts, &tc, &op) > 0)
+      ;
+    th_comment_clear(&tc);
+    }
+  else
+    ts = theora->ts;
+
+  memcpy(buf, theora->buf, sizeof(buf));
+  
+  for(i = 0; i < seg->fill; i++)
+    {
+    for(j = 0; j < 3; j++)
+      {
+      buf[j].stride = frames[i]->strides[j];
+      buf[j].data   = frames[i]->planes[j];
+      }
+    if(!encode_frame(theora, ts, buf, &op))
+      goto fail;
+
+    gavl_packet_init(&gp);
+    bg_ogg_packet_to_gavl(&op, &gp, NULL);
+
+    p = bgen_segment_add_packet(seg);
+    gavl_packet_copy(p, &gp);
+    set_packet_flags(&op, p);
+    }
+  ret = 1;
+  fail:
+  
+  if(theora->gop_parallel)
+    th_encode_free(ts);
+  return ret;
+  }
+
+static void free_segment_frames(void * data, void * frames_p)
+  {
+  int i;
+  gavl_video_frame_t ** frames = frames_p;
+  theora_t * theora = data;
+
+  for(i = 0; i < theora->segment_frames; i++)
+    {
+    if(frames[i])
+      gavl_video_frame_destroy(frames[i]);
+    }
+  free(frames);
+  }
+
+static void start_threads(theora_t * theora)
+  {
+  int num_workers;
+  int num_segments;
+  
+  /* Rate control needs all frames in sequence */
+  theora->gop_parallel = !theora->cbr;
+#ifdef THEORA_1_1
+  if(theora->pass)
+    theora->gop_parallel = 0;
+#endif
+
+  if(theora->gop_parallel)
+    {
+    num_workers = theora->num_threads;
+    num_segments = theora->num_threads + 1;
+    theora->segment_frames = theora->max_keyframe_interval;
+    }
+  else
+    {
+    num_workers = 1;
+    num_segments = PIPE_SEGMENTS;
+    theora->segment_frames = PIPE_SEGMENT_FRAMES;
+    }
+
+  bg_log(BG_LOG_INFO, LOG_DOMAIN,
+         "Using %d threads (%s, %d frames per segment)",
+         num_workers,
+         (theora->gop_parallel ? "GOP parallel" : "pipelined"),
+         theora->segment_frames);
+  
+  theora->segenc = bgen_segment_encoder_create(num_workers, num_segments,
+                                               encode_segment,
+                                               put_packet,
+                                               free_segment_frames,
+                                               theora);
+  }
+
+static gavl_video_frame_t * get_frame_threaded(void * data)
+  {
+  bgen_segment_t * seg;
+  gavl_video_frame_t ** frames;
+  theora_t * theora = data;
+  
+  if(!theora->segenc)
+    start_threads(theora);
+
+  seg = bgen_segment_encoder_get(theora->segenc);
+  
+  if(!seg->data)
+    seg->data = calloc(theora->segment_frames, sizeof(*frames));
+  frames = seg->data;
+  
+  if(!frames[seg->fill])
+    frames[seg->fill] = gavl_video_frame_create(theora->format);
+  
+  return frames[seg->fill];
+  }
+
+static gavl_sink_status_t
+put_frame_threaded(void * data, gavl_video_frame_t * frame)
+  {
+  bgen_segment_t * seg;
+  theora_t * theora = data;
+  
+  seg = bgen_segment_encoder_get(theora->segenc);
+  seg->fill++;
+  
+  if(seg->fill == theora->segment_frames)
+    bgen_segment_encoder_submit(theora->segenc);
+  
+  return bgen_segment_encoder_output(theora->segenc);
+  }
 
 static gavl_video_sink_t *
 init_theora(void * data, gavl_compression_info_t * ci,
@@ -446,7 +685,6 @@ init_theora(void * data, gavl_compression_info_t * ci,
             gavl_metadata_t * stream_metadata)
   {
   int sub_h, sub_v;
-  int arg_i1, arg_i2;
   uint8_t * ptr;
   ogg_packet op;
   int header_packets;
@@ -506,44 +744,8 @@ init_theora(void * data, gavl_compression_info_t * ci,
     }
   
   /* Initialize encoder */
-  if(!(theora->ts = th_encode_alloc(&theora->ti)))
-    {
-    bg_log(BG_LOG_ERROR, LOG_DOMAIN,  "th_encode_alloc failed");
+  if(!(theora->ts = create_encoder(theora)))
     return 0;
-    }
-  /* Build comment (comments are UTF-8, good for us :-) */
-
-  // build_comment(&theora->tc, metadata);
-
-  /* Call encode CTLs */
-  
-  // Keyframe frequency
-
-  th_encode_ctl(theora->ts,
-                TH_ENCCTL_SET_KEYFRAME_FREQUENCY_FORCE,
-                &theora->max_keyframe_interval, sizeof(theora->max_keyframe_interval));
-
-#ifdef THEORA_1_1  
-  // Rate flags
-
-  th_encode_ctl(theora->ts,
-                TH_ENCCTL_SET_RATE_FLAGS,
-                &theora->rate_flags,sizeof(theora->rate_flags));
-#endif
-  // Maximum speed
-
-  if(th_encode_ctl(theora->ts,
-                   TH_ENCCTL_GET_SPLEVEL_MAX,
-                   &arg_i1, sizeof(arg_i1)) != TH_EIMPL)
-    {
-    arg_i2 = (int)((float)arg_i1 * theora->speed + 0.5);
-
-    if(arg_i2 > arg_i1)
-      arg_i2 = arg_i1;
-    
-    th_encode_ctl(theora->ts, TH_ENCCTL_SET_SPLEVEL,
-                  &arg_i2, sizeof(arg_i2));
-    }
   
   /* Encode initial packets */
 
@@ -591,8 +793,12 @@ init_theora(void * data, gavl_compression_info_t * ci,
   theora->buf[2].width  = theora->format->frame_width  / sub_h;
   theora->buf[2].height = theora->format->frame_height / sub_v;
   
-  return gavl_video_sink_create(NULL, write_video_frame_theora, theora,
-                                theora->format);
+  if(theora->num_threads > 1)
+    return gavl_video_sink_create(get_frame_threaded, put_frame_threaded,
+                                  theora, theora->format);
+  else
+    return gavl_video_sink_create(NULL, write_video_frame_theora, theora,
+                                  theora->format);
   }
 
 #ifdef THEORA_1_1
@@ -736,6 +942,13 @@ static int close_theora(void * data)
   int ret = 1;
   theora_t * theora;
   theora = data;
+
+  if(theora->segenc)
+    {
+    if(bgen_segment_encoder_flush(theora->segenc) != GAVL_SINK_OK)
+      ret = 0;
+    bgen_segment_encoder_destroy(theora->segenc);
+    }
   
 #ifdef THEORA_1_1
   if(theora->stats_file)
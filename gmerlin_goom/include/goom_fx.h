@@ -8,5 +8,6 @@ VisualFX convolve_create ();
 VisualFX flying_star_create (void);
 
 void zoom_filter_c(int sizeX, int sizeY, Pixel *src, Pixel *dest, int *brutS, int *brutD, int buffratio, int precalCoef[16][16]);
+void zoom_filter_c_rows(int sizeX, int sizeY, Pixel *src, Pixel *dest, int *brutS, int *brutD, int buffratio, int precalCoef[16][16], int start, int end);
 
 #endif
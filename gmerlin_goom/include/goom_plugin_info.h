@@ -159,9 +159,12 @@ struct _PLUGIN_INFO {
 	struct {
 		void (*draw_line) (Pixel *data, int x1, int y1, int x2, int y2, int col, int screenx, int screeny);
 		void (*zoom_filter) (int sizeX, int sizeY, Pixel *src, Pixel *dest, int *brutS, int *brutD, int buffratio, int precalCoef[16][16]);
+		/* Lines [start..end[ only, NULL if zoom_filter can't be split */
+		void (*zoom_filter_rows) (int sizeX, int sizeY, Pixel *src, Pixel *dest, int *brutS, int *brutD, int buffratio, int precalCoef[16][16], int start, int end);
 	} methods;
 	
 	GoomRandom *gRandom;
+	GoomThreads *threads;
     
     GoomSL *scanner;
     GoomSL *main_scanner;
@@ -0,0 +1,20 @@
+#ifndef _GOOM_THREADS_H
+#define _GOOM_THREADS_H
+
+#include "goom_typedefs.h"
+
+/**
+ * Worker threads for the full screen passes (zoom, convolve).
+ * The image is split into horizontal stripes, one per thread.
+ * The calling thread renders the last stripe itself.
+ */
+
+typedef void (*GoomStripeFunc)(void *data, int start, int end);
+
+GoomThreads *goom_threads_new(int num);
+void goom_threads_free(GoomThreads *t);
+
+/* Calls func for stripes of [0..height[ and returns when all are done */
+void goom_threads_run(GoomThreads *t, GoomStripeFunc func, void *data, int height);
+
+#endif
@@ -7,5 +7,6 @@ typedef struct _GMLINE GMLine;
 typedef struct _GMUNITPOINTER GMUnitPointer;
 typedef struct _ZOOM_FILTER_DATA ZoomFilterData;
 typedef struct _VISUAL_FX VisualFX;
+typedef struct _GOOM_THREADS GoomThreads;
 
 #endif
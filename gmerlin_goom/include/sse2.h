@@ -0,0 +1,20 @@
+#ifndef _SSE2_H
+#define _SSE2_H
+
+/*
+ * SSE2 versions of the zoom filter (x86_64 only, where SSE2 is always
+ * available). The output is the same as the one of zoom_filter_c except
+ * that the alpha channel of dest is left untouched.
+ */
+
+#include "goom_graphic.h"
+
+void zoom_filter_sse2 (int prevX, int prevY, Pixel *expix1, Pixel *expix2,
+                       int *brutS, int *brutD, int buffratio, int precalCoef[16][16]);
+
+/* lines [start..end[ of expix2, the corners of expix1 must be black */
+void zoom_filter_sse2_rows (int prevX, int prevY, Pixel *expix1, Pixel *expix2,
+                            int *brutS, int *brutD, int buffratio, int precalCoef[16][16],
+                            int start, int end);
+
+#endif
@@ -3,12 +3,17 @@
 #include <goom_plugin_info.h>
 #include <goomsl.h>
 #include <goom_config.h>
+#include <goom_threads.h>
 
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
 //#define CONV_MOTIF_W 32
 //#define CONV_MOTIF_WMASK 0x1f
 
@@ -112,45 +117,51 @@ static void convolve_free(VisualFX *_this) {
   free (_this->fx_data);
 }
 
-static void create_output_with_brightness(VisualFX *_this, Pixel *src, Pixel *dest,
-                                         PluginInfo *info, int iff)
-{
-  ConvData *data = (ConvData*)_this->fx_data;
-  
-  int x,y;
-  int i = 0;//info->screen.height * info->screen.width - 1;
+/* one horizontal stripe of the output, called from the worker threads */
+typedef struct {
+  ConvData *data;
+  Pixel *src, *dest;
+  int width;
+  int c, s;
+  int xtex, ytex; /* texture position of the first line */
+  int ifftab[16];
+} ConvStripe;
 
-  const int c = data->h_cos [data->theta];
-  const int s = data->h_sin [data->theta];
+static void create_output_rows(void *priv, int start, int end)
+{
+  ConvStripe *cs = (ConvStripe*)priv;
+  ConvData *data = cs->data;
+  Pixel *src = cs->src;
+  Pixel *dest = cs->dest;
+  const int c = cs->c;
+  const int s = cs->s;
+  const int *ifftab = cs->ifftab;
 
-  const int xi = -(info->screen.width/2) * c;
-  const int yi =  (info->screen.width/2) * s;
+  int x,y;
+  int i = start * cs->width;
 
-  const int xj = -(info->screen.height/2) * s;
-  const int yj = -(info->screen.height/2) * c;
+  int xprime = cs->xtex + start * s;
+  int yprime = cs->ytex + start * c;
 
-  int xprime = xj;
-  int yprime = yj;
+#ifdef HAVE_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i max = _mm_set1_epi16(0xFF);
+  const __m128i rgb_mask = _mm_set1_epi32(~(0xFF << A_OFFSET));
 
-  int ifftab[16];
-  if (data->inverse_motif) {
-    int i;
-    for (i=0;i<16;++i)
-      ifftab[i] = (double)iff * (1.0 + data->visibility * (15.0 - i) / 15.0);
-  }
-  else {
-    int i;
-    for (i=0;i<16;++i)
-      ifftab[i] = (double)iff / (1.0 + data->visibility * (15.0 - i) / 15.0);
-  }
+  /* iff2 clamped to 16 bits: The C version saturates to 0xFF for
+     all values outside, so the results are the same */
+  unsigned short ifftab16[16];
+  for (x=0;x<16;++x)
+    ifftab16[x] = ((unsigned int)ifftab[x] > 0xFFFF) ? 0xFFFF : ifftab[x];
+#endif
 
-  for (y=info->screen.height;y--;) {
+  for (y=start;y<end;y++) {
     int xtex,ytex;
 
-    xtex = xprime + xi + CONV_MOTIF_W * 0x10000 / 2;
+    xtex = xprime;
     xprime += s;
 
-    ytex = yprime + yi + CONV_MOTIF_W * 0x10000 / 2;
+    ytex = yprime;
     yprime += c;
 
 #ifdef HAVE_MMX
@@ -170,7 +181,7 @@ static void create_output_with_brightness(VisualFX *_this, Pixel *src, Pixel *de
         , [c]"g"(c), [s]"g"(s)
         , [motif] "g"(&data->conv_motif[0][0]));
     
-    for (x=info->screen.width;x--;)
+    for (x=cs->width;x--;)
     {
       __asm__ __volatile__
         (
@@ -213,7 +224,40 @@ static void create_output_with_brightness(VisualFX *_this, Pixel *src, Pixel *de
       i++;
     }
 #else
-    for (x=info->screen.width;x--;) {
+    x=cs->width;
+
+#ifdef HAVE_SSE2
+    /* 4 pixels at once, only the texture lookup is scalar */
+    for (;x>=4;x-=4) {
+      __m128i f_lo, f_hi, p, p_lo, p_hi;
+      unsigned short f[4];
+      int k;
+
+      for (k=0;k<4;++k) {
+        xtex += c;
+        ytex -= s;
+        f[k] = ifftab16[data->conv_motif[(ytex >>16) & CONV_MOTIF_WMASK][(xtex >> 16) & CONV_MOTIF_WMASK]];
+      }
+      f_lo = _mm_set_epi16(f[1],f[1],f[1],f[1],f[0],f[0],f[0],f[0]);
+      f_hi = _mm_set_epi16(f[3],f[3],f[3],f[3],f[2],f[2],f[2],f[2]);
+
+      p = _mm_loadu_si128((__m128i*)(src + i));
+
+      /* (channel << 8) * iff2 >> 16 == channel * iff2 >> 8 */
+      p_lo = _mm_mulhi_epu16(_mm_unpacklo_epi8(zero, p), f_lo);
+      p_hi = _mm_mulhi_epu16(_mm_unpackhi_epi8(zero, p), f_hi);
+
+      /* min(x, 0xFF) */
+      p_lo = _mm_sub_epi16(p_lo, _mm_subs_epu16(p_lo, max));
+      p_hi = _mm_sub_epi16(p_hi, _mm_subs_epu16(p_hi, max));
+
+      p = _mm_and_si128(_mm_packus_epi16(p_lo, p_hi), rgb_mask);
+      _mm_storeu_si128((__m128i*)(dest + i), p);
+      i += 4;
+    }
+#endif
+
+    for (;x--;) {
 
       int iff2;
       unsigned int f0,f1,f2,f3;
@@ -247,6 +291,44 @@ static void create_output_with_brightness(VisualFX *_this, Pixel *src, Pixel *de
 #ifdef HAVE_MMX
   __asm__ __volatile__ ("\n\t emms");
 #endif
+}
+
+static void create_output_with_brightness(VisualFX *_this, Pixel *src, Pixel *dest,
+                                         PluginInfo *info, int iff)
+{
+  ConvData *data = (ConvData*)_this->fx_data;
+  ConvStripe cs;
+
+  const int c = data->h_cos [data->theta];
+  const int s = data->h_sin [data->theta];
+
+  const int xi = -(info->screen.width/2) * c;
+  const int yi =  (info->screen.width/2) * s;
+
+  const int xj = -(info->screen.height/2) * s;
+  const int yj = -(info->screen.height/2) * c;
+
+  if (data->inverse_motif) {
+    int i;
+    for (i=0;i<16;++i)
+      cs.ifftab[i] = (double)iff * (1.0 + data->visibility * (15.0 - i) / 15.0);
+  }
+  else {
+    int i;
+    for (i=0;i<16;++i)
+      cs.ifftab[i] = (double)iff / (1.0 + data->visibility * (15.0 - i) / 15.0);
+  }
+
+  cs.data = data;
+  cs.src = src;
+  cs.dest = dest;
+  cs.width = info->screen.width;
+  cs.c = c;
+  cs.s = s;
+  cs.xtex = xj + xi + CONV_MOTIF_W * 0x10000 / 2;
+  cs.ytex = yj + yi + CONV_MOTIF_W * 0x10000 / 2;
+
+  goom_threads_run(info->threads, create_output_rows, &cs, info->screen.height);
     
   compute_tables(_this, info);
 }
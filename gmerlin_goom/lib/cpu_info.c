@@ -17,6 +17,8 @@
 #ifdef CPU_POWERPC
 #include <sys/types.h>
 #include <stdlib.h>
+#else
+#include <unistd.h>
 #endif
 
 static unsigned int CPU_FLAVOUR = 0;
@@ -51,12 +53,22 @@ static void autoset_cpu_info (void)
     {
         if (result != 0) CPU_NUMBER = result;
     }
+#elif defined(_SC_NPROCESSORS_ONLN)
+    {
+        long result = sysconf(_SC_NPROCESSORS_ONLN);
+        if (result > 0) CPU_NUMBER = result;
+    }
 #endif /* CPU_POWERPC */
     
 #ifdef CPU_X86
     if (mmx_supported()) CPU_FLAVOUR |= CPU_OPTION_MMX;
     if (xmmx_supported()) CPU_FLAVOUR |= CPU_OPTION_XMMX;
 #endif /* CPU_X86 */
+
+#ifdef HAVE_SSE2
+    /* Always there on x86_64 */
+    CPU_FLAVOUR |= CPU_OPTION_SSE | CPU_OPTION_SSE2;
+#endif
 }
 
 unsigned int cpu_flavour (void)
@@ -26,6 +26,7 @@
 #include <goom_tools.h>
 #include <goom_plugin_info.h>
 #include <goom_fx.h>
+#include <goom_threads.h>
 #include <v3d.h>
 
 /* TODO : MOVE THIS AWAY !!! */
@@ -86,12 +87,17 @@ static inline void getPixelRGB_ (Pixel *buffer, Uint x, Color * c)
 
 /* pure c version of the zoom filter */
 static void c_zoom (Pixel *expix1, Pixel *expix2, unsigned int prevX, unsigned int prevY, signed int *brutS, signed int *brutD, int buffratio, int precalCoef[BUFFPOINTNB][BUFFPOINTNB]);
+static void c_zoom_rows (Pixel *expix1, Pixel *expix2, unsigned int prevX, unsigned int prevY, signed int *brutS, signed int *brutD, int buffratio, int precalCoef[BUFFPOINTNB][BUFFPOINTNB], int start, int end);
 
 /* simple wrapper to give it the same proto than the others */
 void zoom_filter_c (int sizeX, int sizeY, Pixel *src, Pixel *dest, int *brutS, int *brutD, int buffratio, int precalCoef[16][16]) {
     c_zoom(src, dest, sizeX, sizeY, brutS, brutD, buffratio, precalCoef);
 }
 
+void zoom_filter_c_rows (int sizeX, int sizeY, Pixel *src, Pixel *dest, int *brutS, int *brutD, int buffratio, int precalCoef[16][16], int start, int end) {
+    c_zoom_rows(src, dest, sizeX, sizeY, brutS, brutD, buffratio, precalCoef, start, end);
+}
+
 static void generatePrecalCoef (int precalCoef[BUFFPOINTNB][BUFFPOINTNB]);
 
 
@@ -403,18 +409,24 @@ static void makeZoomBufferStripe(ZoomFilterFXWrapperData * data, int INTERLACE_I
 
 static void c_zoom (Pixel *expix1, Pixel *expix2, unsigned int prevX, unsigned int prevY, signed int *brutS, signed int *brutD,
                     int buffratio, int precalCoef[16][16])
+{
+    expix1[0].val=expix1[prevX-1].val=expix1[prevX*prevY-1].val=expix1[prevX*prevY-prevX].val=0;
+    c_zoom_rows(expix1, expix2, prevX, prevY, brutS, brutD, buffratio, precalCoef, 0, prevY);
+}
+
+/* lines [start..end[ of the destination, the corners of expix1 must be black */
+static void c_zoom_rows (Pixel *expix1, Pixel *expix2, unsigned int prevX, unsigned int prevY, signed int *brutS, signed int *brutD,
+                         int buffratio, int precalCoef[16][16], int start, int end)
 {
     int     myPos, myPos2;
     Color   couleur;
     
     unsigned int ax = (prevX - 1) << PERTEDEC, ay = (prevY - 1) << PERTEDEC;
     
-    int     bufsize = prevX * prevY * 2;
+    int     bufsize = prevX * end * 2;
     int     bufwidth = prevX;
     
-    expix1[0].val=expix1[prevX-1].val=expix1[prevX*prevY-1].val=expix1[prevX*prevY-prevX].val=0;
-    
-    for (myPos = 0; myPos < bufsize; myPos += 2) {
+    for (myPos = prevX * start * 2; myPos < bufsize; myPos += 2) {
         Color   col1, col2, col3, col4;
         int     c1, c2, c3, c4, px, py;
         int     pos;
@@ -509,6 +521,23 @@ static void generateTheWaterFXHorizontalDirectionBuffer(PluginInfo *goomInfo, Zo
 
 
 
+/* one horizontal stripe of the zoom, called from the worker threads */
+typedef struct {
+    PluginInfo *goomInfo;
+    ZoomFilterFXWrapperData *data;
+    Pixel *src, *dest;
+} ZoomStripe;
+
+static void zoom_stripe (void *priv, int start, int end)
+{
+    ZoomStripe *stripe = (ZoomStripe*)priv;
+    ZoomFilterFXWrapperData *data = stripe->data;
+    
+    stripe->goomInfo->methods.zoom_filter_rows (data->prevX, data->prevY, stripe->src, stripe->dest,
+                                                data->brutS, data->brutD, data->buffratio, data->precalCoef,
+                                                start, end);
+}
+
 /**
 * Main work for the dynamic displacement map.
  * 
@@ -641,8 +670,20 @@ void zoomFilterFastRGB (PluginInfo *goomInfo, Pixel * pix1, Pixel * pix2, ZoomFi
     
     data->zoom_width = data->prevX;
     
-    goomInfo->methods.zoom_filter (data->prevX, data->prevY, pix1, pix2,
-                                   data->brutS, data->brutD, data->buffratio, data->precalCoef);
+    if (goomInfo->methods.zoom_filter_rows) {
+        ZoomStripe stripe;
+        
+        pix1[0].val=pix1[data->prevX-1].val=pix1[data->prevX*data->prevY-1].val=pix1[data->prevX*data->prevY-data->prevX].val=0;
+        
+        stripe.goomInfo = goomInfo;
+        stripe.data = data;
+        stripe.src = pix1;
+        stripe.dest = pix2;
+        goom_threads_run(goomInfo->threads, zoom_stripe, &stripe, data->prevY);
+    }
+    else
+        goomInfo->methods.zoom_filter (data->prevX, data->prevY, pix1, pix2,
+                                       data->brutS, data->brutD, data->buffratio, data->precalCoef);
 }
 
 static void generatePrecalCoef (int precalCoef[16][16])
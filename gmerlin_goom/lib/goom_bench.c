@@ -0,0 +1,93 @@
+/* goom_bench.c: Renders goom without display. Synthetic PCM (a sweeping
+ * sine with noise bursts as beats) is passed to goom_update and the
+ * frames per second are reported. */
+
+#include <config.h>
+#include <goom.h>
+#include <goom_threads.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define SAMPLERATE 44100
+#define FPS        25
+
+static void make_pcm (gint16 data[2][512], int frame)
+{
+	int i;
+	int sample = frame * (SAMPLERATE / FPS);
+	/* one beat every 12 frames (125 bpm) */
+	int beat = (frame % 12) < 2;
+	double freq = 220.0 + 200.0 * sin (frame * 0.01);
+
+	for (i = 0; i < 512; i++) {
+		double t = (double)(sample + i) / SAMPLERATE;
+		double v = 0.4 * sin (2.0 * M_PI * freq * t);
+
+		if (beat)
+			v += 0.5 * ((double)rand () / RAND_MAX - 0.5);
+
+		data[0][i] = (gint16)(v * 32767.0);
+		data[1][i] = (gint16)(v * 0.8 * 32767.0);
+	}
+}
+
+int main (int argc, char **argv)
+{
+	int i;
+	int width = 1920, height = 1080;
+	int frames = 250;
+	int threads = 0;
+	gint16 data[2][512];
+	PluginInfo *goom;
+	struct timeval start, end;
+	double seconds;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp (argv[i], "-s") && (i < argc - 1)) {
+			if (sscanf (argv[++i], "%dx%d", &width, &height) < 2)
+				break;
+		}
+		else if (!strcmp (argv[i], "-f") && (i < argc - 1))
+			frames = atoi (argv[++i]);
+		else if (!strcmp (argv[i], "-t") && (i < argc - 1))
+			threads = atoi (argv[++i]);
+		else
+			break;
+	}
+	if (i < argc) {
+		fprintf (stderr, "usage: %s [-s <width>x<height>] [-f <frames>] [-t <threads>]\n", argv[0]);
+		return 1;
+	}
+
+	srand (0);
+	goom = goom_init (width, height);
+
+	/* Default is one thread per CPU */
+	if (threads > 0) {
+		goom_threads_free (goom->threads);
+		goom->threads = goom_threads_new (threads);
+	}
+
+	/* warm up */
+	for (i = 0; i < FPS; i++) {
+		make_pcm (data, i);
+		goom_update (goom, data, 0, FPS, NULL, NULL);
+	}
+
+	gettimeofday (&start, NULL);
+	for (i = 0; i < frames; i++) {
+		make_pcm (data, i + FPS);
+		goom_update (goom, data, 0, FPS, NULL, NULL);
+	}
+	gettimeofday (&end, NULL);
+
+	seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) * 1.0e-6;
+	printf ("%dx%d: %d frames in %.2f s, %.1f fps\n", width, height, frames, seconds, frames / seconds);
+
+	goom_close (goom);
+	return 0;
+}
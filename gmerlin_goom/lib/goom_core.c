@@ -26,6 +26,7 @@
 #include <goom_plugin_info.h>
 #include <goom_fx.h>
 #include <goomsl.h>
+#include <goom_threads.h>
 
 /* #define VERBOSE */
 
@@ -766,6 +767,7 @@ void goom_close (PluginInfo *goomInfo)
     goomInfo->star_fx.free(&goomInfo->star_fx);
     goomInfo->tentacles_fx.free(&goomInfo->tentacles_fx);
     goomInfo->zoomFilter_fx.free(&goomInfo->zoomFilter_fx);
+    goom_threads_free(goomInfo->threads);
     
     free(goomInfo);
 }
@@ -0,0 +1,141 @@
+#include <config.h>
+#include <goom_threads.h>
+
+#include <stdlib.h>
+#include <pthread.h>
+
+/* Minimum number of lines per stripe, smaller images are not worth
+   waking up the threads */
+#define MIN_STRIPE_HEIGHT 16
+
+typedef struct {
+	GoomThreads *t;
+	pthread_t thread;
+	int index;
+} GoomWorker;
+
+struct _GOOM_THREADS {
+	int num; /* including the calling thread */
+	GoomWorker *workers;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t start_cond;
+	pthread_cond_t done_cond;
+
+	unsigned int generation;
+	int pending;
+	int quit;
+
+	/* current job */
+	GoomStripeFunc func;
+	void *data;
+	int height;
+	int stripes;
+};
+
+static void *worker_func(void *priv)
+{
+	GoomWorker *w = (GoomWorker*)priv;
+	GoomThreads *t = w->t;
+	unsigned int generation = 0;
+
+	pthread_mutex_lock(&t->mutex);
+	while (1) {
+		while ((t->generation == generation) && !t->quit)
+			pthread_cond_wait(&t->start_cond, &t->mutex);
+
+		if (t->quit)
+			break;
+
+		generation = t->generation;
+
+		if (w->index < t->stripes - 1) {
+			int start = t->height * w->index / t->stripes;
+			int end = t->height * (w->index + 1) / t->stripes;
+
+			pthread_mutex_unlock(&t->mutex);
+			t->func(t->data, start, end);
+			pthread_mutex_lock(&t->mutex);
+
+			if (!--t->pending)
+				pthread_cond_signal(&t->done_cond);
+		}
+	}
+	pthread_mutex_unlock(&t->mutex);
+	return NULL;
+}
+
+GoomThreads *goom_threads_new(int num)
+{
+	int i;
+	GoomThreads *t = (GoomThreads*)calloc(1, sizeof(GoomThreads));
+
+	if (num < 1)
+		num = 1;
+
+	pthread_mutex_init(&t->mutex, NULL);
+	pthread_cond_init(&t->start_cond, NULL);
+	pthread_cond_init(&t->done_cond, NULL);
+
+	t->workers = (GoomWorker*)calloc(num, sizeof(GoomWorker));
+	t->num = 1;
+
+	for (i = 0; i < num - 1; i++) {
+		t->workers[i].t = t;
+		t->workers[i].index = i;
+		if (pthread_create(&t->workers[i].thread, NULL, worker_func, &t->workers[i]))
+			break;
+		t->num++;
+	}
+	return t;
+}
+
+void goom_threads_free(GoomThreads *t)
+{
+	int i;
+
+	pthread_mutex_lock(&t->mutex);
+	t->quit = 1;
+	pthread_cond_broadcast(&t->start_cond);
+	pthread_mutex_unlock(&t->mutex);
+
+	for (i = 0; i < t->num - 1; i++)
+		pthread_join(t->workers[i].thread, NULL);
+
+	pthread_mutex_destroy(&t->mutex);
+	pthread_cond_destroy(&t->start_cond);
+	pthread_cond_destroy(&t->done_cond);
+	free(t->workers);
+	free(t);
+}
+
+void goom_threads_run(GoomThreads *t, GoomStripeFunc func, void *data, int height)
+{
+	int stripes = t->num;
+
+	if (stripes > height / MIN_STRIPE_HEIGHT)
+		stripes = height / MIN_STRIPE_HEIGHT;
+
+	if (stripes < 2) {
+		func(data, 0, height);
+		return;
+	}
+
+	pthread_mutex_lock(&t->mutex);
+	t->func = func;
+	t->data = data;
+	t->height = height;
+	t->stripes = stripes;
+	t->pending = stripes - 1;
+	t->generation++;
+	pthread_cond_broadcast(&t->start_cond);
+	pthread_mutex_unlock(&t->mutex);
+
+	/* The last stripe is ours */
+	func(data, height * (stripes - 1) / stripes, height);
+
+	pthread_mutex_lock(&t->mutex);
+	while (t->pending)
+		pthread_cond_wait(&t->done_cond, &t->mutex);
+	pthread_mutex_unlock(&t->mutex);
+}
@@ -4,6 +4,7 @@
 #include <cpu_info.h>
 #include <default_scripts.h>
 #include <drawmethods.h>
+#include <goom_threads.h>
 #include <math.h>
 #include <stdio.h>
 
@@ -20,6 +21,10 @@
 #include "mmx.h"
 #endif /* CPU_X86 */
 
+#ifdef HAVE_SSE2
+#include "sse2.h"
+#endif /* HAVE_SSE2 */
+
 
 
 static void setOptimizedMethods(PluginInfo *p) {
@@ -29,6 +34,7 @@ static void setOptimizedMethods(PluginInfo *p) {
     /* set default methods */
     p->methods.draw_line = draw_line;
     p->methods.zoom_filter = zoom_filter_c;
+    p->methods.zoom_filter_rows = zoom_filter_c_rows;
 /*    p->methods.create_output_with_brightness = create_output_with_brightness;*/
 
 #ifdef CPU_X86
@@ -38,6 +44,7 @@ static void setOptimizedMethods(PluginInfo *p) {
 #endif
 		p->methods.draw_line = draw_line_mmx;
 		p->methods.zoom_filter = zoom_filter_xmmx;
+		p->methods.zoom_filter_rows = NULL;
 	}
 	else if (cpuFlavour & CPU_OPTION_MMX) {
 #ifdef VERBOSE
@@ -45,14 +52,23 @@ static void setOptimizedMethods(PluginInfo *p) {
 #endif
 		p->methods.draw_line = draw_line_mmx;
 		p->methods.zoom_filter = zoom_filter_mmx;
+		p->methods.zoom_filter_rows = NULL;
 	}
 #ifdef VERBOSE
         else
             printf ("Too bad ! No SIMD optimization available for your CPU.\n");
 #endif
 #endif /* CPU_X86 */
+
+#ifdef HAVE_SSE2
+	if (cpuFlavour & CPU_OPTION_SSE2) {
+		p->methods.zoom_filter = zoom_filter_sse2;
+		p->methods.zoom_filter_rows = zoom_filter_sse2_rows;
+	}
+#endif /* HAVE_SSE2 */
 	
 #ifdef CPU_POWERPC
+        p->methods.zoom_filter_rows = NULL;
 
         if ((cpuFlavour & CPU_OPTION_64_BITS) != 0) {
 /*            p->methods.create_output_with_brightness = ppc_brightness_G5;        */
@@ -171,6 +187,7 @@ void plugin_info_init(PluginInfo *pp, int nbVisuals) {
 	}
 	
 	setOptimizedMethods(pp);
+	pp->threads = goom_threads_new(cpu_number());
 	
     pp->scanner = gsl_new();
     pp->main_scanner = gsl_new();
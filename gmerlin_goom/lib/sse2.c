@@ -0,0 +1,117 @@
+#include <config.h>
+
+#ifdef HAVE_SSE2
+
+#include <emmintrin.h>
+
+#include <sse2.h>
+#include <goom_graphic.h>
+
+#define BUFFPOINTNB 16
+
+#define sqrtperte 16
+// faire : a % sqrtperte <=> a & pertemask
+#define PERTEMASK 0xf
+// faire : a / sqrtperte <=> a >> PERTEDEC
+#define PERTEDEC 4
+
+/*
+ * Sum of the 4 weighted neighbours of one source pixel, the
+ * 4 channels end up as 16 bit words in the low half of the result.
+ * The coefficients add up to 256 so the sums fit into 16 bits.
+ */
+static inline __m128i zoom_pixel (Pixel *expix1, int pos, int coeffs, int bufwidth)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i c, c12, c34, p12, p34;
+
+	/* [c1 c1 c1 c1 c2 c2 c2 c2] and [c3 c3 c3 c3 c4 c4 c4 c4] */
+	c = _mm_unpacklo_epi8(_mm_cvtsi32_si128(coeffs), zero);
+	c = _mm_unpacklo_epi16(c, c);
+	c12 = _mm_unpacklo_epi32(c, c);
+	c34 = _mm_unpackhi_epi32(c, c);
+
+	/* [col1 col2] and [col3 col4] */
+	p12 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(expix1 + pos)), zero);
+	p34 = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)(expix1 + pos + bufwidth)), zero);
+
+	p12 = _mm_add_epi16(_mm_mullo_epi16(p12, c12), _mm_mullo_epi16(p34, c34));
+	return _mm_add_epi16(p12, _mm_srli_si128(p12, 8));
+}
+
+static inline void zoom_coords (int myPos, signed int *brutS, signed int *brutD, int buffratio,
+                                unsigned int ax, unsigned int ay, unsigned int prevX,
+                                int precalCoef[16][16], int *pos, int *coeffs)
+{
+	int px, py;
+	int brutSmypos = brutS[myPos];
+
+	px = brutSmypos + (((brutD[myPos] - brutSmypos) * buffratio) >> BUFFPOINTNB);
+	brutSmypos = brutS[myPos + 1];
+	py = brutSmypos + (((brutD[myPos + 1] - brutSmypos) * buffratio) >> BUFFPOINTNB);
+
+	if ((py >= ay) || (px >= ax)) {
+		*pos = *coeffs = 0;
+	} else {
+		*pos = ((px >> PERTEDEC) + prevX * (py >> PERTEDEC));
+		/* coef en modulo 15 */
+		*coeffs = precalCoef[px & PERTEMASK][py & PERTEMASK];
+	}
+}
+
+void zoom_filter_sse2_rows (int prevX, int prevY, Pixel *expix1, Pixel *expix2,
+                            int *brutS, int *brutD, int buffratio, int precalCoef[16][16],
+                            int start, int end)
+{
+	unsigned int ax = (prevX - 1) << PERTEDEC, ay = (prevY - 1) << PERTEDEC;
+
+	int myPos = prevX * start * 2;
+	int bufsize = prevX * end * 2;
+
+	const __m128i five = _mm_set1_epi16(5);
+	const __m128i amask = _mm_set1_epi32(0xff << A_OFFSET);
+
+	/* 2 pixels per loop */
+	for (; myPos + 2 < bufsize; myPos += 4) {
+		int pos1, coeffs1, pos2, coeffs2;
+		__m128i sum, dst;
+
+		zoom_coords(myPos, brutS, brutD, buffratio, ax, ay, prevX, precalCoef, &pos1, &coeffs1);
+		zoom_coords(myPos + 2, brutS, brutD, buffratio, ax, ay, prevX, precalCoef, &pos2, &coeffs2);
+
+		sum = _mm_unpacklo_epi64(zoom_pixel(expix1, pos1, coeffs1, prevX),
+		                         zoom_pixel(expix1, pos2, coeffs2, prevX));
+
+		/* if (sum > 5) sum -= 5; sum >>= 8 */
+		sum = _mm_srli_epi16(_mm_subs_epu16(sum, five), 8);
+		sum = _mm_packus_epi16(sum, sum);
+
+		/* keep the alpha of the destination */
+		dst = _mm_loadl_epi64((__m128i*)(expix2 + (myPos >> 1)));
+		sum = _mm_or_si128(_mm_andnot_si128(amask, sum), _mm_and_si128(amask, dst));
+		_mm_storel_epi64((__m128i*)(expix2 + (myPos >> 1)), sum);
+	}
+
+	/* odd number of pixels */
+	if (myPos < bufsize) {
+		int pos, coeffs;
+		__m128i sum;
+
+		zoom_coords(myPos, brutS, brutD, buffratio, ax, ay, prevX, precalCoef, &pos, &coeffs);
+		sum = zoom_pixel(expix1, pos, coeffs, prevX);
+		sum = _mm_srli_epi16(_mm_subs_epu16(sum, five), 8);
+		sum = _mm_packus_epi16(sum, sum);
+
+		expix2[myPos >> 1].val = (_mm_cvtsi128_si32(sum) & ~(0xff << A_OFFSET)) |
+			(expix2[myPos >> 1].val & (0xff << A_OFFSET));
+	}
+}
+
+void zoom_filter_sse2 (int prevX, int prevY, Pixel *expix1, Pixel *expix2,
+                       int *brutS, int *brutD, int buffratio, int precalCoef[16][16])
+{
+	expix1[0].val=expix1[prevX-1].val=expix1[prevX*prevY-1].val=expix1[prevX*prevY-prevX].val=0;
+	zoom_filter_sse2_rows(prevX, prevY, expix1, expix2, brutS, brutD, buffratio, precalCoef, 0, prevY);
+}
+
+#endif /* HAVE_SSE2 */